@@ -0,0 +1,165 @@
+#include "pch.h"
+#include "CoalescingFileWriter.h"
+
+#include <common/logger/logger.h>
+
+CoalescingFileWriter::CoalescingFileWriter(std::vector<std::function<void()>> writeFiles, Clock::duration delay) :
+    m_writeFiles(std::move(writeFiles)),
+    m_delay(delay),
+    m_deadlines(m_writeFiles.size())
+{
+}
+
+CoalescingFileWriter::~CoalescingFileWriter()
+{
+    FlushAll();
+
+    std::thread worker;
+    {
+        std::unique_lock lock(m_mutex);
+        m_abort = true;
+        worker = std::move(m_thread);
+    }
+    m_cv.notify_all();
+
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void CoalescingFileWriter::MarkDirty(size_t file)
+{
+    // A worker that ran out of dirty files has exited or is about to, it is joined outside the lock
+    std::thread finished;
+    {
+        std::unique_lock lock(m_mutex);
+        if (m_abort || m_deadlines[file])
+        {
+            return;
+        }
+
+        m_deadlines[file] = Clock::now() + m_delay;
+
+        if (!m_running)
+        {
+            m_running = true;
+            finished = std::move(m_thread);
+            m_thread = std::thread([this]() { Run(); });
+        }
+    }
+    m_cv.notify_all();
+
+    if (finished.joinable())
+    {
+        finished.join();
+    }
+}
+
+void CoalescingFileWriter::Flush(size_t file)
+{
+    std::unique_lock lock(m_mutex);
+    m_cv.wait(lock, [this]() { return !m_writing; });
+
+    if (m_deadlines[file])
+    {
+        m_deadlines[file].reset();
+        Write(file, lock);
+    }
+}
+
+void CoalescingFileWriter::FlushAll()
+{
+    for (size_t file = 0; file < m_writeFiles.size(); file++)
+    {
+        Flush(file);
+    }
+}
+
+void CoalescingFileWriter::Discard(size_t file)
+{
+    {
+        std::unique_lock lock(m_mutex);
+        m_deadlines[file].reset();
+    }
+    m_cv.notify_all();
+}
+
+void CoalescingFileWriter::SetDelay(Clock::duration delay)
+{
+    std::unique_lock lock(m_mutex);
+    m_delay = delay;
+}
+
+size_t CoalescingFileWriter::WriteCount() const
+{
+    std::unique_lock lock(m_mutex);
+    return m_writeCount;
+}
+
+bool CoalescingFileWriter::IsRunning() const
+{
+    std::unique_lock lock(m_mutex);
+    return m_running;
+}
+
+void CoalescingFileWriter::Run()
+{
+    std::unique_lock lock(m_mutex);
+
+    while (!m_abort)
+    {
+        std::optional<size_t> next;
+        for (size_t file = 0; file < m_deadlines.size(); file++)
+        {
+            if (m_deadlines[file] && (!next || *m_deadlines[file] < *m_deadlines[*next]))
+            {
+                next = file;
+            }
+        }
+
+        if (!next)
+        {
+            // Nothing left to write, MarkDirty starts a new worker
+            break;
+        }
+
+        if (Clock::now() < *m_deadlines[*next])
+        {
+            m_cv.wait_until(lock, *m_deadlines[*next]);
+            continue;
+        }
+
+        if (m_writing)
+        {
+            // Flush is writing on another thread
+            m_cv.wait(lock);
+            continue;
+        }
+
+        m_deadlines[*next].reset();
+        Write(*next, lock);
+    }
+
+    m_running = false;
+}
+
+void CoalescingFileWriter::Write(size_t file, std::unique_lock<std::mutex>& lock)
+{
+    m_writing = true;
+    lock.unlock();
+
+    try
+    {
+        m_writeFiles[file]();
+    }
+    catch (...)
+    {
+        Logger::error("Failed to write FancyZones data file {}", file);
+    }
+
+    lock.lock();
+    m_writing = false;
+    m_writeCount++;
+    m_cv.notify_all();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * Write-behind for the data files. A change marks its file dirty and a worker thread writes the
+ * file once the coalescing delay has passed since the first change, so a burst of changes costs
+ * a single write. The worker runs while files are dirty. Only one write callback runs at a time,
+ * on the worker thread or on the thread calling Flush.
+ */
+class CoalescingFileWriter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @param   writeFiles  Callback writing each file, the files are numbered by their position.
+     * @param   delay       Time from the first change of a file to its write.
+     */
+    CoalescingFileWriter(std::vector<std::function<void()>> writeFiles, Clock::duration delay);
+
+    /**
+     * Writes the dirty files and waits for the worker to stop.
+     */
+    ~CoalescingFileWriter();
+
+    CoalescingFileWriter(const CoalescingFileWriter&) = delete;
+    CoalescingFileWriter& operator=(const CoalescingFileWriter&) = delete;
+
+    void MarkDirty(size_t file);
+
+    /**
+     * Writes the file now if it is dirty, on the calling thread. Returns once the file is on disk,
+     * including when the worker was writing it. Must not be called with a lock the write callbacks
+     * take.
+     */
+    void Flush(size_t file);
+    void FlushAll();
+
+    /**
+     * Forgets the pending write of the file, for instance when its content is read back from disk.
+     */
+    void Discard(size_t file);
+
+    /**
+     * Applies to the files marked dirty from now on.
+     */
+    void SetDelay(Clock::duration delay);
+
+    // Number of times a file was written
+    size_t WriteCount() const;
+    bool IsRunning() const;
+
+private:
+    void Run();
+    void Write(size_t file, std::unique_lock<std::mutex>& lock);
+
+    const std::vector<std::function<void()>> m_writeFiles;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    Clock::duration m_delay;
+    // Time at which each dirty file is written, none if the file is clean
+    std::vector<std::optional<Clock::time_point>> m_deadlines;
+    // A write callback runs, with m_mutex released
+    bool m_writing = false;
+    bool m_running = false;
+    bool m_abort = false;
+    size_t m_writeCount = 0;
+    std::thread m_thread;
+};
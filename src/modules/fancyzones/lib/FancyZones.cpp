@@ -11,6 +11,7 @@
 #include "lib/FancyZonesData.h"
 #include "lib/ZoneSet.h"
 #include "lib/FileWatcher.h"
+#include "lib/LocationChangeCoalescer.h"
 #include "lib/WindowMoveHandler.h"
 #include "lib/FancyZonesWinHookEventIDs.h"
 #include "lib/util.h"
@@ -23,6 +24,8 @@
 
 #include <lib/SecondaryMouseButtonsHook.h>
 
+#include <chrono>
+
 enum class DisplayChangeType
 {
     WorkArea,
@@ -35,6 +38,9 @@ namespace
 {
     constexpr int CUSTOM_POSITIONING_LEFT_TOP_PADDING = 16;
 
+    // Timer of the location change deferred to the next frame of the display
+    constexpr UINT_PTR MOVESIZE_UPDATE_TIMER_ID = 1;
+
     struct require_read_lock
     {
         template<typename T>
@@ -75,7 +81,10 @@ public:
         m_hinstance(hinstance),
         m_settings(settings),
         m_windowMoveHandler(settings, [this]() {
-            PostMessageW(m_window, WM_PRIV_LOCATIONCHANGE, NULL, NULL);
+            if (m_locationChanges.RequestUpdate())
+            {
+                PostMessageW(m_window, WM_PRIV_LOCATIONCHANGE, NULL, NULL);
+            }
         }),
         m_fileWatcher(FancyZonesDataInstance().GetZonesSettingsFileName(), [this]() {
             PostMessageW(m_window, WM_PRIV_FILE_UPDATE, NULL, NULL);
@@ -128,13 +137,19 @@ public:
         switch (data->event)
         {
         case EVENT_SYSTEM_MOVESIZESTART:
+            m_locationChanges.StartTracking(data->hwnd);
             PostMessageW(m_window, WM_PRIV_MOVESIZESTART, wparam, lparam);
             break;
         case EVENT_SYSTEM_MOVESIZEEND:
+            m_locationChanges.StopTracking();
             PostMessageW(m_window, WM_PRIV_MOVESIZEEND, wparam, lparam);
             break;
         case EVENT_OBJECT_LOCATIONCHANGE:
-            PostMessageW(m_window, WM_PRIV_LOCATIONCHANGE, wparam, lparam);
+            // The update is queued once, it uses the cursor position when it is handled
+            if (m_locationChanges.OnLocationChange(data->hwnd, data->idObject))
+            {
+                PostMessageW(m_window, WM_PRIV_LOCATIONCHANGE, NULL, lparam);
+            }
             break;
         case EVENT_OBJECT_NAMECHANGE:
             PostMessageW(m_window, WM_PRIV_NAMECHANGE, wparam, lparam);
@@ -221,6 +236,7 @@ private:
     bool OnSnapHotkeyBasedOnZoneNumber(HWND window, DWORD vkCode) noexcept;
     bool OnSnapHotkeyBasedOnPosition(HWND window, DWORD vkCode) noexcept;
     bool OnSnapHotkey(DWORD vkCode) noexcept;
+    void OnLocationChange(POINT const& ptScreen) noexcept;
     bool ProcessDirectedSnapHotkey(HWND window, DWORD vkCode, bool cycle, winrt::com_ptr<IZoneWindow> zoneWindow) noexcept;
 
     void RegisterVirtualDesktopUpdates(std::vector<GUID>& ids) noexcept;
@@ -247,6 +263,10 @@ private:
     mutable std::shared_mutex m_lock;
     HWND m_window{};
     WindowMoveHandler m_windowMoveHandler;
+    LocationChangeCoalescer m_locationChanges;
+    std::chrono::steady_clock::duration m_frameInterval{};
+    std::chrono::steady_clock::time_point m_lastMoveSizeUpdate{};
+    bool m_moveSizeUpdateScheduled = false;
     MonitorWorkAreaHandler m_workAreaHandler;
     FileWatcher m_fileWatcher;
 
@@ -340,6 +360,9 @@ FancyZones::Destroy() noexcept
     {
         SetEvent(m_terminateVirtualDesktopTrackerEvent.get());
     }
+
+    // The zone history of the last dropped windows may not be written yet
+    FancyZonesDataInstance().FlushPendingSaves();
 }
 
 // IFancyZonesCallback
@@ -720,6 +743,7 @@ void FancyZones::ToggleEditor() noexcept
     params += monitorsDataStr;
 
     FancyZonesDataInstance().SaveFancyZonesEditorParameters(spanZonesAcrossMonitors, virtualDesktopId.get(), targetMonitor); /* Write parameters to json file */
+    FancyZonesDataInstance().FlushPendingSaves(); /* The editor reads the zone settings file */
 
     if (showDpiWarning)
     {
@@ -826,6 +850,22 @@ LRESULT FancyZones::WndProc(HWND window, UINT message, WPARAM wparam, LPARAM lpa
     }
     break;
 
+    case WM_TIMER:
+    {
+        if (wparam == MOVESIZE_UPDATE_TIMER_ID)
+        {
+            KillTimer(window, MOVESIZE_UPDATE_TIMER_ID);
+            m_moveSizeUpdateScheduled = false;
+            if (InMoveSize())
+            {
+                POINT ptScreen;
+                GetPhysicalCursorPos(&ptScreen);
+                OnLocationChange(ptScreen);
+            }
+        }
+    }
+    break;
+
     default:
     {
         POINT ptScreen;
@@ -872,19 +912,29 @@ LRESULT FancyZones::WndProc(HWND window, UINT message, WPARAM wparam, LPARAM lpa
             auto hwnd = reinterpret_cast<HWND>(wparam);
             if (auto monitor = MonitorFromPoint(ptScreen, MONITOR_DEFAULTTONULL))
             {
+                m_frameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / FancyZonesUtils::GetRefreshRateForMonitor(monitor);
+                m_lastMoveSizeUpdate = {};
                 MoveSizeStart(hwnd, monitor, ptScreen);
             }
         }
         else if (message == WM_PRIV_MOVESIZEEND)
         {
             auto hwnd = reinterpret_cast<HWND>(wparam);
+            if (m_moveSizeUpdateScheduled)
+            {
+                KillTimer(window, MOVESIZE_UPDATE_TIMER_ID);
+                m_moveSizeUpdateScheduled = false;
+            }
             MoveSizeEnd(hwnd, ptScreen);
+
+            const auto counters = m_locationChanges.GetCounters();
+            Logger::trace("Location changes during the drag: received {}, dropped {}, processed {}", counters.received, counters.dropped, counters.processed);
         }
-        else if (message == WM_PRIV_LOCATIONCHANGE && InMoveSize())
+        else if (message == WM_PRIV_LOCATIONCHANGE)
         {
-            if (auto monitor = MonitorFromPoint(ptScreen, MONITOR_DEFAULTTONULL))
+            if (m_locationChanges.Drain() && InMoveSize())
             {
-                MoveSizeUpdate(monitor, ptScreen);
+                OnLocationChange(ptScreen);
             }
         }
         else if (message == WM_PRIV_WINDOWCREATED)
@@ -1276,6 +1326,36 @@ bool FancyZones::ProcessDirectedSnapHotkey(HWND window, DWORD vkCode, bool cycle
     }
 }
 
+void FancyZones::OnLocationChange(POINT const& ptScreen) noexcept
+{
+    // The cursor reports positions faster than the display refreshes. Updates closer than a frame
+    // to the previous one wait for the next frame, the timer then takes the cursor position of
+    // that time. Timers are not shorter than USER_TIMER_MINIMUM, so on fast displays the last
+    // update of a burst can come a little later than the next frame.
+    const auto now = std::chrono::steady_clock::now();
+    const auto nextFrame = m_lastMoveSizeUpdate + m_frameInterval;
+    if (now < nextFrame)
+    {
+        if (m_moveSizeUpdateScheduled)
+        {
+            return;
+        }
+
+        const auto delay = std::chrono::ceil<std::chrono::milliseconds>(nextFrame - now);
+        if (SetTimer(m_window, MOVESIZE_UPDATE_TIMER_ID, static_cast<UINT>(delay.count()), nullptr))
+        {
+            m_moveSizeUpdateScheduled = true;
+            return;
+        }
+    }
+
+    m_lastMoveSizeUpdate = now;
+    if (auto monitor = MonitorFromPoint(ptScreen, MONITOR_DEFAULTTONULL))
+    {
+        MoveSizeUpdate(monitor, ptScreen);
+    }
+}
+
 void FancyZones::RegisterVirtualDesktopUpdates(std::vector<GUID>& ids) noexcept
 {
     _TRACER_;
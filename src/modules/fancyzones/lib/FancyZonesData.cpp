@@ -34,6 +34,9 @@ namespace NonLocalizable
 
 namespace
 {
+    // Time a burst of window drops has to reach the files as one write
+    const auto SaveDelay = std::chrono::milliseconds(1000);
+
     std::wstring ExtractVirtualDesktopId(const std::wstring& deviceId)
     {
         // Format: <device-id>_<resolution>_<virtual-desktop-id>
@@ -145,7 +148,8 @@ FancyZonesData& FancyZonesDataInstance()
     return instance;
 }
 
-FancyZonesData::FancyZonesData()
+FancyZonesData::FancyZonesData() :
+    pendingSaves({ [this]() { SaveZoneSettings(); }, [this]() { SaveAppZoneHistory(); } }, SaveDelay)
 {
     std::wstring saveFolderPath = PTSettingsHelper::get_module_save_folder_location(NonLocalizable::FancyZonesStr);
 
@@ -281,7 +285,7 @@ void FancyZonesData::UpdatePrimaryDesktopData(const std::wstring& desktopId)
     // TODO: when updating the primary desktop GUID, the app zone history also needs to be updated 
     if (dirtyFlag)
     {
-        SaveZoneSettings();
+        pendingSaves.MarkDirty(ZoneSettingsFile);
     }
 }
 
@@ -435,7 +439,7 @@ bool FancyZonesData::RemoveAppLastZone(HWND window, const std::wstring_view& dev
                     {
                         appZoneHistoryMap.erase(processPath);
                     }
-                    SaveAppZoneHistory();
+                    pendingSaves.MarkDirty(AppZoneHistoryFile);
                     return true;
                 }
                 else
@@ -480,7 +484,7 @@ bool FancyZonesData::SetAppLastZones(HWND window, const std::wstring& deviceId,
                 data.processIdToHandleMap[processId] = window;
                 data.zoneSetUuid = zoneSetId;
                 data.zoneIndexSet = zoneIndexSet;
-                SaveAppZoneHistory();
+                pendingSaves.MarkDirty(AppZoneHistoryFile);
                 return true;
             }
         }
@@ -504,7 +508,7 @@ bool FancyZonesData::SetAppLastZones(HWND window, const std::wstring& deviceId,
         appZoneHistoryMap[processPath] = std::vector<FancyZonesDataTypes::AppZoneHistoryData>{ data };
     }
 
-    SaveAppZoneHistory();
+    pendingSaves.MarkDirty(AppZoneHistoryFile);
     return true;
 }
 
@@ -548,6 +552,11 @@ json::JsonObject FancyZonesData::GetPersistFancyZonesJSON()
 
 void FancyZonesData::LoadFancyZonesData()
 {
+    // The zone settings file is reloaded when the editor changed it, the pending changes of the
+    // zone settings must not overwrite it. The app zone history is only written by FancyZones.
+    pendingSaves.Discard(ZoneSettingsFile);
+    pendingSaves.Flush(AppZoneHistoryFile);
+
     if (!std::filesystem::exists(zonesSettingsFileName))
     {
         SaveAppZoneHistoryAndZoneSettings();
@@ -583,6 +592,16 @@ void FancyZonesData::SaveAppZoneHistory() const
     JSONHelpers::SaveAppZoneHistory(appZoneHistoryFileName, appZoneHistoryMap);
 }
 
+void FancyZonesData::FlushPendingSaves()
+{
+    pendingSaves.FlushAll();
+}
+
+void FancyZonesData::SetSaveDelay(CoalescingFileWriter::Clock::duration delay)
+{
+    pendingSaves.SetDelay(delay);
+}
+
 void FancyZonesData::SaveFancyZonesEditorParameters(bool spanZonesAcrossMonitors, const std::wstring& virtualDesktopId, const HMONITOR& targetMonitor) const
 {
     JSONHelpers::EditorArgs argsJson; /* json arguments */
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "JsonHelpers.h"
+#include "CoalescingFileWriter.h"
 
 #include <common/SettingsAPI/settings_helpers.h>
 #include <common/utils/json.h>
@@ -79,6 +80,12 @@ public:
     void SaveZoneSettings() const;
     void SaveAppZoneHistory() const;
 
+    /**
+     * Writes the changes whose save is still pending, must not be called with the data lock held.
+     */
+    void FlushPendingSaves();
+    void SetSaveDelay(CoalescingFileWriter::Clock::duration delay);
+
     void SaveFancyZonesEditorParameters(bool spanZonesAcrossMonitors, const std::wstring& virtualDesktopId, const HMONITOR& targetMonitor) const;
 
 private:
@@ -119,6 +126,13 @@ private:
         appZoneHistoryFileName = result + L"\\" + std::wstring(L"app-zone-history.json");
     }
 #endif
+    // Files written by pendingSaves
+    enum DataFile : size_t
+    {
+        ZoneSettingsFile,
+        AppZoneHistoryFile,
+    };
+
     void RemoveDesktopAppZoneHistory(const std::wstring& desktopId);
 
     // Maps app path to app's zone history data
@@ -135,6 +149,10 @@ private:
     std::wstring editorParametersFileName;
 
     mutable std::recursive_mutex dataLock;
+
+    // Writes the changes made for every window drop with a delay. Declared last so that the
+    // pending changes are written before the data is destroyed.
+    CoalescingFileWriter pendingSaves;
 };
 
 FancyZonesData& FancyZonesDataInstance();
@@ -69,6 +69,20 @@ namespace NonLocalizable
 
 namespace
 {
+    // The file is written next to its destination first and then moved over it, so neither the
+    // editor nor a crash in the middle of the write can see a truncated file
+    void WriteJsonFileAtomically(const std::wstring& fileName, const json::JsonObject& root)
+    {
+        const std::wstring tempFileName = fileName + L".tmp";
+        json::to_file(tempFileName, root);
+
+        if (!MoveFileExW(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            Logger::error(L"Failed to replace {}, error {}", fileName, GetLastError());
+            DeleteFileW(tempFileName.c_str());
+        }
+    }
+
     json::JsonArray NumVecToJsonArray(const std::vector<int>& vec)
     {
         json::JsonArray arr;
@@ -589,7 +603,7 @@ namespace JSONHelpers
         if (!before.has_value() || before.value().Stringify() != root.Stringify())
         {
             Trace::FancyZones::DataChanged();
-            json::to_file(zonesSettingsFileName, root);
+            WriteJsonFileAtomically(zonesSettingsFileName, root);
         }
     }
 
@@ -602,7 +616,7 @@ namespace JSONHelpers
         auto before = json::from_file(appZoneHistoryFileName);
         if (!before.has_value() || before.value().Stringify() != root.Stringify())
         {
-            json::to_file(appZoneHistoryFileName, root);
+            WriteJsonFileAtomically(appZoneHistoryFileName, root);
         }
     }
 
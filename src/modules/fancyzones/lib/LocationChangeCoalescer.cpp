@@ -0,0 +1,57 @@
+#include "pch.h"
+
+#include "LocationChangeCoalescer.h"
+
+void LocationChangeCoalescer::StartTracking(HWND window) noexcept
+{
+    m_received = 0;
+    m_dropped = 0;
+    m_processed = 0;
+    // An update left pending by the previous drag would drop every event of this one
+    m_pending = false;
+    m_window = window;
+}
+
+void LocationChangeCoalescer::StopTracking() noexcept
+{
+    m_window = nullptr;
+    m_pending = false;
+}
+
+bool LocationChangeCoalescer::OnLocationChange(HWND window, LONG idObject) noexcept
+{
+    m_received++;
+
+    // The cursor is followed as well, the dragged window does not move when the system only
+    // draws its outline during the drag
+    const HWND trackedWindow = m_window;
+    const bool tracked = trackedWindow && ((window == trackedWindow && idObject == OBJID_WINDOW) || idObject == OBJID_CURSOR);
+    if (!tracked || m_pending.exchange(true))
+    {
+        m_dropped++;
+        return false;
+    }
+
+    return true;
+}
+
+bool LocationChangeCoalescer::RequestUpdate() noexcept
+{
+    return !m_pending.exchange(true);
+}
+
+bool LocationChangeCoalescer::Drain() noexcept
+{
+    if (!m_pending.exchange(false))
+    {
+        return false;
+    }
+
+    m_processed++;
+    return true;
+}
+
+LocationChangeCoalescer::Counters LocationChangeCoalescer::GetCounters() const noexcept
+{
+    return { m_received, m_dropped, m_processed };
+}
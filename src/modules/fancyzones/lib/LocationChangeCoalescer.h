@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+
+/**
+ * Filters and coalesces the EVENT_OBJECT_LOCATIONCHANGE events received while a window is
+ * dragged. The hook is system-wide, so it reports every window, caret and cursor that moves in
+ * the session; only the dragged window and the cursor are kept. The updates that are kept share
+ * a single pending slot: a message only needs to be posted to the FancyZones thread when the slot
+ * was empty, and draining it handles all the updates received since with the latest cursor
+ * position. Can be called from the hook thread and the FancyZones thread at the same time.
+ */
+class LocationChangeCoalescer
+{
+public:
+    struct Counters
+    {
+        // Location changes reported by the hook
+        uint64_t received = 0;
+        // Location changes that were filtered out or merged into a pending update
+        uint64_t dropped = 0;
+        // Updates handled by the FancyZones thread
+        uint64_t processed = 0;
+    };
+
+    /**
+     * Keeps the location changes of the given window from now on, and resets the counters and
+     * the pending update.
+     */
+    void StartTracking(HWND window) noexcept;
+    void StopTracking() noexcept;
+
+    /**
+     * @param   window    Window of the event.
+     * @param   idObject  Object of the event.
+     *
+     * @returns True if a message has to be posted to drain the pending update.
+     */
+    bool OnLocationChange(HWND window, LONG idObject) noexcept;
+
+    /**
+     * Asks for an update that does not come from the hook, such as a change of the modifier keys.
+     *
+     * @returns True if a message has to be posted to drain the pending update.
+     */
+    bool RequestUpdate() noexcept;
+
+    /**
+     * @returns True if an update was pending. Called by the FancyZones thread for each message.
+     */
+    bool Drain() noexcept;
+
+    Counters GetCounters() const noexcept;
+
+private:
+    std::atomic<HWND> m_window = nullptr;
+    std::atomic<bool> m_pending = false;
+
+    std::atomic<uint64_t> m_received = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+    std::atomic<uint64_t> m_processed = 0;
+};
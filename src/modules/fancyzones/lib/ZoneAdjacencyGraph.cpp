@@ -0,0 +1,149 @@
+#include "pch.h"
+
+#include "ZoneAdjacencyGraph.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr DWORD C_DIRECTIONS[] = { VK_LEFT, VK_UP, VK_RIGHT, VK_DOWN };
+    constexpr size_t C_DIRECTION_COUNT = std::size(C_DIRECTIONS);
+}
+
+ZoneAdjacencyGraph::ZoneAdjacencyGraph(const std::vector<Zone>& zones) :
+    m_zones(zones)
+{
+    for (size_t position = 0; position < m_zones.size(); position++)
+    {
+        const size_t id = m_zones[position].id;
+        if (id >= m_positions.size())
+        {
+            m_positions.resize(id + 1, SIZE_MAX);
+        }
+        m_positions[id] = position;
+    }
+
+    m_neighbors.resize(m_zones.size() * C_DIRECTION_COUNT);
+
+    std::vector<std::pair<double, size_t>> ranked;
+    for (size_t from = 0; from < m_zones.size(); from++)
+    {
+        for (size_t direction = 0; direction < C_DIRECTION_COUNT; direction++)
+        {
+            ranked.clear();
+            for (size_t to = 0; to < m_zones.size(); to++)
+            {
+                if (to == from)
+                {
+                    continue;
+                }
+
+                const double distance = FancyZonesUtils::ZoneDistanceByPosition(C_DIRECTIONS[direction], m_zones[from].rect, m_zones[to].rect, to);
+                if (std::isfinite(distance))
+                {
+                    ranked.emplace_back(distance, to);
+                }
+            }
+
+            // Equal distances keep the zone order, like the first closest zone wins in
+            // ChooseNextZoneByPosition
+            std::stable_sort(ranked.begin(), ranked.end(), [](const auto& first, const auto& second) {
+                return first.first < second.first;
+            });
+
+            auto& neighbors = m_neighbors[from * C_DIRECTION_COUNT + direction];
+            neighbors.reserve(ranked.size());
+            for (const auto& [distance, to] : ranked)
+            {
+                neighbors.push_back(m_zones[to].id);
+            }
+        }
+    }
+}
+
+const std::vector<size_t>& ZoneAdjacencyGraph::Neighbors(size_t zoneId, DWORD vkCode) const noexcept
+{
+    static const std::vector<size_t> none;
+
+    const auto position = Position(zoneId);
+    const auto direction = DirectionIndex(vkCode);
+    if (!position || !direction)
+    {
+        return none;
+    }
+
+    return m_neighbors[*position * C_DIRECTION_COUNT + *direction];
+}
+
+std::optional<size_t> ZoneAdjacencyGraph::NextZone(size_t zoneId, DWORD vkCode, const std::vector<size_t>& excludedZones) const
+{
+    for (size_t neighbor : Neighbors(zoneId, vkCode))
+    {
+        if (std::find(excludedZones.begin(), excludedZones.end(), neighbor) == excludedZones.end())
+        {
+            return neighbor;
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<size_t> ZoneAdjacencyGraph::CycleZone(size_t zoneId, DWORD vkCode, RECT workAreaRect) const
+{
+    const auto position = Position(zoneId);
+    const auto direction = DirectionIndex(vkCode);
+    if (!position || !direction)
+    {
+        return std::nullopt;
+    }
+
+    const LONG width = workAreaRect.right - workAreaRect.left;
+    const LONG height = workAreaRect.bottom - workAreaRect.top;
+    if (m_cycleZones.empty() || width != m_cycleWidth || height != m_cycleHeight)
+    {
+        m_cycleZones.assign(m_neighbors.size(), C_NOT_COMPUTED);
+        m_cycleWidth = width;
+        m_cycleHeight = height;
+    }
+
+    size_t& cycleZone = m_cycleZones[*position * C_DIRECTION_COUNT + *direction];
+    if (cycleZone == C_NOT_COMPUTED)
+    {
+        // All zones are candidates, the zone itself included
+        std::vector<RECT> zoneRects(m_zones.size());
+        std::transform(m_zones.begin(), m_zones.end(), zoneRects.begin(), [](const Zone& zone) { return zone.rect; });
+        const RECT fromRect = FancyZonesUtils::PrepareRectForCycling(m_zones[*position].rect, workAreaRect, vkCode);
+        cycleZone = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, fromRect, zoneRects);
+    }
+
+    if (cycleZone < m_zones.size())
+    {
+        return m_zones[cycleZone].id;
+    }
+
+    return std::nullopt;
+}
+
+std::optional<size_t> ZoneAdjacencyGraph::DirectionIndex(DWORD vkCode) noexcept
+{
+    const auto direction = std::find(std::begin(C_DIRECTIONS), std::end(C_DIRECTIONS), vkCode);
+    if (direction == std::end(C_DIRECTIONS))
+    {
+        return std::nullopt;
+    }
+
+    return static_cast<size_t>(direction - std::begin(C_DIRECTIONS));
+}
+
+std::optional<size_t> ZoneAdjacencyGraph::Position(size_t zoneId) const noexcept
+{
+    if (zoneId >= m_positions.size() || m_positions[zoneId] == SIZE_MAX)
+    {
+        return std::nullopt;
+    }
+
+    return m_positions[zoneId];
+}
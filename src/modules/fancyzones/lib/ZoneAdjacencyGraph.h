@@ -0,0 +1,71 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+/**
+ * Directional neighbors of the zones of one layout, for moving and extending windows with
+ * WIN + arrow keys. For each zone and arrow key, the other zones in that direction are ranked
+ * once, closest first, the way FancyZonesUtils::ChooseNextZoneByPosition ranks them from the
+ * rectangle of the zone. A key press is then a walk down a short list instead of rebuilding the
+ * zone rectangles and scoring all of them.
+ */
+class ZoneAdjacencyGraph
+{
+public:
+    struct Zone
+    {
+        size_t id;
+        RECT rect;
+    };
+
+    ZoneAdjacencyGraph() = default;
+
+    /**
+     * @param   zones  Zones of the layout, in the order ChooseNextZoneByPosition would get them.
+     */
+    explicit ZoneAdjacencyGraph(const std::vector<Zone>& zones);
+
+    /**
+     * @param   zoneId  Id of the zone to start from.
+     * @param   vkCode  Arrow key.
+     *
+     * @returns Ids of the zones in the direction of the arrow key, closest first. Empty for an
+     *          unknown zone or key.
+     */
+    const std::vector<size_t>& Neighbors(size_t zoneId, DWORD vkCode) const noexcept;
+
+    /**
+     * @returns Id of the closest zone in the direction of the arrow key that is not one of
+     *          excludedZones, if there is one.
+     */
+    std::optional<size_t> NextZone(size_t zoneId, DWORD vkCode, const std::vector<size_t>& excludedZones) const;
+
+    /**
+     * Zone to cycle to when there is none left in the direction of the arrow key: the closest
+     * one from the zone moved off the work area, to the opposite side. Computed on first use and
+     * kept for the size of the work area.
+     *
+     * @param   workAreaRect  Rectangle of the work area, only its size is used.
+     */
+    std::optional<size_t> CycleZone(size_t zoneId, DWORD vkCode, RECT workAreaRect) const;
+
+private:
+    static std::optional<size_t> DirectionIndex(DWORD vkCode) noexcept;
+    std::optional<size_t> Position(size_t zoneId) const noexcept;
+
+    static constexpr size_t C_NOT_COMPUTED = SIZE_MAX;
+
+    std::vector<Zone> m_zones;
+    // Position in m_zones by zone id, SIZE_MAX for ids that are not used
+    std::vector<size_t> m_positions;
+    // Neighbors of the zone at position i for the arrow key with direction index d are
+    // m_neighbors[i * 4 + d]
+    std::vector<std::vector<size_t>> m_neighbors;
+
+    // Positions of the cycle targets for the work area size below, by the same index as
+    // m_neighbors. m_zones.size() if there is none.
+    mutable std::vector<size_t> m_cycleZones;
+    mutable LONG m_cycleWidth = 0;
+    mutable LONG m_cycleHeight = 0;
+};
@@ -0,0 +1,101 @@
+#include "pch.h"
+
+#include "ZoneContainmentIndex.h"
+
+#include <algorithm>
+
+ZoneContainmentIndex::ZoneContainmentIndex(const std::vector<Zone>& zones)
+{
+    for (const auto& zone : zones)
+    {
+        if (zone.id >= m_rects.size())
+        {
+            m_rects.resize(zone.id + 1);
+            m_used.resize(zone.id + 1, false);
+        }
+        m_rects[zone.id] = zone.rect;
+        m_used[zone.id] = true;
+    }
+
+    std::vector<Zone> sorted = zones;
+    std::sort(sorted.begin(), sorted.end(), [](const Zone& first, const Zone& second) {
+        if (first.rect.left != second.rect.left)
+        {
+            return first.rect.left < second.rect.left;
+        }
+        return first.rect.top < second.rect.top;
+    });
+
+    m_entries.reserve(sorted.size());
+    for (const auto& zone : sorted)
+    {
+        if (m_lefts.empty() || m_lefts.back() != zone.rect.left)
+        {
+            m_lefts.push_back(zone.rect.left);
+            m_groupStart.push_back(m_entries.size());
+        }
+        m_entries.push_back({ zone.rect.top, zone.rect.right, zone.rect.bottom, zone.id });
+    }
+    m_groupStart.push_back(m_entries.size());
+}
+
+std::vector<size_t> ZoneContainmentIndex::ZonesInside(RECT rect) const
+{
+    std::vector<size_t> result;
+
+    const auto firstGroup = std::lower_bound(m_lefts.begin(), m_lefts.end(), rect.left);
+    const auto endGroup = std::upper_bound(firstGroup, m_lefts.end(), rect.right);
+    for (auto group = firstGroup; group != endGroup; ++group)
+    {
+        const size_t groupIndex = group - m_lefts.begin();
+        const auto groupBegin = m_entries.begin() + m_groupStart[groupIndex];
+        const auto groupEnd = m_entries.begin() + m_groupStart[groupIndex + 1];
+
+        auto entry = std::lower_bound(groupBegin, groupEnd, rect.top, [](const Entry& entry, LONG top) {
+            return entry.top < top;
+        });
+        for (; entry != groupEnd && entry->top <= rect.bottom; ++entry)
+        {
+            if (entry->right <= rect.right && entry->bottom <= rect.bottom)
+            {
+                result.push_back(entry->id);
+            }
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<size_t> ZoneContainmentIndex::ZonesInsideBoundsOf(const std::vector<size_t>& zoneIds) const
+{
+    RECT boundingRect{};
+    bool boundingRectEmpty = true;
+
+    for (size_t zoneId : zoneIds)
+    {
+        if (zoneId < m_used.size() && m_used[zoneId])
+        {
+            const RECT& rect = m_rects[zoneId];
+            if (boundingRectEmpty)
+            {
+                boundingRect = rect;
+                boundingRectEmpty = false;
+            }
+            else
+            {
+                boundingRect.left = min(boundingRect.left, rect.left);
+                boundingRect.top = min(boundingRect.top, rect.top);
+                boundingRect.right = max(boundingRect.right, rect.right);
+                boundingRect.bottom = max(boundingRect.bottom, rect.bottom);
+            }
+        }
+    }
+
+    if (boundingRectEmpty)
+    {
+        return {};
+    }
+
+    return ZonesInside(boundingRect);
+}
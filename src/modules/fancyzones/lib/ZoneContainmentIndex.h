@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * Containment queries over the zones of one layout, for selecting the range of zones between
+ * two zones when dragging or extending a window over several of them. The zones are grouped by
+ * their left edge, and sorted by their top edge within a group, so the zones inside a rectangle
+ * are found by a binary search in each group whose left edge is inside, instead of testing all
+ * the zones of the layout.
+ */
+class ZoneContainmentIndex
+{
+public:
+    struct Zone
+    {
+        size_t id;
+        RECT rect;
+    };
+
+    ZoneContainmentIndex() = default;
+
+    /**
+     * @param   zones  Zones of the layout.
+     */
+    explicit ZoneContainmentIndex(const std::vector<Zone>& zones);
+
+    /**
+     * @param   rect  Rectangle to search, edges included.
+     *
+     * @returns Ids of the zones that are inside the rectangle, in increasing order.
+     */
+    std::vector<size_t> ZonesInside(RECT rect) const;
+
+    /**
+     * @param   zoneIds  Ids of zones. Unknown ids are ignored.
+     *
+     * @returns Ids of the zones inside the bounding rectangle of the given zones, in increasing
+     *          order. Empty if none of the ids is known.
+     */
+    std::vector<size_t> ZonesInsideBoundsOf(const std::vector<size_t>& zoneIds) const;
+
+private:
+    struct Entry
+    {
+        LONG top;
+        LONG right;
+        LONG bottom;
+        size_t id;
+    };
+
+    // Rectangle of each zone by id, and whether the id is used
+    std::vector<RECT> m_rects;
+    std::vector<bool> m_used;
+
+    // Distinct left edges in increasing order. The zones with the left edge m_lefts[i] are
+    // m_entries[m_groupStart[i]] to m_entries[m_groupStart[i + 1]], in increasing top order.
+    std::vector<LONG> m_lefts;
+    std::vector<size_t> m_groupStart;
+    std::vector<Entry> m_entries;
+};
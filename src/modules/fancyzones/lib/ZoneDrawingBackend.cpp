@@ -0,0 +1,146 @@
+#include "pch.h"
+
+#include "ZoneDrawingBackend.h"
+
+#include <common/logger/logger.h>
+
+namespace NonLocalizable
+{
+    const wchar_t SegoeUiFont[] = L"Segoe ui";
+}
+
+std::unique_ptr<D2DZoneDrawingBackend> D2DZoneDrawingBackend::Create(HWND window)
+{
+    // Obtain the size of the drawing area.
+    RECT clientRect{};
+    if (!GetClientRect(window, &clientRect))
+    {
+        Logger::error("couldn't initialize ZoneWindowDrawing: GetClientRect failed");
+        return nullptr;
+    }
+
+    // Create a Direct2D render target
+    // We should always use the DPI value of 96 since we're running in DPI aware mode
+    auto renderTargetProperties = D2D1::RenderTargetProperties(
+        D2D1_RENDER_TARGET_TYPE_DEFAULT,
+        D2D1::PixelFormat(DXGI_FORMAT_UNKNOWN, D2D1_ALPHA_MODE_PREMULTIPLIED),
+        96.f,
+        96.f);
+
+    auto renderTargetSize = D2D1::SizeU(clientRect.right - clientRect.left, clientRect.bottom - clientRect.top);
+    // The compositor paces the frames, presenting must not wait for the vertical sync of this
+    // monitor while the other zone windows wait for their turn
+    auto hwndRenderTargetProperties = D2D1::HwndRenderTargetProperties(window, renderTargetSize, D2D1_PRESENT_OPTIONS_IMMEDIATELY);
+
+    auto factory = GetD2DFactory();
+    winrt::com_ptr<ID2D1HwndRenderTarget> renderTarget;
+    HRESULT hr = factory ? factory->CreateHwndRenderTarget(renderTargetProperties, hwndRenderTargetProperties, renderTarget.put()) : E_FAIL;
+
+    if (!SUCCEEDED(hr))
+    {
+        Logger::error("couldn't initialize ZoneWindowDrawing: CreateHwndRenderTarget failed with {}", hr);
+        return nullptr;
+    }
+
+    return std::unique_ptr<D2DZoneDrawingBackend>(new D2DZoneDrawingBackend(std::move(renderTarget)));
+}
+
+D2DZoneDrawingBackend::D2DZoneDrawingBackend(winrt::com_ptr<ID2D1HwndRenderTarget> renderTarget) :
+    m_renderTarget(std::move(renderTarget))
+{
+    auto writeFactory = GetWriteFactory();
+    if (writeFactory &&
+        SUCCEEDED(writeFactory->CreateTextFormat(NonLocalizable::SegoeUiFont, nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 80.f, L"en-US", m_textFormat.put())))
+    {
+        // The layouts have an empty box at the center of the zone, the text is centered around it
+        m_textFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
+        m_textFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
+        m_textFormat->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+    }
+}
+
+ID2D1Factory* D2DZoneDrawingBackend::GetD2DFactory()
+{
+    static auto pD2DFactory = [] {
+        ID2D1Factory* res = nullptr;
+        D2D1CreateFactory(D2D1_FACTORY_TYPE_MULTI_THREADED, &res);
+        return res;
+    }();
+    return pD2DFactory;
+}
+
+IDWriteFactory* D2DZoneDrawingBackend::GetWriteFactory()
+{
+    static auto pDWriteFactory = [] {
+        IUnknown* res = nullptr;
+        DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), &res);
+        return reinterpret_cast<IDWriteFactory*>(res);
+    }();
+    return pDWriteFactory;
+}
+
+std::optional<ZoneDrawingBackend::Brush> D2DZoneDrawingBackend::CreateBrush(const D2D1_COLOR_F& color)
+{
+    winrt::com_ptr<ID2D1SolidColorBrush> brush;
+    if (FAILED(m_renderTarget->CreateSolidColorBrush(color, brush.put())))
+    {
+        return std::nullopt;
+    }
+
+    m_brushes.push_back(std::move(brush));
+    return m_brushes.size() - 1;
+}
+
+std::optional<ZoneDrawingBackend::TextLayout> D2DZoneDrawingBackend::CreateTextLayout(std::wstring_view text)
+{
+    auto writeFactory = GetWriteFactory();
+    if (!writeFactory || !m_textFormat)
+    {
+        return std::nullopt;
+    }
+
+    winrt::com_ptr<IDWriteTextLayout> layout;
+    if (FAILED(writeFactory->CreateTextLayout(text.data(), static_cast<UINT32>(text.size()), m_textFormat.get(), 0.f, 0.f, layout.put())))
+    {
+        return std::nullopt;
+    }
+
+    m_textLayouts.push_back(std::move(layout));
+    return m_textLayouts.size() - 1;
+}
+
+void D2DZoneDrawingBackend::ReleaseResources()
+{
+    m_brushes.clear();
+    m_textLayouts.clear();
+}
+
+void D2DZoneDrawingBackend::BeginDraw()
+{
+    m_renderTarget->BeginDraw();
+}
+
+void D2DZoneDrawingBackend::Clear(const D2D1_COLOR_F& color)
+{
+    m_renderTarget->Clear(color);
+}
+
+void D2DZoneDrawingBackend::FillRectangle(const D2D1_RECT_F& rect, Brush brush)
+{
+    m_renderTarget->FillRectangle(rect, m_brushes[brush].get());
+}
+
+void D2DZoneDrawingBackend::DrawRectangle(const D2D1_RECT_F& rect, Brush brush)
+{
+    m_renderTarget->DrawRectangle(rect, m_brushes[brush].get());
+}
+
+void D2DZoneDrawingBackend::DrawTextLayout(D2D1_POINT_2F center, TextLayout layout, Brush brush)
+{
+    m_renderTarget->DrawTextLayout(center, m_textLayouts[layout].get(), m_brushes[brush].get());
+}
+
+HRESULT D2DZoneDrawingBackend::EndDraw()
+{
+    return m_renderTarget->EndDraw();
+}
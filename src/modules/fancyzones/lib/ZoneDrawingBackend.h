@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include <winrt/base.h>
+#include <d2d1.h>
+#include <dwrite.h>
+
+/**
+ * Drawing operations of a zone window frame. Brushes and text layouts are created once and then
+ * referred to by handle in the frames that follow. Handles stay valid until ReleaseResources.
+ */
+class ZoneDrawingBackend
+{
+public:
+    using Brush = size_t;
+    using TextLayout = size_t;
+
+    virtual ~ZoneDrawingBackend() = default;
+
+    virtual std::optional<Brush> CreateBrush(const D2D1_COLOR_F& color) = 0;
+    /**
+     * @returns Layout of the text, centered on the point it is drawn at.
+     */
+    virtual std::optional<TextLayout> CreateTextLayout(std::wstring_view text) = 0;
+    virtual void ReleaseResources() = 0;
+
+    virtual void BeginDraw() = 0;
+    virtual void Clear(const D2D1_COLOR_F& color) = 0;
+    virtual void FillRectangle(const D2D1_RECT_F& rect, Brush brush) = 0;
+    virtual void DrawRectangle(const D2D1_RECT_F& rect, Brush brush) = 0;
+    virtual void DrawTextLayout(D2D1_POINT_2F center, TextLayout layout, Brush brush) = 0;
+    virtual HRESULT EndDraw() = 0;
+};
+
+class D2DZoneDrawingBackend : public ZoneDrawingBackend
+{
+public:
+    /**
+     * @returns Backend drawing in the client area of the window, null if the render target can
+     *          not be created.
+     */
+    static std::unique_ptr<D2DZoneDrawingBackend> Create(HWND window);
+
+    std::optional<Brush> CreateBrush(const D2D1_COLOR_F& color) override;
+    std::optional<TextLayout> CreateTextLayout(std::wstring_view text) override;
+    void ReleaseResources() override;
+
+    void BeginDraw() override;
+    void Clear(const D2D1_COLOR_F& color) override;
+    void FillRectangle(const D2D1_RECT_F& rect, Brush brush) override;
+    void DrawRectangle(const D2D1_RECT_F& rect, Brush brush) override;
+    void DrawTextLayout(D2D1_POINT_2F center, TextLayout layout, Brush brush) override;
+    HRESULT EndDraw() override;
+
+private:
+    explicit D2DZoneDrawingBackend(winrt::com_ptr<ID2D1HwndRenderTarget> renderTarget);
+
+    static ID2D1Factory* GetD2DFactory();
+    static IDWriteFactory* GetWriteFactory();
+
+    winrt::com_ptr<ID2D1HwndRenderTarget> m_renderTarget;
+    // Shared by the labels of all the zones
+    winrt::com_ptr<IDWriteTextFormat> m_textFormat;
+    std::vector<winrt::com_ptr<ID2D1SolidColorBrush>> m_brushes;
+    std::vector<winrt::com_ptr<IDWriteTextLayout>> m_textLayouts;
+};
@@ -0,0 +1,177 @@
+#include "pch.h"
+
+#include "ZoneHitTest.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Cells per side of the grid, whatever the number of zones
+    constexpr size_t C_MAX_CELLS_PER_SIDE = 32;
+
+    bool RectsOverlap(const RECT& first, const RECT& second, int sensitivityRadius)
+    {
+        return max(first.top, second.top) + sensitivityRadius < min(first.bottom, second.bottom) &&
+               max(first.left, second.left) + sensitivityRadius < min(first.right, second.right);
+    }
+}
+
+ZoneHitTest::ZoneHitTest(const std::vector<Zone>& zones, int sensitivityRadius) :
+    m_sensitivityRadius(sensitivityRadius),
+    m_zones(zones)
+{
+    if (m_zones.empty())
+    {
+        return;
+    }
+
+    // Candidates are taken with a radius of at least 0, so zones that contain the point are
+    // always among them
+    const long grow = max(sensitivityRadius, 0);
+    auto grown = [grow](const RECT& rect) {
+        return RECT{ rect.left - grow, rect.top - grow, rect.right + grow, rect.bottom + grow };
+    };
+
+    m_bounds = grown(m_zones[0].rect);
+    for (const auto& zone : m_zones)
+    {
+        const RECT rect = grown(zone.rect);
+        m_bounds.left = min(m_bounds.left, rect.left);
+        m_bounds.top = min(m_bounds.top, rect.top);
+        m_bounds.right = max(m_bounds.right, rect.right);
+        m_bounds.bottom = max(m_bounds.bottom, rect.bottom);
+    }
+
+    // The edges are part of the grown rectangles
+    const long width = m_bounds.right - m_bounds.left + 1;
+    const long height = m_bounds.bottom - m_bounds.top + 1;
+    const size_t side = std::clamp(static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(m_zones.size())))), size_t(1), C_MAX_CELLS_PER_SIDE);
+    m_cellWidth = max((width + static_cast<long>(side) - 1) / static_cast<long>(side), 1L);
+    m_cellHeight = max((height + static_cast<long>(side) - 1) / static_cast<long>(side), 1L);
+    m_columns = static_cast<size_t>((width + m_cellWidth - 1) / m_cellWidth);
+    m_rows = static_cast<size_t>((height + m_cellHeight - 1) / m_cellHeight);
+
+    auto forEachCell = [&](const RECT& zoneRect, auto&& callback) {
+        const RECT rect = grown(zoneRect);
+        const size_t firstColumn = static_cast<size_t>((rect.left - m_bounds.left) / m_cellWidth);
+        const size_t lastColumn = static_cast<size_t>((rect.right - m_bounds.left) / m_cellWidth);
+        const size_t firstRow = static_cast<size_t>((rect.top - m_bounds.top) / m_cellHeight);
+        const size_t lastRow = static_cast<size_t>((rect.bottom - m_bounds.top) / m_cellHeight);
+        for (size_t row = firstRow; row <= lastRow; row++)
+        {
+            for (size_t column = firstColumn; column <= lastColumn; column++)
+            {
+                callback(row * m_columns + column);
+            }
+        }
+    };
+
+    // Lists of candidates, counted first so they fit in one array
+    const size_t cellCount = m_columns * m_rows;
+    m_cellStart.assign(cellCount + 1, 0);
+    for (const auto& zone : m_zones)
+    {
+        forEachCell(zone.rect, [&](size_t cell) { m_cellStart[cell + 1]++; });
+    }
+
+    for (size_t cell = 0; cell < cellCount; cell++)
+    {
+        m_cellStart[cell + 1] += m_cellStart[cell];
+    }
+
+    std::vector<size_t> cellFill(m_cellStart.begin(), m_cellStart.end() - 1);
+    m_cellZones.resize(m_cellStart.back());
+    for (size_t position = 0; position < m_zones.size(); position++)
+    {
+        forEachCell(m_zones[position].rect, [&](size_t cell) { m_cellZones[cellFill[cell]++] = position; });
+    }
+
+    m_overlapStride = (m_zones.size() + 63) / 64;
+    m_overlap.assign(m_zones.size() * m_overlapStride, 0);
+    for (size_t i = 0; i < m_zones.size(); i++)
+    {
+        for (size_t j = i + 1; j < m_zones.size(); j++)
+        {
+            if (RectsOverlap(m_zones[i].rect, m_zones[j].rect, sensitivityRadius))
+            {
+                m_overlap[i * m_overlapStride + j / 64] |= 1ull << (j % 64);
+                m_overlap[j * m_overlapStride + i / 64] |= 1ull << (i % 64);
+            }
+        }
+    }
+
+    m_cellHasOverlap.assign(cellCount, false);
+    for (size_t cell = 0; cell < cellCount; cell++)
+    {
+        for (size_t i = m_cellStart[cell]; i < m_cellStart[cell + 1] && !m_cellHasOverlap[cell]; i++)
+        {
+            for (size_t j = i + 1; j < m_cellStart[cell + 1]; j++)
+            {
+                if (Overlap(m_cellZones[i], m_cellZones[j]))
+                {
+                    m_cellHasOverlap[cell] = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+ZoneHitTest::Result ZoneHitTest::HitTest(POINT pt) const
+{
+    Result result;
+    if (m_cellStart.empty() ||
+        pt.x < m_bounds.left || pt.x > m_bounds.right ||
+        pt.y < m_bounds.top || pt.y > m_bounds.bottom)
+    {
+        return result;
+    }
+
+    const size_t cell = static_cast<size_t>((pt.y - m_bounds.top) / m_cellHeight) * m_columns + static_cast<size_t>((pt.x - m_bounds.left) / m_cellWidth);
+
+    // Positions of the captured zones first, turned into ids at the end
+    for (size_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++)
+    {
+        const size_t position = m_cellZones[i];
+        const RECT& rect = m_zones[position].rect;
+        if (rect.left - m_sensitivityRadius <= pt.x && pt.x <= rect.right + m_sensitivityRadius &&
+            rect.top - m_sensitivityRadius <= pt.y && pt.y <= rect.bottom + m_sensitivityRadius)
+        {
+            result.zones.push_back(position);
+        }
+
+        if (rect.left <= pt.x && pt.x < rect.right &&
+            rect.top <= pt.y && pt.y < rect.bottom)
+        {
+            result.strictlyCaptured = true;
+        }
+    }
+
+    if (m_cellHasOverlap[cell])
+    {
+        for (size_t i = 0; i < result.zones.size() && !result.overlap; i++)
+        {
+            for (size_t j = i + 1; j < result.zones.size(); j++)
+            {
+                if (Overlap(result.zones[i], result.zones[j]))
+                {
+                    result.overlap = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (size_t& zone : result.zones)
+    {
+        zone = m_zones[zone].id;
+    }
+
+    return result;
+}
+
+bool ZoneHitTest::Overlap(size_t first, size_t second) const
+{
+    return (m_overlap[first * m_overlapStride + second / 64] >> (second % 64)) & 1;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * Hit-testing acceleration structure for the zones of one layout, built once per layout and
+ * sensitivity radius. The bounding box of the zones is cut into a coarse grid of cells and each
+ * cell lists the zones whose rectangle, grown by the sensitivity radius, reaches into it. The
+ * overlap relationship between every pair of zones is computed up front as well, so a point
+ * query costs a cell lookup plus a test of the few candidates of that cell.
+ */
+class ZoneHitTest
+{
+public:
+    struct Zone
+    {
+        size_t id;
+        RECT rect;
+    };
+
+    struct Result
+    {
+        // Ids of the zones within the sensitivity radius of the point, in the order of the zones
+        std::vector<size_t> zones;
+        // At least one zone contains the point itself
+        bool strictlyCaptured = false;
+        // At least two of the zones overlap by more than the sensitivity radius
+        bool overlap = false;
+    };
+
+    ZoneHitTest() = default;
+
+    /**
+     * @param   zones              Zones of the layout, in the order they should be reported.
+     * @param   sensitivityRadius  Distance in pixels from which a zone is captured.
+     */
+    ZoneHitTest(const std::vector<Zone>& zones, int sensitivityRadius);
+
+    Result HitTest(POINT pt) const;
+
+private:
+    // Positions of the zones in m_zones
+    bool Overlap(size_t first, size_t second) const;
+
+    int m_sensitivityRadius = 0;
+    std::vector<Zone> m_zones;
+
+    // Grid covering the zones grown by the sensitivity radius
+    RECT m_bounds{};
+    long m_cellWidth = 1;
+    long m_cellHeight = 1;
+    size_t m_columns = 0;
+    size_t m_rows = 0;
+
+    // Positions in m_zones of the candidates of cell i are m_cellZones[m_cellStart[i]] to
+    // m_cellZones[m_cellStart[i + 1]], in increasing order
+    std::vector<size_t> m_cellStart;
+    std::vector<size_t> m_cellZones;
+    // Cells where two candidates overlap. The pairs only need to be checked in those.
+    std::vector<bool> m_cellHasOverlap;
+
+    // Bit matrix of the overlap relationship, one row of m_overlapStride words per zone
+    std::vector<uint64_t> m_overlap;
+    size_t m_overlapStride = 0;
+};
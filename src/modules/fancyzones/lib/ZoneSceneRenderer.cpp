@@ -0,0 +1,98 @@
+#include "pch.h"
+
+#include "ZoneSceneRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace
+{
+    bool SameColor(const D2D1_COLOR_F& first, const D2D1_COLOR_F& second) noexcept
+    {
+        return first.r == second.r && first.g == second.g && first.b == second.b && first.a == second.a;
+    }
+}
+
+bool ZoneSceneRenderer::DrawableRect::operator==(const DrawableRect& other) const noexcept
+{
+    return rect.left == other.rect.left && rect.top == other.rect.top && rect.right == other.rect.right && rect.bottom == other.rect.bottom &&
+           SameColor(borderColor, other.borderColor) && SameColor(fillColor, other.fillColor) && id == other.id;
+}
+
+void ZoneSceneRenderer::InvalidateResources(ZoneDrawingBackend& backend)
+{
+    m_palette.clear();
+    m_labels.clear();
+    backend.ReleaseResources();
+}
+
+void ZoneSceneRenderer::Draw(ZoneDrawingBackend& backend, const std::vector<DrawableRect>& scene, float alpha)
+{
+    const int alphaBucket = static_cast<int>(std::lround(std::clamp(alpha, 0.f, 1.f) * C_ALPHA_BUCKETS));
+
+    backend.BeginDraw();
+
+    // Draw backdrop
+    backend.Clear(D2D1::ColorF(0.f, 0.f, 0.f, 0.f));
+
+    auto textBrush = GetBrush(backend, D2D1::ColorF(D2D1::ColorF::Black), alphaBucket);
+
+    for (const auto& drawableRect : scene)
+    {
+        if (auto fillBrush = GetBrush(backend, drawableRect.fillColor, alphaBucket))
+        {
+            backend.FillRectangle(drawableRect.rect, *fillBrush);
+        }
+
+        if (auto borderBrush = GetBrush(backend, drawableRect.borderColor, alphaBucket))
+        {
+            backend.DrawRectangle(drawableRect.rect, *borderBrush);
+        }
+
+        auto label = GetLabel(backend, drawableRect.id);
+        if (label && textBrush)
+        {
+            const auto center = D2D1::Point2F((drawableRect.rect.left + drawableRect.rect.right) / 2.f,
+                                              (drawableRect.rect.top + drawableRect.rect.bottom) / 2.f);
+            backend.DrawTextLayout(center, *label, *textBrush);
+        }
+    }
+}
+
+std::optional<ZoneDrawingBackend::Brush> ZoneSceneRenderer::GetBrush(ZoneDrawingBackend& backend, const D2D1_COLOR_F& color, int alphaBucket)
+{
+    for (const auto& entry : m_palette)
+    {
+        if (entry.alphaBucket == alphaBucket && SameColor(entry.color, color))
+        {
+            return entry.brush;
+        }
+    }
+
+    auto brushColor = color;
+    brushColor.a *= static_cast<float>(alphaBucket) / C_ALPHA_BUCKETS;
+
+    auto brush = backend.CreateBrush(brushColor);
+    if (brush)
+    {
+        m_palette.push_back(PaletteEntry{ .color = color, .alphaBucket = alphaBucket, .brush = *brush });
+    }
+
+    return brush;
+}
+
+std::optional<ZoneDrawingBackend::TextLayout> ZoneSceneRenderer::GetLabel(ZoneDrawingBackend& backend, size_t zoneId)
+{
+    if (zoneId >= m_labels.size())
+    {
+        m_labels.resize(zoneId + 1);
+    }
+
+    if (!m_labels[zoneId])
+    {
+        m_labels[zoneId] = backend.CreateTextLayout(std::to_wstring(zoneId + 1));
+    }
+
+    return m_labels[zoneId];
+}
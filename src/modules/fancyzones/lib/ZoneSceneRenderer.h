@@ -0,0 +1,58 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "ZoneDrawingBackend.h"
+
+/**
+ * Draws the zones of a zone window through a ZoneDrawingBackend. The device resources are kept
+ * from one frame to the next: a palette of brushes keyed by color and alpha bucket, and the label
+ * of each zone id laid out once. Once a scene and the alpha buckets of its animation have been
+ * drawn, a frame creates no resources and does not allocate.
+ */
+class ZoneSceneRenderer
+{
+public:
+    struct DrawableRect
+    {
+        D2D1_RECT_F rect;
+        D2D1_COLOR_F borderColor;
+        D2D1_COLOR_F fillColor;
+        size_t id;
+
+        bool operator==(const DrawableRect& other) const noexcept;
+    };
+
+    // Number of steps the animation alpha is rounded to, each one with its own brushes
+    static constexpr int C_ALPHA_BUCKETS = 32;
+
+    /**
+     * Drops the cached resources, for instance when the zone colors change.
+     */
+    void InvalidateResources(ZoneDrawingBackend& backend);
+
+    /**
+     * Draws the frame, without presenting it.
+     *
+     * @param   scene  Zones to draw, from bottom to top.
+     * @param   alpha  Animation alpha, in [0, 1], applied to every color.
+     */
+    void Draw(ZoneDrawingBackend& backend, const std::vector<DrawableRect>& scene, float alpha);
+
+private:
+    struct PaletteEntry
+    {
+        D2D1_COLOR_F color;
+        int alphaBucket;
+        ZoneDrawingBackend::Brush brush;
+    };
+
+    std::optional<ZoneDrawingBackend::Brush> GetBrush(ZoneDrawingBackend& backend, const D2D1_COLOR_F& color, int alphaBucket);
+    std::optional<ZoneDrawingBackend::TextLayout> GetLabel(ZoneDrawingBackend& backend, size_t zoneId);
+
+    // A handful of colors, searched linearly
+    std::vector<PaletteEntry> m_palette;
+    // Label of each zone by id, empty if not laid out yet
+    std::vector<std::optional<ZoneDrawingBackend::TextLayout>> m_labels;
+};
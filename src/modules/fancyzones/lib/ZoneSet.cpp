@@ -6,6 +6,9 @@
 #include "FancyZonesDataTypes.h"
 #include "Settings.h"
 #include "Zone.h"
+#include "ZoneAdjacencyGraph.h"
+#include "ZoneContainmentIndex.h"
+#include "ZoneHitTest.h"
 #include "util.h"
 
 #include <common/logger/logger.h>
@@ -21,6 +24,9 @@ namespace
 {
     constexpr int C_MULTIPLIER = 10000;
 
+    // Number of (initial, final) zone ranges kept, one drag over a layout only visits a few
+    constexpr size_t C_MAX_COMBINED_ZONE_RANGES = 64;
+
     // PriorityGrid layout is unique for zoneCount <= 11. For zoneCount > 11 PriorityGrid is same as Grid
     FancyZonesDataTypes::GridLayoutInfo predefinedPriorityGridLayouts[11] = {
         /* 1 */
@@ -165,7 +171,17 @@ private:
     template<class CompareF>
     std::vector<size_t> ZoneSelectPriority(const std::vector<size_t>& capturedZones, CompareF compare) const;
 
+    const ZoneHitTest& GetHitTest() const;
+    const ZoneAdjacencyGraph& GetAdjacencyGraph() const;
+    const ZoneContainmentIndex& GetContainmentIndex() const;
+    void ResetZoneIndexes() noexcept;
+
     ZonesMap m_zones;
+    // Built from m_zones on first use after they change, ZoneSet is only used by the FancyZones thread
+    mutable std::optional<ZoneHitTest> m_hitTest;
+    mutable std::optional<ZoneAdjacencyGraph> m_adjacencyGraph;
+    mutable std::optional<ZoneContainmentIndex> m_containmentIndex;
+    mutable std::map<std::pair<std::vector<size_t>, std::vector<size_t>>, std::vector<size_t>> m_combinedZoneRanges;
     std::map<HWND, std::vector<size_t>> m_windowIndexSet;
 
     // Needed for ExtendWindowByDirectionAndPosition
@@ -184,6 +200,7 @@ IFACEMETHODIMP ZoneSet::AddZone(winrt::com_ptr<IZone> zone) noexcept
         return S_FALSE;
     }
     m_zones[zoneId] = zone;
+    ResetZoneIndexes();
 
     return S_OK;
 }
@@ -191,64 +208,28 @@ IFACEMETHODIMP ZoneSet::AddZone(winrt::com_ptr<IZone> zone) noexcept
 IFACEMETHODIMP_(std::vector<size_t>)
 ZoneSet::ZonesFromPoint(POINT pt) const noexcept
 {
-    std::vector<size_t> capturedZones;
-    std::vector<size_t> strictlyCapturedZones;
-    for (const auto& [zoneId, zone] : m_zones)
+    ZoneHitTest::Result hit;
+    try
     {
-        const RECT& zoneRect = zone->GetZoneRect();
-        if (zoneRect.left - m_config.SensitivityRadius <= pt.x && pt.x <= zoneRect.right + m_config.SensitivityRadius &&
-            zoneRect.top - m_config.SensitivityRadius <= pt.y && pt.y <= zoneRect.bottom + m_config.SensitivityRadius)
-        {
-            capturedZones.emplace_back(zoneId);
-        }
-            
-        if (zoneRect.left <= pt.x && pt.x < zoneRect.right &&
-            zoneRect.top <= pt.y && pt.y < zoneRect.bottom)
-        {
-            strictlyCapturedZones.emplace_back(zoneId);
-        }
+        hit = GetHitTest().HitTest(pt);
+    }
+    catch (std::bad_alloc&)
+    {
+        return {};
     }
 
+    std::vector<size_t> capturedZones = std::move(hit.zones);
+
     // If only one zone is captured, but it's not strictly captured
     // don't consider it as captured
-    if (capturedZones.size() == 1 && strictlyCapturedZones.size() == 0)
+    if (capturedZones.size() == 1 && !hit.strictlyCaptured)
     {
         return {};
     }
 
     // If captured zones do not overlap, return all of them
     // Otherwise, return one of them based on the chosen selection algorithm.
-    bool overlap = false;
-    for (size_t i = 0; i < capturedZones.size(); ++i)
-    {
-        for (size_t j = i + 1; j < capturedZones.size(); ++j)
-        {
-            RECT rectI;
-            RECT rectJ;
-            try
-            {
-                rectI = m_zones.at(capturedZones[i])->GetZoneRect();
-                rectJ = m_zones.at(capturedZones[j])->GetZoneRect();
-            }
-            catch (std::out_of_range)
-            {
-                return {};
-            }
-
-            if (max(rectI.top, rectJ.top) + m_config.SensitivityRadius < min(rectI.bottom, rectJ.bottom) &&
-                max(rectI.left, rectJ.left) + m_config.SensitivityRadius < min(rectI.right, rectJ.right))
-            {
-                overlap = true;
-                break;
-            }
-        }
-        if (overlap)
-        {
-            break;
-        }
-    }
-
-    if (overlap)
+    if (hit.overlap)
     {
         auto zoneArea = [](auto zone) {
             RECT rect = zone->GetZoneRect();
@@ -410,27 +391,54 @@ ZoneSet::MoveWindowIntoZoneByDirectionAndPosition(HWND window, HWND workAreaWind
         return false;
     }
 
-    std::vector<bool> usedZoneIndices(m_zones.size(), false);
-    for (size_t id : GetZoneIndexSetFromWindow(window))
+    const auto indexSet = GetZoneIndexSetFromWindow(window);
+
+    RECT windowRect, windowZoneRect;
+    if (GetWindowRect(window, &windowRect) && GetWindowRect(workAreaWindow, &windowZoneRect))
     {
-        usedZoneIndices[id] = true;
-    }
+        // A window in a single zone moves from that zone to its neighbor
+        if (indexSet.size() == 1 && m_zones.contains(indexSet[0]))
+        {
+            try
+            {
+                const auto& graph = GetAdjacencyGraph();
+                auto nextZone = graph.NextZone(indexSet[0], vkCode, indexSet);
+                if (!nextZone && cycle)
+                {
+                    nextZone = graph.CycleZone(indexSet[0], vkCode, windowZoneRect);
+                }
 
-    std::vector<RECT> zoneRects;
-    std::vector<size_t> freeZoneIndices;
+                if (nextZone)
+                {
+                    MoveWindowIntoZoneByIndex(window, workAreaWindow, *nextZone);
+                    return true;
+                }
+            }
+            catch (std::bad_alloc&)
+            {
+            }
 
-    for (const auto& [zoneId, zone] : m_zones)
-    {
-        if (!usedZoneIndices[zoneId])
+            return false;
+        }
+
+        std::vector<bool> usedZoneIndices(m_zones.size(), false);
+        for (size_t id : indexSet)
         {
-            zoneRects.emplace_back(m_zones[zoneId]->GetZoneRect());
-            freeZoneIndices.emplace_back(zoneId);
+            usedZoneIndices[id] = true;
+        }
+
+        std::vector<RECT> zoneRects;
+        std::vector<size_t> freeZoneIndices;
+
+        for (const auto& [zoneId, zone] : m_zones)
+        {
+            if (!usedZoneIndices[zoneId])
+            {
+                zoneRects.emplace_back(m_zones[zoneId]->GetZoneRect());
+                freeZoneIndices.emplace_back(zoneId);
+            }
         }
-    }
 
-    RECT windowRect, windowZoneRect;
-    if (GetWindowRect(window, &windowRect) && GetWindowRect(workAreaWindow, &windowZoneRect))
-    {
         // Move to coordinates relative to windowZone
         windowRect.top -= windowZoneRect.top;
         windowRect.bottom -= windowZoneRect.top;
@@ -475,20 +483,39 @@ ZoneSet::ExtendWindowByDirectionAndPosition(HWND window, HWND workAreaWindow, DW
     if (GetWindowRect(window, &windowRect) && GetWindowRect(workAreaWindow, &windowZoneRect))
     {
         auto oldZones = GetZoneIndexSetFromWindow(window);
-        std::vector<bool> usedZoneIndices(m_zones.size(), false);
-        std::vector<RECT> zoneRects;
-        std::vector<size_t> freeZoneIndices;
+        std::optional<size_t> targetZoneFound;
 
         // If selectManyZones = true for the second time, use the last zone into which we moved
-        // instead of the window rect and enable moving to all zones except the old one
+        // instead of the window rect and enable moving to all zones except the old one.
+        // A window in a single zone extends from that zone.
         auto finalIndexIt = m_windowFinalIndex.find(window);
+        std::optional<size_t> fromZone;
         if (finalIndexIt != m_windowFinalIndex.end())
         {
-            usedZoneIndices[finalIndexIt->second] = true;
-            windowRect = m_zones[finalIndexIt->second]->GetZoneRect();
+            fromZone = finalIndexIt->second;
+        }
+        else if (oldZones.size() == 1)
+        {
+            fromZone = oldZones[0];
+        }
+
+        if (fromZone && m_zones.contains(*fromZone))
+        {
+            try
+            {
+                targetZoneFound = GetAdjacencyGraph().NextZone(*fromZone, vkCode, { *fromZone });
+            }
+            catch (std::bad_alloc&)
+            {
+                return false;
+            }
         }
         else
         {
+            std::vector<bool> usedZoneIndices(m_zones.size(), false);
+            std::vector<RECT> zoneRects;
+            std::vector<size_t> freeZoneIndices;
+
             for (size_t idx : oldZones)
             {
                 usedZoneIndices[idx] = true;
@@ -498,21 +525,26 @@ ZoneSet::ExtendWindowByDirectionAndPosition(HWND window, HWND workAreaWindow, DW
             windowRect.bottom -= windowZoneRect.top;
             windowRect.left -= windowZoneRect.left;
             windowRect.right -= windowZoneRect.left;
-        }
 
-        for (size_t i = 0; i < m_zones.size(); i++)
-        {
-            if (!usedZoneIndices[i])
+            for (size_t i = 0; i < m_zones.size(); i++)
             {
-                zoneRects.emplace_back(m_zones[i]->GetZoneRect());
-                freeZoneIndices.emplace_back(i);
+                if (!usedZoneIndices[i])
+                {
+                    zoneRects.emplace_back(m_zones[i]->GetZoneRect());
+                    freeZoneIndices.emplace_back(i);
+                }
+            }
+
+            size_t result = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, windowRect, zoneRects);
+            if (result < zoneRects.size())
+            {
+                targetZoneFound = freeZoneIndices[result];
             }
         }
 
-        size_t result = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, windowRect, zoneRects);
-        if (result < zoneRects.size())
+        if (targetZoneFound)
         {
-            size_t targetZone = freeZoneIndices[result];
+            size_t targetZone = *targetZoneFound;
             std::vector<size_t> resultIndexSet;
 
             // First time with selectManyZones = true for this window?
@@ -591,6 +623,21 @@ ZoneSet::CalculateZones(RECT workAreaRect, int zoneCount, int spacing) noexcept
         break;
     }
 
+    // Build the hit-test grid with the zones rather than on the first mouse move of a drag.
+    // The other indexes wait for their first use, most layouts never get one.
+    ResetZoneIndexes();
+    if (success)
+    {
+        try
+        {
+            GetHitTest();
+        }
+        catch (std::bad_alloc&)
+        {
+            m_hitTest.reset();
+        }
+    }
+
     return success;
 }
 
@@ -906,46 +953,31 @@ bool ZoneSet::CalculateGridZones(Rect workArea, FancyZonesDataTypes::GridLayoutI
 
 std::vector<size_t> ZoneSet::GetCombinedZoneRange(const std::vector<size_t>& initialZones, const std::vector<size_t>& finalZones) const noexcept
 {
-    std::vector<size_t> combinedZones, result;
-    std::set_union(begin(initialZones), end(initialZones), begin(finalZones), end(finalZones), std::back_inserter(combinedZones));
-
-    RECT boundingRect;
-    bool boundingRectEmpty = true;
-
-    for (size_t zoneId : combinedZones)
+    try
     {
-        if (m_zones.contains(zoneId))
+        // Dragging over a zone asks for the same range on every mouse move
+        auto key = std::make_pair(initialZones, finalZones);
+        auto cached = m_combinedZoneRanges.find(key);
+        if (cached != m_combinedZoneRanges.end())
         {
-            const RECT rect = m_zones.at(zoneId)->GetZoneRect();
-            if (boundingRectEmpty)
-            {
-                boundingRect = rect;
-                boundingRectEmpty = false;
-            }
-            else
-            {
-                boundingRect.left = min(boundingRect.left, rect.left);
-                boundingRect.top = min(boundingRect.top, rect.top);
-                boundingRect.right = max(boundingRect.right, rect.right);
-                boundingRect.bottom = max(boundingRect.bottom, rect.bottom);
-            }
+            return cached->second;
         }
-    }
 
-    if (!boundingRectEmpty)
-    {
-        for (const auto& [zoneId, zone] : m_zones)
+        std::vector<size_t> combinedZones;
+        std::set_union(begin(initialZones), end(initialZones), begin(finalZones), end(finalZones), std::back_inserter(combinedZones));
+        auto result = GetContainmentIndex().ZonesInsideBoundsOf(combinedZones);
+
+        if (m_combinedZoneRanges.size() >= C_MAX_COMBINED_ZONE_RANGES)
         {
-            const RECT rect = zone->GetZoneRect();
-            if (boundingRect.left <= rect.left && rect.right <= boundingRect.right &&
-                boundingRect.top <= rect.top && rect.bottom <= boundingRect.bottom)
-            {
-                result.push_back(zoneId);
-            }
+            m_combinedZoneRanges.clear();
         }
+        m_combinedZoneRanges.emplace(std::move(key), result);
+        return result;
+    }
+    catch (std::bad_alloc&)
+    {
+        return {};
     }
-
-    return result;
 }
 
 std::vector<size_t> ZoneSet::ZoneSelectSubregion(const std::vector<size_t>& capturedZones, POINT pt) const
@@ -1009,6 +1041,62 @@ std::vector<size_t> ZoneSet::ZoneSelectPriority(const std::vector<size_t>& captu
     return { capturedZones[chosen] };
 }
 
+const ZoneHitTest& ZoneSet::GetHitTest() const
+{
+    if (!m_hitTest)
+    {
+        std::vector<ZoneHitTest::Zone> zones;
+        zones.reserve(m_zones.size());
+        for (const auto& [zoneId, zone] : m_zones)
+        {
+            zones.push_back({ zoneId, zone->GetZoneRect() });
+        }
+        m_hitTest.emplace(zones, m_config.SensitivityRadius);
+    }
+
+    return *m_hitTest;
+}
+
+const ZoneAdjacencyGraph& ZoneSet::GetAdjacencyGraph() const
+{
+    if (!m_adjacencyGraph)
+    {
+        std::vector<ZoneAdjacencyGraph::Zone> zones;
+        zones.reserve(m_zones.size());
+        for (const auto& [zoneId, zone] : m_zones)
+        {
+            zones.push_back({ zoneId, zone->GetZoneRect() });
+        }
+        m_adjacencyGraph.emplace(zones);
+    }
+
+    return *m_adjacencyGraph;
+}
+
+const ZoneContainmentIndex& ZoneSet::GetContainmentIndex() const
+{
+    if (!m_containmentIndex)
+    {
+        std::vector<ZoneContainmentIndex::Zone> zones;
+        zones.reserve(m_zones.size());
+        for (const auto& [zoneId, zone] : m_zones)
+        {
+            zones.push_back({ zoneId, zone->GetZoneRect() });
+        }
+        m_containmentIndex.emplace(zones);
+    }
+
+    return *m_containmentIndex;
+}
+
+void ZoneSet::ResetZoneIndexes() noexcept
+{
+    m_hitTest.reset();
+    m_adjacencyGraph.reset();
+    m_containmentIndex.reset();
+    m_combinedZoneRanges.clear();
+}
+
 winrt::com_ptr<IZoneSet> MakeZoneSet(ZoneSetConfig const& config) noexcept
 {
     return winrt::make_self<ZoneSet>(config);
@@ -14,6 +14,7 @@
 
 #include <ShellScalingApi.h>
 #include <mutex>
+#include <tuple>
 #include <fileapi.h>
 
 #include <gdiplus.h>
@@ -140,6 +141,8 @@ public:
     ClearSelectedZones() noexcept;
     IFACEMETHODIMP_(void)
     FlashZones() noexcept;
+    IFACEMETHODIMP_(size_t)
+    WastedUpdateCount() const noexcept { return m_wastedUpdateCount; }
 
 protected:
     static LRESULT CALLBACK s_WndProc(HWND window, UINT message, WPARAM wparam, LPARAM lparam) noexcept;
@@ -161,6 +164,9 @@ private:
     std::vector<winrt::com_ptr<IZoneSet>> m_zoneSets;
     std::vector<size_t> m_initialHighlightZone;
     std::vector<size_t> m_highlightZone;
+    // Arguments of the last MoveSizeUpdate, the highlighted zones only change with them
+    std::optional<std::tuple<POINT, bool, bool>> m_lastUpdate;
+    size_t m_wastedUpdateCount{};
     WPARAM m_keyLast{};
     size_t m_keyCycle{};
     std::unique_ptr<ZoneWindowDrawing> m_zoneWindowDrawing;
@@ -223,6 +229,7 @@ IFACEMETHODIMP ZoneWindow::MoveSizeEnter(HWND window) noexcept
     m_windowMoveSize = window;
     m_highlightZone = {};
     m_initialHighlightZone = {};
+    m_lastUpdate.reset();
     ShowZoneWindow();
     return S_OK;
 }
@@ -233,6 +240,17 @@ IFACEMETHODIMP ZoneWindow::MoveSizeUpdate(POINT const& ptScreen, bool dragEnable
     POINT ptClient = ptScreen;
     MapWindowPoints(nullptr, m_window, &ptClient, 1);
 
+    if (m_lastUpdate)
+    {
+        const auto& [lastPoint, lastDragEnabled, lastSelectManyZones] = *m_lastUpdate;
+        if (lastPoint.x == ptClient.x && lastPoint.y == ptClient.y && lastDragEnabled == dragEnabled && lastSelectManyZones == selectManyZones)
+        {
+            m_wastedUpdateCount++;
+            return S_OK;
+        }
+    }
+    m_lastUpdate = std::make_tuple(ptClient, dragEnabled, selectManyZones);
+
     if (dragEnabled)
     {
         auto highlightZone = ZonesFromPoint(ptClient);
@@ -267,6 +285,10 @@ IFACEMETHODIMP ZoneWindow::MoveSizeUpdate(POINT const& ptScreen, bool dragEnable
     {
         m_zoneWindowDrawing->DrawActiveZoneSet(m_activeZoneSet->GetZones(), m_highlightZone, m_host);
     }
+    else
+    {
+        m_wastedUpdateCount++;
+    }
 
     return S_OK;
 }
@@ -290,6 +312,7 @@ IFACEMETHODIMP ZoneWindow::MoveSizeEnd(HWND window, POINT const& ptScreen) noexc
         }
     }
     Trace::ZoneWindow::MoveSizeEnd(m_activeZoneSet);
+    Logger::trace("Zone window updates that did not change the highlighted zones: {}", m_wastedUpdateCount);
 
     HideZoneWindow();
     m_windowMoveSize = nullptr;
@@ -381,6 +404,7 @@ ZoneWindow::ShowZoneWindow() noexcept
     if (m_window)
     {
         SetAsTopmostWindow();
+        m_wastedUpdateCount = 0;
         m_zoneWindowDrawing->DrawActiveZoneSet(m_activeZoneSet->GetZones(), m_highlightZone, m_host);
         m_zoneWindowDrawing->Show();
     }
@@ -395,6 +419,7 @@ ZoneWindow::HideZoneWindow() noexcept
         m_keyLast = 0;
         m_windowMoveSize = nullptr;
         m_highlightZone = {};
+        m_lastUpdate.reset();
     }
 }
 
@@ -405,6 +430,7 @@ ZoneWindow::UpdateActiveZoneSet() noexcept
     if (m_window)
     {
         m_highlightZone.clear();
+        m_lastUpdate.reset();
         m_zoneWindowDrawing->DrawActiveZoneSet(m_activeZoneSet->GetZones(), m_highlightZone, m_host);
     }
 }
@@ -412,6 +438,7 @@ ZoneWindow::UpdateActiveZoneSet() noexcept
 IFACEMETHODIMP_(void)
 ZoneWindow::ClearSelectedZones() noexcept
 {
+    m_lastUpdate.reset();
     if (m_highlightZone.size())
     {
         m_highlightZone.clear();
@@ -115,6 +115,11 @@ interface __declspec(uuid("{7F017528-8110-4FB3-BE41-F472969C2560}")) IZoneWindow
      * Display the layout on the screen and then hide it.
      */
     IFACEMETHOD_(void, FlashZones)() = 0;
+    /**
+     * @returns Number of calls to MoveSizeUpdate since the zone window was shown that left the
+     *          highlighted zones as they were, so there was nothing to redraw.
+     */
+    IFACEMETHOD_(size_t, WastedUpdateCount)() const = 0;
 };
 
 winrt::com_ptr<IZoneWindow> MakeZoneWindow(IZoneWindowHost* host, HINSTANCE hinstance, HMONITOR monitor,
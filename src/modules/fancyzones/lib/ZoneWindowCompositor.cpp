@@ -0,0 +1,138 @@
+#include "pch.h"
+
+#include "ZoneWindowCompositor.h"
+
+#include <algorithm>
+
+ZoneWindowCompositor::~ZoneWindowCompositor()
+{
+    {
+        std::unique_lock lock(m_mutex);
+        m_surfaces.clear();
+        m_abort = true;
+    }
+    m_cv.notify_all();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+ZoneWindowCompositor& ZoneWindowCompositor::Instance()
+{
+    static ZoneWindowCompositor compositor;
+    return compositor;
+}
+
+void ZoneWindowCompositor::Register(Surface* surface)
+{
+    {
+        std::unique_lock lock(m_mutex);
+        m_surfaces.push_back(surface);
+
+        // Unregister joins the thread when the last surface goes away
+        if (!m_thread.joinable())
+        {
+            m_abort = false;
+            m_thread = std::thread([this]() { Run(); });
+        }
+    }
+    m_cv.notify_all();
+}
+
+void ZoneWindowCompositor::Unregister(Surface* surface)
+{
+    std::thread stoppedThread;
+    {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [&]() {
+            return !m_rendering || std::find(m_dueSurfaces.begin(), m_dueSurfaces.end(), surface) == m_dueSurfaces.end();
+        });
+
+        m_surfaces.erase(std::remove(m_surfaces.begin(), m_surfaces.end(), surface), m_surfaces.end());
+        if (m_surfaces.empty() && m_thread.joinable())
+        {
+            m_abort = true;
+            stoppedThread = std::move(m_thread);
+        }
+    }
+    m_cv.notify_all();
+
+    if (stoppedThread.joinable())
+    {
+        stoppedThread.join();
+    }
+}
+
+void ZoneWindowCompositor::Wake()
+{
+    {
+        // Taking the lock orders the change of the surface with the deadlines the thread reads
+        std::unique_lock lock(m_mutex);
+    }
+    m_cv.notify_all();
+}
+
+bool ZoneWindowCompositor::IsRunning() const
+{
+    std::unique_lock lock(m_mutex);
+    return m_thread.joinable() && !m_abort;
+}
+
+void ZoneWindowCompositor::Run()
+{
+    std::unique_lock lock(m_mutex);
+    while (!m_abort)
+    {
+        const auto now = Clock::now();
+        std::optional<Clock::time_point> nextDeadline;
+
+        m_dueSurfaces.clear();
+        for (Surface* surface : m_surfaces)
+        {
+            const auto deadline = surface->NextFrame();
+            if (!deadline)
+            {
+                continue;
+            }
+
+            if (*deadline <= now)
+            {
+                m_dueSurfaces.push_back(surface);
+            }
+            else if (!nextDeadline || *deadline < *nextDeadline)
+            {
+                nextDeadline = deadline;
+            }
+        }
+
+        if (m_dueSurfaces.empty())
+        {
+            if (nextDeadline)
+            {
+                m_cv.wait_until(lock, *nextDeadline);
+            }
+            else
+            {
+                m_cv.wait(lock);
+            }
+            continue;
+        }
+
+        // The surfaces can be shown, hidden and changed while they are rendered, but not
+        // unregistered
+        m_rendering = true;
+        lock.unlock();
+
+        for (Surface* surface : m_dueSurfaces)
+        {
+            surface->RenderFrame();
+        }
+
+        lock.lock();
+        m_rendering = false;
+        m_dueSurfaces.clear();
+        m_cv.notify_all();
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * Single render thread for the zone windows of all monitors and virtual desktops. Each zone
+ * window registers its drawing surface and the thread renders the surfaces whose next frame is
+ * due, then sleeps until the earliest deadline of the others. Surfaces that are hidden or show a
+ * frame that does not change have no deadline and cost nothing. The thread runs while at least
+ * one surface is registered.
+ */
+class ZoneWindowCompositor
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Surface
+    {
+    public:
+        virtual ~Surface() = default;
+
+        /**
+         * Called by the render thread while it holds the lock of the compositor, so it must not
+         * call the compositor.
+         *
+         * @returns Time at which the next frame should be rendered, none if the surface is idle.
+         */
+        virtual std::optional<Clock::time_point> NextFrame() = 0;
+
+        /**
+         * Renders a frame. Called by the render thread once the deadline returned by NextFrame
+         * has passed.
+         */
+        virtual void RenderFrame() = 0;
+    };
+
+    ZoneWindowCompositor() = default;
+    ~ZoneWindowCompositor();
+
+    ZoneWindowCompositor(const ZoneWindowCompositor&) = delete;
+    ZoneWindowCompositor& operator=(const ZoneWindowCompositor&) = delete;
+
+    static ZoneWindowCompositor& Instance();
+
+    /**
+     * Register and Unregister are called by the thread that owns the zone windows. Unregister
+     * returns once the surface is no longer being rendered.
+     */
+    void Register(Surface* surface);
+    void Unregister(Surface* surface);
+
+    /**
+     * Asks the render thread to call NextFrame again, after a change of the surface. Must not be
+     * called with a lock the surface takes in NextFrame or RenderFrame.
+     */
+    void Wake();
+
+    bool IsRunning() const;
+
+private:
+    void Run();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Surface*> m_surfaces;
+    // Surfaces rendered at the moment, with m_mutex released
+    std::vector<Surface*> m_dueSurfaces;
+    bool m_rendering = false;
+    bool m_abort = false;
+    std::thread m_thread;
+};
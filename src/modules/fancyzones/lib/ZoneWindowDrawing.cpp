@@ -15,11 +15,6 @@ namespace
     const int FlashZonesDurationMillis = 700;
 }
 
-namespace NonLocalizable
-{
-    const wchar_t SegoeUiFont[] = L"Segoe ui";
-}
-
 float ZoneWindowDrawing::GetAnimationAlpha()
 {
     // Lock is held by the caller
@@ -41,26 +36,6 @@ float ZoneWindowDrawing::GetAnimationAlpha()
     return std::clamp(millis / FadeInDurationMillis, 0.001f, 1.f);
 }
 
-ID2D1Factory* ZoneWindowDrawing::GetD2DFactory()
-{
-    static auto pD2DFactory = [] {
-        ID2D1Factory* res = nullptr;
-        D2D1CreateFactory(D2D1_FACTORY_TYPE_MULTI_THREADED, &res);
-        return res;
-    }();
-    return pD2DFactory;
-}
-
-IDWriteFactory* ZoneWindowDrawing::GetWriteFactory()
-{
-    static auto pDWriteFactory = [] {
-        IUnknown* res = nullptr;
-        DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), &res);
-        return reinterpret_cast<IDWriteFactory*>(res);
-    }();
-    return pDWriteFactory;
-}
-
 D2D1_COLOR_F ZoneWindowDrawing::ConvertColor(COLORREF color)
 {
     return D2D1::ColorF(GetRValue(color) / 255.f,
@@ -76,45 +51,27 @@ D2D1_RECT_F ZoneWindowDrawing::ConvertRect(RECT rect)
 
 ZoneWindowDrawing::ZoneWindowDrawing(HWND window)
 {
-    HRESULT hr;
     m_window = window;
-    m_renderTarget = nullptr;
     m_shouldRender = false;
 
-    // Obtain the size of the drawing area.
-    if (!GetClientRect(window, &m_clientRect))
-    {
-        Logger::error("couldn't initialize ZoneWindowDrawing: GetClientRect failed");
-        return;
-    }
-
-    // Create a Direct2D render target
-    // We should always use the DPI value of 96 since we're running in DPI aware mode
-    auto renderTargetProperties = D2D1::RenderTargetProperties(
-        D2D1_RENDER_TARGET_TYPE_DEFAULT,
-        D2D1::PixelFormat(DXGI_FORMAT_UNKNOWN, D2D1_ALPHA_MODE_PREMULTIPLIED),
-        96.f,
-        96.f);
-
-    auto renderTargetSize = D2D1::SizeU(m_clientRect.right - m_clientRect.left, m_clientRect.bottom - m_clientRect.top);
-    auto hwndRenderTargetProperties = D2D1::HwndRenderTargetProperties(window, renderTargetSize);
+    const UINT refreshRate = FancyZonesUtils::GetRefreshRateForMonitor(MonitorFromWindow(window, MONITOR_DEFAULTTONEAREST));
+    m_frameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / refreshRate;
 
-    hr = GetD2DFactory()->CreateHwndRenderTarget(renderTargetProperties, hwndRenderTargetProperties, &m_renderTarget);
-
-    if (!SUCCEEDED(hr))
+    m_backend = D2DZoneDrawingBackend::Create(window);
+    if (!m_backend)
     {
-        Logger::error("couldn't initialize ZoneWindowDrawing: CreateHwndRenderTarget failed with {}", hr);
         return;
     }
 
-    m_renderThread = std::thread([this]() { RenderLoop(); });
+    ZoneWindowCompositor::Instance().Register(this);
+    m_registered = true;
 }
 
 ZoneWindowDrawing::RenderResult ZoneWindowDrawing::Render()
 {
     std::unique_lock lock(m_mutex);
 
-    if (!m_renderTarget)
+    if (!m_backend)
     {
         return RenderResult::Failed;
     }
@@ -126,89 +83,57 @@ ZoneWindowDrawing::RenderResult ZoneWindowDrawing::Render()
         return RenderResult::AnimationEnded;
     }
 
-    m_renderTarget->BeginDraw();
-
-    // Draw backdrop
-    m_renderTarget->Clear(D2D1::ColorF(0.f, 0.f, 0.f, 0.f));
+    m_sceneChanged = false;
+    m_renderedAlpha = animationAlpha;
+    m_lastFrame = std::chrono::steady_clock::now();
 
-    ID2D1SolidColorBrush* textBrush = nullptr;
-    IDWriteTextFormat* textFormat = nullptr;
-
-    m_renderTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black, animationAlpha), &textBrush);
-    auto writeFactory = GetWriteFactory();
-
-    if (writeFactory)
+    if (m_resourcesInvalidated)
     {
-        writeFactory->CreateTextFormat(NonLocalizable::SegoeUiFont, nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 80.f, L"en-US", &textFormat);
+        m_renderer.InvalidateResources(*m_backend);
+        m_resourcesInvalidated = false;
     }
 
-    for (auto drawableRect : m_sceneRects)
-    {
-        ID2D1SolidColorBrush* borderBrush = nullptr;
-        ID2D1SolidColorBrush* fillBrush = nullptr;
-
-        // Need to copy the rect from m_sceneRects
-        drawableRect.borderColor.a *= animationAlpha;
-        drawableRect.fillColor.a *= animationAlpha;
+    m_renderer.Draw(*m_backend, m_sceneRects, animationAlpha);
 
-        m_renderTarget->CreateSolidColorBrush(drawableRect.borderColor, &borderBrush);
-        m_renderTarget->CreateSolidColorBrush(drawableRect.fillColor, &fillBrush);
-
-        if (fillBrush)
-        {
-            m_renderTarget->FillRectangle(drawableRect.rect, fillBrush);
-            fillBrush->Release();
-        }
+    // The lock must be released here, EndDraw() presents the frame
+    lock.unlock();
 
-        if (borderBrush)
-        {
-            m_renderTarget->DrawRectangle(drawableRect.rect, borderBrush);
-            borderBrush->Release();
-        }
+    m_backend->EndDraw();
+    return RenderResult::Ok;
+}
 
-        std::wstring idStr = std::to_wstring(drawableRect.id + 1);
+std::optional<std::chrono::steady_clock::time_point> ZoneWindowDrawing::NextFrame()
+{
+    std::unique_lock lock(m_mutex);
 
-        if (textFormat && textBrush)
-        {
-            textFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
-            textFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
-            m_renderTarget->DrawTextW(idStr.c_str(), (UINT32)idStr.size(), textFormat, drawableRect.rect, textBrush);
-        }
+    if (!m_shouldRender)
+    {
+        return std::nullopt;
     }
 
-    if (textFormat)
+    // Fading in and flashing render every frame until the zones are opaque. The window keeps the
+    // last frame after that, so only a new scene needs to be rendered, and the end of the flash
+    // that hides the zones.
+    if (m_sceneChanged || !m_animation || m_renderedAlpha < 1.f)
     {
-        textFormat->Release();
+        return m_lastFrame + m_frameInterval;
     }
 
-    if (textBrush)
+    if (m_animation->autoHide)
     {
-        textBrush->Release();
+        return m_animation->tStart + std::chrono::milliseconds(FlashZonesDurationMillis + 1);
     }
 
-    // The lock must be released here, as EndDraw() will wait for vertical sync
-    lock.unlock();
-
-    m_renderTarget->EndDraw();
-    return RenderResult::Ok;
+    return std::nullopt;
 }
 
-void ZoneWindowDrawing::RenderLoop()
+void ZoneWindowDrawing::RenderFrame()
 {
-    while (!m_abortThread)
-    {
-        {
-            // Wait here while rendering is disabled
-            std::unique_lock lock(m_mutex);
-            m_cv.wait(lock, [this]() { return (bool)m_shouldRender; });
-        }
+    auto result = Render();
 
-        auto result = Render();
-
-        if (result == RenderResult::AnimationEnded || result == RenderResult::Failed)
-        {
-            Hide();
-        }
+    if (result == RenderResult::AnimationEnded || result == RenderResult::Failed)
+    {
+        Hide();
     }
 }
 
@@ -219,6 +144,7 @@ void ZoneWindowDrawing::Hide()
     {
         std::unique_lock lock(m_mutex);
         m_animation.reset();
+        m_renderedAlpha = 0.f;
         shouldHideWindow = m_shouldRender;
         m_shouldRender = false;
     }
@@ -254,7 +180,7 @@ void ZoneWindowDrawing::Show()
         ShowWindow(m_window, SW_SHOWNA);
     }
 
-    m_cv.notify_all();
+    ZoneWindowCompositor::Instance().Wake();
 }
 
 void ZoneWindowDrawing::Flash()
@@ -267,6 +193,8 @@ void ZoneWindowDrawing::Flash()
         m_shouldRender = true;
 
         m_animation.emplace(AnimationInfo{ .tStart = std::chrono::steady_clock().now(), .autoHide = true });
+        // The zones are faded in again from transparent
+        m_renderedAlpha = 0.f;
     }
 
     if (shouldShowWindow)
@@ -274,7 +202,7 @@ void ZoneWindowDrawing::Flash()
         ShowWindow(m_window, SW_SHOWNA);
     }
 
-    m_cv.notify_all();
+    ZoneWindowCompositor::Instance().Wake();
 }
 
 void ZoneWindowDrawing::DrawActiveZoneSet(const IZoneSet::ZonesMap& zones,
@@ -282,78 +210,93 @@ void ZoneWindowDrawing::DrawActiveZoneSet(const IZoneSet::ZonesMap& zones,
                                           winrt::com_ptr<IZoneWindowHost> host)
 {
     _TRACER_;
-    std::unique_lock lock(m_mutex);
+    bool sceneChanged = false;
+    {
+        std::unique_lock lock(m_mutex);
 
-    m_sceneRects = {};
+        m_nextSceneRects.clear();
 
-    auto borderColor = ConvertColor(host->GetZoneBorderColor());
-    auto inactiveColor = ConvertColor(host->GetZoneColor());
-    auto highlightColor = ConvertColor(host->GetZoneHighlightColor());
+        auto borderColor = ConvertColor(host->GetZoneBorderColor());
+        auto inactiveColor = ConvertColor(host->GetZoneColor());
+        auto highlightColor = ConvertColor(host->GetZoneHighlightColor());
 
-    inactiveColor.a = host->GetZoneHighlightOpacity() / 100.f;
-    highlightColor.a = host->GetZoneHighlightOpacity() / 100.f;
+        inactiveColor.a = host->GetZoneHighlightOpacity() / 100.f;
+        highlightColor.a = host->GetZoneHighlightOpacity() / 100.f;
 
-    std::vector<bool> isHighlighted(zones.size() + 1, false);
-    for (size_t x : highlightZones)
-    {
-        isHighlighted[x] = true;
-    }
+        std::array<D2D1_COLOR_F, 3> zoneColors{ borderColor, inactiveColor, highlightColor };
+        if (m_zoneColors && memcmp(m_zoneColors->data(), zoneColors.data(), sizeof(zoneColors)) != 0)
+        {
+            m_resourcesInvalidated = true;
+        }
+        m_zoneColors = zoneColors;
 
-    // First draw the inactive zones
-    for (const auto& [zoneId, zone] : zones)
-    {
-        if (!zone)
+        m_isHighlighted.assign(zones.size() + 1, false);
+        for (size_t x : highlightZones)
         {
-            continue;
+            m_isHighlighted[x] = true;
         }
 
-        if (!isHighlighted[zoneId])
+        // First draw the inactive zones
+        for (const auto& [zoneId, zone] : zones)
         {
-            DrawableRect drawableRect{
-                .rect = ConvertRect(zone->GetZoneRect()),
-                .borderColor = borderColor,
-                .fillColor = inactiveColor,
-                .id = zone->Id()
-            };
-
-            m_sceneRects.push_back(drawableRect);
+            if (!zone)
+            {
+                continue;
+            }
+
+            if (!m_isHighlighted[zoneId])
+            {
+                DrawableRect drawableRect{
+                    .rect = ConvertRect(zone->GetZoneRect()),
+                    .borderColor = borderColor,
+                    .fillColor = inactiveColor,
+                    .id = zone->Id()
+                };
+
+                m_nextSceneRects.push_back(drawableRect);
+            }
         }
-    }
 
-    // Draw the active zones on top of the inactive zones
-    for (const auto& [zoneId, zone] : zones)
-    {
-        if (!zone)
+        // Draw the active zones on top of the inactive zones
+        for (const auto& [zoneId, zone] : zones)
         {
-            continue;
+            if (!zone)
+            {
+                continue;
+            }
+
+            if (m_isHighlighted[zoneId])
+            {
+                DrawableRect drawableRect{
+                    .rect = ConvertRect(zone->GetZoneRect()),
+                    .borderColor = borderColor,
+                    .fillColor = highlightColor,
+                    .id = zone->Id()
+                };
+
+                m_nextSceneRects.push_back(drawableRect);
+            }
         }
 
-        if (isHighlighted[zoneId])
+        // Nothing to render again if the layout, the highlighted zones and the colors are the same
+        if (m_nextSceneRects != m_sceneRects)
         {
-            DrawableRect drawableRect{
-                .rect = ConvertRect(zone->GetZoneRect()),
-                .borderColor = borderColor,
-                .fillColor = highlightColor,
-                .id = zone->Id()
-            };
-
-            m_sceneRects.push_back(drawableRect);
+            m_sceneRects.swap(m_nextSceneRects);
+            m_sceneChanged = true;
+            sceneChanged = true;
         }
     }
-}
 
-ZoneWindowDrawing::~ZoneWindowDrawing()
-{
+    if (sceneChanged)
     {
-        std::unique_lock lock(m_mutex);
-        m_abortThread = true;
-        m_shouldRender = true;
+        ZoneWindowCompositor::Instance().Wake();
     }
-    m_cv.notify_all();
-    m_renderThread.join();
+}
 
-    if (m_renderTarget)
+ZoneWindowDrawing::~ZoneWindowDrawing()
+{
+    if (m_registered)
     {
-        m_renderTarget->Release();
+        ZoneWindowCompositor::Instance().Unregister(this);
     }
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <map>
+#include <memory>
 #include <vector>
 #include <wil\resource.h>
 #include <winrt/base.h>
@@ -11,16 +13,13 @@
 #include "Zone.h"
 #include "ZoneSet.h"
 #include "FancyZones.h"
+#include "ZoneWindowCompositor.h"
+#include "ZoneDrawingBackend.h"
+#include "ZoneSceneRenderer.h"
 
-class ZoneWindowDrawing
+class ZoneWindowDrawing : public ZoneWindowCompositor::Surface
 {
-    struct DrawableRect
-    {
-        D2D1_RECT_F rect;
-        D2D1_COLOR_F borderColor;
-        D2D1_COLOR_F fillColor;
-        size_t id;
-    };
+    using DrawableRect = ZoneSceneRenderer::DrawableRect;
 
     struct AnimationInfo
     {
@@ -36,25 +35,33 @@ class ZoneWindowDrawing
     };
 
     HWND m_window = nullptr;
-    RECT m_clientRect{};
-    ID2D1HwndRenderTarget* m_renderTarget = nullptr;
+    std::unique_ptr<D2DZoneDrawingBackend> m_backend;
+    // Only used by the compositor thread, with m_mutex held
+    ZoneSceneRenderer m_renderer;
     std::optional<AnimationInfo> m_animation;
+    bool m_shouldRender = false;
+    bool m_registered = false;
+    std::chrono::steady_clock::duration m_frameInterval{};
+    std::chrono::steady_clock::time_point m_lastFrame{};
 
     std::mutex m_mutex;
     std::vector<DrawableRect> m_sceneRects;
+    // The scene is built here and only replaces m_sceneRects if it differs, both keep their storage
+    std::vector<DrawableRect> m_nextSceneRects;
+    std::vector<bool> m_isHighlighted;
+    // Set when m_sceneRects changes, cleared when it is rendered
+    bool m_sceneChanged = false;
+    // Animation alpha of the last frame rendered, once it reaches 1 only scene changes are rendered
+    float m_renderedAlpha = 0.f;
+    // Border, inactive and highlight colors of the scene. The cached brushes are dropped when
+    // the settings change them.
+    std::optional<std::array<D2D1_COLOR_F, 3>> m_zoneColors;
+    bool m_resourcesInvalidated = false;
 
     float GetAnimationAlpha();
-    static ID2D1Factory* GetD2DFactory();
-    static IDWriteFactory* GetWriteFactory();
     static D2D1_COLOR_F ConvertColor(COLORREF color);
     static D2D1_RECT_F ConvertRect(RECT rect);
     RenderResult Render();
-    void RenderLoop();
-
-    std::atomic<bool> m_shouldRender = false;
-    std::atomic<bool> m_abortThread = false;
-    std::condition_variable m_cv;
-    std::thread m_renderThread;
 
 public:
 
@@ -66,4 +73,8 @@ public:
     void DrawActiveZoneSet(const IZoneSet::ZonesMap& zones,
                            const std::vector<size_t>& highlightZones,
                            winrt::com_ptr<IZoneWindowHost> host);
+
+    // ZoneWindowCompositor::Surface
+    std::optional<std::chrono::steady_clock::time_point> NextFrame() override;
+    void RenderFrame() override;
 };
@@ -9,6 +9,7 @@
 #include <array>
 #include <sstream>
 #include <complex>
+#include <limits>
 #include <wil/Resource.h>
 
 #include <fancyzones/lib/FancyZonesDataTypes.h>
@@ -222,6 +223,28 @@ namespace FancyZonesUtils
         return (dpi == 0) ? DPIAware::DEFAULT_DPI : dpi;
     }
 
+    UINT GetRefreshRateForMonitor(HMONITOR monitor) noexcept
+    {
+        const UINT defaultRefreshRate = 60;
+
+        MONITORINFOEX mi{};
+        mi.cbSize = sizeof(mi);
+        if (!monitor || !GetMonitorInfoW(monitor, &mi))
+        {
+            return defaultRefreshRate;
+        }
+
+        DEVMODEW devMode{};
+        devMode.dmSize = sizeof(devMode);
+        if (!EnumDisplaySettingsW(mi.szDevice, ENUM_CURRENT_SETTINGS, &devMode))
+        {
+            return defaultRefreshRate;
+        }
+
+        // 0 and 1 stand for the default refresh rate of the display
+        return (devMode.dmDisplayFrequency > 1) ? devMode.dmDisplayFrequency : defaultRefreshRate;
+    }
+
     void OrderMonitors(std::vector<std::pair<HMONITOR, RECT>>& monitorInfo)
     {
         const size_t nMonitors = monitorInfo.size();
@@ -711,11 +734,10 @@ namespace FancyZonesUtils
         return result;
     }
 
-    size_t ChooseNextZoneByPosition(DWORD vkCode, RECT windowRect, const std::vector<RECT>& zoneRects) noexcept
+    double ZoneDistanceByPosition(DWORD vkCode, RECT windowRect, RECT zoneRect, size_t zoneIndex) noexcept
     {
         using complex = std::complex<double>;
-        const size_t invalidResult = zoneRects.size();
-        const double inf = 1e100;
+        const double inf = std::numeric_limits<double>::infinity();
         const double eccentricity = 2.0;
 
         auto rectCenter = [](RECT rect) {
@@ -725,79 +747,72 @@ namespace FancyZonesUtils
             };
         };
 
-        auto distance = [&](complex arrowDirection, complex zoneDirection) {
-            double result = inf;
-
-            try
-            {
-                double scalarProduct = (arrowDirection * conj(zoneDirection)).real();
-                if (scalarProduct <= 0.0)
-                {
-                    return inf;
-                }
-
-                // no need to divide by abs(arrowDirection) because it's = 1
-                double cosAngle = scalarProduct / abs(zoneDirection);
-                double tanAngle = abs(tan(acos(cosAngle)));
-
-                if (tanAngle > 10)
-                {
-                    // The angle is too wide
-                    return inf;
-                }
-
-                // find the intersection with the ellipse with given eccentricity and major axis along arrowDirection
-                double intersectY = 2 * eccentricity / (1.0 + eccentricity * eccentricity * tanAngle * tanAngle);
-                double distanceEstimate = scalarProduct / intersectY;
-
-                if (std::isfinite(distanceEstimate))
-                {
-                    result = distanceEstimate;
-                }
-            }
-            catch (...)
-            {
-            }
-
-            return result;
-        };
-        std::vector<std::pair<size_t, complex>> candidateCenters;
-        for (size_t i = 0; i < zoneRects.size(); i++)
-        {
-            auto center = rectCenter(zoneRects[i]);
-
-            // Offset the zone slightly, to differentiate in case there are overlapping zones
-            center += 0.001 * (i + 1);
-
-            candidateCenters.emplace_back(i, center);
-        }
-
-        complex directionVector, windowCenter = rectCenter(windowRect);
-
+        complex arrowDirection;
         switch (vkCode)
         {
         case VK_UP:
-            directionVector = { 0.0, -1.0 };
+            arrowDirection = { 0.0, -1.0 };
             break;
         case VK_DOWN:
-            directionVector = { 0.0, 1.0 };
+            arrowDirection = { 0.0, 1.0 };
             break;
         case VK_LEFT:
-            directionVector = { -1.0, 0.0 };
+            arrowDirection = { -1.0, 0.0 };
             break;
         case VK_RIGHT:
-            directionVector = { 1.0, 0.0 };
+            arrowDirection = { 1.0, 0.0 };
             break;
         default:
-            return invalidResult;
+            return inf;
         }
 
-        size_t closestIdx = invalidResult;
-        double smallestDistance = inf;
+        // Offset the zone slightly, to differentiate in case there are overlapping zones
+        const complex zoneDirection = rectCenter(zoneRect) + 0.001 * (zoneIndex + 1) - rectCenter(windowRect);
+
+        double result = inf;
+
+        try
+        {
+            double scalarProduct = (arrowDirection * conj(zoneDirection)).real();
+            if (scalarProduct <= 0.0)
+            {
+                return inf;
+            }
+
+            // no need to divide by abs(arrowDirection) because it's = 1
+            double cosAngle = scalarProduct / abs(zoneDirection);
+            double tanAngle = abs(tan(acos(cosAngle)));
+
+            if (tanAngle > 10)
+            {
+                // The angle is too wide
+                return inf;
+            }
+
+            // find the intersection with the ellipse with given eccentricity and major axis along arrowDirection
+            double intersectY = 2 * eccentricity / (1.0 + eccentricity * eccentricity * tanAngle * tanAngle);
+            double distanceEstimate = scalarProduct / intersectY;
+
+            if (std::isfinite(distanceEstimate))
+            {
+                result = distanceEstimate;
+            }
+        }
+        catch (...)
+        {
+        }
+
+        return result;
+    }
+
+    size_t ChooseNextZoneByPosition(DWORD vkCode, RECT windowRect, const std::vector<RECT>& zoneRects) noexcept
+    {
+        size_t closestIdx = zoneRects.size();
+        double smallestDistance = std::numeric_limits<double>::infinity();
 
-        for (auto [zoneIdx, zoneCenter] : candidateCenters)
+        for (size_t zoneIdx = 0; zoneIdx < zoneRects.size(); zoneIdx++)
         {
-            double dist = distance(directionVector, zoneCenter - windowCenter);
+            double dist = ZoneDistanceByPosition(vkCode, windowRect, zoneRects[zoneIdx], zoneIdx);
             if (dist < smallestDistance)
             {
                 smallestDistance = dist;
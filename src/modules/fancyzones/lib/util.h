@@ -187,6 +187,8 @@ namespace FancyZonesUtils
     std::wstring GetDisplayDeviceId(const std::wstring& device, std::unordered_map<std::wstring, DWORD>& displayDeviceIdxMap);
 
     UINT GetDpiForMonitor(HMONITOR monitor) noexcept;
+    // Refresh rate of the monitor in Hz, 60 if it can not be read
+    UINT GetRefreshRateForMonitor(HMONITOR monitor) noexcept;
     void OrderMonitors(std::vector<std::pair<HMONITOR, RECT>>& monitorInfo);
 
     // Parameter rect must be in screen coordinates (e.g. obtained from GetWindowRect)
@@ -212,6 +214,10 @@ namespace FancyZonesUtils
     bool IsValidDeviceId(const std::wstring& str);
 
     RECT PrepareRectForCycling(RECT windowRect, RECT zoneWindowRect, DWORD vkCode) noexcept;
+    // How far zoneRect is from windowRect in the direction of the arrow key, as ranked by
+    // ChooseNextZoneByPosition. Infinite if the zone is not in that direction. zoneIndex is the
+    // position of the zone among the candidates, it breaks ties between overlapping zones.
+    double ZoneDistanceByPosition(DWORD vkCode, RECT windowRect, RECT zoneRect, size_t zoneIndex) noexcept;
     size_t ChooseNextZoneByPosition(DWORD vkCode, RECT windowRect, const std::vector<RECT>& zoneRects) noexcept;
 
     // If HWND is already dead, we assume it wasn't elevated
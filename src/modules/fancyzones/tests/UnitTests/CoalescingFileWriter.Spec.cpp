@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "lib\CoalescingFileWriter.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    TEST_CLASS (CoalescingFileWriterUnitTests)
+    {
+        // Two files, the callbacks count their writes
+        struct Files
+        {
+            std::atomic<size_t> first = 0;
+            std::atomic<size_t> second = 0;
+
+            std::unique_ptr<CoalescingFileWriter> MakeWriter(CoalescingFileWriter::Clock::duration delay)
+            {
+                return std::make_unique<CoalescingFileWriter>(std::vector<std::function<void()>>{ [this]() { first++; }, [this]() { second++; } }, delay);
+            }
+        };
+
+        bool WaitForWrites(const CoalescingFileWriter& writer, size_t count)
+        {
+            for (int i = 0; i < 500 && writer.WriteCount() < count; i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return writer.WriteCount() >= count;
+        }
+
+        TEST_METHOD (BurstWrittenOnce)
+        {
+            Files files;
+            auto writer = files.MakeWriter(std::chrono::milliseconds(100));
+
+            for (int i = 0; i < 50; i++)
+            {
+                writer->MarkDirty(1);
+            }
+
+            Assert::IsTrue(WaitForWrites(*writer, 1));
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+            Assert::AreEqual(size_t{ 0 }, files.first.load());
+            Assert::AreEqual(size_t{ 1 }, files.second.load());
+            Assert::AreEqual(size_t{ 1 }, writer->WriteCount());
+        }
+
+        TEST_METHOD (NotWrittenBeforeDelay)
+        {
+            Files files;
+            auto writer = files.MakeWriter(std::chrono::hours(1));
+
+            writer->MarkDirty(0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            Assert::AreEqual(size_t{ 0 }, files.first.load());
+            Assert::IsTrue(writer->IsRunning());
+        }
+
+        TEST_METHOD (ChangeAfterWriteWrittenAgain)
+        {
+            Files files;
+            auto writer = files.MakeWriter(std::chrono::milliseconds(10));
+
+            writer->MarkDirty(0);
+            Assert::IsTrue(WaitForWrites(*writer, 1));
+
+            writer->MarkDirty(0);
+            Assert::IsTrue(WaitForWrites(*writer, 2));
+
+            Assert::AreEqual(size_t{ 2 }, files.first.load());
+        }
+
+        TEST_METHOD (WorkerStopsWhenClean)
+        {
+            Files files;
+            auto writer = files.MakeWriter(std::chrono::milliseconds(10));
+
+            writer->MarkDirty(0);
+            Assert::IsTrue(WaitForWrites(*writer, 1));
+
+            for (int i = 0; i < 500 && writer->IsRunning(); i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            Assert::IsFalse(writer->IsRunning());
+        }
+
+        TEST_METHOD (Flush)
+        {
+            Files files;
+            auto writer = files.MakeWriter(std::chrono::hours(1));
+
+            writer->MarkDirty(0);
+            writer->MarkDirty(1);
+            writer->Flush(0);
+
+            Assert::AreEqual(size_t{ 1 }, files.first.load());
+            Assert::AreEqual(size_t{ 0 }, files.second.load());
+
+            // Clean files are not written
+            writer->Flush(0);
+            Assert::AreEqual(size_t{ 1 }, files.first.load());
+        }
+
+        TEST_METHOD (Discard)
+        {
+            Files files;
+            auto writer = files.MakeWriter(std::chrono::hours(1));
+
+            writer->MarkDirty(0);
+            writer->Discard(0);
+            writer->FlushAll();
+
+            Assert::AreEqual(size_t{ 0 }, files.first.load());
+            Assert::AreEqual(size_t{ 0 }, writer->WriteCount());
+        }
+
+        TEST_METHOD (FlushedOnDestruction)
+        {
+            Files files;
+            auto writer = files.MakeWriter(std::chrono::hours(1));
+
+            writer->MarkDirty(0);
+            writer->MarkDirty(1);
+            writer.reset();
+
+            Assert::AreEqual(size_t{ 1 }, files.first.load());
+            Assert::AreEqual(size_t{ 1 }, files.second.load());
+        }
+
+        TEST_METHOD (DelayApplied)
+        {
+            Files files;
+            auto writer = files.MakeWriter(std::chrono::hours(1));
+
+            writer->SetDelay(std::chrono::milliseconds(10));
+            writer->MarkDirty(0);
+
+            Assert::IsTrue(WaitForWrites(*writer, 1));
+            Assert::AreEqual(size_t{ 1 }, files.first.load());
+        }
+    };
+}
@@ -2021,6 +2021,33 @@ namespace FancyZonesUnitTests
 
                 Assert::IsFalse(data.RemoveAppLastZone(nullptr, deviceId, zoneSetId));
             }
+
+            TEST_METHOD (AppLastZonesBurstSavedOnce)
+            {
+                const std::wstring zoneSetId = L"zoneset-uuid";
+                const std::wstring deviceId = L"device-id";
+                const auto window = Mocks::WindowCreate(m_hInst);
+                FancyZonesData data;
+                data.SetSettingsModulePath(m_moduleName);
+                data.SetSaveDelay(std::chrono::hours(1));
+
+                for (size_t i = 0; i < 50; i++)
+                {
+                    Assert::IsTrue(data.SetAppLastZones(window, deviceId, zoneSetId, { i % 3 }));
+                }
+
+                Assert::IsFalse(std::filesystem::exists(data.appZoneHistoryFileName));
+
+                data.FlushPendingSaves();
+
+                Assert::AreEqual(size_t{ 1 }, data.pendingSaves.WriteCount());
+                auto savedJson = json::from_file(data.appZoneHistoryFileName);
+                Assert::IsTrue(savedJson.has_value());
+
+                auto history = JSONHelpers::ParseAppZoneHistory(*savedJson);
+                Assert::AreEqual(size_t{ 1 }, history.size());
+                Assert::IsTrue(std::vector<size_t>{ 49 % 3 } == history.begin()->second[0].zoneIndexSet);
+            }
     };
 
     TEST_CLASS(EditorArgsUnitTests)
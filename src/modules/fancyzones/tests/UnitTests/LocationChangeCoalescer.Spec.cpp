@@ -0,0 +1,143 @@
+#include "pch.h"
+#include "lib\LocationChangeCoalescer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    TEST_CLASS (LocationChangeCoalescerUnitTests)
+    {
+        const HWND m_draggedWindow = reinterpret_cast<HWND>(0x100);
+        const HWND m_otherWindow = reinterpret_cast<HWND>(0x200);
+
+    public:
+        TEST_METHOD (NotTracking)
+        {
+            LocationChangeCoalescer coalescer;
+            Assert::IsFalse(coalescer.OnLocationChange(m_draggedWindow, OBJID_WINDOW));
+            Assert::IsFalse(coalescer.OnLocationChange(nullptr, OBJID_CURSOR));
+            Assert::IsFalse(coalescer.Drain());
+        }
+
+        TEST_METHOD (FiltersOtherObjects)
+        {
+            LocationChangeCoalescer coalescer;
+            coalescer.StartTracking(m_draggedWindow);
+            Assert::IsFalse(coalescer.OnLocationChange(m_otherWindow, OBJID_WINDOW));
+            Assert::IsFalse(coalescer.OnLocationChange(m_otherWindow, OBJID_CARET));
+            Assert::IsFalse(coalescer.OnLocationChange(m_draggedWindow, OBJID_CARET));
+            Assert::IsFalse(coalescer.Drain());
+
+            Assert::IsTrue(coalescer.OnLocationChange(m_draggedWindow, OBJID_WINDOW));
+            Assert::IsTrue(coalescer.Drain());
+            Assert::IsTrue(coalescer.OnLocationChange(nullptr, OBJID_CURSOR));
+            Assert::IsTrue(coalescer.Drain());
+
+            const auto counters = coalescer.GetCounters();
+            Assert::AreEqual(uint64_t{ 5 }, counters.received);
+            Assert::AreEqual(uint64_t{ 3 }, counters.dropped);
+            Assert::AreEqual(uint64_t{ 2 }, counters.processed);
+        }
+
+        TEST_METHOD (CoalescesPendingUpdates)
+        {
+            LocationChangeCoalescer coalescer;
+            coalescer.StartTracking(m_draggedWindow);
+            Assert::IsTrue(coalescer.OnLocationChange(m_draggedWindow, OBJID_WINDOW));
+            Assert::IsFalse(coalescer.OnLocationChange(m_draggedWindow, OBJID_WINDOW));
+            Assert::IsFalse(coalescer.RequestUpdate());
+            Assert::IsTrue(coalescer.Drain());
+            Assert::IsFalse(coalescer.Drain());
+
+            Assert::IsTrue(coalescer.RequestUpdate());
+            Assert::IsTrue(coalescer.Drain());
+        }
+
+        TEST_METHOD (StopTracking)
+        {
+            LocationChangeCoalescer coalescer;
+            coalescer.StartTracking(m_draggedWindow);
+            coalescer.StopTracking();
+            Assert::IsFalse(coalescer.OnLocationChange(m_draggedWindow, OBJID_WINDOW));
+
+            // The counters start over with the next drag
+            coalescer.StartTracking(m_otherWindow);
+            Assert::IsTrue(coalescer.OnLocationChange(m_otherWindow, OBJID_WINDOW));
+            Assert::AreEqual(uint64_t{ 1 }, coalescer.GetCounters().received);
+        }
+
+        TEST_METHOD (StartTrackingClearsPendingUpdate)
+        {
+            // The drag ends before the FancyZones thread drains the last update
+            LocationChangeCoalescer coalescer;
+            coalescer.StartTracking(m_draggedWindow);
+            Assert::IsTrue(coalescer.OnLocationChange(m_draggedWindow, OBJID_WINDOW));
+            coalescer.StopTracking();
+            Assert::IsFalse(coalescer.Drain());
+
+            coalescer.StartTracking(m_draggedWindow);
+            Assert::IsFalse(coalescer.Drain());
+            Assert::IsTrue(coalescer.RequestUpdate());
+            coalescer.StartTracking(m_draggedWindow);
+            Assert::IsTrue(coalescer.OnLocationChange(m_draggedWindow, OBJID_WINDOW));
+            Assert::IsTrue(coalescer.Drain());
+        }
+
+        TEST_METHOD (ReplayDrag)
+        {
+            // Events of a drag where each mouse move reports the dragged window, the cursor, the
+            // caret of the focused window and a few windows animating in the background. The
+            // FancyZones thread gets to its queue after every third mouse move.
+            const size_t mouseMoves = 600;
+            const size_t backgroundWindows = 4;
+
+            LocationChangeCoalescer coalescer;
+            coalescer.StartTracking(m_draggedWindow);
+            size_t events = 0;
+            size_t posted = 0;
+            size_t queued = 0;
+            size_t maxQueued = 0;
+            size_t handled = 0;
+            for (size_t move = 0; move < mouseMoves; move++)
+            {
+                auto replay = [&](HWND window, LONG idObject) {
+                    events++;
+                    if (coalescer.OnLocationChange(window, idObject))
+                    {
+                        posted++;
+                        queued++;
+                        maxQueued = max(maxQueued, queued);
+                    }
+                };
+
+                replay(m_draggedWindow, OBJID_WINDOW);
+                replay(nullptr, OBJID_CURSOR);
+                replay(m_otherWindow, OBJID_CARET);
+                for (size_t i = 0; i < backgroundWindows; i++)
+                {
+                    replay(reinterpret_cast<HWND>(0x1000 + i), OBJID_WINDOW);
+                }
+
+                if (move % 3 == 2)
+                {
+                    for (; queued > 0; queued--)
+                    {
+                        handled += coalescer.Drain() ? 1 : 0;
+                    }
+                }
+            }
+            coalescer.StopTracking();
+
+            const auto counters = coalescer.GetCounters();
+            Assert::AreEqual(static_cast<uint64_t>(events), counters.received);
+            Assert::AreEqual(static_cast<uint64_t>(events - posted), counters.dropped);
+            Assert::AreEqual(static_cast<uint64_t>(handled), counters.processed);
+            Assert::AreEqual(size_t{ 1 }, maxQueued);
+            Assert::AreEqual(mouseMoves / 3, posted);
+
+            wchar_t message[256];
+            swprintf_s(message, L"Location changes: received %llu, dropped %llu, processed %llu\n", counters.received, counters.dropped, counters.processed);
+            Logger::WriteMessage(message);
+        }
+    };
+}
@@ -0,0 +1,253 @@
+#include "pch.h"
+#include "lib\ZoneSceneRenderer.h"
+
+#include <atomic>
+#include <crtdbg.h>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    namespace
+    {
+        // Heap allocations made by one thread, counted by a debug CRT allocation hook
+        std::atomic<DWORD> g_countedThread = 0;
+        std::atomic<size_t> g_allocationCount = 0;
+
+        int __cdecl CountAllocations(int allocType, void*, size_t, int blockType, long, const unsigned char*, int)
+        {
+            if ((allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC) && blockType != _CRT_BLOCK && GetCurrentThreadId() == g_countedThread)
+            {
+                g_allocationCount++;
+            }
+            return TRUE;
+        }
+    }
+
+    TEST_CLASS (ZoneSceneRendererUnitTests)
+    {
+        using DrawableRect = ZoneSceneRenderer::DrawableRect;
+
+        // Records the drawing operations of the last frame and counts the resources created
+        class RecordingBackend : public ZoneDrawingBackend
+        {
+        public:
+            enum class Operation
+            {
+                BeginDraw,
+                Clear,
+                FillRectangle,
+                DrawRectangle,
+                DrawTextLayout,
+                EndDraw,
+            };
+
+            struct Record
+            {
+                Operation operation;
+                size_t resource;
+            };
+
+            RecordingBackend()
+            {
+                // Recording a frame must not allocate either
+                m_frame.reserve(1024);
+            }
+
+            std::optional<Brush> CreateBrush(const D2D1_COLOR_F& color) override
+            {
+                m_brushes.push_back(color);
+                return m_brushes.size() - 1;
+            }
+
+            std::optional<TextLayout> CreateTextLayout(std::wstring_view text) override
+            {
+                m_textLayouts.emplace_back(text);
+                return m_textLayouts.size() - 1;
+            }
+
+            void ReleaseResources() override
+            {
+                m_brushes.clear();
+                m_textLayouts.clear();
+                m_releaseCount++;
+            }
+
+            void BeginDraw() override
+            {
+                m_frame.clear();
+                m_frame.push_back({ Operation::BeginDraw, 0 });
+            }
+
+            void Clear(const D2D1_COLOR_F&) override
+            {
+                m_frame.push_back({ Operation::Clear, 0 });
+            }
+
+            void FillRectangle(const D2D1_RECT_F&, Brush brush) override
+            {
+                Assert::IsTrue(brush < m_brushes.size());
+                m_frame.push_back({ Operation::FillRectangle, brush });
+            }
+
+            void DrawRectangle(const D2D1_RECT_F&, Brush brush) override
+            {
+                Assert::IsTrue(brush < m_brushes.size());
+                m_frame.push_back({ Operation::DrawRectangle, brush });
+            }
+
+            void DrawTextLayout(D2D1_POINT_2F, TextLayout layout, Brush brush) override
+            {
+                Assert::IsTrue(layout < m_textLayouts.size());
+                Assert::IsTrue(brush < m_brushes.size());
+                m_frame.push_back({ Operation::DrawTextLayout, layout });
+            }
+
+            HRESULT EndDraw() override
+            {
+                m_frame.push_back({ Operation::EndDraw, 0 });
+                return S_OK;
+            }
+
+            std::vector<Record> m_frame;
+            std::vector<D2D1_COLOR_F> m_brushes;
+            std::vector<std::wstring> m_textLayouts;
+            size_t m_releaseCount = 0;
+        };
+
+        std::vector<DrawableRect> MakeScene(size_t zoneCount, size_t highlighted)
+        {
+            std::vector<DrawableRect> scene;
+            for (size_t i = 0; i < zoneCount; i++)
+            {
+                scene.push_back(DrawableRect{
+                    .rect = D2D1::RectF(i * 100.f + 0.5f, 0.5f, i * 100.f + 99.5f, 99.5f),
+                    .borderColor = D2D1::ColorF(1.f, 1.f, 1.f, 1.f),
+                    .fillColor = i == highlighted ? D2D1::ColorF(0.f, 0.5f, 1.f, 0.5f) : D2D1::ColorF(0.2f, 0.2f, 0.2f, 0.5f),
+                    .id = i });
+            }
+            return scene;
+        }
+
+        TEST_METHOD (DrawsZonesFromBottomToTop)
+        {
+            RecordingBackend backend;
+            ZoneSceneRenderer renderer;
+            auto scene = MakeScene(2, 0);
+
+            renderer.Draw(backend, scene, 1.f);
+
+            using Operation = RecordingBackend::Operation;
+            std::vector<Operation> expected{ Operation::BeginDraw, Operation::Clear,
+                                             Operation::FillRectangle, Operation::DrawRectangle, Operation::DrawTextLayout,
+                                             Operation::FillRectangle, Operation::DrawRectangle, Operation::DrawTextLayout };
+            Assert::AreEqual(expected.size(), backend.m_frame.size());
+            for (size_t i = 0; i < expected.size(); i++)
+            {
+                Assert::IsTrue(expected[i] == backend.m_frame[i].operation);
+            }
+
+            Assert::AreEqual(size_t{ 2 }, backend.m_textLayouts.size());
+            Assert::AreEqual(std::wstring(L"1"), backend.m_textLayouts[backend.m_frame[4].resource]);
+            Assert::AreEqual(std::wstring(L"2"), backend.m_textLayouts[backend.m_frame[7].resource]);
+        }
+
+        TEST_METHOD (BrushesKeyedByColorAndAlpha)
+        {
+            RecordingBackend backend;
+            ZoneSceneRenderer renderer;
+            auto scene = MakeScene(10, 3);
+
+            renderer.Draw(backend, scene, 1.f);
+
+            // Text, border, inactive and highlight colors
+            Assert::AreEqual(size_t{ 4 }, backend.m_brushes.size());
+
+            renderer.Draw(backend, scene, 0.5f);
+
+            Assert::AreEqual(size_t{ 8 }, backend.m_brushes.size());
+            Assert::AreEqual(0.25f, backend.m_brushes[backend.m_frame[2].resource].a);
+        }
+
+        TEST_METHOD (NoResourcesCreatedAfterWarmUp)
+        {
+            RecordingBackend backend;
+            ZoneSceneRenderer renderer;
+            auto scene = MakeScene(20, 5);
+
+            // A fade in, then the same fade in again
+            for (int pass = 0; pass < 2; pass++)
+            {
+                for (int frame = 0; frame <= 100; frame++)
+                {
+                    renderer.Draw(backend, scene, frame / 100.f);
+                }
+
+                if (pass == 0)
+                {
+                    Assert::IsTrue(backend.m_brushes.size() <= 4 * (ZoneSceneRenderer::C_ALPHA_BUCKETS + 1));
+                    Assert::AreEqual(scene.size(), backend.m_textLayouts.size());
+                }
+            }
+
+            Assert::IsTrue(backend.m_brushes.size() <= 4 * (ZoneSceneRenderer::C_ALPHA_BUCKETS + 1));
+            Assert::AreEqual(scene.size(), backend.m_textLayouts.size());
+            Assert::AreEqual(size_t{ 0 }, backend.m_releaseCount);
+        }
+
+        TEST_METHOD (NoAllocationsPerFrameAfterWarmUp)
+        {
+            RecordingBackend backend;
+            ZoneSceneRenderer renderer;
+            auto scene = MakeScene(20, 5);
+
+            for (int frame = 0; frame <= 100; frame++)
+            {
+                renderer.Draw(backend, scene, frame / 100.f);
+            }
+
+            const size_t brushCount = backend.m_brushes.size();
+            const size_t layoutCount = backend.m_textLayouts.size();
+
+#ifdef _DEBUG
+            g_allocationCount = 0;
+            g_countedThread = GetCurrentThreadId();
+            auto previousHook = _CrtSetAllocHook(CountAllocations);
+#endif
+
+            for (int frame = 0; frame <= 100; frame++)
+            {
+                renderer.Draw(backend, scene, frame / 100.f);
+            }
+
+#ifdef _DEBUG
+            _CrtSetAllocHook(previousHook);
+            g_countedThread = 0;
+            Assert::AreEqual(size_t{ 0 }, g_allocationCount.load());
+#endif
+
+            Assert::AreEqual(brushCount, backend.m_brushes.size());
+            Assert::AreEqual(layoutCount, backend.m_textLayouts.size());
+        }
+
+        TEST_METHOD (InvalidateResources)
+        {
+            RecordingBackend backend;
+            ZoneSceneRenderer renderer;
+            auto scene = MakeScene(3, 0);
+
+            renderer.Draw(backend, scene, 1.f);
+            renderer.InvalidateResources(backend);
+
+            Assert::AreEqual(size_t{ 1 }, backend.m_releaseCount);
+            Assert::AreEqual(size_t{ 0 }, backend.m_brushes.size());
+
+            renderer.Draw(backend, scene, 1.f);
+
+            Assert::AreEqual(size_t{ 4 }, backend.m_brushes.size());
+            Assert::AreEqual(size_t{ 3 }, backend.m_textLayouts.size());
+        }
+    };
+}
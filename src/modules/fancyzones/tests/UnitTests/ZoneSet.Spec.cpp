@@ -4,8 +4,14 @@
 #include "lib\JsonHelpers.h"
 #include "lib\VirtualDesktopUtils.h"
 #include "lib\ZoneSet.h"
+#include "lib\ZoneAdjacencyGraph.h"
+#include "lib\ZoneContainmentIndex.h"
+#include "lib\ZoneHitTest.h"
+#include "lib\util.h"
 
+#include <chrono>
 #include <filesystem>
+#include <random>
 
 #include "Util.h"
 #include <common/SettingsAPI/settings_helpers.h>
@@ -1125,4 +1131,356 @@ namespace FancyZonesUnitTests
                     }
                 }
     };
+    TEST_CLASS (ZoneHitTestUnitTests)
+    {
+        struct Reference
+        {
+            std::vector<size_t> zones;
+            bool strictlyCaptured = false;
+            bool overlap = false;
+        };
+
+        // What ZonesFromPoint computed by scanning every zone
+        static Reference LinearHitTest(const std::vector<ZoneHitTest::Zone>& zones, int sensitivityRadius, POINT pt)
+        {
+            Reference result;
+            std::vector<RECT> capturedRects;
+            for (const auto& zone : zones)
+            {
+                const RECT& rect = zone.rect;
+                if (rect.left - sensitivityRadius <= pt.x && pt.x <= rect.right + sensitivityRadius &&
+                    rect.top - sensitivityRadius <= pt.y && pt.y <= rect.bottom + sensitivityRadius)
+                {
+                    result.zones.push_back(zone.id);
+                    capturedRects.push_back(rect);
+                }
+
+                if (rect.left <= pt.x && pt.x < rect.right && rect.top <= pt.y && pt.y < rect.bottom)
+                {
+                    result.strictlyCaptured = true;
+                }
+            }
+
+            for (size_t i = 0; i < capturedRects.size(); i++)
+            {
+                for (size_t j = i + 1; j < capturedRects.size(); j++)
+                {
+                    const RECT& first = capturedRects[i];
+                    const RECT& second = capturedRects[j];
+                    if (max(first.top, second.top) + sensitivityRadius < min(first.bottom, second.bottom) &&
+                        max(first.left, second.left) + sensitivityRadius < min(first.right, second.right))
+                    {
+                        result.overlap = true;
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        // Canvas layout of overlapping zones on a 4K monitor
+        static std::vector<ZoneHitTest::Zone> MakeCanvasZones(size_t count, std::mt19937& random)
+        {
+            std::uniform_int_distribution<long> x(0, 3400);
+            std::uniform_int_distribution<long> y(0, 1800);
+            std::uniform_int_distribution<long> extent(150, 600);
+            std::vector<ZoneHitTest::Zone> zones;
+            for (size_t i = 0; i < count; i++)
+            {
+                const long left = x(random);
+                const long top = y(random);
+                zones.push_back({ i, RECT{ left, top, left + extent(random), top + extent(random) } });
+            }
+            return zones;
+        }
+
+    public:
+        TEST_METHOD (EmptyLayout)
+        {
+            const ZoneHitTest hitTest({}, DefaultValues::SensitivityRadius);
+            Assert::IsTrue(hitTest.HitTest(POINT{ 0, 0 }).zones.empty());
+        }
+
+        TEST_METHOD (MatchesLinearScan)
+        {
+            std::mt19937 random(42);
+            std::uniform_int_distribution<long> coordinate(-100, 4000);
+            for (int sensitivityRadius : { 0, 5, 20 })
+            {
+                for (size_t zoneCount : { 1u, 4u, 50u, 300u })
+                {
+                    const auto zones = MakeCanvasZones(zoneCount, random);
+                    const ZoneHitTest hitTest(zones, sensitivityRadius);
+                    for (size_t i = 0; i < 2000; i++)
+                    {
+                        // Every other point on the edge of a zone or of its sensitivity radius
+                        POINT pt{ coordinate(random), coordinate(random) };
+                        if (i % 2 == 0)
+                        {
+                            const RECT& rect = zones[i % zones.size()].rect;
+                            pt.x = (i % 4 == 0) ? rect.right + sensitivityRadius : rect.left;
+                            pt.y = (i % 8 == 0) ? rect.top - sensitivityRadius : rect.bottom;
+                        }
+
+                        const auto expected = LinearHitTest(zones, sensitivityRadius, pt);
+                        const auto actual = hitTest.HitTest(pt);
+                        Assert::IsTrue(expected.zones == actual.zones);
+                        Assert::AreEqual(expected.strictlyCaptured, actual.strictlyCaptured);
+                        Assert::AreEqual(expected.overlap, actual.overlap);
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD (ZonesFromPointBenchmark)
+        {
+            std::mt19937 random(7);
+            const auto zones = MakeCanvasZones(400, random);
+
+            GUID id;
+            Assert::AreEqual(S_OK, CoCreateGuid(&id));
+            auto set = MakeZoneSet(ZoneSetConfig(id, ZoneSetLayoutType::Custom, Mocks::Monitor(), DefaultValues::SensitivityRadius, Settings::OverlappingZonesAlgorithm::Smallest));
+            for (const auto& zone : zones)
+            {
+                set->AddZone(MakeZone(zone.rect, zone.id));
+            }
+
+            std::uniform_int_distribution<long> x(0, 3839);
+            std::uniform_int_distribution<long> y(0, 2159);
+            std::vector<POINT> points(100000);
+            for (auto& pt : points)
+            {
+                pt = POINT{ x(random), y(random) };
+            }
+
+            const auto zonesMap = set->GetZones();
+            size_t expectedCount = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& pt : points)
+            {
+                // The scan ZonesFromPoint did through the zone objects
+                std::vector<ZoneHitTest::Zone> scanned;
+                for (const auto& [zoneId, zone] : zonesMap)
+                {
+                    scanned.push_back({ zoneId, zone->GetZoneRect() });
+                }
+                expectedCount += LinearHitTest(scanned, DefaultValues::SensitivityRadius, pt).zones.size();
+            }
+            const auto linearTime = std::chrono::steady_clock::now() - start;
+
+            // The first call builds the grid
+            start = std::chrono::steady_clock::now();
+            size_t count = 0;
+            for (const auto& pt : points)
+            {
+                count += set->ZonesFromPoint(pt).empty() ? 0 : 1;
+            }
+            const auto gridTime = std::chrono::steady_clock::now() - start;
+
+            // Only points within the radius of a zone get one
+            Assert::IsTrue(count <= expectedCount);
+            wchar_t message[256];
+            swprintf_s(message, L"ZonesFromPoint over %zu zones: linear scan %.3f us, hit-test grid %.3f us per point\n", zones.size(), std::chrono::duration<double, std::micro>(linearTime).count() / points.size(), std::chrono::duration<double, std::micro>(gridTime).count() / points.size());
+            Logger::WriteMessage(message);
+        }
+    };
+
+    TEST_CLASS (ZoneAdjacencyGraphUnitTests)
+    {
+        // rows x columns grid of equal zones, numbered row by row
+        static std::vector<ZoneAdjacencyGraph::Zone> MakeGridZones(long rows, long columns)
+        {
+            std::vector<ZoneAdjacencyGraph::Zone> zones;
+            for (long row = 0; row < rows; row++)
+            {
+                for (long column = 0; column < columns; column++)
+                {
+                    zones.push_back({ zones.size(), RECT{ column * 100, row * 100, (column + 1) * 100, (row + 1) * 100 } });
+                }
+            }
+            return zones;
+        }
+
+        // What MoveWindowIntoZoneByDirectionAndPosition computed for a window in one zone
+        static size_t ScanNextZone(const std::vector<ZoneAdjacencyGraph::Zone>& zones, size_t from, DWORD vkCode)
+        {
+            std::vector<RECT> zoneRects;
+            std::vector<size_t> freeZoneIds;
+            for (const auto& zone : zones)
+            {
+                if (zone.id != from)
+                {
+                    zoneRects.push_back(zone.rect);
+                    freeZoneIds.push_back(zone.id);
+                }
+            }
+
+            const size_t result = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, zones[from].rect, zoneRects);
+            return result < zoneRects.size() ? freeZoneIds[result] : zones.size();
+        }
+
+    public:
+        TEST_METHOD (EmptyLayout)
+        {
+            const ZoneAdjacencyGraph graph({});
+            Assert::IsTrue(graph.Neighbors(0, VK_LEFT).empty());
+            Assert::IsFalse(graph.NextZone(0, VK_LEFT, {}).has_value());
+            Assert::IsFalse(graph.CycleZone(0, VK_LEFT, RECT{ 0, 0, 100, 100 }).has_value());
+        }
+
+        TEST_METHOD (UnknownZoneOrKey)
+        {
+            const ZoneAdjacencyGraph graph(MakeGridZones(2, 2));
+            Assert::IsTrue(graph.Neighbors(4, VK_RIGHT).empty());
+            Assert::IsTrue(graph.Neighbors(0, VK_RETURN).empty());
+            Assert::IsFalse(graph.CycleZone(0, VK_RETURN, RECT{ 0, 0, 200, 200 }).has_value());
+        }
+
+        TEST_METHOD (MatchesScanOnGrids)
+        {
+            for (const auto& [rows, columns] : { std::pair{ 1l, 3l }, std::pair{ 3l, 1l }, std::pair{ 2l, 2l }, std::pair{ 3l, 4l } })
+            {
+                const auto zones = MakeGridZones(rows, columns);
+                const ZoneAdjacencyGraph graph(zones);
+                for (const auto& zone : zones)
+                {
+                    for (DWORD vkCode : { VK_LEFT, VK_UP, VK_RIGHT, VK_DOWN })
+                    {
+                        const size_t expected = ScanNextZone(zones, zone.id, vkCode);
+                        const auto actual = graph.NextZone(zone.id, vkCode, { zone.id });
+                        Assert::AreEqual(expected, actual.value_or(zones.size()));
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD (NeighborsClosestFirst)
+        {
+            const ZoneAdjacencyGraph graph(MakeGridZones(1, 4));
+            const std::vector<size_t> expected{ 1, 2, 3 };
+            Assert::IsTrue(expected == graph.Neighbors(0, VK_RIGHT));
+            Assert::IsTrue(graph.Neighbors(0, VK_LEFT).empty());
+        }
+
+        TEST_METHOD (SkipsExcludedZones)
+        {
+            const ZoneAdjacencyGraph graph(MakeGridZones(1, 4));
+            Assert::AreEqual(size_t{ 3 }, graph.NextZone(0, VK_RIGHT, { 0, 1, 2 }).value());
+            Assert::IsFalse(graph.NextZone(0, VK_RIGHT, { 1, 2, 3 }).has_value());
+        }
+
+        TEST_METHOD (CycleWrapsAround)
+        {
+            const ZoneAdjacencyGraph graph(MakeGridZones(2, 3));
+            const RECT workArea{ 0, 0, 300, 200 };
+            Assert::AreEqual(size_t{ 0 }, graph.CycleZone(2, VK_RIGHT, workArea).value());
+            Assert::AreEqual(size_t{ 5 }, graph.CycleZone(3, VK_LEFT, workArea).value());
+            Assert::AreEqual(size_t{ 1 }, graph.CycleZone(4, VK_DOWN, workArea).value());
+
+            // Computed again for another work area size
+            Assert::AreEqual(size_t{ 0 }, graph.CycleZone(2, VK_RIGHT, RECT{ 0, 0, 600, 200 }).value());
+        }
+    };
+
+    TEST_CLASS (ZoneContainmentIndexUnitTests)
+    {
+        // What GetCombinedZoneRange computed by testing every zone
+        static std::vector<size_t> LinearZonesInside(const std::vector<ZoneContainmentIndex::Zone>& zones, RECT rect)
+        {
+            std::vector<size_t> result;
+            for (const auto& zone : zones)
+            {
+                if (rect.left <= zone.rect.left && zone.rect.right <= rect.right &&
+                    rect.top <= zone.rect.top && zone.rect.bottom <= rect.bottom)
+                {
+                    result.push_back(zone.id);
+                }
+            }
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+
+    public:
+        TEST_METHOD (EmptyLayout)
+        {
+            const ZoneContainmentIndex index({});
+            Assert::IsTrue(index.ZonesInside(RECT{ 0, 0, 100, 100 }).empty());
+            Assert::IsTrue(index.ZonesInsideBoundsOf({ 0, 1 }).empty());
+        }
+
+        TEST_METHOD (UnknownZones)
+        {
+            const ZoneContainmentIndex index({ { 0, RECT{ 0, 0, 100, 100 } }, { 1, RECT{ 100, 0, 200, 100 } } });
+            Assert::IsTrue(index.ZonesInsideBoundsOf({ 2, 7 }).empty());
+            const std::vector<size_t> expected{ 1 };
+            Assert::IsTrue(expected == index.ZonesInsideBoundsOf({ 1, 7 }));
+        }
+
+        TEST_METHOD (GridRange)
+        {
+            // 3 x 3 grid numbered row by row
+            std::vector<ZoneContainmentIndex::Zone> zones;
+            for (long row = 0; row < 3; row++)
+            {
+                for (long column = 0; column < 3; column++)
+                {
+                    zones.push_back({ zones.size(), RECT{ column * 100, row * 100, (column + 1) * 100, (row + 1) * 100 } });
+                }
+            }
+
+            const ZoneContainmentIndex index(zones);
+            const std::vector<size_t> expected{ 1, 2, 4, 5 };
+            Assert::IsTrue(expected == index.ZonesInsideBoundsOf({ 1, 5 }));
+            const std::vector<size_t> all{ 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+            Assert::IsTrue(all == index.ZonesInsideBoundsOf({ 2, 6 }));
+        }
+
+        TEST_METHOD (MatchesLinearScan)
+        {
+            std::mt19937 random(11);
+            std::uniform_int_distribution<long> cell(0, 7);
+            std::uniform_int_distribution<long> span(1, 3);
+            std::uniform_int_distribution<long> coordinate(-50, 1100);
+            for (size_t zoneCount : { 1u, 10u, 60u })
+            {
+                std::vector<ZoneContainmentIndex::Zone> zones;
+                for (size_t i = 0; i < zoneCount; i++)
+                {
+                    const long left = cell(random) * 100;
+                    const long top = cell(random) * 100;
+                    zones.push_back({ i * 2, RECT{ left, top, left + span(random) * 100, top + span(random) * 100 } });
+                }
+
+                const ZoneContainmentIndex index(zones);
+                for (size_t i = 0; i < 500; i++)
+                {
+                    // Every other rectangle is the bounds of two zones
+                    RECT rect{ coordinate(random), coordinate(random), coordinate(random), coordinate(random) };
+                    if (i % 2 == 0)
+                    {
+                        const RECT& first = zones[i % zones.size()].rect;
+                        const RECT& second = zones[(i / 2) % zones.size()].rect;
+                        rect = RECT{ min(first.left, second.left), min(first.top, second.top), max(first.right, second.right), max(first.bottom, second.bottom) };
+                    }
+
+                    Assert::IsTrue(LinearZonesInside(zones, rect) == index.ZonesInside(rect));
+                }
+            }
+        }
+
+        TEST_METHOD (CombinedZoneRangeAfterLayoutChange)
+        {
+            GUID id;
+            Assert::AreEqual(S_OK, CoCreateGuid(&id));
+            auto set = MakeZoneSet(ZoneSetConfig(id, ZoneSetLayoutType::Custom, Mocks::Monitor(), DefaultValues::SensitivityRadius));
+            set->AddZone(MakeZone(RECT{ 0, 0, 100, 100 }, 0));
+            set->AddZone(MakeZone(RECT{ 200, 0, 300, 100 }, 1));
+
+            Assert::IsTrue(std::vector<size_t>{ 0, 1 } == set->GetCombinedZoneRange({ 0 }, { 1 }));
+
+            // The range asked during the previous drag is computed again with the new zone
+            set->AddZone(MakeZone(RECT{ 100, 0, 200, 100 }, 2));
+            Assert::IsTrue(std::vector<size_t>{ 0, 1, 2 } == set->GetCombinedZoneRange({ 0 }, { 1 }));
+        }
+    };
 }
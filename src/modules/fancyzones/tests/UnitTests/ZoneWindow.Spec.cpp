@@ -288,6 +288,20 @@ namespace FancyZonesUnitTests
                 Assert::AreEqual(expected, actual);
             }
 
+            TEST_METHOD (MoveSizeUpdateWastedUpdates)
+            {
+                auto zoneWindow = MakeZoneWindow(winrt::make_self<MockZoneWindowHost>().get(), m_hInst, m_monitor, m_uniqueId.str(), {});
+                zoneWindow->MoveSizeEnter(Mocks::Window());
+                Assert::AreEqual(size_t{ 0 }, zoneWindow->WastedUpdateCount());
+
+                // No zone outside of the monitor, the highlighted zones stay empty
+                const POINT outside{ m_monitorInfo.rcMonitor.right + 1, m_monitorInfo.rcMonitor.bottom + 1 };
+                Assert::AreEqual(S_OK, zoneWindow->MoveSizeUpdate(outside, true, false));
+                Assert::AreEqual(S_OK, zoneWindow->MoveSizeUpdate(outside, true, false));
+                Assert::AreEqual(S_OK, zoneWindow->MoveSizeUpdate(outside, false, false));
+                Assert::AreEqual(size_t{ 3 }, zoneWindow->WastedUpdateCount());
+            }
+
             TEST_METHOD (MoveSizeEnd)
             {
                 auto zoneWindow = MakeZoneWindow(winrt::make_self<MockZoneWindowHost>().get(), m_hInst, m_monitor, m_uniqueId.str(), {});
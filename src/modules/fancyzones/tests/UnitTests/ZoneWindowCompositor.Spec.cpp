@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "lib\ZoneWindowCompositor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    TEST_CLASS (ZoneWindowCompositorUnitTests)
+    {
+        using Clock = ZoneWindowCompositor::Clock;
+
+        // Renders once for each Schedule call, when the deadline has passed
+        class MockSurface : public ZoneWindowCompositor::Surface
+        {
+        public:
+            std::optional<Clock::time_point> NextFrame() override
+            {
+                std::unique_lock lock(m_mutex);
+                return m_deadline;
+            }
+
+            void RenderFrame() override
+            {
+                std::unique_lock lock(m_mutex);
+                m_frames.push_back(Clock::now());
+                m_renderThread = std::this_thread::get_id();
+                m_deadline.reset();
+                m_cv.notify_all();
+            }
+
+            void Schedule(Clock::time_point deadline)
+            {
+                std::unique_lock lock(m_mutex);
+                m_deadline = deadline;
+            }
+
+            bool WaitForFrames(size_t count)
+            {
+                std::unique_lock lock(m_mutex);
+                return m_cv.wait_for(lock, std::chrono::seconds(5), [&]() { return m_frames.size() >= count; });
+            }
+
+            std::vector<Clock::time_point> Frames()
+            {
+                std::unique_lock lock(m_mutex);
+                return m_frames;
+            }
+
+            std::thread::id RenderThread()
+            {
+                std::unique_lock lock(m_mutex);
+                return m_renderThread;
+            }
+
+        private:
+            std::mutex m_mutex;
+            std::condition_variable m_cv;
+            std::optional<Clock::time_point> m_deadline;
+            std::vector<Clock::time_point> m_frames;
+            std::thread::id m_renderThread;
+        };
+
+    public:
+        TEST_METHOD (RunsWhileSurfacesAreRegistered)
+        {
+            ZoneWindowCompositor compositor;
+            MockSurface first, second;
+            Assert::IsFalse(compositor.IsRunning());
+
+            compositor.Register(&first);
+            compositor.Register(&second);
+            Assert::IsTrue(compositor.IsRunning());
+
+            compositor.Unregister(&first);
+            Assert::IsTrue(compositor.IsRunning());
+            compositor.Unregister(&second);
+            Assert::IsFalse(compositor.IsRunning());
+
+            // Started again for the next surface
+            compositor.Register(&first);
+            first.Schedule(Clock::now());
+            compositor.Wake();
+            Assert::IsTrue(first.WaitForFrames(1));
+            compositor.Unregister(&first);
+        }
+
+        TEST_METHOD (IdleSurfacesAreNotRendered)
+        {
+            ZoneWindowCompositor compositor;
+            MockSurface surface;
+            compositor.Register(&surface);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            Assert::IsTrue(surface.Frames().empty());
+
+            compositor.Unregister(&surface);
+        }
+
+        TEST_METHOD (SingleThreadForAllSurfaces)
+        {
+            ZoneWindowCompositor compositor;
+            std::vector<std::unique_ptr<MockSurface>> surfaces;
+            for (int i = 0; i < 12; i++)
+            {
+                surfaces.push_back(std::make_unique<MockSurface>());
+                compositor.Register(surfaces.back().get());
+            }
+
+            for (auto& surface : surfaces)
+            {
+                surface->Schedule(Clock::now());
+            }
+            compositor.Wake();
+
+            for (auto& surface : surfaces)
+            {
+                Assert::IsTrue(surface->WaitForFrames(1));
+                Assert::IsTrue(surfaces.front()->RenderThread() == surface->RenderThread());
+            }
+            Assert::IsTrue(surfaces.front()->RenderThread() != std::this_thread::get_id());
+
+            for (auto& surface : surfaces)
+            {
+                compositor.Unregister(surface.get());
+            }
+        }
+
+        TEST_METHOD (RendersAtDeadline)
+        {
+            ZoneWindowCompositor compositor;
+            MockSurface early, late;
+            compositor.Register(&early);
+            compositor.Register(&late);
+
+            const auto start = Clock::now();
+            late.Schedule(start + std::chrono::milliseconds(60));
+            early.Schedule(start + std::chrono::milliseconds(20));
+            compositor.Wake();
+
+            Assert::IsTrue(early.WaitForFrames(1));
+            Assert::IsTrue(late.WaitForFrames(1));
+            Assert::IsTrue(early.Frames().front() >= start + std::chrono::milliseconds(20));
+            Assert::IsTrue(late.Frames().front() >= start + std::chrono::milliseconds(60));
+
+            compositor.Unregister(&early);
+            compositor.Unregister(&late);
+        }
+
+        TEST_METHOD (UnregisterDuringFrames)
+        {
+            ZoneWindowCompositor compositor;
+            auto surface = std::make_unique<MockSurface>();
+            compositor.Register(surface.get());
+
+            for (int i = 0; i < 100; i++)
+            {
+                surface->Schedule(Clock::now());
+                compositor.Wake();
+            }
+
+            // The surface is not rendered any more once Unregister returns
+            compositor.Unregister(surface.get());
+            surface.reset();
+            Assert::IsFalse(compositor.IsRunning());
+        }
+    };
+}
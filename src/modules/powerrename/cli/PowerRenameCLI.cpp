@@ -0,0 +1,395 @@
+// PowerRenameCLI.cpp : Applies a PowerRename rule to a folder tree from the command line.
+//
+
+#include "pch.h"
+#include <PowerRenameInterfaces.h>
+#include <RenameEngine.h>
+#include <WorkerPool.h>
+#include <chrono>
+#include <cstdio>
+#include <cwchar>
+#include <fcntl.h>
+#include <fstream>
+#include <io.h>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+HINSTANCE g_hInst;
+
+namespace
+{
+    const wchar_t c_usage[] =
+        L"Usage: powerrename-cli [options] <folder> <search> <replace> [<search> <replace>...]\n"
+        L"       powerrename-cli --undo <journal>\n"
+        L"       powerrename-cli --generate <count> <folder>\n"
+        L"\n"
+        L"Applies the rule to every item below <folder> and prints the changes, then the\n"
+        L"throughput of each stage. Several search and replace pairs are applied in order in\n"
+        L"one pass, followed by the case, trim and enumeration steps of the dialog.\n"
+        L"\n"
+        L"Options:\n"
+        L"  --commit              Rename the items instead of only printing the changes\n"
+        L"  --journal <file>      Write the renames of --commit to <file>, for --undo\n"
+        L"  --quiet               Do not print the changes\n"
+        L"  --workers <count>     Number of threads, one per processor by default\n"
+        L"  --regex               Use regular expressions\n"
+        L"  --case-sensitive      Match the case of the search term\n"
+        L"  --first-only          Only replace the first match\n"
+        L"  --exclude-files       Do not rename files\n"
+        L"  --exclude-folders     Do not rename folders\n"
+        L"  --exclude-subfolders  Only rename the items directly in <folder>\n"
+        L"  --name-only           Only rename the part before the extension\n"
+        L"  --extension-only      Only rename the extension\n"
+        L"  --uppercase, --lowercase, --titlecase, --capitalize\n"
+        L"                        Change the case of the new names\n"
+        L"  --enumerate           Number the renamed items\n"
+        L"  --start <number>      First number of --enumerate, 1 by default\n"
+        L"  --padding <digits>    Pad the numbers of --enumerate with zeros to <digits>\n"
+        L"\n"
+        L"--undo renames the items of a journal back. --generate creates <count> empty\n"
+        L"files in subfolders of <folder>, as a tree to benchmark against.\n";
+
+    const struct
+    {
+        PCWSTR name;
+        DWORD flag;
+    } c_flagOptions[] = {
+        { L"--regex", UseRegularExpressions },
+        { L"--case-sensitive", CaseSensitive },
+        { L"--exclude-files", ExcludeFiles },
+        { L"--exclude-folders", ExcludeFolders },
+        { L"--exclude-subfolders", ExcludeSubfolders },
+        { L"--name-only", NameOnly },
+        { L"--extension-only", ExtensionOnly },
+        { L"--uppercase", Uppercase },
+        { L"--lowercase", Lowercase },
+        { L"--titlecase", Titlecase },
+        { L"--capitalize", Capitalized },
+        { L"--enumerate", EnumerateItems },
+    };
+
+    // Files per folder of a generated tree
+    const size_t c_generatedFolderSize = 1000;
+
+    enum class Command
+    {
+        Rename,
+        Undo,
+        Generate,
+    };
+
+    struct Options
+    {
+        Command command = Command::Rename;
+        RenameRule rule;
+        // Search and replace pairs after the first one
+        std::vector<std::pair<std::wstring, std::wstring>> moreTerms;
+        fs::path folder;
+        fs::path journal;
+        size_t count = 0;
+        unsigned int workerCount = CWorkerPool::DefaultWorkerCount();
+        bool commit = false;
+        bool quiet = false;
+    };
+
+    bool ParseCount(PCWSTR value, size_t& count, bool allowZero = false)
+    {
+        wchar_t* end = nullptr;
+        count = static_cast<size_t>(wcstoull(value, &end, 10));
+        return end != value && *end == L'\0' && (allowZero || count > 0);
+    }
+
+    bool ParseOptions(int argc, wchar_t* argv[], Options& options)
+    {
+        std::vector<PCWSTR> arguments;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::wstring_view argument(argv[i]);
+            const bool hasValue = i + 1 < argc;
+            bool isFlag = false;
+            for (const auto& flagOption : c_flagOptions)
+            {
+                if (argument == flagOption.name)
+                {
+                    options.rule.flags |= flagOption.flag;
+                    isFlag = true;
+                }
+            }
+
+            if (isFlag)
+            {
+                continue;
+            }
+
+            size_t count = 0;
+            if (argument == L"--first-only")
+            {
+                options.rule.flags &= ~static_cast<DWORD>(MatchAllOccurences);
+            }
+            else if (argument == L"--commit")
+            {
+                options.commit = true;
+            }
+            else if (argument == L"--quiet")
+            {
+                options.quiet = true;
+            }
+            else if (argument == L"--journal" && hasValue)
+            {
+                options.journal = argv[++i];
+            }
+            else if (argument == L"--workers" && hasValue && ParseCount(argv[i + 1], count))
+            {
+                options.workerCount = static_cast<unsigned int>(count);
+                i++;
+            }
+            else if (argument == L"--start" && hasValue && ParseCount(argv[i + 1], count, true))
+            {
+                options.rule.enumerateStart = static_cast<unsigned long>(count);
+                i++;
+            }
+            else if (argument == L"--padding" && hasValue && ParseCount(argv[i + 1], count, true))
+            {
+                options.rule.enumeratePadding = static_cast<unsigned int>(count);
+                i++;
+            }
+            else if (argument == L"--undo" && hasValue)
+            {
+                options.command = Command::Undo;
+                options.journal = argv[++i];
+            }
+            else if (argument == L"--generate" && hasValue && ParseCount(argv[i + 1], options.count))
+            {
+                options.command = Command::Generate;
+                i++;
+            }
+            else if (argument.starts_with(L"--"))
+            {
+                return false;
+            }
+            else
+            {
+                arguments.push_back(argv[i]);
+            }
+        }
+
+        switch (options.command)
+        {
+        case Command::Rename:
+            if (arguments.size() < 3 || arguments.size() % 2 != 1)
+            {
+                return false;
+            }
+            options.folder = arguments[0];
+            options.rule.searchTerm = arguments[1];
+            options.rule.replaceTerm = arguments[2];
+            for (size_t i = 3; i < arguments.size(); i += 2)
+            {
+                options.moreTerms.push_back({ arguments[i], arguments[i + 1] });
+            }
+            return true;
+        case Command::Generate:
+            if (arguments.size() != 1)
+            {
+                return false;
+            }
+            options.folder = arguments[0];
+            return true;
+        default:
+            return arguments.empty();
+        }
+    }
+
+    void PrintThroughput(PCWSTR stage, size_t count, std::chrono::steady_clock::duration elapsed)
+    {
+        const double seconds = std::chrono::duration<double>(elapsed).count();
+        fwprintf(stderr, L"%-8s %zu items in %.3f s (%.0f items/s)\n", stage, count, seconds, seconds > 0 ? count / seconds : 0.0);
+    }
+
+    // Steps for several search and replace pairs: the replaces in order, then the trim, the
+    // case change and the enumeration of the items the replaces renamed
+    std::vector<RenameStep> GetPipelineSteps(const Options& options)
+    {
+        const DWORD flags = options.rule.flags;
+        const RenameStepType replaceType = (flags & UseRegularExpressions) ? RenameStepType::RegexReplace : RenameStepType::LiteralReplace;
+
+        std::vector<RenameStep> steps;
+        steps.push_back({ replaceType, options.rule.searchTerm, options.rule.replaceTerm, flags & (CaseSensitive | MatchAllOccurences | NameOnly | ExtensionOnly) });
+        for (const auto& [searchTerm, replaceTerm] : options.moreTerms)
+        {
+            steps.push_back({ replaceType, searchTerm, replaceTerm, steps.front().flags });
+        }
+        steps.push_back({ RenameStepType::Trim });
+        steps.push_back({ RenameStepType::ChangeCase, {}, {}, flags & (Uppercase | Lowercase | Titlecase | Capitalized | NameOnly | ExtensionOnly) });
+        if (flags & EnumerateItems)
+        {
+            steps.push_back({ RenameStepType::Enumerate, {}, {}, 0, options.rule.enumerateStart, options.rule.enumeratePadding });
+        }
+        return steps;
+    }
+
+    int Rename(const Options& options)
+    {
+        CRenameEngine engine;
+        HRESULT hr = !options.moreTerms.empty() ? engine.InitPipeline(GetPipelineSteps(options), options.rule.flags) : engine.Init(options.rule);
+        if (FAILED(hr))
+        {
+            fwprintf(stderr, L"Invalid rule (0x%08lX)\n", hr);
+            return 1;
+        }
+
+        std::vector<RenameEngineItem> items;
+        auto start = std::chrono::steady_clock::now();
+        CFindFileMetadataProvider provider;
+        hr = CRenameEngine::s_ListTree(options.folder, provider, items);
+        if (FAILED(hr))
+        {
+            fwprintf(stderr, L"Cannot list %s (0x%08lX)\n", options.folder.c_str(), hr);
+            return 1;
+        }
+        else if (hr == S_FALSE)
+        {
+            fwprintf(stderr, L"Some folders could not be listed, their content is skipped\n");
+        }
+        PrintThroughput(L"Listed", items.size(), std::chrono::steady_clock::now() - start);
+
+        start = std::chrono::steady_clock::now();
+        hr = engine.Preview(items, options.workerCount);
+        if (FAILED(hr))
+        {
+            fwprintf(stderr, L"Preview failed (0x%08lX)\n", hr);
+            return 1;
+        }
+        PrintThroughput(L"Previewed", items.size(), std::chrono::steady_clock::now() - start);
+
+        size_t renameCount = 0;
+        for (const RenameEngineItem& item : items)
+        {
+            if (item.newName.empty())
+            {
+                continue;
+            }
+
+            renameCount++;
+            if (!options.quiet)
+            {
+                const fs::path relativePath = item.path.lexically_relative(options.folder);
+                wprintf(L"- %s\n+ %s\n", relativePath.c_str(), (relativePath.parent_path() / item.newName).c_str());
+            }
+        }
+
+        if (!options.commit)
+        {
+            fwprintf(stderr, L"%zu of %zu items would be renamed, run again with --commit to rename them\n", renameCount, items.size());
+            return 0;
+        }
+
+        CRenameJournal journal;
+        if (!options.journal.empty() && FAILED(journal.Open(options.journal)))
+        {
+            fwprintf(stderr, L"Cannot write the journal %s\n", options.journal.c_str());
+            return 1;
+        }
+
+        std::vector<HRESULT> results;
+        CWin32RenameFileSystem fileSystem;
+        start = std::chrono::steady_clock::now();
+        hr = engine.Commit(items, fileSystem, journal, options.workerCount, results);
+        PrintThroughput(L"Renamed", renameCount, std::chrono::steady_clock::now() - start);
+
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (FAILED(results[i]))
+            {
+                fwprintf(stderr, L"Not renamed (0x%08lX): %s\n", results[i], items[i].path.c_str());
+            }
+        }
+
+        return SUCCEEDED(hr) ? 0 : 2;
+    }
+
+    int Undo(const Options& options)
+    {
+        std::vector<RenameJournalEntry> entries;
+        if (FAILED(CRenameJournal::s_Read(options.journal, entries)))
+        {
+            fwprintf(stderr, L"Cannot read the journal %s\n", options.journal.c_str());
+            return 1;
+        }
+
+        CWin32RenameFileSystem fileSystem;
+        const auto start = std::chrono::steady_clock::now();
+        const HRESULT hr = CRenameJournal::s_Undo(entries, fileSystem);
+        PrintThroughput(L"Undone", entries.size(), std::chrono::steady_clock::now() - start);
+        return SUCCEEDED(hr) ? 0 : 2;
+    }
+
+    int Generate(const Options& options)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < options.count; i++)
+        {
+            wchar_t name[MAX_PATH] = { 0 };
+            StringCchPrintf(name, ARRAYSIZE(name), L"folder_%04zu", i / c_generatedFolderSize);
+            const fs::path folder = options.folder / name;
+            if (i % c_generatedFolderSize == 0)
+            {
+                std::error_code error;
+                fs::create_directories(folder, error);
+                if (error)
+                {
+                    fwprintf(stderr, L"Cannot create %s\n", folder.c_str());
+                    return 1;
+                }
+            }
+
+            StringCchPrintf(name, ARRAYSIZE(name), L"IMG_%07zu_Holiday Trip %zu.jpg", i, i % 37);
+            std::ofstream file(folder / name);
+            if (!file.is_open())
+            {
+                fwprintf(stderr, L"Cannot create %s\n", (folder / name).c_str());
+                return 1;
+            }
+        }
+
+        PrintThroughput(L"Created", options.count, std::chrono::steady_clock::now() - start);
+        return 0;
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    _setmode(_fileno(stdout), _O_U16TEXT);
+    _setmode(_fileno(stderr), _O_U16TEXT);
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        fwprintf(stderr, L"%s", c_usage);
+        return 1;
+    }
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
+    {
+        return 1;
+    }
+
+    int result = 0;
+    switch (options.command)
+    {
+    case Command::Rename:
+        result = Rename(options);
+        break;
+    case Command::Undo:
+        result = Undo(options);
+        break;
+    case Command::Generate:
+        result = Generate(options);
+        break;
+    }
+
+    CoUninitialize();
+    return result;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Hands items from a producer thread to a consumer thread. Push blocks while the queue is
+// full, so a producer that runs ahead of the consumer does not hold the whole output in memory.
+// The consumer waits with a timeout so it can keep its thread responsive between items, and
+// pops until Closed, which also tells it the producer is done with the queue.
+template<typename T>
+class CBoundedQueue
+{
+public:
+    enum class PopResult
+    {
+        Item,
+        Timeout,
+        // Completed by the producer and drained
+        Closed,
+    };
+
+    explicit CBoundedQueue(size_t capacity) :
+        m_capacity(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    // Returns false if the queue was canceled, the item is dropped in that case.
+    bool Push(T item)
+    {
+        std::unique_lock lock(m_lock);
+        m_notFull.wait(lock, [this]() { return m_canceled || m_items.size() < m_capacity; });
+        if (m_canceled)
+        {
+            return false;
+        }
+
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    PopResult Pop(T& item, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lock(m_lock);
+        if (!m_notEmpty.wait_for(lock, timeout, [this]() { return m_completed || !m_items.empty(); }))
+        {
+            return PopResult::Timeout;
+        }
+
+        if (m_items.empty())
+        {
+            return PopResult::Closed;
+        }
+
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return PopResult::Item;
+    }
+
+    // Called by the producer once it pushed its last item. Pending items can still be popped.
+    void Complete()
+    {
+        std::scoped_lock lock(m_lock);
+        m_completed = true;
+        m_notEmpty.notify_all();
+    }
+
+    // Called by the consumer to stop the producer. Pending and later items are dropped.
+    void Cancel()
+    {
+        std::scoped_lock lock(m_lock);
+        m_canceled = true;
+        m_items.clear();
+        m_notFull.notify_all();
+    }
+
+private:
+    const size_t m_capacity;
+
+    std::mutex m_lock;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+    std::deque<T> m_items;
+    bool m_completed = false;
+    bool m_canceled = false;
+};
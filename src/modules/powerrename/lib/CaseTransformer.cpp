@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "CaseTransformer.h"
+#include "PowerRenameInterfaces.h"
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define POWERRENAME_CASE_SSE2
+#endif
+
+namespace
+{
+    // Words that stay lower case in title case, unless first or last
+    const std::wstring_view c_titlecaseExceptions[] = { L"a", L"an", L"to", L"the", L"at", L"by", L"for", L"in", L"of", L"on", L"up", L"and", L"as", L"but", L"or", L"nor" };
+
+    struct NameParts
+    {
+        std::wstring_view stem;
+        std::wstring_view extension;
+    };
+
+    // Same split as fs::path stem() and extension(): only the last path component is kept,
+    // and ".", ".." and names starting with their only dot have no extension.
+    NameParts SplitName(std::wstring_view name)
+    {
+        const size_t separator = name.find_last_of(L"\\/");
+        const std::wstring_view fileName = separator == std::wstring_view::npos ? name : name.substr(separator + 1);
+        if (fileName == L"." || fileName == L"..")
+        {
+            return { fileName, {} };
+        }
+
+        const size_t dot = fileName.rfind(L'.');
+        if (dot == std::wstring_view::npos || dot == 0)
+        {
+            return { fileName, {} };
+        }
+
+        return { fileName.substr(0, dot), fileName.substr(dot) };
+    }
+
+    // Simple case mapping of ASCII letters is the same in every locale since towupper and
+    // towlower do not apply linguistic casing (ex: the Turkish dotted i).
+    template<bool upper>
+    inline wchar_t MapAscii(wchar_t c)
+    {
+        if constexpr (upper)
+        {
+            return (c >= L'a' && c <= L'z') ? static_cast<wchar_t>(c - (L'a' - L'A')) : c;
+        }
+        else
+        {
+            return (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c + (L'a' - L'A')) : c;
+        }
+    }
+
+    template<bool upper>
+    void MapCase(wchar_t* text, size_t length, const std::ctype<wchar_t>& ctype)
+    {
+        size_t i = 0;
+#ifdef POWERRENAME_CASE_SSE2
+        const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i first = _mm_set1_epi16(static_cast<short>(upper ? L'a' - 1 : L'A' - 1));
+        const __m128i last = _mm_set1_epi16(static_cast<short>(upper ? L'z' + 1 : L'Z' + 1));
+        const __m128i caseBit = _mm_set1_epi16(static_cast<short>(L'a' - L'A'));
+        for (; sizeof(wchar_t) == sizeof(short) && i + 8 <= length; i += 8)
+        {
+            __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chars, nonAscii), zero)) != 0xFFFF)
+            {
+                // Not only ASCII
+                for (size_t k = i; k < i + 8; k++)
+                {
+                    text[k] = text[k] < 0x80 ? MapAscii<upper>(text[k]) : (upper ? ctype.toupper(text[k]) : ctype.tolower(text[k]));
+                }
+                continue;
+            }
+
+            // Values are below 0x80 here, so signed compares work
+            const __m128i letters = _mm_and_si128(_mm_cmpgt_epi16(chars, first), _mm_cmplt_epi16(chars, last));
+            const __m128i delta = _mm_and_si128(letters, caseBit);
+            chars = upper ? _mm_sub_epi16(chars, delta) : _mm_add_epi16(chars, delta);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(text + i), chars);
+        }
+#endif
+        for (; i < length; i++)
+        {
+            text[i] = text[i] < 0x80 ? MapAscii<upper>(text[i]) : (upper ? ctype.toupper(text[i]) : ctype.tolower(text[i]));
+        }
+    }
+
+    std::locale GetUserLocale()
+    {
+        try
+        {
+            return std::locale("");
+        }
+        catch (const std::runtime_error&)
+        {
+            return std::locale::classic();
+        }
+    }
+}
+
+CCaseTransformer::CCaseTransformer(DWORD flags) :
+    m_nameOnly((flags & NameOnly) != 0),
+    m_extensionOnly((flags & ExtensionOnly) != 0)
+{
+    if (flags & Uppercase)
+    {
+        m_mode = Mode::Uppercase;
+    }
+    else if (flags & Lowercase)
+    {
+        m_mode = Mode::Lowercase;
+    }
+    else if (flags & Titlecase)
+    {
+        m_mode = Mode::Titlecase;
+        m_exceptions.insert(std::begin(c_titlecaseExceptions), std::end(c_titlecaseExceptions));
+    }
+    else if (flags & Capitalized)
+    {
+        m_mode = Mode::Capitalized;
+    }
+
+    if (m_mode != Mode::None)
+    {
+        m_locale = GetUserLocale();
+        m_ctype = &std::use_facet<std::ctype<wchar_t>>(m_locale);
+    }
+}
+
+HRESULT CCaseTransformer::Transform(_Out_ PWSTR result, UINT cchMax, _In_ PCWSTR source) const
+{
+    std::wstring transformed;
+    Transform(source, transformed);
+    return StringCchCopy(result, cchMax, transformed.c_str());
+}
+
+void CCaseTransformer::Transform(std::wstring_view source, std::wstring& result) const
+{
+    result.clear();
+    switch (m_mode)
+    {
+    case Mode::Uppercase:
+    case Mode::Lowercase:
+    {
+        const auto mapCase = [this](wchar_t* text, size_t length) {
+            if (m_mode == Mode::Uppercase)
+            {
+                _ToUpper(text, length);
+            }
+            else
+            {
+                _ToLower(text, length);
+            }
+        };
+
+        const NameParts parts = SplitName(source);
+        if (m_nameOnly)
+        {
+            result.append(parts.stem).append(parts.extension);
+            mapCase(result.data(), parts.stem.size());
+        }
+        else if (m_extensionOnly && !parts.extension.empty())
+        {
+            result.append(parts.stem).append(parts.extension);
+            mapCase(result.data() + parts.stem.size(), parts.extension.size());
+        }
+        else
+        {
+            result.assign(source);
+            mapCase(result.data(), result.size());
+        }
+        break;
+    }
+
+    case Mode::Titlecase:
+    case Mode::Capitalized:
+        if (!m_extensionOnly)
+        {
+            const NameParts parts = SplitName(source);
+            result.append(parts.stem).append(parts.extension);
+            _ToWords(result.data(), parts.stem.size());
+        }
+        else
+        {
+            result.assign(source);
+        }
+        break;
+
+    default:
+        result.assign(source);
+        break;
+    }
+}
+
+void CCaseTransformer::_ToUpper(wchar_t* text, size_t length) const
+{
+    MapCase<true>(text, length, *m_ctype);
+}
+
+void CCaseTransformer::_ToLower(wchar_t* text, size_t length) const
+{
+    MapCase<false>(text, length, *m_ctype);
+}
+
+void CCaseTransformer::_ToWords(wchar_t* stem, size_t stemLength) const
+{
+    // Trailing separators are left as they are
+    while (stemLength > 0 && _IsSeparator(stem[stemLength - 1]))
+    {
+        stemLength--;
+    }
+
+    bool isFirstWord = true;
+    for (size_t i = 0; i < stemLength; i++)
+    {
+        if (i > 0 && !_IsSeparator(stem[i - 1]))
+        {
+            stem[i] = m_ctype->tolower(stem[i]);
+            continue;
+        }
+
+        if (_IsSeparator(stem[i]))
+        {
+            continue;
+        }
+
+        size_t wordLength = 0;
+        while (i + wordLength < stemLength && !_IsSeparator(stem[i + wordLength]))
+        {
+            wordLength++;
+        }
+
+        // Title case keeps the exception words in lower case, unless they are the first or the last word
+        if (m_mode == Mode::Capitalized ||
+            isFirstWord ||
+            i + wordLength == stemLength ||
+            m_exceptions.find(std::wstring_view(stem + i, wordLength)) == m_exceptions.end())
+        {
+            stem[i] = m_ctype->toupper(stem[i]);
+            isFirstWord = false;
+        }
+        else
+        {
+            stem[i] = m_ctype->tolower(stem[i]);
+        }
+    }
+}
+
+bool CCaseTransformer::_IsSeparator(wchar_t c) const
+{
+    return m_ctype->is(std::ctype_base::space | std::ctype_base::punct, c);
+}
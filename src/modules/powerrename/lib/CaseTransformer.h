@@ -0,0 +1,45 @@
+#pragma once
+#include <locale>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+// Applies the Uppercase, Lowercase, Titlecase or Capitalized flag to new names. Created once
+// per preview pass: the user locale, its character classification facet and the title case
+// exception words are set up by the constructor instead of for every name. ASCII runs are
+// converted with SSE2 when available, other characters use the facet of the user locale.
+// Const members can be called from several threads.
+class CCaseTransformer
+{
+public:
+    explicit CCaseTransformer(DWORD flags);
+
+    // The flags ask for a case transformation
+    bool IsEnabled() const { return m_mode != Mode::None; }
+
+    // Same result as GetTransformedFileName
+    HRESULT Transform(_Out_ PWSTR result, UINT cchMax, _In_ PCWSTR source) const;
+    void Transform(std::wstring_view source, std::wstring& result) const;
+
+private:
+    enum class Mode
+    {
+        None,
+        Uppercase,
+        Lowercase,
+        Titlecase,
+        Capitalized,
+    };
+
+    void _ToUpper(wchar_t* text, size_t length) const;
+    void _ToLower(wchar_t* text, size_t length) const;
+    void _ToWords(wchar_t* text, size_t length) const;
+    bool _IsSeparator(wchar_t c) const;
+
+    Mode m_mode = Mode::None;
+    bool m_nameOnly = false;
+    bool m_extensionOnly = false;
+    std::locale m_locale;
+    const std::ctype<wchar_t>* m_ctype = nullptr;
+    std::unordered_set<std::wstring_view> m_exceptions;
+};
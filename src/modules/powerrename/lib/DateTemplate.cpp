@@ -0,0 +1,294 @@
+#include "pch.h"
+#include "DateTemplate.h"
+#include <algorithm>
+#include <locale>
+#include <stdexcept>
+
+namespace
+{
+    // Same output as printf with %0<minDigits>d
+    void AppendNumber(std::wstring& result, unsigned int value, size_t minDigits)
+    {
+        wchar_t digits[16];
+        size_t count = 0;
+        do
+        {
+            digits[count++] = static_cast<wchar_t>(L'0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+
+        for (; count < minDigits; count++)
+        {
+            digits[count] = L'0';
+        }
+
+        while (count > 0)
+        {
+            result += digits[--count];
+        }
+    }
+
+    bool IsLeapYear(unsigned int year)
+    {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+    // GetDateFormatEx fails on these, so the names are left empty like before
+    bool IsValidDate(const SYSTEMTIME& date)
+    {
+        static const WORD daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        if (date.wYear < 1601 || date.wYear > 30827 || date.wMonth < 1 || date.wMonth > 12 || date.wDay < 1)
+        {
+            return false;
+        }
+
+        const WORD lastDay = (date.wMonth == 2 && IsLeapYear(date.wYear)) ? 29 : daysInMonth[date.wMonth - 1];
+        return date.wDay <= lastDay;
+    }
+
+    // GetDateFormatEx also ignores wDayOfWeek and computes it from the date
+    size_t GetDayOfWeek(const SYSTEMTIME& date)
+    {
+        static const unsigned int monthOffsets[] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+        const unsigned int year = static_cast<unsigned int>(date.wYear) - (date.wMonth < 3 ? 1u : 0u);
+        return (year + year / 4 - year / 100 + year / 400 + monthOffsets[date.wMonth - 1] + date.wDay) % 7;
+    }
+
+    std::locale GetUserLocale()
+    {
+        try
+        {
+            return std::locale("");
+        }
+        catch (const std::runtime_error&)
+        {
+            return std::locale::classic();
+        }
+    }
+}
+
+CDateTemplate::CDateTemplate(std::wstring_view replaceTerm)
+{
+    // Longer names first, so $YYYY is not read as $YY followed by "YY"
+    static const struct
+    {
+        std::wstring_view name;
+        Field field;
+    } fieldNames[] = {
+        { L"YYYY", Field::Year4 },
+        { L"YY", Field::Year2 },
+        { L"Y", Field::Year1 },
+        { L"MMMM", Field::MonthName },
+        { L"MMM", Field::MonthAbbreviation },
+        { L"MM", Field::Month2 },
+        { L"M", Field::Month1 },
+        { L"DDDD", Field::DayName },
+        { L"DDD", Field::DayAbbreviation },
+        { L"DD", Field::Day2 },
+        { L"D", Field::Day1 },
+        { L"hh", Field::Hour2 },
+        { L"h", Field::Hour1 },
+        { L"mm", Field::Minute2 },
+        { L"m", Field::Minute1 },
+        { L"ss", Field::Second2 },
+        { L"s", Field::Second1 },
+        { L"fff", Field::Millisecond3 },
+        { L"ff", Field::Millisecond2 },
+        { L"f", Field::Millisecond1 },
+    };
+
+    bool usesNames = false;
+    std::wstring literal;
+    size_t i = 0;
+    while (i < replaceTerm.size())
+    {
+        if (replaceTerm[i] != L'$')
+        {
+            literal += replaceTerm[i++];
+            continue;
+        }
+
+        // "$$" is an escaped '$' and stays in the literal run for regex_replace.
+        // Only the last '$' of an odd run can start a field.
+        size_t runEnd = i;
+        while (runEnd < replaceTerm.size() && replaceTerm[runEnd] == L'$')
+        {
+            runEnd++;
+        }
+
+        const size_t runLength = runEnd - i;
+        literal.append(runLength & ~static_cast<size_t>(1), L'$');
+        i = runEnd;
+        if ((runLength & 1) == 0)
+        {
+            continue;
+        }
+
+        const std::wstring_view rest = replaceTerm.substr(runEnd);
+        auto fieldName = std::find_if(std::begin(fieldNames), std::end(fieldNames), [rest](const auto& candidate) {
+            return rest.substr(0, candidate.name.size()) == candidate.name;
+        });
+
+        if (fieldName == std::end(fieldNames))
+        {
+            literal += L'$';
+            continue;
+        }
+
+        if (!literal.empty())
+        {
+            m_tokens.push_back({ Field::Literal, std::move(literal) });
+            literal.clear();
+        }
+
+        m_tokens.push_back({ fieldName->field, {} });
+        m_usesFileTime = true;
+        usesNames = usesNames ||
+                    fieldName->field == Field::MonthName ||
+                    fieldName->field == Field::MonthAbbreviation ||
+                    fieldName->field == Field::DayName ||
+                    fieldName->field == Field::DayAbbreviation;
+        i += fieldName->name.size();
+    }
+
+    if (!literal.empty())
+    {
+        m_tokens.push_back({ Field::Literal, std::move(literal) });
+    }
+
+    if (usesNames)
+    {
+        _LoadNames();
+    }
+}
+
+void CDateTemplate::Format(const SYSTEMTIME& fileTime, std::wstring& result) const
+{
+    result.clear();
+    const bool validDate = IsValidDate(fileTime);
+    for (const Token& token : m_tokens)
+    {
+        switch (token.field)
+        {
+        case Field::Literal:
+            result += token.text;
+            break;
+        case Field::Year4:
+            AppendNumber(result, fileTime.wYear, 4);
+            break;
+        case Field::Year2:
+            AppendNumber(result, fileTime.wYear % 100, 2);
+            break;
+        case Field::Year1:
+            AppendNumber(result, fileTime.wYear % 10, 1);
+            break;
+        case Field::MonthName:
+            if (validDate)
+            {
+                result += m_monthNames[fileTime.wMonth - 1];
+            }
+            break;
+        case Field::MonthAbbreviation:
+            if (validDate)
+            {
+                result += m_monthAbbreviations[fileTime.wMonth - 1];
+            }
+            break;
+        case Field::Month2:
+            AppendNumber(result, fileTime.wMonth, 2);
+            break;
+        case Field::Month1:
+            AppendNumber(result, fileTime.wMonth, 1);
+            break;
+        case Field::DayName:
+            if (validDate)
+            {
+                result += m_dayNames[GetDayOfWeek(fileTime)];
+            }
+            break;
+        case Field::DayAbbreviation:
+            if (validDate)
+            {
+                result += m_dayAbbreviations[GetDayOfWeek(fileTime)];
+            }
+            break;
+        case Field::Day2:
+            AppendNumber(result, fileTime.wDay, 2);
+            break;
+        case Field::Day1:
+            AppendNumber(result, fileTime.wDay, 1);
+            break;
+        case Field::Hour2:
+            AppendNumber(result, fileTime.wHour, 2);
+            break;
+        case Field::Hour1:
+            AppendNumber(result, fileTime.wHour, 1);
+            break;
+        case Field::Minute2:
+            AppendNumber(result, fileTime.wMinute, 2);
+            break;
+        case Field::Minute1:
+            AppendNumber(result, fileTime.wMinute, 1);
+            break;
+        case Field::Second2:
+            AppendNumber(result, fileTime.wSecond, 2);
+            break;
+        case Field::Second1:
+            AppendNumber(result, fileTime.wSecond, 1);
+            break;
+        case Field::Millisecond3:
+            AppendNumber(result, fileTime.wMilliseconds, 3);
+            break;
+        case Field::Millisecond2:
+            AppendNumber(result, fileTime.wMilliseconds / 10, 2);
+            break;
+        case Field::Millisecond1:
+            AppendNumber(result, fileTime.wMilliseconds / 100, 1);
+            break;
+        }
+    }
+}
+
+void CDateTemplate::TransformLiterals(const std::function<std::wstring(const std::wstring&)>& transform)
+{
+    for (Token& token : m_tokens)
+    {
+        if (token.field == Field::Literal)
+        {
+            token.text = transform(token.text);
+        }
+    }
+}
+
+void CDateTemplate::_LoadNames()
+{
+    wchar_t localeName[LOCALE_NAME_MAX_LENGTH];
+    if (GetUserDefaultLocaleName(localeName, LOCALE_NAME_MAX_LENGTH) == 0)
+    {
+        StringCchCopy(localeName, LOCALE_NAME_MAX_LENGTH, L"en_US");
+    }
+
+    const std::locale userLocale = GetUserLocale();
+    const std::ctype<wchar_t>& ctype = std::use_facet<std::ctype<wchar_t>>(userLocale);
+    auto getName = [&](const SYSTEMTIME& date, PCWSTR format) {
+        wchar_t formattedDate[MAX_PATH] = { 0 };
+        GetDateFormatEx(localeName, 0, &date, format, formattedDate, MAX_PATH, nullptr);
+        formattedDate[0] = ctype.toupper(formattedDate[0]);
+        return std::wstring(formattedDate);
+    };
+
+    for (WORD month = 1; month <= 12; month++)
+    {
+        const SYSTEMTIME date = { 2000, month, 0, 1 };
+        m_monthNames[month - 1] = getName(date, L"MMMM");
+        m_monthAbbreviations[month - 1] = getName(date, L"MMM");
+    }
+
+    // January 2, 2000 is a Sunday
+    for (WORD day = 0; day < 7; day++)
+    {
+        const SYSTEMTIME date = { 2000, 1, day, static_cast<WORD>(2 + day) };
+        m_dayNames[day] = getName(date, L"dddd");
+        m_dayAbbreviations[day] = getName(date, L"ddd");
+    }
+}
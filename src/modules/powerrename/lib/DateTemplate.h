@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Replace term with its $YYYY, $MM, $hh and similar file time fields parsed out. The term is
+// compiled once into literal runs and typed fields, then Format fills the fields in from the
+// file time of each item. Month and day names of the user locale are looked up by the
+// constructor, so Format does not touch any shared state and can be called from several threads.
+class CDateTemplate
+{
+public:
+    CDateTemplate() = default;
+    explicit CDateTemplate(std::wstring_view replaceTerm);
+
+    // The replace term has at least one file time field
+    bool UsesFileTime() const { return m_usesFileTime; }
+
+    // Same result as GetDatedFileName
+    void Format(const SYSTEMTIME& fileTime, std::wstring& result) const;
+
+    // Rewrites the literal runs, ex: to prepare them for regex_replace. The fields are left as
+    // they are since their values never contain '$'.
+    void TransformLiterals(const std::function<std::wstring(const std::wstring&)>& transform);
+
+private:
+    enum class Field
+    {
+        Literal,
+        Year4,
+        Year2,
+        Year1,
+        MonthName,
+        MonthAbbreviation,
+        Month2,
+        Month1,
+        DayName,
+        DayAbbreviation,
+        Day2,
+        Day1,
+        Hour2,
+        Hour1,
+        Minute2,
+        Minute1,
+        Second2,
+        Second1,
+        Millisecond3,
+        Millisecond2,
+        Millisecond1,
+    };
+
+    struct Token
+    {
+        Field field = Field::Literal;
+        // Only used by literal runs
+        std::wstring text;
+    };
+
+    void _LoadNames();
+
+    std::vector<Token> m_tokens;
+    bool m_usesFileTime = false;
+
+    std::array<std::wstring, 12> m_monthNames;
+    std::array<std::wstring, 12> m_monthAbbreviations;
+    // Indexed by the day of week, Sunday first
+    std::array<std::wstring, 7> m_dayNames;
+    std::array<std::wstring, 7> m_dayAbbreviations;
+};
@@ -0,0 +1,110 @@
+#include "pch.h"
+#include "EnumerationTemplate.h"
+#include <algorithm>
+
+namespace
+{
+    // Same as PathFindExtension: the last dot after the last space or backslash, or the end
+    size_t FindExtension(std::wstring_view name)
+    {
+        size_t dot = name.size();
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            if (name[i] == L'.')
+            {
+                dot = i;
+            }
+            else if (name[i] == L'\\' || name[i] == L' ')
+            {
+                dot = name.size();
+            }
+        }
+        return dot;
+    }
+
+    bool IsDigit(wchar_t c)
+    {
+        return c >= L'0' && c <= L'9';
+    }
+}
+
+CEnumerationTemplate::CEnumerationTemplate(unsigned long start, unsigned int padding) :
+    m_start(start),
+    m_padding(padding)
+{
+}
+
+void CEnumerationTemplate::Reset(std::wstring_view name)
+{
+    // The counter replaces the digits of the first "(digits)" group of the name, like in
+    // "Photo (3).jpg"
+    size_t counter = name.size();
+    size_t rest = name.size();
+    for (size_t open = name.find(L'('); open != std::wstring_view::npos; open = name.find(L'(', open + 1))
+    {
+        size_t end = open + 1;
+        while (end < name.size() && IsDigit(name[end]))
+        {
+            end++;
+        }
+
+        if (end < name.size() && name[end] == L')')
+        {
+            counter = open + 1;
+            rest = end;
+            break;
+        }
+    }
+
+    m_suffix.clear();
+    std::wstring_view stem = name.substr(0, counter);
+    std::wstring_view opening;
+    if (counter == name.size())
+    {
+        const size_t extension = FindExtension(name);
+        stem = name.substr(0, extension);
+        opening = L" (";
+        m_suffix = L")";
+        rest = extension;
+    }
+    m_suffix.append(name.substr(rest));
+
+    m_stemLength = stem.size() + opening.size();
+    m_fits = m_stemLength < m_name.size();
+    if (m_fits)
+    {
+        std::copy(opening.begin(), opening.end(), std::copy(stem.begin(), stem.end(), m_name.begin()));
+    }
+}
+
+std::wstring_view CEnumerationTemplate::Format(unsigned long index)
+{
+    if (!m_fits)
+    {
+        return {};
+    }
+
+    unsigned long long value = static_cast<unsigned long long>(m_start) + index;
+    wchar_t digits[20];
+    size_t digitCount = 0;
+    do
+    {
+        digits[digitCount++] = static_cast<wchar_t>(L'0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    const size_t zeros = m_padding > digitCount ? m_padding - digitCount : 0;
+    const size_t length = m_stemLength + zeros + digitCount + m_suffix.size();
+    if (length >= m_name.size())
+    {
+        return {};
+    }
+
+    auto next = std::fill_n(m_name.begin() + m_stemLength, zeros, L'0');
+    while (digitCount > 0)
+    {
+        *next++ = digits[--digitCount];
+    }
+    *std::copy(m_suffix.begin(), m_suffix.end(), next) = L'\0';
+    return std::wstring_view(m_name.data(), length);
+}
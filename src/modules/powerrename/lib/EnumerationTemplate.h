@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <string>
+#include <string_view>
+
+// New name with the place of its enumeration counter parsed out: the digits of the first
+// "(digits)" group of the name, or a " (n)" inserted before the extension. The name is analyzed
+// once by Reset, then Format writes the counters into a buffer that is allocated with the
+// object, with no format string or printf per item. Gives the same names as
+// GetEnumeratedFileName without a folder, except that counters of a million and more are
+// written instead of leaving the name without a counter.
+class CEnumerationTemplate
+{
+public:
+    // The first item gets start, written with at least padding digits
+    explicit CEnumerationTemplate(unsigned long start = 1, unsigned int padding = 0);
+
+    void Reset(std::wstring_view name);
+
+    // Name of the item at index, 0 for the first one. Points into the buffer of the object, is
+    // null terminated and is valid until the next call. Empty if the name does not fit in
+    // MAX_PATH.
+    std::wstring_view Format(unsigned long index);
+
+private:
+    unsigned long m_start;
+    unsigned int m_padding;
+
+    // The name up to the counter is kept at the start of m_name, the rest of the name in
+    // m_suffix. Only the part written by Reset and Format is ever read.
+    std::array<wchar_t, MAX_PATH> m_name;
+    size_t m_stemLength = 0;
+    std::wstring m_suffix;
+    bool m_fits = false;
+};
@@ -6,6 +6,8 @@ HRESULT GetTrimmedFileName(_Out_ PWSTR result, UINT cchMax, _In_ PCWSTR source);
 HRESULT GetTransformedFileName(_Out_ PWSTR result, UINT cchMax, _In_ PCWSTR source, DWORD flags);
 HRESULT GetDatedFileName(_Out_ PWSTR result, UINT cchMax, _In_ PCWSTR source, SYSTEMTIME fileTime);
 bool isFileTimeUsed(_In_ PCWSTR source);
+bool FileTimeToLocalSystemTime(_In_ const FILETIME& fileTime, _Out_ SYSTEMTIME* localTime);
+bool ContainsLiteral(_In_ PCWSTR source, _In_ PCWSTR searchTerm, bool caseSensitive);
 bool DataObjectContainsRenamableItem(_In_ IUnknown* dataSource);
 HRESULT GetShellItemArrayFromDataObject(_In_ IUnknown* dataSource, _COM_Outptr_ IShellItemArray** items);
 BOOL GetEnumeratedFileName(
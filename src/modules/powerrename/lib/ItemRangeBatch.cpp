@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "ItemRangeBatch.h"
+#include <algorithm>
+
+CItemRangeBatch::CItemRangeBatch(std::chrono::milliseconds interval, size_t maxPendingItems) :
+    m_interval(interval),
+    m_maxPendingItems(maxPendingItems),
+    m_lastTake(std::chrono::steady_clock::now())
+{
+}
+
+bool CItemRangeBatch::Add(unsigned int index)
+{
+    std::scoped_lock lock(m_lock);
+    m_pending.push_back(index);
+
+    if (!m_notified &&
+        (m_pending.size() >= m_maxPendingItems || std::chrono::steady_clock::now() - m_lastTake >= m_interval))
+    {
+        m_notified = true;
+        return true;
+    }
+
+    return false;
+}
+
+bool CItemRangeBatch::HasPending()
+{
+    std::scoped_lock lock(m_lock);
+    return !m_pending.empty();
+}
+
+std::vector<CItemRangeBatch::Range> CItemRangeBatch::Take()
+{
+    std::vector<unsigned int> pending;
+    {
+        std::scoped_lock lock(m_lock);
+        pending.swap(m_pending);
+        m_notified = false;
+        m_lastTake = std::chrono::steady_clock::now();
+    }
+
+    // Workers process the items in chunks, so the indices are mostly sorted already
+    std::sort(pending.begin(), pending.end());
+
+    std::vector<Range> ranges;
+    for (unsigned int index : pending)
+    {
+        if (!ranges.empty() && index <= ranges.back().last + 1)
+        {
+            ranges.back().last = std::max<unsigned int>(ranges.back().last, index);
+        }
+        else
+        {
+            ranges.push_back({ index, index });
+        }
+    }
+
+    return ranges;
+}
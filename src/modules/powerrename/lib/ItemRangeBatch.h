@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+// Collects the indices of the items updated by the preview workers and hands them to the
+// UI thread as sorted ranges. Workers are told to notify the UI thread at most once per
+// interval, or once enough items are pending, and never while a notification is already
+// waiting to be handled.
+class CItemRangeBatch
+{
+public:
+    // Inclusive range of item indices
+    struct Range
+    {
+        unsigned int first;
+        unsigned int last;
+    };
+
+    CItemRangeBatch(std::chrono::milliseconds interval, size_t maxPendingItems);
+
+    // Records an updated item. Returns true if the caller has to notify the UI thread.
+    bool Add(unsigned int index);
+
+    // Removes and returns the pending items, merged into ranges. Called by the UI thread
+    // when handling the notification.
+    std::vector<Range> Take();
+
+    // Returns true if updated items are waiting to be taken. Lets the UI thread flush the
+    // last items of a burst, which came too soon after the previous batch to notify.
+    bool HasPending();
+
+private:
+    const std::chrono::milliseconds m_interval;
+    const size_t m_maxPendingItems;
+
+    std::mutex m_lock;
+    std::vector<unsigned int> m_pending;
+    std::chrono::steady_clock::time_point m_lastTake;
+    bool m_notified = false;
+};
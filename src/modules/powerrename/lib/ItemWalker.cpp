@@ -0,0 +1,189 @@
+#include "pch.h"
+#include "ItemWalker.h"
+#include <ShlGuid.h>
+
+namespace
+{
+    // Number of shell items fetched from a folder enumerator at a time
+    const ULONG c_shellItemBatchSize = 64;
+
+    // We shouldn't get this deep since we only enum the contents of
+    // regular folders but adding just in case
+    const UINT c_maxDepth = MAX_PATH / 2;
+}
+
+CShellItemWalker::CShellItemWalker(_In_ IEnumShellItems* rootItems, _In_ IPowerRenameItemFactory* factory) :
+    m_factory(factory)
+{
+    if (rootItems)
+    {
+        m_levels.push_back({ rootItems, {}, 0, 0 });
+    }
+}
+
+HRESULT CShellItemWalker::Next(size_t maxCount, _Inout_ std::vector<CComPtr<IPowerRenameItem>>& items)
+{
+    size_t added = 0;
+    while (added < maxCount && !m_levels.empty())
+    {
+        Level& level = m_levels.back();
+        if (level.next == level.fetched.size())
+        {
+            _Fetch(level);
+            if (level.fetched.empty())
+            {
+                // Done with this folder, resume its parent
+                m_levels.pop_back();
+                continue;
+            }
+        }
+
+        CComPtr<IShellItem> spsi = level.fetched[level.next];
+        level.fetched[level.next] = nullptr;
+        level.next++;
+        const UINT depth = level.depth;
+
+        CComPtr<IPowerRenameItem> spNewItem;
+        // Failure may be valid if we come across a shell item that does
+        // not support a file system path.  In that case we simply ignore
+        // the item.
+        if (FAILED(m_factory->Create(spsi, &spNewItem)))
+        {
+            continue;
+        }
+
+        spNewItem->PutDepth(depth);
+        items.push_back(spNewItem);
+        added++;
+
+        bool isFolder = false;
+        if (SUCCEEDED(spNewItem->GetIsFolder(&isFolder)) && isFolder)
+        {
+            if (depth + 1 >= c_maxDepth)
+            {
+                return E_INVALIDARG;
+            }
+
+            // Bind to the IShellItem for the IEnumShellItems interface
+            CComPtr<IEnumShellItems> spesiNext;
+            HRESULT hr = spsi->BindToHandler(nullptr, BHID_EnumItems, IID_PPV_ARGS(&spesiNext));
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+
+            // The folder content comes next, the rest of the current folder waits for it
+            m_levels.push_back({ spesiNext, {}, 0, depth + 1 });
+        }
+    }
+
+    return m_levels.empty() ? S_FALSE : S_OK;
+}
+
+HRESULT CShellItemWalker::_Fetch(_Inout_ Level& level)
+{
+    level.fetched.clear();
+    level.next = 0;
+
+    IShellItem* fetched[c_shellItemBatchSize] = { 0 };
+    ULONG fetchedCount = 0;
+    // S_FALSE comes with the last, partial batch
+    HRESULT hr = level.enumItems->Next(c_shellItemBatchSize, fetched, &fetchedCount);
+    if (SUCCEEDED(hr))
+    {
+        level.fetched.resize(fetchedCount);
+        for (ULONG i = 0; i < fetchedCount; i++)
+        {
+            level.fetched[i].Attach(fetched[i]);
+        }
+    }
+
+    return hr;
+}
+
+CDirectoryItemWalker::CDirectoryItemWalker(std::vector<std::filesystem::path> roots, CreateItemCallback createItem) :
+    m_roots(std::move(roots)),
+    m_createItem(std::move(createItem))
+{
+}
+
+HRESULT CDirectoryItemWalker::Next(size_t maxCount, _Inout_ std::vector<CComPtr<IPowerRenameItem>>& items)
+{
+    const size_t previousCount = items.size();
+    while (items.size() - previousCount < maxCount)
+    {
+        HRESULT hr = S_OK;
+        if (m_folders.empty())
+        {
+            if (m_nextRoot == m_roots.size())
+            {
+                break;
+            }
+
+            hr = _AddItem(m_roots[m_nextRoot++], 0, items);
+        }
+        else
+        {
+            std::filesystem::directory_iterator& folder = m_folders.back();
+            if (folder == std::filesystem::directory_iterator())
+            {
+                m_folders.pop_back();
+                continue;
+            }
+
+            const std::filesystem::path path = folder->path();
+            std::error_code error;
+            folder.increment(error);
+            if (error)
+            {
+                // Stop listing this folder, like a shell enumerator that fails
+                folder = std::filesystem::directory_iterator();
+            }
+
+            hr = _AddItem(path, static_cast<UINT>(m_folders.size()), items);
+        }
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    return (m_folders.empty() && m_nextRoot == m_roots.size()) ? S_FALSE : S_OK;
+}
+
+HRESULT CDirectoryItemWalker::_AddItem(const std::filesystem::path& path, UINT depth, _Inout_ std::vector<CComPtr<IPowerRenameItem>>& items)
+{
+    // Links are not followed, so the walk can not loop
+    std::error_code error;
+    const bool isFolder = std::filesystem::is_directory(std::filesystem::symlink_status(path, error));
+
+    CComPtr<IPowerRenameItem> item;
+    // Entries the callback does not support are ignored, like shell items
+    // without a file system path
+    if (FAILED(m_createItem(path, isFolder, depth, &item)) || !item)
+    {
+        return S_FALSE;
+    }
+
+    item->PutDepth(depth);
+    items.push_back(item);
+
+    if (isFolder)
+    {
+        if (depth + 1 >= c_maxDepth)
+        {
+            return E_INVALIDARG;
+        }
+
+        std::filesystem::directory_iterator folder(path, error);
+        if (error)
+        {
+            return HRESULT_FROM_WIN32(static_cast<unsigned long>(error.value()));
+        }
+
+        m_folders.push_back(std::move(folder));
+    }
+
+    return S_OK;
+}
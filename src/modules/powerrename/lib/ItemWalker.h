@@ -0,0 +1,65 @@
+#pragma once
+#include "pch.h"
+#include "PowerRenameInterfaces.h"
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+// Filesystem walk stage of the enumeration. Items come depth first: a folder is directly
+// followed by its content, which is the order the visibility index and the UI expect.
+// Every item has its depth set.
+class CItemWalker
+{
+public:
+    virtual ~CItemWalker() = default;
+
+    // Appends up to maxCount items to items. Returns S_FALSE once the walk is complete.
+    virtual HRESULT Next(size_t maxCount, _Inout_ std::vector<CComPtr<IPowerRenameItem>>& items) = 0;
+};
+
+// Walks shell items, fetching the content of each folder in batches
+class CShellItemWalker :
+    public CItemWalker
+{
+public:
+    CShellItemWalker(_In_ IEnumShellItems* rootItems, _In_ IPowerRenameItemFactory* factory);
+
+    HRESULT Next(size_t maxCount, _Inout_ std::vector<CComPtr<IPowerRenameItem>>& items) override;
+
+private:
+    struct Level
+    {
+        CComPtr<IEnumShellItems> enumItems;
+        // Items fetched from enumItems that were not walked yet
+        std::vector<CComPtr<IShellItem>> fetched;
+        size_t next = 0;
+        UINT depth = 0;
+    };
+
+    HRESULT _Fetch(_Inout_ Level& level);
+
+    CComPtr<IPowerRenameItemFactory> m_factory;
+    std::vector<Level> m_levels;
+};
+
+// Walks directories with std::filesystem, so the enumeration can be driven without the shell
+// (ex: in tests). createItem makes the rename item of an entry.
+class CDirectoryItemWalker :
+    public CItemWalker
+{
+public:
+    using CreateItemCallback = std::function<HRESULT(const std::filesystem::path& path, bool isFolder, UINT depth, IPowerRenameItem** item)>;
+
+    CDirectoryItemWalker(std::vector<std::filesystem::path> roots, CreateItemCallback createItem);
+
+    HRESULT Next(size_t maxCount, _Inout_ std::vector<CComPtr<IPowerRenameItem>>& items) override;
+
+private:
+    HRESULT _AddItem(const std::filesystem::path& path, UINT depth, _Inout_ std::vector<CComPtr<IPowerRenameItem>>& items);
+
+    std::vector<std::filesystem::path> m_roots;
+    size_t m_nextRoot = 0;
+    CreateItemCallback m_createItem;
+    // Open folders, innermost last. The depth of their content is their index + 1.
+    std::vector<std::filesystem::directory_iterator> m_folders;
+};
@@ -0,0 +1,1217 @@
+#include "pch.h"
+#include "LinearRegex.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace
+{
+    // Bounds that keep the program small enough to simulate. Patterns past them are left to the
+    // backtracking engine, which also reports the ones that are not valid.
+    const size_t c_maxProgramSize = 10000;
+    const unsigned int c_maxRepeat = 1000;
+    const unsigned int c_maxNesting = 100;
+    const unsigned int c_unbounded = static_cast<unsigned int>(-1);
+
+    enum ClassEscape : uint8_t
+    {
+        ClassDigit = 0x01,
+        ClassNotDigit = 0x02,
+        ClassWord = 0x04,
+        ClassNotWord = 0x08,
+        ClassSpace = 0x10,
+        ClassNotSpace = 0x20,
+    };
+
+    struct Node
+    {
+        enum class Type
+        {
+            Empty,
+            Char,
+            Any,
+            Class,
+            Concat,
+            Alternate,
+            Repeat,
+            Group,
+            LineStart,
+            LineEnd,
+            WordBoundary,
+            NotWordBoundary,
+        };
+
+        Type type = Type::Empty;
+        wchar_t ch = 0;
+        // Char class index, or group number for Group (0 when the group does not capture)
+        size_t index = 0;
+        unsigned int min = 0;
+        unsigned int max = 0;
+        bool greedy = true;
+        std::vector<size_t> children;
+    };
+
+    inline wchar_t FoldChar(wchar_t c)
+    {
+        return static_cast<wchar_t>(towlower(c));
+    }
+
+    inline bool IsDigit(wchar_t c)
+    {
+        return c >= L'0' && c <= L'9';
+    }
+
+    inline bool IsAsciiAlnum(wchar_t c)
+    {
+        return IsDigit(c) || (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z');
+    }
+
+    // Same character classes as the ones std::regex_traits uses for \w, \d and \s
+    inline bool IsWordChar(wchar_t c)
+    {
+        return c == L'_' || iswalnum(c);
+    }
+
+    inline bool IsLineTerminator(wchar_t c)
+    {
+        return c == L'\n' || c == L'\r' || c == 0x2028 || c == 0x2029;
+    }
+
+    inline bool IsQuantifierStart(wchar_t c)
+    {
+        return c == L'*' || c == L'+' || c == L'?' || c == L'{';
+    }
+
+    uint8_t GetClassEscape(wchar_t c)
+    {
+        switch (c)
+        {
+        case L'd':
+            return ClassDigit;
+        case L'D':
+            return ClassNotDigit;
+        case L'w':
+            return ClassWord;
+        case L'W':
+            return ClassNotWord;
+        case L's':
+            return ClassSpace;
+        case L'S':
+            return ClassNotSpace;
+        default:
+            return 0;
+        }
+    }
+
+    int HexValue(wchar_t c)
+    {
+        if (IsDigit(c))
+        {
+            return c - L'0';
+        }
+        if (c >= L'a' && c <= L'f')
+        {
+            return c - L'a' + 10;
+        }
+        if (c >= L'A' && c <= L'F')
+        {
+            return c - L'A' + 10;
+        }
+        return -1;
+    }
+}
+
+// Parses the pattern into a tree of nodes and emits the program from it. Every construct
+// the engine does not handle, or that the engines do not agree on, makes the parse fail.
+class CLinearRegex::CParser
+{
+public:
+    CParser(std::wstring_view pattern, std::vector<CharClass>& classes) :
+        m_pattern(pattern), m_classes(classes)
+    {
+    }
+
+    bool Parse(size_t& root)
+    {
+        return _ParseDisjunction(root, 0) && _AtEnd();
+    }
+
+    size_t GetGroupCount() const { return m_groupCount; }
+
+    bool Emit(size_t node, bool caseSensitive, std::vector<Inst>& program)
+    {
+        // Nested repetitions of empty nodes emit nothing, so the calls are bounded as well
+        if (program.size() > c_maxProgramSize || ++m_emitCount > 4 * c_maxProgramSize)
+        {
+            return false;
+        }
+
+        const Node& n = m_nodes[node];
+        switch (n.type)
+        {
+        case Node::Type::Empty:
+            return true;
+        case Node::Type::Char:
+            program.push_back({ Op::Char, caseSensitive ? n.ch : FoldChar(n.ch), 0, 0 });
+            return true;
+        case Node::Type::Any:
+            program.push_back({ Op::Any, 0, 0, 0 });
+            return true;
+        case Node::Type::Class:
+            program.push_back({ Op::Class, 0, static_cast<uint32_t>(n.index), 0 });
+            return true;
+        case Node::Type::LineStart:
+            program.push_back({ Op::LineStart, 0, 0, 0 });
+            return true;
+        case Node::Type::LineEnd:
+            program.push_back({ Op::LineEnd, 0, 0, 0 });
+            return true;
+        case Node::Type::WordBoundary:
+            program.push_back({ Op::WordBoundary, 0, 0, 0 });
+            return true;
+        case Node::Type::NotWordBoundary:
+            program.push_back({ Op::NotWordBoundary, 0, 0, 0 });
+            return true;
+        case Node::Type::Concat:
+            for (size_t child : n.children)
+            {
+                if (!Emit(child, caseSensitive, program))
+                {
+                    return false;
+                }
+            }
+            return true;
+        case Node::Type::Group:
+            if (n.index == 0)
+            {
+                return Emit(n.children[0], caseSensitive, program);
+            }
+            program.push_back({ Op::Save, 0, static_cast<uint32_t>(2 * n.index), 0 });
+            if (!Emit(n.children[0], caseSensitive, program))
+            {
+                return false;
+            }
+            program.push_back({ Op::Save, 0, static_cast<uint32_t>(2 * n.index + 1), 0 });
+            return true;
+        case Node::Type::Alternate:
+            return _EmitAlternate(n, caseSensitive, program);
+        case Node::Type::Repeat:
+            return _EmitRepeat(n, caseSensitive, program);
+        }
+        return false;
+    }
+
+private:
+    bool _AtEnd() const { return m_pos >= m_pattern.size(); }
+    wchar_t _Peek() const { return m_pattern[m_pos]; }
+
+    size_t _AddNode(Node::Type type)
+    {
+        m_nodes.emplace_back();
+        m_nodes.back().type = type;
+        return m_nodes.size() - 1;
+    }
+
+    size_t _AddClassNode(CharClass&& charClass)
+    {
+        const size_t node = _AddNode(Node::Type::Class);
+        m_nodes[node].index = m_classes.size();
+        m_classes.push_back(std::move(charClass));
+        return node;
+    }
+
+    bool _ParseDisjunction(size_t& node, unsigned int depth)
+    {
+        if (depth > c_maxNesting)
+        {
+            return false;
+        }
+
+        std::vector<size_t> alternatives(1);
+        if (!_ParseAlternative(alternatives[0], depth))
+        {
+            return false;
+        }
+
+        while (!_AtEnd() && _Peek() == L'|')
+        {
+            m_pos++;
+            size_t alternative = 0;
+            if (!_ParseAlternative(alternative, depth))
+            {
+                return false;
+            }
+            alternatives.push_back(alternative);
+        }
+
+        if (alternatives.size() == 1)
+        {
+            node = alternatives[0];
+            return true;
+        }
+
+        node = _AddNode(Node::Type::Alternate);
+        m_nodes[node].children = std::move(alternatives);
+        return true;
+    }
+
+    bool _ParseAlternative(size_t& node, unsigned int depth)
+    {
+        std::vector<size_t> terms;
+        while (!_AtEnd() && _Peek() != L'|' && _Peek() != L')')
+        {
+            size_t term = 0;
+            if (!_ParseTerm(term, depth))
+            {
+                return false;
+            }
+            terms.push_back(term);
+        }
+
+        if (terms.size() == 1)
+        {
+            node = terms[0];
+            return true;
+        }
+
+        node = _AddNode(terms.empty() ? Node::Type::Empty : Node::Type::Concat);
+        m_nodes[node].children = std::move(terms);
+        return true;
+    }
+
+    bool _ParseTerm(size_t& node, unsigned int depth)
+    {
+        const wchar_t c = _Peek();
+
+        Node::Type assertion = Node::Type::Empty;
+        if (c == L'^')
+        {
+            assertion = Node::Type::LineStart;
+        }
+        else if (c == L'$')
+        {
+            assertion = Node::Type::LineEnd;
+        }
+        else if (c == L'\\' && m_pos + 1 < m_pattern.size() && (m_pattern[m_pos + 1] == L'b' || m_pattern[m_pos + 1] == L'B'))
+        {
+            assertion = (m_pattern[m_pos + 1] == L'b') ? Node::Type::WordBoundary : Node::Type::NotWordBoundary;
+        }
+
+        if (assertion != Node::Type::Empty)
+        {
+            m_pos += (c == L'\\') ? 2 : 1;
+            node = _AddNode(assertion);
+            // Assertions can not be repeated
+            return _AtEnd() || !IsQuantifierStart(_Peek());
+        }
+
+        switch (c)
+        {
+        case L'(':
+        {
+            m_pos++;
+            size_t group = 0;
+            if (!_AtEnd() && _Peek() == L'?')
+            {
+                // Non capturing group. Lookahead and lookbehind are not supported.
+                if (m_pos + 1 >= m_pattern.size() || m_pattern[m_pos + 1] != L':')
+                {
+                    return false;
+                }
+                m_pos += 2;
+            }
+            else
+            {
+                group = ++m_groupCount;
+            }
+
+            size_t child = 0;
+            if (!_ParseDisjunction(child, depth + 1) || _AtEnd() || _Peek() != L')')
+            {
+                return false;
+            }
+            m_pos++;
+
+            node = _AddNode(Node::Type::Group);
+            m_nodes[node].index = group;
+            m_nodes[node].children.push_back(child);
+            break;
+        }
+        case L'[':
+            if (!_ParseClass(node))
+            {
+                return false;
+            }
+            break;
+        case L'.':
+            m_pos++;
+            node = _AddNode(Node::Type::Any);
+            break;
+        case L'\\':
+            if (!_ParseAtomEscape(node))
+            {
+                return false;
+            }
+            break;
+        case L'*':
+        case L'+':
+        case L'?':
+        case L'{':
+        case L'}':
+        case L']':
+            // Nothing to repeat, or a bracket the engines do not agree on
+            return false;
+        default:
+            m_pos++;
+            node = _AddNode(Node::Type::Char);
+            m_nodes[node].ch = c;
+            break;
+        }
+
+        return _ParseQuantifier(node);
+    }
+
+    bool _ParseQuantifier(size_t& node)
+    {
+        if (_AtEnd())
+        {
+            return true;
+        }
+
+        unsigned int min = 0;
+        unsigned int max = c_unbounded;
+        switch (_Peek())
+        {
+        case L'*':
+            m_pos++;
+            break;
+        case L'+':
+            m_pos++;
+            min = 1;
+            break;
+        case L'?':
+            m_pos++;
+            max = 1;
+            break;
+        case L'{':
+            m_pos++;
+            if (!_ParseNumber(min))
+            {
+                return false;
+            }
+            max = min;
+            if (!_AtEnd() && _Peek() == L',')
+            {
+                m_pos++;
+                max = c_unbounded;
+                if (!_AtEnd() && IsDigit(_Peek()) && !_ParseNumber(max))
+                {
+                    return false;
+                }
+            }
+            if (_AtEnd() || _Peek() != L'}' || max < min)
+            {
+                return false;
+            }
+            m_pos++;
+            break;
+        default:
+            return true;
+        }
+
+        bool greedy = true;
+        if (!_AtEnd() && _Peek() == L'?')
+        {
+            m_pos++;
+            greedy = false;
+        }
+
+        // A quantifier can not be repeated either
+        if (min > c_maxRepeat || (max != c_unbounded && max > c_maxRepeat) || (!_AtEnd() && IsQuantifierStart(_Peek())))
+        {
+            return false;
+        }
+
+        // ECMAScript rejects the optional iterations that match the empty string, which depends
+        // on the path that led to the loop. The simulation merges those paths, so these loops
+        // are left to the backtracking engine.
+        if (max > min && _IsNullable(node))
+        {
+            return false;
+        }
+
+        const size_t repeat = _AddNode(Node::Type::Repeat);
+        m_nodes[repeat].min = min;
+        m_nodes[repeat].max = max;
+        m_nodes[repeat].greedy = greedy;
+        m_nodes[repeat].children.push_back(node);
+        node = repeat;
+        return true;
+    }
+
+    // True if the node can match the empty string
+    bool _IsNullable(size_t node) const
+    {
+        const Node& n = m_nodes[node];
+        switch (n.type)
+        {
+        case Node::Type::Char:
+        case Node::Type::Any:
+        case Node::Type::Class:
+            return false;
+        case Node::Type::Concat:
+            return std::all_of(n.children.begin(), n.children.end(), [this](size_t child) { return _IsNullable(child); });
+        case Node::Type::Alternate:
+            return std::any_of(n.children.begin(), n.children.end(), [this](size_t child) { return _IsNullable(child); });
+        case Node::Type::Group:
+            return _IsNullable(n.children[0]);
+        case Node::Type::Repeat:
+            return n.min == 0 || _IsNullable(n.children[0]);
+        default:
+            return true;
+        }
+    }
+
+    bool _ParseNumber(unsigned int& value)
+    {
+        if (_AtEnd() || !IsDigit(_Peek()))
+        {
+            return false;
+        }
+
+        value = 0;
+        while (!_AtEnd() && IsDigit(_Peek()))
+        {
+            value = value * 10 + static_cast<unsigned int>(_Peek() - L'0');
+            if (value > c_maxRepeat * 10)
+            {
+                return false;
+            }
+            m_pos++;
+        }
+        return true;
+    }
+
+    bool _ParseAtomEscape(size_t& node)
+    {
+        m_pos++;
+        if (_AtEnd())
+        {
+            return false;
+        }
+
+        const wchar_t c = m_pattern[m_pos++];
+        const uint8_t escape = GetClassEscape(c);
+        if (escape)
+        {
+            CharClass charClass;
+            charClass.escapes = escape;
+            node = _AddClassNode(std::move(charClass));
+            return true;
+        }
+
+        wchar_t ch = 0;
+        if (!_ParseCharEscape(c, ch))
+        {
+            return false;
+        }
+
+        node = _AddNode(Node::Type::Char);
+        m_nodes[node].ch = ch;
+        return true;
+    }
+
+    // Escapes that stand for one character, c is the character after the backslash
+    bool _ParseCharEscape(wchar_t c, wchar_t& ch)
+    {
+        switch (c)
+        {
+        case L'f':
+            ch = L'\f';
+            return true;
+        case L'n':
+            ch = L'\n';
+            return true;
+        case L'r':
+            ch = L'\r';
+            return true;
+        case L't':
+            ch = L'\t';
+            return true;
+        case L'v':
+            ch = L'\v';
+            return true;
+        case L'0':
+            // \0 followed by a digit is an octal escape or a backreference
+            ch = L'\0';
+            return _AtEnd() || !IsDigit(_Peek());
+        case L'c':
+            if (_AtEnd() || !IsAsciiAlnum(_Peek()) || IsDigit(_Peek()))
+            {
+                return false;
+            }
+            ch = static_cast<wchar_t>(m_pattern[m_pos++] % 32);
+            return true;
+        case L'x':
+            return _ParseHex(2, ch);
+        case L'u':
+            return _ParseHex(4, ch);
+        default:
+            // Identity escape of a punctuation character. Other letters and digits are
+            // backreferences, named groups or property classes.
+            if (IsAsciiAlnum(c))
+            {
+                return false;
+            }
+            ch = c;
+            return true;
+        }
+    }
+
+    bool _ParseHex(size_t digits, wchar_t& ch)
+    {
+        unsigned int value = 0;
+        for (size_t i = 0; i < digits; i++)
+        {
+            const int digit = _AtEnd() ? -1 : HexValue(_Peek());
+            if (digit < 0)
+            {
+                return false;
+            }
+            value = value * 16 + static_cast<unsigned int>(digit);
+            m_pos++;
+        }
+        ch = static_cast<wchar_t>(value);
+        return true;
+    }
+
+    bool _ParseClass(size_t& node)
+    {
+        m_pos++;
+        CharClass charClass;
+        if (!_AtEnd() && _Peek() == L'^')
+        {
+            m_pos++;
+            charClass.negated = true;
+        }
+
+        // [] and [^] mean different things to the engines
+        if (!_AtEnd() && _Peek() == L']')
+        {
+            return false;
+        }
+
+        for (;;)
+        {
+            if (_AtEnd())
+            {
+                return false;
+            }
+            if (_Peek() == L']')
+            {
+                m_pos++;
+                break;
+            }
+
+            wchar_t first = 0;
+            uint8_t firstEscape = 0;
+            if (!_ParseClassAtom(first, firstEscape))
+            {
+                return false;
+            }
+
+            if (m_pos + 1 < m_pattern.size() && _Peek() == L'-' && m_pattern[m_pos + 1] != L']')
+            {
+                m_pos++;
+                wchar_t last = 0;
+                uint8_t lastEscape = 0;
+                if (!_ParseClassAtom(last, lastEscape) || firstEscape || lastEscape || last < first)
+                {
+                    return false;
+                }
+                charClass.ranges.emplace_back(first, last);
+            }
+            else if (firstEscape)
+            {
+                charClass.escapes |= firstEscape;
+            }
+            else
+            {
+                charClass.ranges.emplace_back(first, first);
+            }
+        }
+
+        node = _AddClassNode(std::move(charClass));
+        return true;
+    }
+
+    bool _ParseClassAtom(wchar_t& ch, uint8_t& escape)
+    {
+        escape = 0;
+        const wchar_t c = m_pattern[m_pos++];
+        if (c == L'[')
+        {
+            // [:alpha:], [=a=] and [.a.] are std::regex extensions
+            if (!_AtEnd() && (_Peek() == L':' || _Peek() == L'=' || _Peek() == L'.'))
+            {
+                return false;
+            }
+            ch = c;
+            return true;
+        }
+
+        if (c != L'\\')
+        {
+            ch = c;
+            return true;
+        }
+
+        if (_AtEnd())
+        {
+            return false;
+        }
+
+        const wchar_t e = m_pattern[m_pos++];
+        escape = GetClassEscape(e);
+        if (escape)
+        {
+            return true;
+        }
+
+        if (e == L'b')
+        {
+            // Backspace inside a class
+            ch = L'\b';
+            return true;
+        }
+
+        return _ParseCharEscape(e, ch);
+    }
+
+    bool _EmitAlternate(const Node& n, bool caseSensitive, std::vector<Inst>& program)
+    {
+        // split L1, L2; L1: first; jmp end; L2: split ...; last; end:
+        std::vector<size_t> jumps;
+        for (size_t i = 0; i + 1 < n.children.size(); i++)
+        {
+            const size_t split = program.size();
+            program.push_back({ Op::Split, 0, static_cast<uint32_t>(split + 1), 0 });
+            if (!Emit(n.children[i], caseSensitive, program))
+            {
+                return false;
+            }
+            jumps.push_back(program.size());
+            program.push_back({ Op::Jmp, 0, 0, 0 });
+            program[split].y = static_cast<uint32_t>(program.size());
+        }
+
+        if (!Emit(n.children.back(), caseSensitive, program))
+        {
+            return false;
+        }
+
+        for (size_t jump : jumps)
+        {
+            program[jump].x = static_cast<uint32_t>(program.size());
+        }
+        return true;
+    }
+
+    bool _EmitRepeat(const Node& n, bool caseSensitive, std::vector<Inst>& program)
+    {
+        const size_t child = n.children[0];
+        for (unsigned int i = 0; i < n.min; i++)
+        {
+            if (!Emit(child, caseSensitive, program))
+            {
+                return false;
+            }
+        }
+
+        if (n.max == c_unbounded)
+        {
+            // L1: split L2, L3; L2: child; jmp L1; L3:
+            const size_t split = program.size();
+            program.push_back({ Op::Split, 0, 0, 0 });
+            if (!Emit(child, caseSensitive, program))
+            {
+                return false;
+            }
+            program.push_back({ Op::Jmp, 0, static_cast<uint32_t>(split), 0 });
+            _SetSplitTargets(program[split], split + 1, program.size(), n.greedy);
+            return true;
+        }
+
+        // The optional copies are nested like (child(child)?)? so skipping one skips the rest
+        std::vector<size_t> splits;
+        for (unsigned int i = n.min; i < n.max; i++)
+        {
+            splits.push_back(program.size());
+            program.push_back({ Op::Split, 0, 0, 0 });
+            if (!Emit(child, caseSensitive, program))
+            {
+                return false;
+            }
+        }
+
+        for (size_t split : splits)
+        {
+            _SetSplitTargets(program[split], split + 1, program.size(), n.greedy);
+        }
+        return true;
+    }
+
+    static void _SetSplitTargets(Inst& split, size_t body, size_t exit, bool greedy)
+    {
+        split.x = static_cast<uint32_t>(greedy ? body : exit);
+        split.y = static_cast<uint32_t>(greedy ? exit : body);
+    }
+
+    std::wstring_view m_pattern;
+    std::vector<CharClass>& m_classes;
+    std::vector<Node> m_nodes;
+    size_t m_pos = 0;
+    size_t m_groupCount = 0;
+    size_t m_emitCount = 0;
+};
+
+// Threads of one step of the simulation in priority order, at most one per instruction.
+class CLinearRegex::CThreadList
+{
+public:
+    void Init(size_t programSize, size_t slotCount)
+    {
+        m_sparse.assign(programSize, 0);
+        m_dense.assign(programSize, 0);
+        m_slotCount = slotCount;
+        m_count = 0;
+    }
+
+    void Clear() { m_count = 0; }
+    size_t GetCount() const { return m_count; }
+    uint32_t GetPc(size_t index) const { return m_dense[index]; }
+    size_t* GetCaptures(size_t index) { return m_captures.data() + index * m_slotCount; }
+
+    bool Contains(uint32_t pc) const
+    {
+        const size_t index = m_sparse[pc];
+        return index < m_count && m_dense[index] == pc;
+    }
+
+    size_t Add(uint32_t pc)
+    {
+        m_sparse[pc] = static_cast<uint32_t>(m_count);
+        m_dense[m_count] = pc;
+        if (m_captures.size() < (m_count + 1) * m_slotCount)
+        {
+            m_captures.resize((m_count + 1) * m_slotCount);
+        }
+        return m_count++;
+    }
+
+private:
+    // Sparse set of the instructions that already have a thread
+    std::vector<uint32_t> m_sparse;
+    std::vector<uint32_t> m_dense;
+    std::vector<size_t> m_captures;
+    size_t m_slotCount = 0;
+    size_t m_count = 0;
+};
+
+struct CLinearRegex::CScratch
+{
+    CScratch(size_t programSize, size_t slotCount) :
+        captures(slotCount, npos)
+    {
+        current.Init(programSize, slotCount);
+        next.Init(programSize, slotCount);
+    }
+
+    struct Job
+    {
+        uint32_t pc;
+        uint32_t slot;
+        size_t value;
+        bool restore;
+    };
+
+    CThreadList current;
+    CThreadList next;
+    // Captures of the thread being added, Save jobs restore them when the other branch is taken
+    std::vector<size_t> captures;
+    std::vector<Job> jobs;
+};
+
+bool CLinearRegex::Compile(std::wstring_view pattern, bool caseSensitive)
+{
+    Reset();
+
+    CParser parser(pattern, m_classes);
+    size_t root = 0;
+    std::vector<Inst> program;
+    program.push_back({ Op::Save, 0, 0, 0 });
+    if (!parser.Parse(root) || !parser.Emit(root, caseSensitive, program) || program.size() > c_maxProgramSize)
+    {
+        Reset();
+        return false;
+    }
+    program.push_back({ Op::Save, 0, 1, 0 });
+    program.push_back({ Op::Match, 0, 0, 0 });
+
+    m_program = std::move(program);
+    m_groupCount = parser.GetGroupCount();
+    m_caseSensitive = caseSensitive;
+    _FindFirstInsts();
+    return true;
+}
+
+void CLinearRegex::Reset()
+{
+    m_program.clear();
+    m_classes.clear();
+    m_firstInsts.clear();
+    m_groupCount = 0;
+    m_caseSensitive = true;
+}
+
+bool CLinearRegex::Search(std::wstring_view text, size_t start, std::vector<size_t>& captures) const
+{
+    if (!IsValid() || start > text.size())
+    {
+        return false;
+    }
+
+    CScratch scratch(m_program.size(), 2 * (m_groupCount + 1));
+    return _Search(text, start, 0, false, scratch, captures);
+}
+
+size_t CLinearRegex::Replace(std::wstring_view text, std::wstring_view format, bool replaceAll, std::wstring& result) const
+{
+    if (!IsValid())
+    {
+        result.append(text);
+        return 0;
+    }
+
+    CScratch scratch(m_program.size(), 2 * (m_groupCount + 1));
+    std::vector<size_t> captures;
+    size_t count = 0;
+    size_t pos = 0;
+    size_t lineStart = 0;
+    bool notNull = false;
+    bool previousAvailable = false;
+    while (_Search(text, pos, lineStart, notNull, scratch, captures))
+    {
+        result.append(text.substr(pos, captures[0] - pos));
+        _AppendFormat(text, captures, pos, format, result);
+        count++;
+
+        // Same enumeration as std::regex_replace: stop once a match reaches the end and
+        // after an empty match look for the next non empty one
+        pos = captures[1];
+        if (!replaceAll || pos == text.size())
+        {
+            break;
+        }
+        notNull = (captures[0] == captures[1]);
+
+        // Until a non empty match is found std::regex_replace searches the rest of the name
+        // as if it was the whole name, so ^ and \b see it as the start of a line
+        if (!notNull)
+        {
+            previousAvailable = true;
+        }
+        lineStart = previousAvailable ? 0 : pos;
+    }
+
+    result.append(text.substr(pos));
+    return count;
+}
+
+void CLinearRegex::_FindFirstInsts()
+{
+    // Follow the instructions that do not consume a character from the start of the program.
+    // Assertions are assumed to pass, they only make the candidates more precise.
+    std::vector<bool> visited(m_program.size());
+    std::vector<uint32_t> pending{ 0 };
+    while (!pending.empty())
+    {
+        const uint32_t pc = pending.back();
+        pending.pop_back();
+        if (visited[pc])
+        {
+            continue;
+        }
+        visited[pc] = true;
+
+        const Inst& inst = m_program[pc];
+        switch (inst.op)
+        {
+        case Op::Char:
+        case Op::Any:
+        case Op::Class:
+            m_firstInsts.push_back(pc);
+            break;
+        case Op::Match:
+            m_firstInsts.clear();
+            return;
+        case Op::Jmp:
+            pending.push_back(inst.x);
+            break;
+        case Op::Split:
+            pending.push_back(inst.y);
+            pending.push_back(inst.x);
+            break;
+        default:
+            pending.push_back(pc + 1);
+            break;
+        }
+    }
+}
+
+size_t CLinearRegex::_FindCandidate(std::wstring_view text, size_t pos) const
+{
+    if (m_firstInsts.empty())
+    {
+        return pos;
+    }
+
+    for (; pos < text.size(); pos++)
+    {
+        for (uint32_t pc : m_firstInsts)
+        {
+            if (_MatchesChar(m_program[pc], text[pos]))
+            {
+                return pos;
+            }
+        }
+    }
+
+    // The pattern can not match the empty string at the end
+    return npos;
+}
+
+bool CLinearRegex::_Search(std::wstring_view text, size_t start, size_t lineStart, bool notNull, CScratch& scratch, std::vector<size_t>& captures) const
+{
+    const size_t slotCount = 2 * (m_groupCount + 1);
+    CThreadList* current = &scratch.current;
+    CThreadList* next = &scratch.next;
+    current->Clear();
+
+    bool matched = false;
+    for (size_t pos = start;; pos++)
+    {
+        if (!matched)
+        {
+            if (current->GetCount() == 0)
+            {
+                // No match in progress, skip to the next character that can start one
+                pos = _FindCandidate(text, pos);
+                if (pos == npos)
+                {
+                    break;
+                }
+            }
+
+            // A match starting here has a lower priority than the ones already started
+            std::fill(scratch.captures.begin(), scratch.captures.end(), npos);
+            _AddThread(*current, 0, pos, lineStart, text, scratch);
+        }
+
+        if (current->GetCount() == 0 && matched)
+        {
+            break;
+        }
+
+        next->Clear();
+        for (size_t i = 0; i < current->GetCount(); i++)
+        {
+            const uint32_t pc = current->GetPc(i);
+            const Inst& inst = m_program[pc];
+            const size_t* threadCaptures = current->GetCaptures(i);
+            if (inst.op == Op::Match)
+            {
+                // Empty matches are rejected right after an empty match at the same position
+                if (notNull && threadCaptures[0] == pos)
+                {
+                    continue;
+                }
+
+                // The threads after this one have a lower priority
+                captures.assign(threadCaptures, threadCaptures + slotCount);
+                matched = true;
+                break;
+            }
+
+            if (pos < text.size() && _MatchesChar(inst, text[pos]))
+            {
+                std::copy(threadCaptures, threadCaptures + slotCount, scratch.captures.begin());
+                _AddThread(*next, pc + 1, pos + 1, lineStart, text, scratch);
+            }
+        }
+
+        std::swap(current, next);
+        if (pos >= text.size())
+        {
+            break;
+        }
+    }
+
+    return matched;
+}
+
+void CLinearRegex::_AddThread(CThreadList& list, uint32_t pc, size_t pos, size_t lineStart, std::wstring_view text, CScratch& scratch) const
+{
+    // Follows the instructions that do not consume a character, in priority order
+    auto& jobs = scratch.jobs;
+    jobs.push_back({ pc, 0, 0, false });
+    while (!jobs.empty())
+    {
+        const CScratch::Job job = jobs.back();
+        jobs.pop_back();
+        if (job.restore)
+        {
+            scratch.captures[job.slot] = job.value;
+            continue;
+        }
+
+        uint32_t current = job.pc;
+        while (!list.Contains(current))
+        {
+            const size_t index = list.Add(current);
+            const Inst& inst = m_program[current];
+            bool follow = false;
+            if (inst.op == Op::Jmp)
+            {
+                current = inst.x;
+                continue;
+            }
+            else if (inst.op == Op::Split)
+            {
+                jobs.push_back({ inst.y, 0, 0, false });
+                current = inst.x;
+                continue;
+            }
+            else if (inst.op == Op::Save)
+            {
+                jobs.push_back({ 0, inst.x, scratch.captures[inst.x], true });
+                scratch.captures[inst.x] = pos;
+                follow = true;
+            }
+            else if (inst.op == Op::LineStart)
+            {
+                follow = (pos == lineStart);
+            }
+            else if (inst.op == Op::LineEnd)
+            {
+                follow = (pos == text.size());
+            }
+            else if (inst.op == Op::WordBoundary || inst.op == Op::NotWordBoundary)
+            {
+                const bool wordBefore = pos > lineStart && IsWordChar(text[pos - 1]);
+                const bool wordAfter = pos < text.size() && IsWordChar(text[pos]);
+                follow = (wordBefore != wordAfter) == (inst.op == Op::WordBoundary);
+            }
+            else
+            {
+                // Consuming instructions and Match wait for the next step
+                std::copy(scratch.captures.begin(), scratch.captures.end(), list.GetCaptures(index));
+            }
+
+            if (!follow)
+            {
+                break;
+            }
+            current++;
+        }
+    }
+}
+
+bool CLinearRegex::_MatchesChar(const Inst& inst, wchar_t c) const
+{
+    switch (inst.op)
+    {
+    case Op::Char:
+        return (m_caseSensitive ? c : FoldChar(c)) == inst.ch;
+    case Op::Any:
+        return !IsLineTerminator(c);
+    case Op::Class:
+        return _MatchesClass(m_classes[inst.x], c);
+    default:
+        return false;
+    }
+}
+
+bool CLinearRegex::_MatchesClass(const CharClass& charClass, wchar_t c) const
+{
+    auto contains = [&charClass](wchar_t value) {
+        for (const auto& range : charClass.ranges)
+        {
+            if (value >= range.first && value <= range.second)
+            {
+                return true;
+            }
+        }
+
+        const uint8_t escapes = charClass.escapes;
+        return ((escapes & ClassDigit) && iswdigit(value)) ||
+               ((escapes & ClassNotDigit) && !iswdigit(value)) ||
+               ((escapes & ClassWord) && IsWordChar(value)) ||
+               ((escapes & ClassNotWord) && !IsWordChar(value)) ||
+               ((escapes & ClassSpace) && iswspace(value)) ||
+               ((escapes & ClassNotSpace) && !iswspace(value));
+    };
+
+    bool found = contains(c);
+    if (!found && !m_caseSensitive)
+    {
+        found = contains(static_cast<wchar_t>(towlower(c))) || contains(static_cast<wchar_t>(towupper(c)));
+    }
+    return found != charClass.negated;
+}
+
+void CLinearRegex::_AppendFormat(std::wstring_view text, const std::vector<size_t>& captures, size_t prefixStart, std::wstring_view format, std::wstring& result) const
+{
+    for (size_t i = 0; i < format.size(); i++)
+    {
+        const wchar_t c = format[i];
+        if (c != L'$' || i + 1 == format.size())
+        {
+            result.push_back(c);
+            continue;
+        }
+
+        const wchar_t next = format[i + 1];
+        if (next == L'$')
+        {
+            result.push_back(L'$');
+        }
+        else if (next == L'&')
+        {
+            result.append(text.substr(captures[0], captures[1] - captures[0]));
+        }
+        else if (next == L'`')
+        {
+            result.append(text.substr(prefixStart, captures[0] - prefixStart));
+        }
+        else if (next == L'\'')
+        {
+            result.append(text.substr(captures[1]));
+        }
+        else if (next >= L'1' && next <= L'9' && static_cast<size_t>(next - L'0') <= m_groupCount)
+        {
+            // $N is always a single digit, $12 is group 1 followed by 2
+            const size_t group = static_cast<size_t>(next - L'0');
+            if (captures[2 * group] != npos)
+            {
+                result.append(text.substr(captures[2 * group], captures[2 * group + 1] - captures[2 * group]));
+            }
+        }
+        else
+        {
+            // Not a replacement, $0 is kept as is
+            result.push_back(L'$');
+            continue;
+        }
+        i++;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Regular expression engine for the ECMAScript subset typed in the search box. The pattern is
+// compiled to a Thompson NFA which is simulated with a Pike VM: every instruction runs at most
+// once per character, so matching is linear in the length of the name whatever the pattern is.
+// Threads are kept in priority order, which gives the same matches and captures as the
+// backtracking std::wregex engine. Backreferences and lookaround can not be matched this way,
+// Compile rejects them and the caller falls back to std::wregex.
+class CLinearRegex
+{
+public:
+    static constexpr size_t npos = std::wstring_view::npos;
+
+    // Returns false if the pattern is not valid or uses a construct this engine does not support.
+    bool Compile(std::wstring_view pattern, bool caseSensitive);
+    void Reset();
+
+    bool IsValid() const { return !m_program.empty(); }
+
+    // Number of capturing groups, not counting the whole match
+    size_t GetGroupCount() const { return m_groupCount; }
+
+    // Finds the leftmost match at or after start. captures receives the begin and end of the
+    // match followed by the ones of every group, npos for the groups that did not participate.
+    bool Search(std::wstring_view text, size_t start, std::vector<size_t>& captures) const;
+
+    // Appends text to result with the first match, or every match when replaceAll is set,
+    // replaced by format. Matches are enumerated like std::regex_replace and format uses the
+    // replace term syntax of the std engine: $$, $&, $`, $' and $1 to $9.
+    // Returns the number of replaced matches.
+    size_t Replace(std::wstring_view text, std::wstring_view format, bool replaceAll, std::wstring& result) const;
+
+private:
+    enum class Op : uint8_t
+    {
+        Char,
+        Any,
+        Class,
+        Split,
+        Jmp,
+        Save,
+        LineStart,
+        LineEnd,
+        WordBoundary,
+        NotWordBoundary,
+        Match,
+    };
+
+    struct Inst
+    {
+        Op op;
+        wchar_t ch;
+        // Char class index, jump target, preferred split target or capture slot
+        uint32_t x;
+        // Other split target
+        uint32_t y;
+    };
+
+    struct CharClass
+    {
+        std::vector<std::pair<wchar_t, wchar_t>> ranges;
+        // Combination of the \d \D \w \W \s \S escapes used in the class
+        uint8_t escapes = 0;
+        bool negated = false;
+    };
+
+    class CParser;
+    class CThreadList;
+    struct CScratch;
+
+    void _FindFirstInsts();
+    size_t _FindCandidate(std::wstring_view text, size_t pos) const;
+    // lineStart is where ^ matches and \b sees no previous character, notNull rejects empty matches
+    bool _Search(std::wstring_view text, size_t start, size_t lineStart, bool notNull, CScratch& scratch, std::vector<size_t>& captures) const;
+    void _AddThread(CThreadList& list, uint32_t pc, size_t pos, size_t lineStart, std::wstring_view text, CScratch& scratch) const;
+    bool _MatchesChar(const Inst& inst, wchar_t c) const;
+    bool _MatchesClass(const CharClass& charClass, wchar_t c) const;
+    void _AppendFormat(std::wstring_view text, const std::vector<size_t>& captures, size_t prefixStart, std::wstring_view format, std::wstring& result) const;
+
+    std::vector<Inst> m_program;
+    std::vector<CharClass> m_classes;
+    // Instructions that can consume the first character of a match. Empty when the pattern
+    // can match the empty string, in which case every position has to be tried.
+    std::vector<uint32_t> m_firstInsts;
+    size_t m_groupCount = 0;
+    bool m_caseSensitive = true;
+};
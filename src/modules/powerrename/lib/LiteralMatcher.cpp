@@ -0,0 +1,162 @@
+#include "pch.h"
+#include "LiteralMatcher.h"
+#include <cwctype>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define POWERRENAME_LITERAL_SSE2
+#endif
+
+namespace
+{
+    inline wchar_t FoldChar(wchar_t c)
+    {
+        if (c < 0x80)
+        {
+            return (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c + (L'a' - L'A')) : c;
+        }
+        return static_cast<wchar_t>(towlower(c));
+    }
+
+#ifdef POWERRENAME_LITERAL_SSE2
+    inline unsigned int LowestSetBit(unsigned int mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
+#endif
+}
+
+CLiteralMatcher::CLiteralMatcher(std::wstring_view pattern, bool caseSensitive)
+{
+    Reset(pattern, caseSensitive);
+}
+
+void CLiteralMatcher::Reset(std::wstring_view pattern, bool caseSensitive)
+{
+    m_caseSensitive = caseSensitive;
+    m_pattern.assign(pattern);
+    if (!m_caseSensitive)
+    {
+        for (auto& c : m_pattern)
+        {
+            c = FoldChar(c);
+        }
+    }
+}
+
+size_t CLiteralMatcher::Find(std::wstring_view text, size_t start) const
+{
+    if (m_pattern.empty() || start > text.size() || text.size() - start < m_pattern.size())
+    {
+        return npos;
+    }
+
+    if (m_caseSensitive)
+    {
+        return text.find(m_pattern, start);
+    }
+
+    return _FindFolded(text, start);
+}
+
+size_t CLiteralMatcher::Replace(std::wstring_view text, std::wstring_view replacement, bool replaceAll, std::wstring& result) const
+{
+    size_t count = 0;
+    size_t pos = 0;
+    for (size_t match = Find(text, pos); match != npos; match = Find(text, pos))
+    {
+        result.append(text.substr(pos, match - pos));
+        result.append(replacement);
+        pos = match + m_pattern.size();
+        count++;
+
+        if (!replaceAll)
+        {
+            break;
+        }
+    }
+
+    result.append(text.substr(pos));
+    return count;
+}
+
+size_t CLiteralMatcher::_FindFolded(std::wstring_view text, size_t start) const
+{
+    const wchar_t first = m_pattern[0];
+    const size_t last = text.size() - m_pattern.size();
+    size_t i = start;
+
+#ifdef POWERRENAME_LITERAL_SSE2
+    if (sizeof(wchar_t) == sizeof(short) && first < 0x80)
+    {
+        const __m128i needle = _mm_set1_epi16(static_cast<short>(first));
+        const __m128i beforeUpperA = _mm_set1_epi16(L'A' - 1);
+        const __m128i afterUpperZ = _mm_set1_epi16(L'Z' + 1);
+        const __m128i caseBit = _mm_set1_epi16(L'a' - L'A');
+        const __m128i nonAsciiBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+
+        // Blocks of 8 characters that may hold the first character of a match
+        for (; i + 8 <= last + 1; i += 8)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(block, nonAsciiBits), zero)) != 0xFFFF)
+            {
+                // Some non ASCII characters fold to ASCII ones (ex: KELVIN SIGN), check this block one by one
+                for (size_t j = i; j < i + 8; j++)
+                {
+                    if (FoldChar(text[j]) == first && _MatchesFoldedAt(text, j))
+                    {
+                        return j;
+                    }
+                }
+                continue;
+            }
+
+            const __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi16(block, beforeUpperA), _mm_cmpgt_epi16(afterUpperZ, block));
+            const __m128i folded = _mm_add_epi16(block, _mm_and_si128(isUpper, caseBit));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi16(folded, needle)));
+            while (mask != 0)
+            {
+                const unsigned int bit = LowestSetBit(mask);
+                const size_t j = i + bit / 2;
+                if (_MatchesFoldedAt(text, j))
+                {
+                    return j;
+                }
+
+                // Two mask bits per character
+                mask &= ~(3u << bit);
+            }
+        }
+    }
+#endif
+
+    for (; i <= last; i++)
+    {
+        if (FoldChar(text[i]) == first && _MatchesFoldedAt(text, i))
+        {
+            return i;
+        }
+    }
+
+    return npos;
+}
+
+bool CLiteralMatcher::_MatchesFoldedAt(std::wstring_view text, size_t pos) const
+{
+    for (size_t k = 1; k < m_pattern.size(); k++)
+    {
+        if (FoldChar(text[pos + k]) != m_pattern[k])
+        {
+            return false;
+        }
+    }
+    return true;
+}
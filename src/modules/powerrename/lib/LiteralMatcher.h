@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Finds a literal (non regex) search term in file names. The term is case folded once when
+// it is set and the text is folded while it is scanned, so searching does not copy or
+// allocate. Case insensitive matching folds with towlower like the previous literal search,
+// and scans ASCII text with SSE2 when available.
+class CLiteralMatcher
+{
+public:
+    static constexpr size_t npos = std::wstring_view::npos;
+
+    CLiteralMatcher() = default;
+    CLiteralMatcher(std::wstring_view pattern, bool caseSensitive);
+
+    void Reset(std::wstring_view pattern, bool caseSensitive);
+
+    bool IsEmpty() const { return m_pattern.empty(); }
+
+    // Position of the first match at or after start, or npos. An empty pattern never matches.
+    size_t Find(std::wstring_view text, size_t start = 0) const;
+
+    bool Contains(std::wstring_view text) const { return Find(text) != npos; }
+
+    // Appends text to result with the first match, or every non overlapping match when
+    // replaceAll is set, replaced by replacement. Returns the number of replaced matches.
+    size_t Replace(std::wstring_view text, std::wstring_view replacement, bool replaceAll, std::wstring& result) const;
+
+private:
+    size_t _FindFolded(std::wstring_view text, size_t start) const;
+    bool _MatchesFoldedAt(std::wstring_view text, size_t pos) const;
+
+    // Folded to lower case unless m_caseSensitive
+    std::wstring m_pattern;
+    bool m_caseSensitive = true;
+};
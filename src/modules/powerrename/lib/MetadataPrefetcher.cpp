@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "MetadataPrefetcher.h"
+#include "Helpers.h"
+
+namespace
+{
+    // Selected items of a folder are only worth a listing of the whole folder when there
+    // are enough of them. The content of walked folders is always listed.
+    const size_t c_minItemsPerListing = 16;
+
+    // File names are compared without case, like the file system does
+    std::wstring GetKey(std::wstring_view value)
+    {
+        std::wstring key(value);
+        if (!key.empty())
+        {
+            CharUpperBuffW(key.data(), static_cast<DWORD>(key.size()));
+        }
+        return key;
+    }
+
+    struct PendingItem
+    {
+        IPowerRenameItem* item = nullptr;
+        std::wstring folderKey;
+        std::wstring folderPath;
+        std::wstring nameKey;
+        bool walked = false;
+    };
+}
+
+HRESULT CFindFileMetadataProvider::ListFolder(_In_ PCWSTR folder, const EntryCallback& addEntry)
+{
+    std::wstring pattern(folder);
+    if (!pattern.empty() && pattern.back() != L'\\')
+    {
+        pattern += L'\\';
+    }
+    pattern += L'*';
+
+    WIN32_FIND_DATAW findData;
+    HANDLE find = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    do
+    {
+        if (lstrcmp(findData.cFileName, L".") == 0 || lstrcmp(findData.cFileName, L"..") == 0)
+        {
+            continue;
+        }
+
+        FileMetadata metadata;
+        metadata.creationTime = findData.ftCreationTime;
+        metadata.attributes = findData.dwFileAttributes;
+        metadata.size = (static_cast<ULONGLONG>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+        addEntry(findData.cFileName, metadata);
+    } while (FindNextFileW(find, &findData));
+
+    const DWORD error = GetLastError();
+    FindClose(find);
+    return error == ERROR_NO_MORE_FILES ? S_OK : HRESULT_FROM_WIN32(error);
+}
+
+CMetadataPrefetcher::CMetadataPrefetcher(std::unique_ptr<CFileMetadataProvider> provider) :
+    m_provider(std::move(provider))
+{
+}
+
+void CMetadataPrefetcher::Prefetch(const std::vector<CComPtr<IPowerRenameItem>>& items)
+{
+    std::vector<PendingItem> pendingItems;
+    pendingItems.reserve(items.size());
+    std::unordered_map<std::wstring, size_t> itemCounts;
+    for (const auto& item : items)
+    {
+        PWSTR path = nullptr;
+        if (FAILED(item->GetPath(&path)))
+        {
+            continue;
+        }
+
+        const std::wstring_view pathView(path);
+        const size_t separator = pathView.find_last_of(L"\\/");
+        if (separator != std::wstring_view::npos && separator + 1 < pathView.size())
+        {
+            UINT depth = 0;
+            item->GetDepth(&depth);
+
+            PendingItem pendingItem;
+            pendingItem.item = item;
+            pendingItem.folderPath = pathView.substr(0, separator);
+            pendingItem.folderKey = GetKey(pendingItem.folderPath);
+            pendingItem.nameKey = GetKey(pathView.substr(separator + 1));
+            // Items below the selected ones come from a folder walk, which lists the whole folder anyway
+            pendingItem.walked = depth > 0;
+            itemCounts[pendingItem.folderKey]++;
+            pendingItems.push_back(std::move(pendingItem));
+        }
+        CoTaskMemFree(path);
+    }
+
+    for (const PendingItem& pendingItem : pendingItems)
+    {
+        const bool list = pendingItem.walked || itemCounts[pendingItem.folderKey] >= c_minItemsPerListing;
+        Folder* folder = _GetFolder(pendingItem.folderKey, pendingItem.folderPath, list);
+        if (folder == nullptr)
+        {
+            continue;
+        }
+
+        auto entry = folder->entries.find(pendingItem.nameKey);
+        if (entry == folder->entries.end())
+        {
+            continue;
+        }
+
+        SYSTEMTIME time;
+        if (FileTimeToLocalSystemTime(entry->second.creationTime, &time))
+        {
+            pendingItem.item->PutMetadata(time, entry->second.attributes, entry->second.size);
+        }
+        folder->entries.erase(entry);
+    }
+}
+
+CMetadataPrefetcher::Folder* CMetadataPrefetcher::_GetFolder(const std::wstring& folderKey, std::wstring_view folderPath, bool list)
+{
+    auto existing = m_folders.find(folderKey);
+    if (existing != m_folders.end())
+    {
+        return &existing->second;
+    }
+
+    if (!list)
+    {
+        return nullptr;
+    }
+
+    // A failed listing keeps the entries listed before the failure, the other
+    // items load their metadata on first use
+    Folder& folder = m_folders[folderKey];
+    const std::wstring path(folderPath);
+    m_provider->ListFolder(path.c_str(), [&folder](PCWSTR name, const FileMetadata& metadata) {
+        folder.entries.emplace(GetKey(name), metadata);
+    });
+
+    return &folder;
+}
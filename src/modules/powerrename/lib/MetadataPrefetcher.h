@@ -0,0 +1,65 @@
+#pragma once
+#include "pch.h"
+#include "PowerRenameInterfaces.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Metadata of a directory entry
+struct FileMetadata
+{
+    FILETIME creationTime = {};
+    DWORD attributes = 0;
+    ULONGLONG size = 0;
+};
+
+// Lists the metadata of every entry of a folder at once
+class CFileMetadataProvider
+{
+public:
+    using EntryCallback = std::function<void(PCWSTR name, const FileMetadata& metadata)>;
+
+    virtual ~CFileMetadataProvider() = default;
+
+    // Calls addEntry for every entry of folder, except "." and ".."
+    virtual HRESULT ListFolder(_In_ PCWSTR folder, const EntryCallback& addEntry) = 0;
+};
+
+// Lists folders with FindFirstFileEx. Large fetches let a network share return many
+// entries per round trip instead of one query per file.
+class CFindFileMetadataProvider :
+    public CFileMetadataProvider
+{
+public:
+    HRESULT ListFolder(_In_ PCWSTR folder, const EntryCallback& addEntry) override;
+};
+
+// Metadata stage of the enumeration, run on the walk thread. The creation time, attributes
+// and size of the walked items are taken from one listing of their folder and stored in the
+// items, so the preview does not query each file when it needs them. Items that are not in
+// a listing keep loading their metadata on first use.
+class CMetadataPrefetcher
+{
+public:
+    explicit CMetadataPrefetcher(std::unique_ptr<CFileMetadataProvider> provider);
+
+    void Prefetch(const std::vector<CComPtr<IPowerRenameItem>>& items);
+
+private:
+    struct Folder
+    {
+        // Keyed by the upper case name, entries are removed once stored in their item
+        std::unordered_map<std::wstring, FileMetadata> entries;
+    };
+
+    // Returns nullptr if the folder was not listed and should not be
+    Folder* _GetFolder(const std::wstring& folderKey, std::wstring_view folderPath, bool list);
+
+    std::unique_ptr<CFileMetadataProvider> m_provider;
+    // Listed folders, keyed by the upper case path. A failed listing leaves an empty folder,
+    // so it is not listed again.
+    std::unordered_map<std::wstring, Folder> m_folders;
+};
@@ -1,7 +1,17 @@
 #include "pch.h"
 #include "PowerRenameEnum.h"
-#include <ShlGuid.h>
 #include <helpers.h>
+#include <thread>
+
+namespace
+{
+    // Number of items the walk thread hands over at a time
+    const size_t c_itemBatchSize = 256;
+    // Batches walked ahead of the items added to the manager
+    const size_t c_queuedBatchCount = 16;
+    // Longest time messages are not pumped while waiting for the walk
+    const std::chrono::milliseconds c_pumpInterval(30);
+}
 
 IFACEMETHODIMP_(ULONG) CPowerRenameEnum::AddRef()
 {
@@ -31,19 +41,81 @@ IFACEMETHODIMP CPowerRenameEnum::QueryInterface(_In_ REFIID riid, _Outptr_ void*
 IFACEMETHODIMP CPowerRenameEnum::Start()
 {
     m_canceled = false;
-    CComPtr<IShellItemArray> spsia;
-    HRESULT hr = GetShellItemArrayFromDataObject(m_spdo, &spsia);
-    if (SUCCEEDED(hr))
+    m_quitReceived = false;
+
+    if (m_spdo)
     {
-        CComPtr<IEnumShellItems> spesi;
-        hr = spsia->EnumItems(&spesi);
-        if (SUCCEEDED(hr))
+        // The walk runs on its own thread, which needs its own proxy of the data object
+        m_spdoStream = nullptr;
+        HRESULT hr = CoMarshalInterThreadInterfaceInStream(IID_IUnknown, m_spdo, &m_spdoStream);
+        if (FAILED(hr))
         {
-            hr = _ParseEnumItems(spesi);
+            return hr;
         }
     }
 
-    return hr;
+    // The walk thread produces batches of items while this thread adds them to the manager,
+    // so the preview of the first items runs while the rest of the tree is still walked.
+    CBoundedQueue<ItemBatch> queue(c_queuedBatchCount);
+    HRESULT walkResult = S_OK;
+    std::thread walkThread([this, &queue, &walkResult]() {
+        walkResult = _Walk(queue);
+    });
+
+    HRESULT hr = S_OK;
+    bool stopped = false;
+    ItemBatch batch;
+    // Pop until the walk thread is done with the queue, even after a cancel, since it
+    // may need this thread to pump messages for the data object until then.
+    for (;;)
+    {
+        CBoundedQueue<ItemBatch>::PopResult result = queue.Pop(batch, c_pumpInterval);
+        if (result == CBoundedQueue<ItemBatch>::PopResult::Closed)
+        {
+            break;
+        }
+
+        if (result == CBoundedQueue<ItemBatch>::PopResult::Item && !stopped)
+        {
+            for (const auto& item : batch)
+            {
+                hr = m_spsrm->AddItem(item);
+                if (FAILED(hr))
+                {
+                    stopped = true;
+                    queue.Cancel();
+                    break;
+                }
+            }
+        }
+        batch.clear();
+
+        // Let the manager publish the preview of the items added so far
+        _PumpMessages();
+
+        // A cancel seen while pumping stops the walk before any more items are added
+        if (m_canceled && !stopped)
+        {
+            stopped = true;
+            queue.Cancel();
+        }
+    }
+
+    walkThread.join();
+    m_spdoStream = nullptr;
+
+    if (m_quitReceived)
+    {
+        // Hand the quit message back to the message loop Start was called from
+        PostQuitMessage(m_quitExitCode);
+    }
+
+    if (m_canceled)
+    {
+        return E_ABORT;
+    }
+
+    return FAILED(hr) ? hr : walkResult;
 }
 
 IFACEMETHODIMP CPowerRenameEnum::Cancel()
@@ -71,6 +143,25 @@ HRESULT CPowerRenameEnum::s_CreateInstance(_In_ IUnknown* pdo, _In_ IPowerRename
     return hr;
 }
 
+HRESULT CPowerRenameEnum::s_CreateInstance(_In_ WalkerFactory createWalker, _In_ IPowerRenameManager* pManager, _In_ REFIID iid, _Outptr_ void** resultInterface)
+{
+    *resultInterface = nullptr;
+
+    CPowerRenameEnum* newRenameEnum = new CPowerRenameEnum();
+    HRESULT hr = newRenameEnum ? S_OK : E_OUTOFMEMORY;
+    if (SUCCEEDED(hr))
+    {
+        hr = newRenameEnum->_Init(std::move(createWalker), pManager);
+        if (SUCCEEDED(hr))
+        {
+            hr = newRenameEnum->QueryInterface(iid, resultInterface);
+        }
+
+        newRenameEnum->Release();
+    }
+    return hr;
+}
+
 CPowerRenameEnum::CPowerRenameEnum() :
     m_refCount(1)
 {
@@ -84,61 +175,112 @@ HRESULT CPowerRenameEnum::_Init(_In_ IUnknown* pdo, _In_ IPowerRenameManager* pM
 {
     m_spdo = pdo;
     m_spsrm = pManager;
+    m_createWalker = [this](std::unique_ptr<CItemWalker>& walker) {
+        return _CreateShellItemWalker(walker);
+    };
     return S_OK;
 }
 
-HRESULT CPowerRenameEnum::_ParseEnumItems(_In_ IEnumShellItems* pesi, _In_ int depth)
+HRESULT CPowerRenameEnum::_Init(_In_ WalkerFactory createWalker, _In_ IPowerRenameManager* pManager)
 {
-    HRESULT hr = E_INVALIDARG;
+    m_spsrm = pManager;
+    m_createWalker = std::move(createWalker);
+    return m_createWalker ? S_OK : E_INVALIDARG;
+}
 
-    // We shouldn't get this deep since we only enum the contents of
-    // regular folders but adding just in case
-    if ((pesi) && (depth < (MAX_PATH / 2)))
+HRESULT CPowerRenameEnum::_CreateShellItemWalker(std::unique_ptr<CItemWalker>& walker)
+{
+    CComPtr<IUnknown> spdo;
+    HRESULT hr = CoUnmarshalInterface(m_spdoStream, IID_PPV_ARGS(&spdo));
+    if (SUCCEEDED(hr))
     {
-        hr = S_OK;
+        CComPtr<IShellItemArray> spsia;
+        hr = GetShellItemArrayFromDataObject(spdo, &spsia);
+        if (SUCCEEDED(hr))
+        {
+            CComPtr<IEnumShellItems> spesi;
+            hr = spsia->EnumItems(&spesi);
+            if (SUCCEEDED(hr))
+            {
+                CComPtr<IPowerRenameItemFactory> spFactory;
+                hr = m_spsrm->GetRenameItemFactory(&spFactory);
+                if (SUCCEEDED(hr))
+                {
+                    walker = std::make_unique<CShellItemWalker>(spesi, spFactory);
+                }
+            }
+        }
+    }
+
+    return hr;
+}
 
-        ULONG celtFetched;
-        CComPtr<IShellItem> spsi;
-        while ((S_OK == pesi->Next(1, &spsi, &celtFetched)) && (SUCCEEDED(hr)))
+HRESULT CPowerRenameEnum::_Walk(CBoundedQueue<ItemBatch>& queue)
+{
+    HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+    if (SUCCEEDED(hr))
+    {
+        // Scope the walker so its shell objects are released before CoUninitialize
         {
-            if (m_canceled)
+            std::unique_ptr<CItemWalker> walker;
+            hr = m_createWalker(walker);
+            if (SUCCEEDED(hr) && !walker)
             {
-                return E_ABORT;
+                hr = E_FAIL;
             }
 
-            CComPtr<IPowerRenameItemFactory> spFactory;
-            hr = m_spsrm->GetRenameItemFactory(&spFactory);
-            if (SUCCEEDED(hr))
+            CMetadataPrefetcher prefetcher(std::make_unique<CFindFileMetadataProvider>());
+            while (hr == S_OK)
             {
-                CComPtr<IPowerRenameItem> spNewItem;
-                // Failure may be valid if we come across a shell item that does
-                // not support a file system path.  In that case we simply ignore
-                // the item.
-                if (SUCCEEDED(spFactory->Create(spsi, &spNewItem)))
+                ItemBatch batch;
+                batch.reserve(c_itemBatchSize);
+                hr = walker->Next(c_itemBatchSize, batch);
+
+                // Fill in the file times and attributes from folder listings before the preview needs them
+                prefetcher.Prefetch(batch);
+
+                // Items walked before a failure are still added
+                if (!batch.empty() && !queue.Push(std::move(batch)))
                 {
-                    spNewItem->PutDepth(depth);
-                    hr = m_spsrm->AddItem(spNewItem);
-                    if (SUCCEEDED(hr))
-                    {
-                        bool isFolder = false;
-                        if (SUCCEEDED(spNewItem->GetIsFolder(&isFolder)) && isFolder)
-                        {
-                            // Bind to the IShellItem for the IEnumShellItems interface
-                            CComPtr<IEnumShellItems> spesiNext;
-                            hr = spsi->BindToHandler(nullptr, BHID_EnumItems, IID_PPV_ARGS(&spesiNext));
-                            if (SUCCEEDED(hr))
-                            {
-                                // Parse the folder contents recursively
-                                hr = _ParseEnumItems(spesiNext, depth + 1);
-                            }
-                        }
-                    }
+                    // Canceled by the consumer
+                    hr = E_ABORT;
                 }
             }
 
-            spsi = nullptr;
+            if (hr == S_FALSE)
+            {
+                hr = S_OK;
+            }
         }
+
+        CoUninitialize();
     }
 
+    queue.Complete();
     return hr;
 }
+
+void CPowerRenameEnum::_PumpMessages()
+{
+    MSG msg;
+    while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+    {
+        if (msg.message == WM_QUIT)
+        {
+            // Stop the walk, but keep pumping until the walk thread is done since it may be
+            // waiting on a call to the data object. The message is posted again by Start.
+            m_quitReceived = true;
+            m_quitExitCode = static_cast<int>(msg.wParam);
+            m_canceled = true;
+            continue;
+        }
+
+        // Keyboard navigation of the dialog the message is for, like its own message loop does
+        HWND root = msg.hwnd ? GetAncestor(msg.hwnd, GA_ROOT) : nullptr;
+        if (!root || !IsDialogMessage(root, &msg))
+        {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+    }
+}
@@ -1,8 +1,13 @@
 #pragma once
 #include "pch.h"
 #include "PowerRenameInterfaces.h"
+#include <functional>
+#include <memory>
 #include <vector>
 #include "srwlock.h"
+#include "BoundedQueue.h"
+#include "ItemWalker.h"
+#include "MetadataPrefetcher.h"
 
 class CPowerRenameEnum :
     public IPowerRenameEnum
@@ -18,17 +23,36 @@ public:
     IFACEMETHODIMP Cancel();
 
 public:
+    // Called on the walk thread to create the walker
+    using WalkerFactory = std::function<HRESULT(std::unique_ptr<CItemWalker>& walker)>;
+
     static HRESULT s_CreateInstance(_In_ IUnknown* pdo, _In_ IPowerRenameManager* pManager, _In_ REFIID iid, _Outptr_ void** resultInterface);
+    static HRESULT s_CreateInstance(_In_ WalkerFactory createWalker, _In_ IPowerRenameManager* pManager, _In_ REFIID iid, _Outptr_ void** resultInterface);
 
 protected:
+    using ItemBatch = std::vector<CComPtr<IPowerRenameItem>>;
+
     CPowerRenameEnum();
     virtual ~CPowerRenameEnum();
 
     HRESULT _Init(_In_ IUnknown* pdo, _In_ IPowerRenameManager* pManager);
-    HRESULT _ParseEnumItems(_In_ IEnumShellItems* pesi, _In_ int depth = 0);
+    HRESULT _Init(_In_ WalkerFactory createWalker, _In_ IPowerRenameManager* pManager);
+    HRESULT _CreateShellItemWalker(std::unique_ptr<CItemWalker>& walker);
+    // Producer stage: walks the items and queues them in batches
+    HRESULT _Walk(CBoundedQueue<ItemBatch>& queue);
+    // Dispatches the messages of the calling thread while it waits for the walk. Start runs
+    // nested in a message handler of the caller, which must not start another enumeration
+    // until Start returns.
+    void _PumpMessages();
 
     CComPtr<IPowerRenameManager> m_spsrm;
     CComPtr<IUnknown> m_spdo;
+    // m_spdo marshaled for the walk thread
+    CComPtr<IStream> m_spdoStream;
+    WalkerFactory m_createWalker;
     bool m_canceled = false;
+    // A WM_QUIT was taken off the queue by _PumpMessages
+    bool m_quitReceived = false;
+    int m_quitExitCode = 0;
     long m_refCount = 0;
 };
\ No newline at end of file
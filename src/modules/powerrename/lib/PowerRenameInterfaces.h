@@ -49,6 +49,7 @@ public:
     IFACEMETHOD(PutFileTime)(_In_ SYSTEMTIME fileTime) = 0;
     IFACEMETHOD(ResetFileTime)() = 0;
     IFACEMETHOD(Replace)(_In_ PCWSTR source, _Outptr_ PWSTR* result) = 0;
+    IFACEMETHOD(ReplaceWithFileTime)(_In_ PCWSTR source, SYSTEMTIME fileTime, _Outptr_ PWSTR* result) = 0;
 };
 
 interface __declspec(uuid("C7F59201-4DE1-4855-A3A2-26FC3279C8A5")) IPowerRenameItem : public IUnknown
@@ -56,6 +57,9 @@ interface __declspec(uuid("C7F59201-4DE1-4855-A3A2-26FC3279C8A5")) IPowerRenameI
 public:
     IFACEMETHOD(GetPath)(_Outptr_ PWSTR* path) = 0;
     IFACEMETHOD(GetTime)(_Outptr_ SYSTEMTIME* time) = 0;
+    IFACEMETHOD(GetAttributes)(_Out_ DWORD* attributes) = 0;
+    IFACEMETHOD(GetSize)(_Out_ ULONGLONG* size) = 0;
+    IFACEMETHOD(PutMetadata)(_In_ SYSTEMTIME time, _In_ DWORD attributes, _In_ ULONGLONG size) = 0;
     IFACEMETHOD(GetShellItem)(_Outptr_ IShellItem** ppsi) = 0;
     IFACEMETHOD(GetOriginalName)(_Outptr_ PWSTR* originalName) = 0;
     IFACEMETHOD(GetNewName)(_Outptr_ PWSTR* newName) = 0;
@@ -83,7 +87,7 @@ interface __declspec(uuid("87FC43F9-7634-43D9-99A5-20876AFCE4AD")) IPowerRenameM
 {
 public:
     IFACEMETHOD(OnItemAdded)(_In_ IPowerRenameItem* renameItem) = 0;
-    IFACEMETHOD(OnUpdate)(_In_ IPowerRenameItem* renameItem) = 0;
+    IFACEMETHOD(OnUpdate)(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex) = 0;
     IFACEMETHOD(OnError)(_In_ IPowerRenameItem* renameItem) = 0;
     IFACEMETHOD(OnRegExStarted)(_In_ DWORD threadId) = 0;
     IFACEMETHOD(OnRegExCanceled)(_In_ DWORD threadId) = 0;
@@ -106,9 +110,11 @@ public:
     IFACEMETHOD(GetItemByIndex)(_In_ UINT index, _COM_Outptr_ IPowerRenameItem** ppItem) = 0;
     IFACEMETHOD(GetVisibleItemByIndex)(_In_ UINT index, _COM_Outptr_ IPowerRenameItem ** ppItem) = 0;
     IFACEMETHOD(SetVisible)() = 0;
+    IFACEMETHOD(UpdateItemVisibility)(_In_ int id) = 0;
     IFACEMETHOD(GetItemById)(_In_ int id, _COM_Outptr_ IPowerRenameItem** ppItem) = 0;
     IFACEMETHOD(GetItemCount)(_Out_ UINT* count) = 0;
     IFACEMETHOD(GetVisibleItemCount)(_Out_ UINT* count) = 0;
+    IFACEMETHOD(PutViewport)(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex) = 0;
     IFACEMETHOD(GetSelectedItemCount)(_Out_ UINT* count) = 0;
     IFACEMETHOD(GetRenameItemCount)(_Out_ UINT* count) = 0;
     IFACEMETHOD(GetFlags)(_Out_ DWORD* flags) = 0;
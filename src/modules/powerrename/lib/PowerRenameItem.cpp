@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "PowerRenameItem.h"
+#include "Helpers.h"
 #include <common/themes/icon_helpers.h>
 
 int CPowerRenameItem::s_id = 0;
@@ -46,39 +47,38 @@ IFACEMETHODIMP CPowerRenameItem::GetPath(_Outptr_ PWSTR* path)
 
 IFACEMETHODIMP CPowerRenameItem::GetTime(_Outptr_ SYSTEMTIME* time)
 {
+    HRESULT hr = _EnsureMetadata();
     CSRWSharedAutoLock lock(&m_lock);
-    HRESULT hr = E_FAIL ;
-
-    if (m_isTimeParsed)
-    {
-        hr = S_OK;
-    }
-    else
-    {
-        HANDLE hFile = CreateFileW(m_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
-        if (hFile != INVALID_HANDLE_VALUE)
-        {
-            FILETIME CreationTime;
-            if (GetFileTime(hFile, &CreationTime, NULL, NULL))
-            {
-                SYSTEMTIME SystemTime, LocalTime;
-                if (FileTimeToSystemTime(&CreationTime, &SystemTime))
-                {
-                    if (SystemTimeToTzSpecificLocalTime(NULL, &SystemTime, &LocalTime))
-                    {
-                        m_time = LocalTime;
-                        m_isTimeParsed = true;
-                        hr = S_OK;
-                    }
-                }
-            }
-        }
-        CloseHandle(hFile);
-    }
     *time = m_time;
     return hr;
 }
 
+IFACEMETHODIMP CPowerRenameItem::GetAttributes(_Out_ DWORD* attributes)
+{
+    HRESULT hr = _EnsureMetadata();
+    CSRWSharedAutoLock lock(&m_lock);
+    *attributes = m_attributes;
+    return hr;
+}
+
+IFACEMETHODIMP CPowerRenameItem::GetSize(_Out_ ULONGLONG* size)
+{
+    HRESULT hr = _EnsureMetadata();
+    CSRWSharedAutoLock lock(&m_lock);
+    *size = m_size;
+    return hr;
+}
+
+IFACEMETHODIMP CPowerRenameItem::PutMetadata(_In_ SYSTEMTIME time, _In_ DWORD attributes, _In_ ULONGLONG size)
+{
+    CSRWExclusiveAutoLock lock(&m_lock);
+    m_time = time;
+    m_attributes = attributes;
+    m_size = size;
+    m_hasMetadata = true;
+    return S_OK;
+}
+
 IFACEMETHODIMP CPowerRenameItem::GetShellItem(_Outptr_ IShellItem** ppsi)
 {
     return SHCreateItemFromParsingName(m_path, nullptr, IID_PPV_ARGS(ppsi));
@@ -97,24 +97,27 @@ IFACEMETHODIMP CPowerRenameItem::GetOriginalName(_Outptr_ PWSTR* originalName)
 
 IFACEMETHODIMP CPowerRenameItem::PutNewName(_In_opt_ PCWSTR newName)
 {
-    CSRWSharedAutoLock lock(&m_lock);
-    CoTaskMemFree(m_newName);
-    m_newName = nullptr;
-    HRESULT hr = S_OK;
-    if (newName != nullptr)
+    CSRWExclusiveAutoLock lock(&m_lock);
+    m_hasNewName = (newName != nullptr);
+    if (m_hasNewName)
     {
-        hr = SHStrDup(newName, &m_newName);
+        m_newName.assign(newName);
     }
-    return hr;
+    else
+    {
+        m_newName.clear();
+    }
+    return S_OK;
 }
 
 IFACEMETHODIMP CPowerRenameItem::GetNewName(_Outptr_ PWSTR* newName)
 {
+    *newName = nullptr;
     CSRWSharedAutoLock lock(&m_lock);
     HRESULT hr = S_OK;
-    if (m_newName)
+    if (m_hasNewName)
     {
-        hr = SHStrDup(m_newName, newName);
+        hr = SHStrDup(m_newName.c_str(), newName);
     }
     return hr;
 }
@@ -180,7 +183,7 @@ IFACEMETHODIMP CPowerRenameItem::ShouldRenameItem(_In_ DWORD flags, _Out_ bool*
 {
     // Should we perform a rename on this item given its
     // state and the options that were set?
-    bool hasChanged = m_newName != nullptr && (lstrcmp(m_originalName, m_newName) != 0);
+    bool hasChanged = m_hasNewName && (lstrcmp(m_originalName, m_newName.c_str()) != 0);
     bool excludeBecauseFolder = (m_isFolder && (flags & PowerRenameFlags::ExcludeFolders));
     bool excludeBecauseFile = (!m_isFolder && (flags & PowerRenameFlags::ExcludeFiles));
     bool excludeBecauseSubFolderContent = (m_depth > 0 && (flags & PowerRenameFlags::ExcludeSubfolders));
@@ -213,9 +216,9 @@ IFACEMETHODIMP CPowerRenameItem::IsItemVisible(_In_ DWORD filter, _In_ DWORD fla
 
 IFACEMETHODIMP CPowerRenameItem::Reset()
 {
-    CSRWSharedAutoLock lock(&m_lock);
-    CoTaskMemFree(m_newName);
-    m_newName = nullptr;
+    CSRWExclusiveAutoLock lock(&m_lock);
+    m_hasNewName = false;
+    m_newName.clear();
     return S_OK;
 }
 
@@ -245,24 +248,71 @@ HRESULT CPowerRenameItem::s_CreateInstance(_In_opt_ IShellItem* psi, _In_ REFIID
 
 CPowerRenameItem::CPowerRenameItem() :
     m_refCount(1),
-    m_id(++s_id)
+    m_id(++s_id),
+    m_arena(CStringArena::Shared())
 {
 }
 
 CPowerRenameItem::~CPowerRenameItem()
 {
-    CoTaskMemFree(m_path);
-    CoTaskMemFree(m_newName);
-    CoTaskMemFree(m_originalName);
+}
+
+void CPowerRenameItem::_InitNames(_In_opt_ PCWSTR path, _In_opt_ PCWSTR originalName)
+{
+    if (path != nullptr)
+    {
+        size_t pathLength = wcslen(path);
+        m_path = m_arena->Store(path, pathLength);
+
+        if (originalName != nullptr)
+        {
+            size_t nameLength = wcslen(originalName);
+            if (nameLength <= pathLength && wcscmp(m_path + pathLength - nameLength, originalName) == 0)
+            {
+                m_originalName = m_path + pathLength - nameLength;
+            }
+        }
+    }
+
+    if (originalName != nullptr && m_originalName == nullptr)
+    {
+        m_originalName = m_arena->Store(originalName, wcslen(originalName));
+    }
+}
+
+HRESULT CPowerRenameItem::_EnsureMetadata()
+{
+    {
+        CSRWSharedAutoLock lock(&m_lock);
+        if (m_hasMetadata)
+        {
+            return S_OK;
+        }
+    }
+
+    // Not in a folder listing of the enumeration, so query this file on its own
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    SYSTEMTIME time;
+    if (m_path == nullptr ||
+        !GetFileAttributesExW(m_path, GetFileExInfoStandard, &data) ||
+        !FileTimeToLocalSystemTime(data.ftCreationTime, &time))
+    {
+        return E_FAIL;
+    }
+
+    return PutMetadata(time, data.dwFileAttributes, (static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) | data.nFileSizeLow);
 }
 
 HRESULT CPowerRenameItem::_Init(_In_ IShellItem* psi)
 {
     // Get the full filesystem path from the shell item
-    HRESULT hr = psi->GetDisplayName(SIGDN_FILESYSPATH, &m_path);
+    PWSTR path = nullptr;
+    HRESULT hr = psi->GetDisplayName(SIGDN_FILESYSPATH, &path);
     if (SUCCEEDED(hr))
     {
-        hr = SHStrDup(PathFindFileName(m_path), &m_originalName);
+        _InitNames(path, PathFindFileName(path));
+        CoTaskMemFree(path);
+        hr = (m_path && m_originalName) ? S_OK : E_OUTOFMEMORY;
         if (SUCCEEDED(hr))
         {
             // Check if we are a folder now so we can check this attribute quickly later
@@ -1,7 +1,10 @@
 #pragma once
 #include "pch.h"
 #include "PowerRenameInterfaces.h"
+#include "StringArena.h"
 #include "srwlock.h"
+#include <memory>
+#include <string>
 
 class CPowerRenameItem :
     public IPowerRenameItem,
@@ -16,6 +19,9 @@ public:
     // IPowerRenameItem
     IFACEMETHODIMP GetPath(_Outptr_ PWSTR* path);
     IFACEMETHODIMP GetTime(_Outptr_ SYSTEMTIME* time);
+    IFACEMETHODIMP GetAttributes(_Out_ DWORD* attributes);
+    IFACEMETHODIMP GetSize(_Out_ ULONGLONG* size);
+    IFACEMETHODIMP PutMetadata(_In_ SYSTEMTIME time, _In_ DWORD attributes, _In_ ULONGLONG size);
     IFACEMETHODIMP GetShellItem(_Outptr_ IShellItem** ppsi);
     IFACEMETHODIMP GetOriginalName(_Outptr_ PWSTR* originalName);
     IFACEMETHODIMP PutNewName(_In_opt_ PCWSTR newName);
@@ -47,19 +53,29 @@ protected:
     virtual ~CPowerRenameItem();
 
     HRESULT _Init(_In_ IShellItem* psi);
+    // Stores the path and original name in the string arena. The original name shares
+    // the storage of the path when it is the last path component.
+    void _InitNames(_In_opt_ PCWSTR path, _In_opt_ PCWSTR originalName);
+    // Loads the metadata of this file if the enumeration did not prefetch it
+    HRESULT _EnsureMetadata();
 
     bool        m_selected = true;
     bool        m_isFolder = false;
-    bool        m_isTimeParsed = false;
+    bool        m_hasMetadata = false;
     bool        m_canRename = true;
+    bool        m_hasNewName = false;
     int         m_id = -1;
     int         m_iconIndex = -1;
     UINT        m_depth = 0;
     HRESULT     m_error = S_OK;
-    PWSTR       m_path = nullptr;
-    PWSTR       m_originalName = nullptr;
-    PWSTR       m_newName = nullptr;
+    PCWSTR      m_path = nullptr;
+    PCWSTR      m_originalName = nullptr;
+    // Reassigned on every preview pass, so keep the buffer around instead of reallocating it
+    std::wstring m_newName;
+    std::shared_ptr<CStringArena> m_arena;
     SYSTEMTIME  m_time = {0};
+    DWORD       m_attributes = 0;
+    ULONGLONG   m_size = 0;
     CSRWLock    m_lock;
     long        m_refCount = 0;
 };
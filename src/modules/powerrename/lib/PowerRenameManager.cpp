@@ -7,14 +7,45 @@
 #include "helpers.h"
 #include <filesystem>
 #include "trace.h"
+#include "WorkerPool.h"
+#include "ItemRangeBatch.h"
+#include "LiteralMatcher.h"
+#include "CaseTransformer.h"
+#include "EnumerationTemplate.h"
+#include "RenameEngine.h"
+#include "RenameExecutor.h"
 #include <winrt/base.h>
 
 namespace fs = std::filesystem;
 
 extern HINSTANCE g_hInst;
 
-// The default FOF flags to use in the rename operations
-#define FOF_DEFAULTFLAGS (FOF_ALLOWUNDO | FOFX_ADDUNDORECORD | FOFX_SHOWELEVATIONPROMPT | FOF_RENAMEONCOLLISION)
+namespace
+{
+    // Item updates from the preview workers are published to the UI at most once per frame,
+    // or sooner once this many items are waiting
+    const std::chrono::milliseconds c_updateInterval(16);
+    const size_t c_maxPendingUpdates = 4096;
+
+    // Publishes the items left in the update batch once the workers stop notifying
+    const UINT_PTR c_updateFlushTimerId = 2;
+
+    // Search and replace term edits are coalesced into one preview pass once the user
+    // stops typing for this long
+    const UINT_PTR c_regExRenameTimerId = 1;
+    const UINT c_regExRenameDelay = 50; // ms
+}
+
+// Custom messages for worker threads
+enum
+{
+    SRM_REGEX_ITEMS_UPDATED = (WM_APP + 1), // Rename items processed by regex worker threads are waiting in the update batch
+    SRM_REGEX_STARTED, // RegEx operation was started
+    SRM_REGEX_CANCELED, // Regex operation was canceled
+    SRM_REGEX_COMPLETE, // Regex worker thread completed
+    SRM_FILEOP_COMPLETE, // File Operation worker thread completed
+    SRM_ITEMS_ADDED // Rename items were added since this message was last handled
+};
 
 IFACEMETHODIMP_(ULONG)
 CPowerRenameManager::AddRef()
@@ -121,10 +152,13 @@ IFACEMETHODIMP CPowerRenameManager::AddItem(_In_ IPowerRenameItem* pItem)
         int id = 0;
         pItem->GetId(&id);
         // Verify the item isn't already added
-        if (m_renameItems.find(id) == m_renameItems.end())
+        if (m_renameItemIndices.find(id) == m_renameItemIndices.end())
         {
-            m_renameItems[id] = pItem;
-            m_isVisible.push_back(true);
+            UINT depth = 0;
+            pItem->GetDepth(&depth);
+            m_renameItemIndices[id] = static_cast<UINT>(m_renameItems.size());
+            m_renameItems.push_back(pItem);
+            m_visibility.AddItem(depth, _IsItemVisible(pItem));
             pItem->AddRef();
             hr = S_OK;
         }
@@ -133,6 +167,13 @@ IFACEMETHODIMP CPowerRenameManager::AddItem(_In_ IPowerRenameItem* pItem)
     if (SUCCEEDED(hr))
     {
         _OnItemAdded(pItem);
+
+        // Items come in batches from the enumeration, so only one message is posted
+        // until the manager thread handles it
+        if (m_hwndMessage && !m_itemsAddedNotified.exchange(true))
+        {
+            PostMessage(m_hwndMessage, SRM_ITEMS_ADDED, 0, 0);
+        }
     }
 
     return hr;
@@ -145,9 +186,7 @@ IFACEMETHODIMP CPowerRenameManager::GetItemByIndex(_In_ UINT index, _COM_Outptr_
     HRESULT hr = E_FAIL;
     if (index < m_renameItems.size())
     {
-        std::map<int, IPowerRenameItem*>::iterator it = m_renameItems.begin();
-        std::advance(it, index);
-        *ppItem = it->second;
+        *ppItem = m_renameItems[index];
         (*ppItem)->AddRef();
         hr = S_OK;
     }
@@ -159,29 +198,14 @@ IFACEMETHODIMP CPowerRenameManager::GetVisibleItemByIndex(_In_ UINT index, _COM_
 {
     *ppItem = nullptr;
     CSRWSharedAutoLock lock(&m_lockItems);
-    UINT count = 0;
     HRESULT hr = E_FAIL;
 
-    if (m_filter == PowerRenameFilters::None)
-    {
-        hr = GetItemByIndex(index, ppItem);
-    }
-    else if (SUCCEEDED(GetVisibleItemCount(&count)) && index < count)
+    size_t itemIndex = (m_filter == PowerRenameFilters::None) ? index : m_visibility.GetItemIndex(index);
+    if (itemIndex < m_renameItems.size())
     {
-        UINT realIndex = 0, visibleIndex = 0;
-        for (size_t i = 0; i < m_isVisible.size(); i++)
-        {
-            if (m_isVisible[i] && visibleIndex == index)
-            {
-                realIndex = static_cast<UINT>(i);
-                break;
-            }
-            if (m_isVisible[i])
-            {
-                visibleIndex++;
-            }
-        }
-        hr = GetItemByIndex(realIndex, ppItem);
+        *ppItem = m_renameItems[itemIndex];
+        (*ppItem)->AddRef();
+        hr = S_OK;
     }
 
     return hr;
@@ -193,11 +217,10 @@ IFACEMETHODIMP CPowerRenameManager::GetItemById(_In_ int id, _COM_Outptr_ IPower
 
     CSRWSharedAutoLock lock(&m_lockItems);
     HRESULT hr = E_FAIL;
-    std::map<int, IPowerRenameItem*>::iterator it;
-    it = m_renameItems.find(id);
-    if (it != m_renameItems.end())
+    auto it = m_renameItemIndices.find(id);
+    if (it != m_renameItemIndices.end())
     {
-        *ppItem = m_renameItems[id];
+        *ppItem = m_renameItems[it->second];
         (*ppItem)->AddRef();
         hr = S_OK;
     }
@@ -214,39 +237,18 @@ IFACEMETHODIMP CPowerRenameManager::GetItemCount(_Out_ UINT* count)
 
 IFACEMETHODIMP CPowerRenameManager::SetVisible()
 {
-    CSRWSharedAutoLock lock(&m_lockItems);
-    HRESULT hr = E_FAIL;
-    UINT lastVisibleDepth = 0;
-    size_t i = m_isVisible.size() - 1;
-    PWSTR searchTerm = nullptr;
-    for (auto rit = m_renameItems.rbegin(); rit != m_renameItems.rend(); ++rit, --i)
-    {
-        bool isVisible = false;
-        if (m_filter == PowerRenameFilters::ShouldRename &&
-            (FAILED(m_spRegEx->GetSearchTerm(&searchTerm)) || searchTerm && wcslen(searchTerm) == 0))
-        {
-            isVisible = true;
-        }
-        else
-        {
-            rit->second->IsItemVisible(m_filter, m_flags, &isVisible);
-        }
-
-        UINT itemDepth = 0;
-        rit->second->GetDepth(&itemDepth);
-
-        //Make an item visible if it has a least one visible subitem
-        if (isVisible)
-        {
-            lastVisibleDepth = itemDepth;
-        }
-        else if (lastVisibleDepth == itemDepth + 1)
-        {
-            isVisible = true;
-            lastVisibleDepth = itemDepth;
-        }
+    _RebuildVisibility();
+    return S_OK;
+}
 
-        m_isVisible[i] = isVisible;
+IFACEMETHODIMP CPowerRenameManager::UpdateItemVisibility(_In_ int id)
+{
+    CSRWExclusiveAutoLock lock(&m_lockItems);
+    HRESULT hr = E_FAIL;
+    auto it = m_renameItemIndices.find(id);
+    if (it != m_renameItemIndices.end())
+    {
+        m_visibility.SetVisible(it->second, _IsItemVisible(m_renameItems[it->second]));
         hr = S_OK;
     }
 
@@ -255,24 +257,42 @@ IFACEMETHODIMP CPowerRenameManager::SetVisible()
 
 IFACEMETHODIMP CPowerRenameManager::GetVisibleItemCount(_Out_ UINT* count)
 {
-    *count = 0;
     CSRWSharedAutoLock lock(&m_lockItems);
 
     if (m_filter != PowerRenameFilters::None)
     {
-        SetVisible();
+        *count = static_cast<UINT>(m_visibility.GetVisibleCount());
+    }
+    else
+    {
+        *count = static_cast<UINT>(m_renameItems.size());
+    }
 
-        for (size_t i = 0; i < m_isVisible.size(); i++)
-        {
-            if (m_isVisible[i])
-            {
-                (*count)++;
-            }
-        }
+    return S_OK;
+}
+
+IFACEMETHODIMP CPowerRenameManager::PutViewport(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex)
+{
+    CSRWSharedAutoLock lock(&m_lockItems);
+
+    const size_t visibleCount = (m_filter == PowerRenameFilters::None) ? m_renameItems.size() : m_visibility.GetVisibleCount();
+    if (visibleCount == 0 || firstVisibleIndex > lastVisibleIndex)
+    {
+        m_viewportHint.Clear();
+        return S_OK;
+    }
+
+    // The rows are visible indices, the preview works on item indices. The items between the
+    // first and last row include every row of the viewport.
+    const size_t firstIndex = std::min<size_t>(firstVisibleIndex, visibleCount - 1);
+    const size_t lastIndex = std::min<size_t>(lastVisibleIndex, visibleCount - 1);
+    if (m_filter == PowerRenameFilters::None)
+    {
+        m_viewportHint.Set(static_cast<UINT>(firstIndex), static_cast<UINT>(lastIndex));
     }
     else
     {
-        GetItemCount(count);
+        m_viewportHint.Set(static_cast<UINT>(m_visibility.GetItemIndex(firstIndex)), static_cast<UINT>(m_visibility.GetItemIndex(lastIndex)));
     }
 
     return S_OK;
@@ -283,9 +303,8 @@ IFACEMETHODIMP CPowerRenameManager::GetSelectedItemCount(_Out_ UINT* count)
     *count = 0;
     CSRWSharedAutoLock lock(&m_lockItems);
 
-    for (auto it : m_renameItems)
+    for (auto pItem : m_renameItems)
     {
-        IPowerRenameItem* pItem = it.second;
         bool selected = false;
         if (SUCCEEDED(pItem->GetSelected(&selected)) && selected)
         {
@@ -301,9 +320,8 @@ IFACEMETHODIMP CPowerRenameManager::GetRenameItemCount(_Out_ UINT* count)
     *count = 0;
     CSRWSharedAutoLock lock(&m_lockItems);
 
-    for (auto it : m_renameItems)
+    for (auto pItem : m_renameItems)
     {
-        IPowerRenameItem* pItem = it.second;
         bool shouldRename = false;
         if (SUCCEEDED(pItem->ShouldRenameItem(m_flags, &shouldRename)) && shouldRename)
         {
@@ -356,6 +374,8 @@ IFACEMETHODIMP CPowerRenameManager::SwitchFilter(_In_ int columnNumber)
         break;
     }
 
+    _RebuildVisibility();
+
     return S_OK;
 }
 
@@ -397,15 +417,23 @@ IFACEMETHODIMP CPowerRenameManager::PutRenameItemFactory(_In_ IPowerRenameItemFa
     return S_OK;
 }
 
-IFACEMETHODIMP CPowerRenameManager::OnSearchTermChanged(_In_ PCWSTR /*searchTerm*/)
+IFACEMETHODIMP CPowerRenameManager::OnSearchTermChanged(_In_ PCWSTR searchTerm)
 {
-    _PerformRegExRename();
+    // Going from or to an empty search term changes what the ShouldRename filter shows
+    // for every item. Otherwise the items are updated as the preview reaches them.
+    bool isSearchTermEmpty = (searchTerm == nullptr || searchTerm[0] == L'\0');
+    if (isSearchTermEmpty != m_isSearchTermEmpty)
+    {
+        _RebuildVisibility();
+    }
+
+    _SchedulePerformRegExRename();
     return S_OK;
 }
 
 IFACEMETHODIMP CPowerRenameManager::OnReplaceTermChanged(_In_ PCWSTR /*replaceTerm*/)
 {
-    _PerformRegExRename();
+    _SchedulePerformRegExRename();
     return S_OK;
 }
 
@@ -413,6 +441,7 @@ IFACEMETHODIMP CPowerRenameManager::OnFlagsChanged(_In_ DWORD flags)
 {
     // Flags were updated in the rename regex.  Update our preview.
     m_flags = flags;
+    _RebuildVisibility();
     _PerformRegExRename();
     return S_OK;
 }
@@ -441,6 +470,7 @@ HRESULT CPowerRenameManager::s_CreateInstance(_Outptr_ IPowerRenameManager** pps
 }
 
 CPowerRenameManager::CPowerRenameManager() :
+    m_updateBatch(c_updateInterval, c_maxPendingUpdates),
     m_refCount(1)
 {
     InitializeCriticalSection(&m_critsecReentrancy);
@@ -463,22 +493,20 @@ HRESULT CPowerRenameManager::_Init()
     return S_OK;
 }
 
-// Custom messages for worker threads
-enum
-{
-    SRM_REGEX_ITEM_UPDATED = (WM_APP + 1), // Single rename item processed by regex worker thread
-    SRM_REGEX_STARTED, // RegEx operation was started
-    SRM_REGEX_CANCELED, // Regex operation was canceled
-    SRM_REGEX_COMPLETE, // Regex worker thread completed
-    SRM_FILEOP_COMPLETE // File Operation worker thread completed
-};
-
 struct WorkerThreadData
 {
     HWND hwndManager = nullptr;
     HANDLE startEvent = nullptr;
     HANDLE cancelEvent = nullptr;
+    // Owner window of the rename operation
     HWND hwndParent = nullptr;
+    // Only evaluate the items added since the last completed pass
+    bool addedItemsOnly = false;
+    CItemRangeBatch* updateBatch = nullptr;
+    PreviewMatchState* matchState = nullptr;
+    const CViewportHint* viewportHint = nullptr;
+    // Indexes of the items the rename operation failed to rename
+    std::vector<UINT>* renameFailures = nullptr;
     CComPtr<IPowerRenameManager> spsrm;
 };
 
@@ -513,26 +541,56 @@ LRESULT CPowerRenameManager::_WndProc(_In_ HWND hwnd, _In_ UINT msg, _In_ WPARAM
 
     switch (msg)
     {
-    case SRM_REGEX_ITEM_UPDATED:
-    {
-        int id = static_cast<int>(lParam);
-        CComPtr<IPowerRenameItem> spItem;
-        if (SUCCEEDED(GetItemById(id, &spItem)))
+    case SRM_REGEX_ITEMS_UPDATED:
+        _PublishItemUpdates();
+        break;
+
+    case WM_TIMER:
+        if (wParam == c_regExRenameTimerId)
+        {
+            KillTimer(hwnd, c_regExRenameTimerId);
+            if (m_regExRenamePending)
+            {
+                _PerformRegExRename();
+            }
+        }
+        else if (wParam == c_updateFlushTimerId)
         {
-            _OnUpdate(spItem);
+            if (m_updateBatch.HasPending())
+            {
+                _PublishItemUpdates();
+            }
+            else
+            {
+                KillTimer(hwnd, c_updateFlushTimerId);
+            }
         }
         break;
-    }
+
     case SRM_REGEX_STARTED:
         _OnRegExStarted(static_cast<DWORD>(wParam));
         break;
 
     case SRM_REGEX_CANCELED:
+        _PublishItemUpdates();
         _OnRegExCanceled(static_cast<DWORD>(wParam));
         break;
 
     case SRM_REGEX_COMPLETE:
+        // Items updated since the last batch was published
+        _PublishItemUpdates();
         _OnRegExCompleted(static_cast<DWORD>(wParam));
+
+        // Items were added while the current pass was running
+        if (m_addedItemsPreviewPending && !m_regExRenamePending && m_regExWorkerThreadHandle &&
+            GetThreadId(m_regExWorkerThreadHandle) == static_cast<DWORD>(wParam))
+        {
+            _PerformRegExRename(true);
+        }
+        break;
+
+    case SRM_ITEMS_ADDED:
+        _OnItemsAdded();
         break;
 
     default:
@@ -597,6 +655,15 @@ void CPowerRenameManager::_LogOperationTelemetry()
 
 HRESULT CPowerRenameManager::_PerformFileOperation()
 {
+    // Run the preview pass of a term edit that is still waiting for the debounce timer
+    if (m_regExRenamePending)
+    {
+        _PerformRegExRename();
+    }
+
+    // Wait for existing regex thread to finish, so the count below sees its new names
+    _WaitForRegExWorkerThread();
+
     // Do we have items to rename?
     UINT renameItemCount = 0;
     if (FAILED(GetRenameItemCount(&renameItemCount)) || renameItemCount == 0)
@@ -606,10 +673,8 @@ HRESULT CPowerRenameManager::_PerformFileOperation()
 
     _LogOperationTelemetry();
 
-    // Wait for existing regex thread to finish
-    _WaitForRegExWorkerThread();
-
     // Create worker thread which will perform the actual rename
+    m_renameFailures.clear();
     HRESULT hr = _CreateFileOpWorkerThread();
     if (SUCCEEDED(hr))
     {
@@ -643,6 +708,16 @@ HRESULT CPowerRenameManager::_PerformFileOperation()
             }
         }
 
+        // The worker thread has exited, so the failures can be read
+        for (UINT index : m_renameFailures)
+        {
+            CComPtr<IPowerRenameItem> spItem;
+            if (SUCCEEDED(GetItemByIndex(index, &spItem)))
+            {
+                _OnError(spItem);
+            }
+        }
+
         _OnRenameCompleted();
     }
 
@@ -658,6 +733,8 @@ HRESULT CPowerRenameManager::_CreateFileOpWorkerThread()
         pwtd->hwndManager = m_hwndMessage;
         pwtd->startEvent = m_startRegExWorkerEvent;
         pwtd->cancelEvent = nullptr;
+        pwtd->hwndParent = m_hwndParent;
+        pwtd->renameFailures = &m_renameFailures;
         pwtd->spsrm = this;
         m_fileOpWorkerThreadHandle = CreateThread(nullptr, 0, s_fileOpWorkerThread, pwtd, 0, nullptr);
         hr = E_FAIL;
@@ -687,73 +764,50 @@ DWORD WINAPI CPowerRenameManager::s_fileOpWorkerThread(_In_ void* pv)
                 CComPtr<IPowerRenameRegEx> spRenameRegEx;
                 if (SUCCEEDED(pwtd->spsrm->GetRenameRegEx(&spRenameRegEx)))
                 {
-                    // Create IFileOperation interface
-                    CComPtr<IFileOperation> spFileOp;
-                    if (SUCCEEDED(CoCreateInstance(CLSID_FileOperation, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&spFileOp))))
-                    {
-                        DWORD flags = 0;
-                        spRenameRegEx->GetFlags(&flags);
-
-                        UINT itemCount = 0;
-                        pwtd->spsrm->GetItemCount(&itemCount);
-
-                        // We add the items to the operation in depth-first order.  This allows child items to be
-                        // renamed before parent items.
+                    DWORD flags = 0;
+                    spRenameRegEx->GetFlags(&flags);
 
-                        // Creating a vector of vectors of items of the same depth
-                        std::vector<std::vector<UINT>> matrix(itemCount);
+                    UINT itemCount = 0;
+                    pwtd->spsrm->GetItemCount(&itemCount);
 
-                        for (UINT u = 0; u < itemCount; u++)
+                    // The executor orders the renames itself: items before the folders that
+                    // contain them, and items that take the name of another one after it
+                    std::vector<RenameRequest> requests;
+                    std::vector<UINT> requestItems;
+                    for (UINT u = 0; u < itemCount; u++)
+                    {
+                        CComPtr<IPowerRenameItem> spItem;
+                        bool shouldRename = false;
+                        if (SUCCEEDED(pwtd->spsrm->GetItemByIndex(u, &spItem)) &&
+                            SUCCEEDED(spItem->ShouldRenameItem(flags, &shouldRename)) && shouldRename)
                         {
-                            CComPtr<IPowerRenameItem> spItem;
-                            if (SUCCEEDED(pwtd->spsrm->GetItemByIndex(u, &spItem)))
+                            PWSTR path = nullptr;
+                            PWSTR newName = nullptr;
+                            if (SUCCEEDED(spItem->GetPath(&path)) && SUCCEEDED(spItem->GetNewName(&newName)))
                             {
-                                UINT depth = 0;
-                                spItem->GetDepth(&depth);
-                                matrix[depth].push_back(u);
-                            }
-                        }
-
-                        // From the greatest depth first, add all items of that depth to the operation
-                        for (LONG v = itemCount - 1; v >= 0; v--)
-                        {
-                            for (auto it : matrix[v])
-                            {
-                                CComPtr<IPowerRenameItem> spItem;
-                                if (SUCCEEDED(pwtd->spsrm->GetItemByIndex(it, &spItem)))
-                                {
-                                    bool shouldRename = false;
-                                    if (SUCCEEDED(spItem->ShouldRenameItem(flags, &shouldRename)) && shouldRename)
-                                    {
-                                        PWSTR newName = nullptr;
-                                        if (SUCCEEDED(spItem->GetNewName(&newName)))
-                                        {
-                                            CComPtr<IShellItem> spShellItem;
-                                            if (SUCCEEDED(spItem->GetShellItem(&spShellItem)))
-                                            {
-                                                spFileOp->RenameItem(spShellItem, newName, nullptr);
-                                            }
-                                            CoTaskMemFree(newName);
-                                        }
-                                    }
-                                }
+                                requests.push_back({ path, newName });
+                                requestItems.push_back(u);
                             }
+                            CoTaskMemFree(path);
+                            CoTaskMemFree(newName);
                         }
+                    }
 
-                        // Set the operation flags
-                        if (SUCCEEDED(spFileOp->SetOperationFlags(FOF_DEFAULTFLAGS)))
+                    // The plan runs as one IFileOperation, which Explorer undoes in one step, asks
+                    // for elevation where needed and gives colliding items a free name such as
+                    // "name (2)". Cycles of names add an operation per step. The failed items are
+                    // reported to the UI once the thread has exited.
+                    CWin32RenameFileSystem fileSystem;
+                    CShellRenameOperation operation(pwtd->hwndParent);
+                    CRenameJournal journal;
+                    CRenameExecutor executor(fileSystem, operation, journal);
+                    std::vector<HRESULT> results;
+                    executor.Execute(requests, results);
+                    for (size_t i = 0; i < results.size(); i++)
+                    {
+                        if (FAILED(results[i]))
                         {
-                            // Set the parent window
-                            if (pwtd->hwndParent)
-                            {
-                                spFileOp->SetOwnerWindow(pwtd->hwndParent);
-                            }
-
-                            // Perform the operation
-                            // We don't care about the return code here. We would rather
-                            // return control back to explorer so the user can cleanly
-                            // undo the operation if it failed halfway through.
-                            spFileOp->PerformOperations();
+                            pwtd->renameFailures->push_back(requestItems[i]);
                         }
                     }
                 }
@@ -770,7 +824,7 @@ DWORD WINAPI CPowerRenameManager::s_fileOpWorkerThread(_In_ void* pv)
     return 0;
 }
 
-HRESULT CPowerRenameManager::_PerformRegExRename()
+HRESULT CPowerRenameManager::_PerformRegExRename(bool addedItemsOnly)
 {
     HRESULT hr = E_FAIL;
 
@@ -781,11 +835,22 @@ HRESULT CPowerRenameManager::_PerformRegExRename()
     }
     else
     {
+        // This pass covers any edit still waiting for the debounce timer
+        _CancelPendingRegExRename();
+
         // Ensure previous thread is canceled
         _CancelRegExWorkerThread();
 
+        // Every pass covers the items added so far
+        m_previewStarted = true;
+        m_addedItemsPreviewPending = false;
+        {
+            CSRWSharedAutoLock lock(&m_lockItems);
+            m_previewItemCount = m_renameItems.size();
+        }
+
         // Create worker thread which will message us progress and completion.
-        hr = _CreateRegExWorkerThread();
+        hr = _CreateRegExWorkerThread(addedItemsOnly);
         if (SUCCEEDED(hr))
         {
             ResetEvent(m_cancelRegExWorkerEvent);
@@ -799,7 +864,34 @@ HRESULT CPowerRenameManager::_PerformRegExRename()
     return hr;
 }
 
-HRESULT CPowerRenameManager::_CreateRegExWorkerThread()
+void CPowerRenameManager::_SchedulePerformRegExRename()
+{
+    if (!m_hwndMessage)
+    {
+        _PerformRegExRename();
+        return;
+    }
+
+    // Stop the pass for the previous term right away so it does not keep updating the
+    // preview, and start the new one once the user stops typing.
+    _CancelRegExWorkerThread();
+    m_regExRenamePending = true;
+    SetTimer(m_hwndMessage, c_regExRenameTimerId, c_regExRenameDelay, nullptr);
+}
+
+void CPowerRenameManager::_CancelPendingRegExRename()
+{
+    if (m_regExRenamePending)
+    {
+        m_regExRenamePending = false;
+        if (m_hwndMessage)
+        {
+            KillTimer(m_hwndMessage, c_regExRenameTimerId);
+        }
+    }
+}
+
+HRESULT CPowerRenameManager::_CreateRegExWorkerThread(bool addedItemsOnly)
 {
     WorkerThreadData* pwtd = new WorkerThreadData;
     HRESULT hr = E_OUTOFMEMORY;
@@ -808,7 +900,10 @@ HRESULT CPowerRenameManager::_CreateRegExWorkerThread()
         pwtd->hwndManager = m_hwndMessage;
         pwtd->startEvent = m_startRegExWorkerEvent;
         pwtd->cancelEvent = m_cancelRegExWorkerEvent;
-        pwtd->hwndParent = m_hwndParent;
+        pwtd->addedItemsOnly = addedItemsOnly;
+        pwtd->updateBatch = &m_updateBatch;
+        pwtd->matchState = &m_previewMatchState;
+        pwtd->viewportHint = &m_viewportHint;
         pwtd->spsrm = this;
         m_regExWorkerThreadHandle = CreateThread(nullptr, 0, s_regexWorkerThread, pwtd, 0, nullptr);
         hr = E_FAIL;
@@ -825,6 +920,75 @@ HRESULT CPowerRenameManager::_CreateRegExWorkerThread()
     return hr;
 }
 
+namespace
+{
+    // Number of items a preview worker claims at a time
+    const size_t c_previewChunkSize = 256;
+
+    // New name computed for an item before enumeration is applied
+    struct PreviewCandidate
+    {
+        bool excluded = false;
+        bool hasName = false;
+        // The source name contains the literal search term
+        bool matched = true;
+        std::wstring name;
+    };
+
+    // matcher finds the literal search term when the pass tracks matches, nullptr otherwise
+    void ComputePreviewCandidate(_In_ IPowerRenameItem* item, DWORD flags, _In_ IPowerRenameRegEx* renameRegEx, bool useFileTime, _In_opt_ const CLiteralMatcher* matcher, const CCaseTransformer& transformer, _Inout_ PreviewCandidate& candidate)
+    {
+        candidate.excluded = false;
+        candidate.hasName = false;
+        candidate.matched = true;
+        candidate.name.clear();
+
+        bool isFolder = false;
+        bool isSubFolderContent = false;
+        winrt::check_hresult(item->GetIsFolder(&isFolder));
+        winrt::check_hresult(item->GetIsSubFolderContent(&isSubFolderContent));
+        if (IsExcludedItem(isFolder, isSubFolderContent, flags))
+        {
+            candidate.excluded = true;
+            return;
+        }
+
+        PWSTR originalName = nullptr;
+        winrt::check_hresult(item->GetOriginalName(&originalName));
+
+        const std::wstring sourceName = GetRenameSource(originalName, flags);
+        if (matcher)
+        {
+            // Every name contains the empty search term
+            candidate.matched = matcher->IsEmpty() || matcher->Contains(sourceName);
+        }
+
+        SYSTEMTIME fileTime = { 0 };
+        if (useFileTime)
+        {
+            winrt::check_hresult(item->GetTime(&fileTime));
+        }
+
+        // No change from originalName leaves the candidate empty, so we clear it from our UI as well
+        candidate.hasName = ComputeNewName(originalName, sourceName.c_str(), flags, renameRegEx, useFileTime ? &fileTime : nullptr, transformer, candidate.name);
+
+        CoTaskMemFree(originalName);
+    }
+
+    // Returns true if the new name of the item changed
+    bool ApplyNewName(_In_ IPowerRenameItem* item, _In_opt_ PCWSTR newNameToUse)
+    {
+        PWSTR currentNewName = nullptr;
+        winrt::check_hresult(item->GetNewName(&currentNewName));
+
+        winrt::check_hresult(item->PutNewName(newNameToUse));
+
+        bool changed = lstrcmp(currentNewName, newNameToUse) != 0;
+        CoTaskMemFree(currentNewName);
+        return changed;
+    }
+}
+
 DWORD WINAPI CPowerRenameManager::s_regexWorkerThread(_In_ void* pv)
 {
     try
@@ -833,7 +997,8 @@ DWORD WINAPI CPowerRenameManager::s_regexWorkerThread(_In_ void* pv)
         WorkerThreadData* pwtd = reinterpret_cast<WorkerThreadData*>(pv);
         if (pwtd)
         {
-            PostMessage(pwtd->hwndManager, SRM_REGEX_STARTED, GetCurrentThreadId(), 0);
+            const DWORD threadId = GetCurrentThreadId();
+            PostMessage(pwtd->hwndManager, SRM_REGEX_STARTED, threadId, 0);
 
             // Wait to be told we can begin
             if (WaitForSingleObject(pwtd->startEvent, INFINITE) == WAIT_OBJECT_0)
@@ -846,187 +1011,214 @@ DWORD WINAPI CPowerRenameManager::s_regexWorkerThread(_In_ void* pv)
                 winrt::check_hresult(spRenameRegEx->GetFlags(&flags));
 
                 PWSTR replaceTerm = nullptr;
-                bool useFileTime = false;
-
                 winrt::check_hresult(spRenameRegEx->GetReplaceTerm(&replaceTerm));
 
-                if (isFileTimeUsed(replaceTerm))
-                {
-                    useFileTime = true;
-                }
+                // Parsed once per pass, the regex object fills in the fields for each item
+                const bool useFileTime = isFileTimeUsed(replaceTerm);
+                std::wstring replaceTermToUse(replaceTerm ? replaceTerm : L"");
+                CoTaskMemFree(replaceTerm);
+
+                PWSTR searchTerm = nullptr;
+                winrt::check_hresult(spRenameRegEx->GetSearchTerm(&searchTerm));
+                std::wstring searchTermToUse(searchTerm ? searchTerm : L"");
+                CoTaskMemFree(searchTerm);
 
                 UINT itemCount = 0;
-                unsigned long itemEnumIndex = 1;
                 winrt::check_hresult(pwtd->spsrm->GetItemCount(&itemCount));
-                for (UINT u = 0; u < itemCount; u++)
-                {
-                    // Check if cancel event is signaled
-                    if (WaitForSingleObject(pwtd->cancelEvent, 0) == WAIT_OBJECT_0)
-                    {
-                        // Canceled from manager
-                        // Send the manager thread the canceled message
-                        PostMessage(pwtd->hwndManager, SRM_REGEX_CANCELED, GetCurrentThreadId(), 0);
-                        break;
-                    }
 
-                    CComPtr<IPowerRenameItem> spItem;
-                    winrt::check_hresult(pwtd->spsrm->GetItemByIndex(u, &spItem));
-
-                    int id = -1;
-                    winrt::check_hresult(spItem->GetId(&id));
-
-                    bool isFolder = false;
-                    bool isSubFolderContent = false;
-                    winrt::check_hresult(spItem->GetIsFolder(&isFolder));
-                    winrt::check_hresult(spItem->GetIsSubFolderContent(&isSubFolderContent));
-                    if ((isFolder && (flags & PowerRenameFlags::ExcludeFolders)) ||
-                        (!isFolder && (flags & PowerRenameFlags::ExcludeFiles)) ||
-                        (isSubFolderContent && (flags & PowerRenameFlags::ExcludeSubfolders)))
-                    {
-                        // Exclude this item from renaming.  Ensure new name is cleared.
-                        winrt::check_hresult(spItem->PutNewName(nullptr));
-
-                        // Send the manager thread the item processed message
-                        PostMessage(pwtd->hwndManager, SRM_REGEX_ITEM_UPDATED, GetCurrentThreadId(), id);
-
-                        continue;
-                    }
-
-                    PWSTR originalName = nullptr;
-                    winrt::check_hresult(spItem->GetOriginalName(&originalName));
-
-
-                    PWSTR currentNewName = nullptr;
-                    winrt::check_hresult(spItem->GetNewName(&currentNewName));
-
-                    wchar_t sourceName[MAX_PATH] = { 0 };
-                    if (flags & NameOnly)
-                    {
-                        StringCchCopy(sourceName, ARRAYSIZE(sourceName), fs::path(originalName).stem().c_str());
-                    }
-                    else if (flags & ExtensionOnly)
+                // Literal searches record which items contain the search term. When the new term
+                // contains the term of the previous pass (ex: one more character was typed) and
+                // nothing else that affects unmatched items changed, only the items that matched
+                // before and the items added since then are evaluated again.
+                PreviewMatchState& matchState = *pwtd->matchState;
+                const bool trackMatches = !(flags & (UseRegularExpressions | EnumerateItems));
+
+                // Items added by the enumeration after a completed pass are the only ones whose
+                // name is out of date if nothing else changed since. Enumeration numbers every
+                // item, so it still needs all of them.
+                const bool addedOnly = pwtd->addedItemsOnly &&
+                                       matchState.completed &&
+                                       !(flags & EnumerateItems) &&
+                                       matchState.flags == flags &&
+                                       matchState.itemCount <= itemCount &&
+                                       matchState.searchTerm == searchTermToUse &&
+                                       matchState.replaceTerm == replaceTermToUse;
+                const bool incremental = addedOnly ||
+                                         (trackMatches &&
+                                          matchState.valid &&
+                                          matchState.flags == flags &&
+                                          matchState.itemCount <= itemCount &&
+                                          ContainsLiteral(searchTermToUse.c_str(), matchState.searchTerm.c_str(), (flags & CaseSensitive) != 0));
+
+                std::vector<UINT> itemsToEvaluate;
+                if (incremental)
+                {
+                    for (UINT u = 0; u < itemCount; u++)
                     {
-                        std::wstring extension = fs::path(originalName).extension().wstring();
-                        if (!extension.empty() && extension.front() == '.')
+                        if (u >= matchState.itemCount || (!addedOnly && matchState.matches[u]))
                         {
-                            extension = extension.erase(0, 1);
+                            itemsToEvaluate.push_back(u);
                         }
-                        StringCchCopy(sourceName, ARRAYSIZE(sourceName), extension.c_str());
-                    }
-                    else
-                    {
-                        StringCchCopy(sourceName, ARRAYSIZE(sourceName), originalName);
                     }
+                    matchState.matches.resize(trackMatches ? itemCount : 0, 1);
+                }
+                else
+                {
+                    // Not evaluated yet, so every item may match. This keeps the state usable
+                    // by the next pass even if this one gets canceled.
+                    matchState.matches.assign(trackMatches ? itemCount : 0, 1);
+                }
 
-                    SYSTEMTIME fileTime = { 0 };
-
-                    if (useFileTime)
+                matchState.valid = trackMatches;
+                matchState.completed = false;
+                matchState.flags = flags;
+                matchState.searchTerm = searchTermToUse;
+                matchState.replaceTerm = replaceTermToUse;
+                matchState.itemCount = itemCount;
+                const CLiteralMatcher matcher(searchTermToUse, (flags & CaseSensitive) != 0);
+                const CCaseTransformer transformer(flags);
+                const size_t evaluateCount = incremental ? itemsToEvaluate.size() : itemCount;
+
+                const unsigned int workerCount = CWorkerPool::DefaultWorkerCount();
+                const bool enumerate = (flags & EnumerateItems) != 0;
+
+                auto isCanceled = [pwtd]() {
+                    return WaitForSingleObject(pwtd->cancelEvent, 0) == WAIT_OBJECT_0;
+                };
+
+                // Queue the item for the next UI update and wake the manager thread when the batch is due
+                auto itemUpdated = [pwtd, threadId](size_t index) {
+                    if (pwtd->updateBatch->Add(static_cast<UINT>(index)))
                     {
-                        winrt::check_hresult(spItem->GetTime(&fileTime));
-                        winrt::check_hresult(spRenameRegEx->PutFileTime(fileTime));
+                        PostMessage(pwtd->hwndManager, SRM_REGEX_ITEMS_UPDATED, threadId, 0);
                     }
-
-                    PWSTR newName = nullptr;
-
-                    // Failure here means we didn't match anything or had nothing to match
-                    // Call put_newName with null in that case to reset it
-                    winrt::check_hresult(spRenameRegEx->Replace(sourceName, &newName));
-
-                    if (useFileTime)
+                };
+
+                // Enumeration needs the final candidate of every item before it can assign
+                // the enumeration index, so keep them around in that case.
+                std::vector<PreviewCandidate> candidates(enumerate ? itemCount : 0);
+
+                // The items on screen are evaluated first, then the ones around them
+                CViewportScheduler evaluateScheduler(CWorkerPool::GetChunkCount(evaluateCount, c_previewChunkSize), *pwtd->viewportHint, [&](UINT itemIndex) {
+                    // Evaluation index of the first item to evaluate from itemIndex on
+                    const size_t k = incremental ? static_cast<size_t>(std::lower_bound(itemsToEvaluate.begin(), itemsToEvaluate.end(), itemIndex) - itemsToEvaluate.begin()) : itemIndex;
+                    return k / c_previewChunkSize;
+                });
+                auto claimEvaluateChunk = [&evaluateScheduler](size_t& chunk) {
+                    return evaluateScheduler.Claim(chunk);
+                };
+
+                bool completed = CWorkerPool::RunChunked(evaluateCount, c_previewChunkSize, workerCount, claimEvaluateChunk, [&](size_t begin, size_t end) {
+                    PreviewCandidate localCandidate;
+                    for (size_t k = begin; k < end; k++)
                     {
-                        winrt::check_hresult(spRenameRegEx->ResetFileTime());
-                    }
-
-                    wchar_t resultName[MAX_PATH] = { 0 };
+                        if (isCanceled())
+                        {
+                            return false;
+                        }
 
-                    PWSTR newNameToUse = nullptr;
+                        const size_t u = incremental ? itemsToEvaluate[k] : k;
+                        CComPtr<IPowerRenameItem> spItem;
+                        winrt::check_hresult(pwtd->spsrm->GetItemByIndex(static_cast<UINT>(u), &spItem));
 
-                    // newName == nullptr likely means we have an empty search string.  We should leave newNameToUse
-                    // as nullptr so we clear the renamed column
-                    // Except string transformation is selected.
+                        PreviewCandidate& candidate = enumerate ? candidates[u] : localCandidate;
+                        ComputePreviewCandidate(spItem, flags, spRenameRegEx, useFileTime, trackMatches ? &matcher : nullptr, transformer, candidate);
+                        if (candidate.excluded)
+                        {
+                            // Exclude this item from renaming.  Ensure new name is cleared.
+                            winrt::check_hresult(spItem->PutNewName(nullptr));
+                            itemUpdated(u);
+                        }
+                        else if (!enumerate && ApplyNewName(spItem, candidate.hasName ? candidate.name.c_str() : nullptr))
+                        {
+                            itemUpdated(u);
+                        }
 
-                    if (newName == nullptr && (flags & Uppercase || flags & Lowercase || flags & Titlecase || flags & Capitalized))
-                    {
-                        SHStrDup(sourceName, &newName);
+                        // Only once the new name is in place, so skipped items always have the name
+                        // they would get from this pass
+                        if (trackMatches)
+                        {
+                            matchState.matches[u] = (!candidate.excluded && candidate.matched) ? 1 : 0;
+                        }
                     }
+                    return true;
+                });
 
-                    if (newName != nullptr)
+                if (completed && enumerate)
+                {
+                    // Ordered prefix assignment: items are numbered in enumeration order no matter
+                    // which worker computed their candidate.
+                    std::vector<unsigned long> enumIndices(itemCount, 0);
+                    unsigned long itemEnumIndex = 0;
+                    for (UINT u = 0; u < itemCount; u++)
                     {
-                        newNameToUse = resultName;
-                        if (flags & NameOnly)
+                        if (candidates[u].hasName)
                         {
-                            StringCchPrintf(resultName, ARRAYSIZE(resultName), L"%s%s", newName, fs::path(originalName).extension().c_str());
+                            enumIndices[u] = itemEnumIndex++;
                         }
-                        else if (flags & ExtensionOnly)
+                    }
+
+                    CViewportScheduler applyScheduler(CWorkerPool::GetChunkCount(itemCount, c_previewChunkSize), *pwtd->viewportHint, [](UINT itemIndex) {
+                        return itemIndex / c_previewChunkSize;
+                    });
+                    auto claimApplyChunk = [&applyScheduler](size_t& chunk) {
+                        return applyScheduler.Claim(chunk);
+                    };
+
+                    completed = CWorkerPool::RunChunked(itemCount, c_previewChunkSize, workerCount, claimApplyChunk, [&](size_t begin, size_t end) {
+                        // Numbers start at 1, enumIndices from 0
+                        CEnumerationTemplate enumeration(1);
+                        for (size_t u = begin; u < end; u++)
                         {
-                            std::wstring extension = fs::path(originalName).extension().wstring();
-                            if (!extension.empty())
+                            if (isCanceled())
                             {
-                                StringCchPrintf(resultName, ARRAYSIZE(resultName), L"%s.%s", fs::path(originalName).stem().c_str(), newName);
+                                return false;
                             }
-                            else
+
+                            const PreviewCandidate& candidate = candidates[u];
+                            if (candidate.excluded)
                             {
-                                StringCchCopy(resultName, ARRAYSIZE(resultName), originalName);
+                                continue;
                             }
-                        }
-                        else
-                        {
-                            StringCchCopy(resultName, ARRAYSIZE(resultName), newName);
-                        }
-                    }
-
-                    wchar_t trimmedName[MAX_PATH] = { 0 };
-                    if (newNameToUse != nullptr)
-                    {
-                        winrt::check_hresult(GetTrimmedFileName(trimmedName, ARRAYSIZE(trimmedName), newNameToUse));
-                        newNameToUse = trimmedName;
-                    }
 
-                    wchar_t transformedName[MAX_PATH] = { 0 };
-                    if (newNameToUse != nullptr && (flags & Uppercase || flags & Lowercase || flags & Titlecase || flags & Capitalized))
-                    {
-                        winrt::check_hresult(GetTransformedFileName(transformedName, ARRAYSIZE(transformedName), newNameToUse, flags));
-                        newNameToUse = transformedName;
-                    }
+                            CComPtr<IPowerRenameItem> spItem;
+                            winrt::check_hresult(pwtd->spsrm->GetItemByIndex(static_cast<UINT>(u), &spItem));
 
-                    // No change from originalName so set newName to
-                    // null so we clear it from our UI as well.
-                    if (lstrcmp(originalName, newNameToUse) == 0)
-                    {
-                        newNameToUse = nullptr;
-                    }
+                            PCWSTR newNameToUse = nullptr;
+                            if (candidate.hasName)
+                            {
+                                newNameToUse = candidate.name.c_str();
+                                enumeration.Reset(candidate.name);
+                                const std::wstring_view uniqueName = enumeration.Format(enumIndices[u]);
+                                if (!uniqueName.empty())
+                                {
+                                    newNameToUse = uniqueName.data();
+                                }
+                            }
 
-                    wchar_t uniqueName[MAX_PATH] = { 0 };
-                    if (newNameToUse != nullptr && (flags & EnumerateItems))
-                    {
-                        unsigned long countUsed = 0;
-                        if (GetEnumeratedFileName(uniqueName, ARRAYSIZE(uniqueName), newNameToUse, nullptr, itemEnumIndex, &countUsed))
-                        {
-                            newNameToUse = uniqueName;
+                            if (ApplyNewName(spItem, newNameToUse))
+                            {
+                                itemUpdated(u);
+                            }
                         }
-                        itemEnumIndex++;
-                    }
+                        return true;
+                    });
+                }
 
-                    winrt::check_hresult(spItem->PutNewName(newNameToUse));
+                matchState.completed = completed;
 
-                    // Was there a change?
-                    if (lstrcmp(currentNewName, newNameToUse) != 0)
-                    {
-                        // Send the manager thread the item processed message
-                        PostMessage(pwtd->hwndManager, SRM_REGEX_ITEM_UPDATED, GetCurrentThreadId(), id);
-                    }
-                    CoTaskMemFree(newName);
-                    CoTaskMemFree(currentNewName);
-                    CoTaskMemFree(originalName);
+                if (!completed)
+                {
+                    // Canceled from manager
+                    // Send the manager thread the canceled message
+                    PostMessage(pwtd->hwndManager, SRM_REGEX_CANCELED, threadId, 0);
                 }
-                CoTaskMemFree(replaceTerm);
             }
 
             // Send the manager thread the completion message
-            PostMessage(pwtd->hwndManager, SRM_REGEX_COMPLETE, GetCurrentThreadId(), 0);
+            PostMessage(pwtd->hwndManager, SRM_REGEX_COMPLETE, threadId, 0);
 
             delete pwtd;
-            
         }
         CoUninitialize();
     }
@@ -1124,7 +1316,7 @@ void CPowerRenameManager::_OnItemAdded(_In_ IPowerRenameItem* renameItem)
     }
 }
 
-void CPowerRenameManager::_OnUpdate(_In_ IPowerRenameItem* renameItem)
+void CPowerRenameManager::_OnUpdate(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex)
 {
     CSRWSharedAutoLock lock(&m_lockEvents);
 
@@ -1132,9 +1324,119 @@ void CPowerRenameManager::_OnUpdate(_In_ IPowerRenameItem* renameItem)
     {
         if (it.pEvents)
         {
-            it.pEvents->OnUpdate(renameItem);
+            it.pEvents->OnUpdate(firstVisibleIndex, lastVisibleIndex);
+        }
+    }
+}
+
+void CPowerRenameManager::_PublishItemUpdates()
+{
+    std::vector<CItemRangeBatch::Range> ranges = m_updateBatch.Take();
+    if (ranges.empty())
+    {
+        return;
+    }
+
+    // Items updated after this batch only notify once the interval passed, flush them
+    // if the workers are done by then
+    if (m_hwndMessage)
+    {
+        SetTimer(m_hwndMessage, c_updateFlushTimerId, static_cast<UINT>(c_updateInterval.count()), nullptr);
+    }
+
+    // The whole batch is published as one notification covering its visible rows, so the
+    // UI updates its item count and status once per batch however scattered the items are
+    bool updated = false;
+    UINT updateFirst = 0;
+    UINT updateLast = 0;
+    {
+        CSRWExclusiveAutoLock lock(&m_lockItems);
+
+        // Refresh the visibility of the updated items first. Rows after the first item
+        // that was shown or hidden move, so everything from there on is redrawn.
+        size_t firstMovedItem = m_renameItems.size();
+        for (const auto& range : ranges)
+        {
+            for (size_t i = range.first; i <= range.last && i < m_renameItems.size(); i++)
+            {
+                if (m_visibility.SetVisible(i, _IsItemVisible(m_renameItems[i])))
+                {
+                    firstMovedItem = std::min<size_t>(firstMovedItem, i);
+                }
+            }
+        }
+
+        const UINT visibleCount = static_cast<UINT>(m_visibility.GetVisibleCount());
+        for (const auto& range : ranges)
+        {
+            if (range.first >= firstMovedItem)
+            {
+                break;
+            }
+
+            // Visible rows of the items in the range, if any of them is shown
+            UINT first = static_cast<UINT>(m_visibility.GetVisibleIndex(range.first));
+            UINT end = static_cast<UINT>(m_visibility.GetVisibleIndex(static_cast<size_t>(range.last) + 1));
+            if (first < end)
+            {
+                updateFirst = updated ? updateFirst : first;
+                updateLast = end - 1;
+                updated = true;
+            }
+        }
+
+        if (firstMovedItem < m_renameItems.size())
+        {
+            UINT first = static_cast<UINT>(m_visibility.GetVisibleIndex(firstMovedItem));
+            updateFirst = updated ? updateFirst : first;
+            updateLast = std::max<UINT>(first, visibleCount > 0 ? visibleCount - 1 : 0);
+            updated = true;
         }
     }
+
+    if (updated)
+    {
+        _OnUpdate(updateFirst, updateLast);
+    }
+}
+
+void CPowerRenameManager::_OnItemsAdded()
+{
+    m_itemsAddedNotified = false;
+
+    // Show the rows of the new items right away, the preview updates them once it gets to them
+    UINT first = 0;
+    UINT visibleCount = 0;
+    size_t itemCount = 0;
+    {
+        CSRWSharedAutoLock lock(&m_lockItems);
+        first = static_cast<UINT>(m_visibility.GetVisibleIndex(m_publishedItemCount));
+        visibleCount = static_cast<UINT>(m_visibility.GetVisibleCount());
+        itemCount = m_renameItems.size();
+        m_publishedItemCount = itemCount;
+    }
+
+    if (first < visibleCount)
+    {
+        _OnUpdate(first, visibleCount - 1);
+    }
+
+    // Nothing to preview yet, the last pass already saw the new items or the pending
+    // pass of a term edit covers them too
+    if (!m_previewStarted || itemCount <= m_previewItemCount || m_regExRenamePending)
+    {
+        return;
+    }
+
+    if (m_regExWorkerThreadHandle && WaitForSingleObject(m_regExWorkerThreadHandle, 0) != WAIT_OBJECT_0)
+    {
+        // Wait for the running pass to complete rather than restart it
+        m_addedItemsPreviewPending = true;
+    }
+    else
+    {
+        _PerformRegExRename(true);
+    }
 }
 
 void CPowerRenameManager::_OnError(_In_ IPowerRenameItem* renameItem)
@@ -1233,22 +1535,59 @@ void CPowerRenameManager::_ClearEventHandlers()
     m_powerRenameManagerEvents.clear();
 }
 
+void CPowerRenameManager::_RebuildVisibility()
+{
+    if (m_spRegEx)
+    {
+        PWSTR searchTerm = nullptr;
+        if (SUCCEEDED(m_spRegEx->GetSearchTerm(&searchTerm)))
+        {
+            m_isSearchTermEmpty = (searchTerm == nullptr || searchTerm[0] == L'\0');
+            CoTaskMemFree(searchTerm);
+        }
+    }
+
+    CSRWExclusiveAutoLock lock(&m_lockItems);
+    std::vector<bool> visible(m_renameItems.size(), true);
+    if (m_filter != PowerRenameFilters::None)
+    {
+        for (size_t i = 0; i < m_renameItems.size(); i++)
+        {
+            visible[i] = _IsItemVisible(m_renameItems[i]);
+        }
+    }
+
+    m_visibility.Assign(visible);
+}
+
+bool CPowerRenameManager::_IsItemVisible(_In_ IPowerRenameItem* renameItem)
+{
+    bool isVisible = true;
+    if (m_filter != PowerRenameFilters::ShouldRename || !m_isSearchTermEmpty)
+    {
+        renameItem->IsItemVisible(m_filter, m_flags, &isVisible);
+    }
+    return isVisible;
+}
+
 void CPowerRenameManager::_ClearPowerRenameItems()
 {
     CSRWExclusiveAutoLock lock(&m_lockItems);
 
     // Cleanup rename items
-    for (std::map<int, IPowerRenameItem*>::iterator it = m_renameItems.begin(); it != m_renameItems.end(); ++it)
+    for (auto& pItem : m_renameItems)
     {
-        IPowerRenameItem* pItem = it->second;
         if (pItem)
         {
             pItem->Release();
-            it->second = nullptr;
+            pItem = nullptr;
         }
     }
 
     m_renameItems.clear();
+    m_renameItemIndices.clear();
+    m_visibility.Clear();
+    m_publishedItemCount = 0;
 }
 
 void CPowerRenameManager::_Cleanup()
@@ -1,11 +1,37 @@
 #pragma once
+#include <atomic>
+#include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "srwlock.h"
+#include "VisibilityIndex.h"
+#include "ItemRangeBatch.h"
+#include "ViewportScheduler.h"
 
 #include <lib/PowerRenameManager.h>
 #include <lib/PowerRenameInterfaces.h>
 
+// Literal search results of the last preview pass. An item that did not contain the
+// search term cannot contain a longer term that includes it, and its new name does not
+// depend on the search term, so such items are skipped by the next pass.
+// The pass started for items added by the enumeration also skips the items known to the
+// last pass if it completed with the same terms.
+struct PreviewMatchState
+{
+    // False when the last pass did not track matches (ex: regular expressions)
+    bool valid = false;
+    // The last pass evaluated every item it had to
+    bool completed = false;
+    DWORD flags = 0;
+    std::wstring searchTerm;
+    std::wstring replaceTerm;
+    // Number of items known to the last pass
+    size_t itemCount = 0;
+    // 0 if the item does not contain searchTerm, 1 if it does or was not evaluated yet
+    std::vector<uint8_t> matches;
+};
+
 class CPowerRenameManager :
     public IPowerRenameManager,
     public IPowerRenameRegExEvents
@@ -30,7 +56,9 @@ public:
     IFACEMETHODIMP GetItemById(_In_ int id, _COM_Outptr_ IPowerRenameItem** ppItem);
     IFACEMETHODIMP GetItemCount(_Out_ UINT* count);
     IFACEMETHODIMP SetVisible();
+    IFACEMETHODIMP UpdateItemVisibility(_In_ int id);
     IFACEMETHODIMP GetVisibleItemCount(_Out_ UINT* count);
+    IFACEMETHODIMP PutViewport(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex);
     IFACEMETHODIMP GetSelectedItemCount(_Out_ UINT* count);
     IFACEMETHODIMP GetRenameItemCount(_Out_ UINT* count);
     IFACEMETHODIMP GetFlags(_Out_ DWORD* flags);
@@ -60,7 +88,8 @@ protected:
     void _Cancel();
 
     void _OnItemAdded(_In_ IPowerRenameItem* renameItem);
-    void _OnUpdate(_In_ IPowerRenameItem* renameItem);
+    void _OnItemsAdded();
+    void _OnUpdate(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex);
     void _OnError(_In_ IPowerRenameItem* renameItem);
     void _OnRegExStarted(_In_ DWORD threadId);
     void _OnRegExCanceled(_In_ DWORD threadId);
@@ -71,14 +100,20 @@ protected:
     void _ClearEventHandlers();
     void _ClearPowerRenameItems();
 
-    HRESULT _PerformRegExRename();
+    HRESULT _PerformRegExRename(bool addedItemsOnly = false);
+    void _SchedulePerformRegExRename();
+    void _CancelPendingRegExRename();
     HRESULT _PerformFileOperation();
 
-    HRESULT _CreateRegExWorkerThread();
+    HRESULT _CreateRegExWorkerThread(bool addedItemsOnly);
     void _CancelRegExWorkerThread();
     void _WaitForRegExWorkerThread();
     HRESULT _CreateFileOpWorkerThread();
 
+    void _RebuildVisibility();
+    void _PublishItemUpdates();
+    bool _IsItemVisible(_In_ IPowerRenameItem* renameItem);
+
     HRESULT _EnsureRegEx();
     HRESULT _InitRegEx();
     void _ClearRegEx();
@@ -120,11 +155,40 @@ protected:
     CComPtr<IPowerRenameRegEx> m_spRegEx;
 
     _Guarded_by_(m_lockEvents) std::vector<RENAME_MGR_EVENT> m_powerRenameManagerEvents;
-    _Guarded_by_(m_lockItems) std::map<int, IPowerRenameItem*> m_renameItems;
-    _Guarded_by_(m_lockItems) std::vector<bool> m_isVisible;
-
-    // Parent HWND used by IFileOperation
+    // Items in enumeration order, so index lookups are constant time
+    _Guarded_by_(m_lockItems) std::vector<IPowerRenameItem*> m_renameItems;
+    // Maps an item id to its index in m_renameItems
+    _Guarded_by_(m_lockItems) std::unordered_map<int, UINT> m_renameItemIndices;
+    // Items shown in the list view for m_filter
+    _Guarded_by_(m_lockItems) CVisibilityIndex m_visibility;
+    // With an empty search term every item is shown by the ShouldRename filter
+    bool m_isSearchTermEmpty = true;
+
+    // Only touched by the regex worker thread. Passes never overlap.
+    PreviewMatchState m_previewMatchState;
+    // A search or replace term edit is waiting for the debounce timer
+    bool m_regExRenamePending = false;
+    // A preview pass was started, so items added from now on need one as well
+    bool m_previewStarted = false;
+    // Number of items when the last pass started
+    size_t m_previewItemCount = 0;
+    // Items were added while a pass was running
+    bool m_addedItemsPreviewPending = false;
+    // SRM_ITEMS_ADDED is waiting to be handled
+    std::atomic<bool> m_itemsAddedNotified = false;
+    // Items the UI was told about through OnUpdate when they were added
+    size_t m_publishedItemCount = 0;
+
+    // Items updated by the preview workers that the UI was not told about yet
+    CItemRangeBatch m_updateBatch;
+    // Items on screen, evaluated first by the preview workers
+    CViewportHint m_viewportHint;
+
+    // Owner window of the rename operation, ex: for the elevation prompt
     HWND m_hwndParent = nullptr;
+    // Indexes of the items the last rename operation failed to rename, written by the file
+    // operation worker thread and read once it has exited
+    std::vector<UINT> m_renameFailures;
 
     HWND m_hwndMessage = nullptr;
 
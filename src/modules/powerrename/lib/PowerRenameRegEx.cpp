@@ -6,10 +6,42 @@
 #include <algorithm>
 #include <boost/regex.hpp>
 #include <helpers.h>
+#include "LinearRegex.h"
+#include "LiteralMatcher.h"
 
 using namespace std;
 using std::regex_error;
 
+struct CPowerRenameRegEx::CompiledSearch
+{
+    std::wstring searchTerm;
+    DWORD flags = 0;
+    bool useBoostLib = false;
+    bool useLinearRegex = false;
+    bool valid = false;
+    CLiteralMatcher literal;
+    // Used instead of stdPattern when the linear engine supports the pattern
+    CLinearRegex linearPattern;
+    std::wregex stdPattern;
+    boost::wregex boostPattern;
+};
+
+namespace
+{
+    // Only these flags change how the search pattern is compiled
+    const DWORD c_compileFlags = UseRegularExpressions | CaseSensitive;
+
+    // Rewrite $0 and $N in the replace term into the format regex_replace expects.
+    std::wstring PrepareReplaceTerm(const std::wstring& replaceTerm)
+    {
+        static const std::wregex zeroGroup(L"(([^\\$]|^)(\\$\\$)*)\\$[0]");
+        static const std::wregex numberedGroup(L"(([^\\$]|^)(\\$\\$)*)\\$([1-9])");
+
+        std::wstring result = regex_replace(replaceTerm, zeroGroup, L"$1$$$0");
+        return regex_replace(result, numberedGroup, L"$1$0$4");
+    }
+}
+
 IFACEMETHODIMP_(ULONG) CPowerRenameRegEx::AddRef()
 {
     return InterlockedIncrement(&m_refCount);
@@ -97,6 +129,10 @@ IFACEMETHODIMP CPowerRenameRegEx::PutSearchTerm(_In_ PCWSTR searchTerm)
             changed = true;
             CoTaskMemFree(m_searchTerm);
             hr = SHStrDup(searchTerm, &m_searchTerm);
+            if (SUCCEEDED(hr))
+            {
+                _UpdateCompiledSearch();
+            }
         }
     }
 
@@ -132,6 +168,10 @@ IFACEMETHODIMP CPowerRenameRegEx::PutReplaceTerm(_In_ PCWSTR replaceTerm)
             changed = true;
             CoTaskMemFree(m_replaceTerm);
             hr = SHStrDup(replaceTerm, &m_replaceTerm);
+            if (SUCCEEDED(hr))
+            {
+                _UpdatePreparedReplaceTerm();
+            }
         }
     }
 
@@ -153,7 +193,11 @@ IFACEMETHODIMP CPowerRenameRegEx::PutFlags(_In_ DWORD flags)
 {
     if (m_flags != flags)
     {
-        m_flags = flags;
+        {
+            CSRWExclusiveAutoLock lock(&m_lock);
+            m_flags = flags;
+            _UpdateCompiledSearch();
+        }
         _OnFlagsChanged();
     }
     return S_OK;
@@ -175,8 +219,11 @@ IFACEMETHODIMP CPowerRenameRegEx::PutFileTime(_In_ SYSTEMTIME fileTime)
 
     if (ft2.ul.QuadPart != ft1.ul.QuadPart)
     {
-        m_fileTime = fileTime;
-        m_useFileTime = true;
+        {
+            CSRWExclusiveAutoLock lock(&m_lock);
+            m_fileTime = fileTime;
+            m_useFileTime = true;
+        }
         _OnFileTimeChanged();
     }
     return S_OK;
@@ -184,9 +231,12 @@ IFACEMETHODIMP CPowerRenameRegEx::PutFileTime(_In_ SYSTEMTIME fileTime)
 
 IFACEMETHODIMP CPowerRenameRegEx::ResetFileTime()
 {
-    SYSTEMTIME ZERO = { 0 };
-    m_fileTime = ZERO;
-    m_useFileTime = false;
+    {
+        CSRWExclusiveAutoLock lock(&m_lock);
+        SYSTEMTIME ZERO = { 0 };
+        m_fileTime = ZERO;
+        m_useFileTime = false;
+    }
     _OnFileTimeChanged();
     return S_OK;
 }
@@ -206,13 +256,15 @@ HRESULT CPowerRenameRegEx::s_CreateInstance(_Outptr_ IPowerRenameRegEx** renameR
 }
 
 CPowerRenameRegEx::CPowerRenameRegEx() :
-    m_refCount(1)
+    m_refCount(1),
+    m_compiledSearch(std::make_unique<CompiledSearch>())
 {
     // Init to empty strings
     SHStrDup(L"", &m_searchTerm);
     SHStrDup(L"", &m_replaceTerm);
 
     _useBoostLib = CSettingsInstance().GetUseBoostLib();
+    _useLinearRegex = CSettingsInstance().GetUseLinearRegex();
 }
 
 CPowerRenameRegEx::~CPowerRenameRegEx()
@@ -223,9 +275,22 @@ CPowerRenameRegEx::~CPowerRenameRegEx()
 
 HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result)
 {
-    *result = nullptr;
+    CSRWSharedAutoLock lock(&m_lock);
+    return _Replace(source, m_useFileTime ? &m_fileTime : nullptr, result);
+}
 
+HRESULT CPowerRenameRegEx::ReplaceWithFileTime(_In_ PCWSTR source, SYSTEMTIME fileTime, _Outptr_ PWSTR* result)
+{
+    // The file time only applies to this call, so callers on several threads do not
+    // share it through PutFileTime
     CSRWSharedAutoLock lock(&m_lock);
+    return _Replace(source, &fileTime, result);
+}
+
+HRESULT CPowerRenameRegEx::_Replace(_In_ PCWSTR source, _In_opt_ const SYSTEMTIME* fileTime, _Outptr_ PWSTR* result)
+{
+    *result = nullptr;
+
     HRESULT hr = S_OK;
     if (!(m_searchTerm && wcslen(m_searchTerm) > 0 && source && wcslen(source) > 0))
     {
@@ -234,35 +299,43 @@ HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result)
     wstring res = source;
     try
     {
-        // TODO: creating the regex could be costly.  May want to cache this.
-        wchar_t newReplaceTerm[MAX_PATH] = { 0 };
-        bool fileTimeErrorOccurred = false;
-        if (m_useFileTime)
-        {
-            if (FAILED(GetDatedFileName(newReplaceTerm, ARRAYSIZE(newReplaceTerm), m_replaceTerm, m_fileTime)))
-                fileTimeErrorOccurred = true;
-        }
-
-        std::wstring sourceToUse(source);
-        std::wstring searchTerm(m_searchTerm);
-        std::wstring replaceTerm(L"");
-        if (m_useFileTime && !fileTimeErrorOccurred)
-        {
-            replaceTerm = wstring(newReplaceTerm);
-        }
-        else if (m_replaceTerm)
+        // The linear engine reads the replace term as typed, the other engines need it prepared
+        const bool useLinearRegex = (m_flags & UseRegularExpressions) && m_compiledSearch->linearPattern.IsValid();
+        PCWSTR rawReplaceTerm = m_replaceTerm ? m_replaceTerm : L"";
+        std::wstring datedReplaceTerm;
+        const std::wstring* replaceTermToUse = &m_preparedReplaceTerm;
+        if (fileTime && m_dateTemplate.UsesFileTime())
         {
-            replaceTerm = wstring(m_replaceTerm);
+            // Only the date fields depend on the file time, the rest of the term was prepared with the template
+            if (useLinearRegex)
+            {
+                m_dateTemplate.Format(*fileTime, datedReplaceTerm);
+                rawReplaceTerm = datedReplaceTerm.c_str();
+            }
+            else
+            {
+                m_preparedDateTemplate.Format(*fileTime, datedReplaceTerm);
+                replaceTermToUse = &datedReplaceTerm;
+            }
         }
-
-        replaceTerm = regex_replace(replaceTerm, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$[0]"), L"$1$$$0");
-        replaceTerm = regex_replace(replaceTerm, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$([1-9])"), L"$1$0$4");
+        const std::wstring& replaceTerm = *replaceTermToUse;
 
         if (m_flags & UseRegularExpressions)
         {
-            if (_useBoostLib)
+            if (!m_compiledSearch->valid)
             {
-                boost::wregex pattern(m_searchTerm, (!(m_flags & CaseSensitive)) ? boost::regex::icase | boost::regex::ECMAScript : boost::regex::ECMAScript);
+                // The search term could not be compiled
+                return E_FAIL;
+            }
+
+            if (useLinearRegex)
+            {
+                res.clear();
+                m_compiledSearch->linearPattern.Replace(source, rawReplaceTerm, (m_flags & MatchAllOccurences) != 0, res);
+            }
+            else if (m_compiledSearch->useBoostLib)
+            {
+                const boost::wregex& pattern = m_compiledSearch->boostPattern;
                 if (m_flags & MatchAllOccurences)
                 {
                     res = boost::regex_replace(wstring(source), pattern, replaceTerm);
@@ -274,7 +347,7 @@ HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result)
             }
             else
             {
-                std::wregex pattern(m_searchTerm, (!(m_flags & CaseSensitive)) ? regex_constants::icase | regex_constants::ECMAScript : regex_constants::ECMAScript);
+                const std::wregex& pattern = m_compiledSearch->stdPattern;
                 if (m_flags & MatchAllOccurences)
                 {
                     res = regex_replace(wstring(source), pattern, replaceTerm);
@@ -288,21 +361,8 @@ HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result)
         else
         {
             // Simple search and replace
-            size_t pos = 0;
-            do
-            {
-                pos = _Find(sourceToUse, searchTerm, (!(m_flags & CaseSensitive)), pos);
-                if (pos != std::string::npos)
-                {
-                    res = sourceToUse.replace(pos, searchTerm.length(), replaceTerm);
-                    pos += replaceTerm.length();
-                }
-
-                if (!(m_flags & MatchAllOccurences))
-                {
-                    break;
-                }
-            } while (pos != std::string::npos);
+            res.clear();
+            m_compiledSearch->literal.Replace(source, replaceTerm, (m_flags & MatchAllOccurences) != 0, res);
         }
 
         hr = SHStrDup(res.c_str(), result);
@@ -314,17 +374,78 @@ HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result)
     return hr;
 }
 
-size_t CPowerRenameRegEx::_Find(std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos)
+void CPowerRenameRegEx::_UpdateCompiledSearch()
 {
-    if (caseInsensitive)
+    const DWORD compileFlags = m_flags & c_compileFlags;
+    CompiledSearch& compiled = *m_compiledSearch;
+    if (compiled.searchTerm == m_searchTerm && compiled.flags == compileFlags && compiled.useBoostLib == _useBoostLib && compiled.useLinearRegex == _useLinearRegex)
     {
-        // Convert to lower
-        std::transform(data.begin(), data.end(), data.begin(), ::towlower);
-        std::transform(toSearch.begin(), toSearch.end(), toSearch.begin(), ::towlower);
+        return;
     }
 
-    // Find sub string position in given string starting at position pos
-    return data.find(toSearch, pos);
+    compiled.searchTerm = m_searchTerm;
+    compiled.flags = compileFlags;
+    compiled.useBoostLib = _useBoostLib;
+    compiled.useLinearRegex = _useLinearRegex;
+    compiled.valid = false;
+    compiled.literal.Reset(compiled.searchTerm, (compileFlags & CaseSensitive) != 0);
+    compiled.linearPattern.Reset();
+
+    // Literal searches do not need a compiled program
+    if (!(compileFlags & UseRegularExpressions) || compiled.searchTerm.empty())
+    {
+        return;
+    }
+
+    // The linear engine stands in for std::wregex. Boost keeps its own syntax and replace format.
+    // Patterns with backreferences, lookaround or empty loops fall back to std::wregex.
+    if (!_useBoostLib && _useLinearRegex && compiled.linearPattern.Compile(compiled.searchTerm, (compileFlags & CaseSensitive) != 0))
+    {
+        compiled.valid = true;
+        return;
+    }
+
+    try
+    {
+        if (_useBoostLib)
+        {
+            compiled.boostPattern.assign(compiled.searchTerm, (!(compileFlags & CaseSensitive)) ? boost::regex::icase | boost::regex::ECMAScript : boost::regex::ECMAScript);
+        }
+        else
+        {
+            compiled.stdPattern.assign(compiled.searchTerm, (!(compileFlags & CaseSensitive)) ? regex_constants::icase | regex_constants::ECMAScript : regex_constants::ECMAScript);
+        }
+        compiled.valid = true;
+    }
+    catch (regex_error)
+    {
+        // Expected while the user is still typing the expression. Replace reports the failure.
+    }
+    catch (boost::regex_error)
+    {
+    }
+}
+
+void CPowerRenameRegEx::_UpdatePreparedReplaceTerm()
+{
+    auto prepare = [](const std::wstring& replaceTerm) {
+        try
+        {
+            return PrepareReplaceTerm(replaceTerm);
+        }
+        catch (regex_error)
+        {
+            return replaceTerm;
+        }
+    };
+
+    m_preparedReplaceTerm = prepare(m_replaceTerm ? m_replaceTerm : L"");
+
+    // Date fields never contain '$', so preparing the text around them once gives the
+    // same term as preparing the dated term of every item
+    m_dateTemplate = CDateTemplate(m_replaceTerm ? m_replaceTerm : L"");
+    m_preparedDateTemplate = m_dateTemplate;
+    m_preparedDateTemplate.TransformLiterals(prepare);
 }
 
 void CPowerRenameRegEx::_OnSearchTermChanged()
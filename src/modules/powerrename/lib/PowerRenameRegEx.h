@@ -2,7 +2,9 @@
 #include "pch.h"
 #include <vector>
 #include <string>
+#include <memory>
 #include "srwlock.h"
+#include "DateTemplate.h"
 
 #include "PowerRenameInterfaces.h"
 
@@ -28,6 +30,7 @@ public:
     IFACEMETHODIMP PutFileTime(_In_ SYSTEMTIME fileTime);
     IFACEMETHODIMP ResetFileTime();
     IFACEMETHODIMP Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result);
+    IFACEMETHODIMP ReplaceWithFileTime(_In_ PCWSTR source, SYSTEMTIME fileTime, _Outptr_ PWSTR* result);
 
     static HRESULT s_CreateInstance(_Outptr_ IPowerRenameRegEx **renameRegEx);
 
@@ -40,9 +43,30 @@ protected:
     void _OnFlagsChanged();
     void _OnFileTimeChanged();
 
-    size_t _Find(std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos);
+    // Rebuild the cached search program / replace template if the inputs they were built from changed.
+    // Must be called with m_lock held exclusively.
+    void _UpdateCompiledSearch();
+    void _UpdatePreparedReplaceTerm();
+
+    // fileTime fills in the date fields of the replace term, nullptr leaves them as typed.
+    // Must be called with m_lock held.
+    HRESULT _Replace(_In_ PCWSTR source, _In_opt_ const SYSTEMTIME* fileTime, _Outptr_ PWSTR* result);
+
+    // Compiled search program, keyed by the search term, the flags that affect compilation and the engines.
+    // Built by the writers and only read by Replace, so concurrent callers never compile a pattern.
+    struct CompiledSearch;
+    std::unique_ptr<CompiledSearch> m_compiledSearch;
+
+    // Replace term with $0/$N already rewritten into the format expected by regex_replace.
+    std::wstring m_preparedReplaceTerm;
+
+    // Replace term compiled into literal runs and date fields, as typed for the linear engine
+    // and prepared like m_preparedReplaceTerm for the other ones.
+    CDateTemplate m_dateTemplate;
+    CDateTemplate m_preparedDateTemplate;
 
     bool _useBoostLib = false;
+    bool _useLinearRegex = false;
     DWORD m_flags = DEFAULT_FLAGS;
     PWSTR m_searchTerm = nullptr;
     PWSTR m_replaceTerm = nullptr;
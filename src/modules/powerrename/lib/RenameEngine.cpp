@@ -0,0 +1,378 @@
+#include "pch.h"
+#include "RenameEngine.h"
+#include "EnumerationTemplate.h"
+#include "Helpers.h"
+#include "PowerRenameRegEx.h"
+#include "WorkerPool.h"
+#include <winrt/base.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Number of items a preview worker claims at a time
+    const size_t c_previewChunkSize = 256;
+}
+
+bool IsExcludedItem(bool isFolder, bool isSubFolderContent, DWORD flags)
+{
+    return (isFolder && (flags & PowerRenameFlags::ExcludeFolders)) ||
+           (!isFolder && (flags & PowerRenameFlags::ExcludeFiles)) ||
+           (isSubFolderContent && (flags & PowerRenameFlags::ExcludeSubfolders));
+}
+
+std::wstring GetRenameSource(_In_ PCWSTR originalName, DWORD flags)
+{
+    wchar_t sourceName[MAX_PATH] = { 0 };
+    if (flags & NameOnly)
+    {
+        StringCchCopy(sourceName, ARRAYSIZE(sourceName), fs::path(originalName).stem().c_str());
+    }
+    else if (flags & ExtensionOnly)
+    {
+        std::wstring extension = fs::path(originalName).extension().wstring();
+        if (!extension.empty() && extension.front() == '.')
+        {
+            extension = extension.erase(0, 1);
+        }
+        StringCchCopy(sourceName, ARRAYSIZE(sourceName), extension.c_str());
+    }
+    else
+    {
+        StringCchCopy(sourceName, ARRAYSIZE(sourceName), originalName);
+    }
+
+    return sourceName;
+}
+
+bool ComputeNewName(_In_ PCWSTR originalName, _In_ PCWSTR sourceName, DWORD flags, _In_ IPowerRenameRegEx* renameRegEx, _In_opt_ const SYSTEMTIME* fileTime, const CCaseTransformer& transformer, std::wstring& newName)
+{
+    newName.clear();
+    PWSTR replacedName = nullptr;
+
+    // Failure here means we didn't match anything or had nothing to match
+    if (fileTime)
+    {
+        // The file time is passed with the call instead of being set on the shared regex object
+        winrt::check_hresult(renameRegEx->ReplaceWithFileTime(sourceName, *fileTime, &replacedName));
+    }
+    else
+    {
+        winrt::check_hresult(renameRegEx->Replace(sourceName, &replacedName));
+    }
+
+    wchar_t resultName[MAX_PATH] = { 0 };
+
+    PWSTR newNameToUse = nullptr;
+
+    // replacedName == nullptr likely means we have an empty search string.  We should leave newNameToUse
+    // as nullptr so we clear the renamed column
+    // Except string transformation is selected.
+
+    if (replacedName == nullptr && transformer.IsEnabled())
+    {
+        SHStrDup(sourceName, &replacedName);
+    }
+
+    if (replacedName != nullptr)
+    {
+        newNameToUse = resultName;
+        if (flags & NameOnly)
+        {
+            StringCchPrintf(resultName, ARRAYSIZE(resultName), L"%s%s", replacedName, fs::path(originalName).extension().c_str());
+        }
+        else if (flags & ExtensionOnly)
+        {
+            std::wstring extension = fs::path(originalName).extension().wstring();
+            if (!extension.empty())
+            {
+                StringCchPrintf(resultName, ARRAYSIZE(resultName), L"%s.%s", fs::path(originalName).stem().c_str(), replacedName);
+            }
+            else
+            {
+                StringCchCopy(resultName, ARRAYSIZE(resultName), originalName);
+            }
+        }
+        else
+        {
+            StringCchCopy(resultName, ARRAYSIZE(resultName), replacedName);
+        }
+    }
+
+    CoTaskMemFree(replacedName);
+
+    wchar_t trimmedName[MAX_PATH] = { 0 };
+    if (newNameToUse != nullptr)
+    {
+        winrt::check_hresult(GetTrimmedFileName(trimmedName, ARRAYSIZE(trimmedName), newNameToUse));
+        newNameToUse = trimmedName;
+    }
+
+    wchar_t transformedName[MAX_PATH] = { 0 };
+    if (newNameToUse != nullptr && transformer.IsEnabled())
+    {
+        winrt::check_hresult(transformer.Transform(transformedName, ARRAYSIZE(transformedName), newNameToUse));
+        newNameToUse = transformedName;
+    }
+
+    // No change from originalName so leave the new name empty
+    if (newNameToUse == nullptr || lstrcmp(originalName, newNameToUse) == 0)
+    {
+        return false;
+    }
+
+    newName = newNameToUse;
+    return true;
+}
+
+HRESULT CRenameEngine::Init(const RenameRule& rule)
+{
+    m_rule = rule;
+    m_renameRegEx = nullptr;
+    m_pipeline = nullptr;
+    HRESULT hr = CPowerRenameRegEx::s_CreateInstance(&m_renameRegEx);
+    if (SUCCEEDED(hr))
+    {
+        hr = m_renameRegEx->PutFlags(rule.flags);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = m_renameRegEx->PutSearchTerm(rule.searchTerm.c_str());
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = m_renameRegEx->PutReplaceTerm(rule.replaceTerm.c_str());
+    }
+    return hr;
+}
+
+HRESULT CRenameEngine::InitPipeline(const std::vector<RenameStep>& steps, DWORD excludeFlags)
+{
+    m_rule = RenameRule();
+    m_rule.flags = excludeFlags & (ExcludeFiles | ExcludeFolders | ExcludeSubfolders);
+    m_renameRegEx = nullptr;
+    m_pipeline = std::make_unique<CRenamePipeline>();
+    const HRESULT hr = m_pipeline->Compile(steps);
+    if (FAILED(hr))
+    {
+        m_pipeline = nullptr;
+    }
+    return hr;
+}
+
+HRESULT CRenameEngine::s_ListTree(const fs::path& root, CFileMetadataProvider& provider, std::vector<RenameEngineItem>& items)
+{
+    auto listFolder = [&provider](const fs::path& folder, UINT depth, std::vector<RenameEngineItem>& entries) {
+        return provider.ListFolder(folder.c_str(), [&](PCWSTR name, const FileMetadata& metadata) {
+            RenameEngineItem entry;
+            entry.path = folder / name;
+            entry.isFolder = (metadata.attributes & FILE_ATTRIBUTE_DIRECTORY) && !(metadata.attributes & FILE_ATTRIBUTE_REPARSE_POINT);
+            entry.depth = depth;
+            FileTimeToLocalSystemTime(metadata.creationTime, &entry.time);
+            entries.push_back(std::move(entry));
+        });
+    };
+
+    struct OpenFolder
+    {
+        std::vector<RenameEngineItem> entries;
+        size_t next = 0;
+    };
+
+    // Listed folders whose entries are not all added yet, innermost last
+    std::vector<OpenFolder> folders(1);
+    HRESULT hr = listFolder(root, 0, folders.back().entries);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    HRESULT result = S_OK;
+    while (!folders.empty())
+    {
+        OpenFolder& folder = folders.back();
+        if (folder.next == folder.entries.size())
+        {
+            folders.pop_back();
+            continue;
+        }
+
+        items.push_back(std::move(folder.entries[folder.next++]));
+        const RenameEngineItem& item = items.back();
+        if (item.isFolder)
+        {
+            OpenFolder subfolder;
+            if (FAILED(listFolder(item.path, item.depth + 1, subfolder.entries)))
+            {
+                // The entries listed before the failure are kept
+                result = S_FALSE;
+            }
+            folders.push_back(std::move(subfolder));
+        }
+    }
+
+    return result;
+}
+
+HRESULT CRenameEngine::Preview(std::vector<RenameEngineItem>& items, unsigned int workerCount) const
+{
+    if (m_pipeline)
+    {
+        return _PreviewPipeline(items, workerCount);
+    }
+
+    if (!m_renameRegEx)
+    {
+        return E_UNEXPECTED;
+    }
+
+    try
+    {
+        const DWORD flags = m_rule.flags;
+        const bool useFileTime = isFileTimeUsed(m_rule.replaceTerm.c_str());
+        const CCaseTransformer transformer(flags);
+
+        CWorkerPool::RunChunked(items.size(), c_previewChunkSize, workerCount, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                RenameEngineItem& item = items[i];
+                item.newName.clear();
+                if (IsExcludedItem(item.isFolder, item.depth > 0, flags))
+                {
+                    continue;
+                }
+
+                const std::wstring originalName = item.path.filename().wstring();
+                const std::wstring sourceName = GetRenameSource(originalName.c_str(), flags);
+                ComputeNewName(originalName.c_str(), sourceName.c_str(), flags, m_renameRegEx, useFileTime ? &item.time : nullptr, transformer, item.newName);
+            }
+            return true;
+        });
+
+        if (flags & EnumerateItems)
+        {
+            // Items are numbered in listing order, like in the dialog
+            CEnumerationTemplate enumeration(m_rule.enumerateStart, m_rule.enumeratePadding);
+            unsigned long itemEnumIndex = 0;
+            for (RenameEngineItem& item : items)
+            {
+                if (item.newName.empty())
+                {
+                    continue;
+                }
+
+                enumeration.Reset(item.newName);
+                const std::wstring_view uniqueName = enumeration.Format(itemEnumIndex++);
+                if (!uniqueName.empty())
+                {
+                    item.newName = uniqueName;
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        return winrt::to_hresult();
+    }
+
+    return S_OK;
+}
+
+HRESULT CRenameEngine::_PreviewPipeline(std::vector<RenameEngineItem>& items, unsigned int workerCount) const
+{
+    try
+    {
+        const DWORD flags = m_rule.flags;
+        if (!m_pipeline->Enumerates())
+        {
+            CWorkerPool::RunChunked(items.size(), c_previewChunkSize, workerCount, [&](size_t begin, size_t end) {
+                CRenamePipeline::Scratch scratch;
+                for (size_t i = begin; i < end; i++)
+                {
+                    RenameEngineItem& item = items[i];
+                    item.newName.clear();
+                    if (!IsExcludedItem(item.isFolder, item.depth > 0, flags))
+                    {
+                        m_pipeline->Apply(item.path.filename().wstring(), item.time, 0, scratch, item.newName);
+                    }
+                }
+                return true;
+            });
+            return S_OK;
+        }
+
+        // Enumerate steps number the items the steps before them rename, in listing order like
+        // the dialog. The names up to the first Enumerate step are kept in newName until the
+        // ordinals are known.
+        // Not a std::vector<bool>, the workers write to it concurrently
+        std::vector<unsigned char> renamed(items.size(), 0);
+        CWorkerPool::RunChunked(items.size(), c_previewChunkSize, workerCount, [&](size_t begin, size_t end) {
+            CRenamePipeline::Scratch scratch;
+            for (size_t i = begin; i < end; i++)
+            {
+                RenameEngineItem& item = items[i];
+                item.newName.clear();
+                if (!IsExcludedItem(item.isFolder, item.depth > 0, flags))
+                {
+                    renamed[i] = m_pipeline->ApplyBeforeEnumerate(item.path.filename().wstring(), item.time, scratch, item.newName);
+                }
+            }
+            return true;
+        });
+
+        std::vector<unsigned long> ordinals(items.size(), 0);
+        unsigned long ordinal = 0;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            ordinals[i] = ordinal;
+            ordinal += renamed[i] ? 1 : 0;
+        }
+
+        CWorkerPool::RunChunked(items.size(), c_previewChunkSize, workerCount, [&](size_t begin, size_t end) {
+            CRenamePipeline::Scratch scratch;
+            std::wstring name;
+            for (size_t i = begin; i < end; i++)
+            {
+                RenameEngineItem& item = items[i];
+                if (!IsExcludedItem(item.isFolder, item.depth > 0, flags))
+                {
+                    name.swap(item.newName);
+                    m_pipeline->ApplyFromEnumerate(item.path.filename().wstring(), name, item.time, ordinals[i], scratch, item.newName);
+                }
+            }
+            return true;
+        });
+    }
+    catch (...)
+    {
+        return winrt::to_hresult();
+    }
+
+    return S_OK;
+}
+
+HRESULT CRenameEngine::Commit(const std::vector<RenameEngineItem>& items, CRenameFileSystem& fileSystem, CRenameJournal& journal, unsigned int workerCount, std::vector<HRESULT>& results) const
+{
+    std::vector<RenameRequest> requests;
+    std::vector<size_t> requestItems;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (!items[i].newName.empty())
+        {
+            requests.push_back({ items[i].path, items[i].newName });
+            requestItems.push_back(i);
+        }
+    }
+
+    std::vector<HRESULT> requestResults;
+    CRenameExecutor executor(fileSystem, journal, workerCount);
+    const HRESULT hr = executor.Execute(requests, requestResults);
+
+    results.assign(items.size(), S_FALSE);
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        results[requestItems[i]] = requestResults[i];
+    }
+
+    return hr;
+}
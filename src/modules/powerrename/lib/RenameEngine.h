@@ -0,0 +1,79 @@
+#pragma once
+#include "pch.h"
+#include "PowerRenameInterfaces.h"
+#include "CaseTransformer.h"
+#include "MetadataPrefetcher.h"
+#include "RenamePipeline.h"
+#include "RenameExecutor.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Search term, replace term and flags of a rename, as set in the dialog
+struct RenameRule
+{
+    std::wstring searchTerm;
+    std::wstring replaceTerm;
+    DWORD flags = MatchAllOccurences;
+    // First number and zero padding of EnumerateItems
+    unsigned long enumerateStart = 1;
+    unsigned int enumeratePadding = 0;
+};
+
+struct RenameEngineItem
+{
+    std::filesystem::path path;
+    bool isFolder = false;
+    // 0 for the entries of the root folder
+    UINT depth = 0;
+    // Local creation time, for the file time fields of the replace term
+    SYSTEMTIME time = {};
+    // Empty if the item keeps its name
+    std::wstring newName;
+};
+
+// The item is filtered out by ExcludeFiles, ExcludeFolders or ExcludeSubfolders
+bool IsExcludedItem(bool isFolder, bool isSubFolderContent, DWORD flags);
+
+// Part of the original name the search applies to, depending on NameOnly and ExtensionOnly
+std::wstring GetRenameSource(_In_ PCWSTR originalName, DWORD flags);
+
+// New name of an item before enumeration, the same for the preview of the dialog and the
+// engine. sourceName comes from GetRenameSource and fileTime is only needed when the replace
+// term has file time fields. Returns false if the item keeps its name.
+// Throws winrt::hresult_error if the regex object fails.
+bool ComputeNewName(_In_ PCWSTR originalName, _In_ PCWSTR sourceName, DWORD flags, _In_ IPowerRenameRegEx* renameRegEx, _In_opt_ const SYSTEMTIME* fileTime, const CCaseTransformer& transformer, std::wstring& newName);
+
+// Headless entry point of the rename logic: lists a folder tree, computes the new names with
+// the rules of the preview and renames the items, without the shell extension, the dialog or a
+// message loop. powerrename-cli is built on it.
+class CRenameEngine
+{
+public:
+    HRESULT Init(const RenameRule& rule);
+
+    // Computes the new names with several steps in one pass instead of a single rule. The
+    // items excluded by the ExcludeFiles, ExcludeFolders and ExcludeSubfolders flags keep their
+    // name. Enumerate steps only count the items the steps before them rename.
+    HRESULT InitPipeline(const std::vector<RenameStep>& steps, DWORD excludeFlags);
+
+    // Appends every entry below root to items, root excluded. A folder is directly followed by
+    // its content, like in the dialog. Links are not followed. Returns S_FALSE if a folder of
+    // the tree could not be listed, its content is skipped.
+    static HRESULT s_ListTree(const std::filesystem::path& root, CFileMetadataProvider& provider, std::vector<RenameEngineItem>& items);
+
+    // Sets the new name of every item, on up to workerCount threads
+    HRESULT Preview(std::vector<RenameEngineItem>& items, unsigned int workerCount) const;
+
+    // Renames the items that have a new name. results has one code per item, S_FALSE for the
+    // items without a new name, see CRenameExecutor::Execute for the others.
+    HRESULT Commit(const std::vector<RenameEngineItem>& items, CRenameFileSystem& fileSystem, CRenameJournal& journal, unsigned int workerCount, std::vector<HRESULT>& results) const;
+
+private:
+    HRESULT _PreviewPipeline(std::vector<RenameEngineItem>& items, unsigned int workerCount) const;
+
+    RenameRule m_rule;
+    CComPtr<IPowerRenameRegEx> m_renameRegEx;
+    // Set by InitPipeline, used instead of m_renameRegEx
+    std::unique_ptr<CRenamePipeline> m_pipeline;
+};
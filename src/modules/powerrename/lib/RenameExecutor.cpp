@@ -0,0 +1,656 @@
+#include "pch.h"
+#include "RenameExecutor.h"
+#include "WorkerPool.h"
+#include <iterator>
+#include <sherrors.h>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Appended to the name of the item that breaks a cycle, followed by a number
+    const wchar_t c_temporarySuffix[] = L".~rename";
+
+    // File names are compared without case, like the file system does
+    std::wstring GetKey(const std::wstring& value)
+    {
+        std::wstring key(value);
+        if (!key.empty())
+        {
+            CharUpperBuffW(key.data(), static_cast<DWORD>(key.size()));
+        }
+        return key;
+    }
+
+    std::string ToUtf8(const fs::path& path)
+    {
+        const std::u8string value = path.u8string();
+        return std::string(reinterpret_cast<const char*>(value.data()), value.size());
+    }
+
+    fs::path FromUtf8(const std::string& value)
+    {
+        return fs::path(std::u8string(reinterpret_cast<const char8_t*>(value.data()), value.size()));
+    }
+
+    // The flags Explorer renames with
+    const DWORD c_shellRenameFlags = FOF_ALLOWUNDO | FOFX_ADDUNDORECORD | FOFX_SHOWELEVATIONPROMPT | FOF_RENAMEONCOLLISION;
+
+    // Receives the result of the rename of one item of an IFileOperation
+    class CRenameItemProgressSink :
+        public IFileOperationProgressSink
+    {
+    public:
+        explicit CRenameItemProgressSink(HRESULT& result) :
+            m_result(result)
+        {
+        }
+
+        // IUnknown
+        IFACEMETHODIMP QueryInterface(__in REFIID riid, __deref_out void** ppv)
+        {
+            static const QITAB qit[] = {
+                QITABENT(CRenameItemProgressSink, IFileOperationProgressSink),
+                { 0 }
+            };
+            return QISearch(this, qit, riid, ppv);
+        }
+
+        IFACEMETHODIMP_(ULONG) AddRef()
+        {
+            return InterlockedIncrement(&m_refCount);
+        }
+
+        IFACEMETHODIMP_(ULONG) Release()
+        {
+            long refCount = InterlockedDecrement(&m_refCount);
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+        // IFileOperationProgressSink
+        IFACEMETHODIMP PostRenameItem(DWORD, IShellItem*, PCWSTR, HRESULT hrRename, IShellItem*)
+        {
+            // A success code such as COPYENGINE_S_COLLISIONRESOLVED still means the item was renamed
+            m_result = (hrRename == COPYENGINE_S_USER_IGNORED) ? HRESULT_FROM_WIN32(ERROR_CANCELLED) : hrRename;
+            return S_OK;
+        }
+
+        IFACEMETHODIMP StartOperations() { return S_OK; }
+        IFACEMETHODIMP FinishOperations(HRESULT) { return S_OK; }
+        IFACEMETHODIMP PreRenameItem(DWORD, IShellItem*, PCWSTR) { return S_OK; }
+        IFACEMETHODIMP PreMoveItem(DWORD, IShellItem*, IShellItem*, PCWSTR) { return S_OK; }
+        IFACEMETHODIMP PostMoveItem(DWORD, IShellItem*, IShellItem*, PCWSTR, HRESULT, IShellItem*) { return S_OK; }
+        IFACEMETHODIMP PreCopyItem(DWORD, IShellItem*, IShellItem*, PCWSTR) { return S_OK; }
+        IFACEMETHODIMP PostCopyItem(DWORD, IShellItem*, IShellItem*, PCWSTR, HRESULT, IShellItem*) { return S_OK; }
+        IFACEMETHODIMP PreDeleteItem(DWORD, IShellItem*) { return S_OK; }
+        IFACEMETHODIMP PostDeleteItem(DWORD, IShellItem*, HRESULT, IShellItem*) { return S_OK; }
+        IFACEMETHODIMP PreNewItem(DWORD, IShellItem*, PCWSTR) { return S_OK; }
+        IFACEMETHODIMP PostNewItem(DWORD, IShellItem*, PCWSTR, PCWSTR, DWORD, HRESULT, IShellItem*) { return S_OK; }
+        IFACEMETHODIMP UpdateProgress(UINT, UINT) { return S_OK; }
+        IFACEMETHODIMP ResetTimer() { return S_OK; }
+        IFACEMETHODIMP PauseTimer() { return S_OK; }
+        IFACEMETHODIMP ResumeTimer() { return S_OK; }
+
+    private:
+        long m_refCount = 1;
+        HRESULT& m_result;
+    };
+}
+
+HRESULT CWin32RenameFileSystem::Rename(const fs::path& source, const fs::path& target)
+{
+    // Without MOVEFILE_REPLACE_EXISTING an existing target fails the move instead of being replaced
+    if (!MoveFileExW(source.c_str(), target.c_str(), 0))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    const DWORD attributes = GetFileAttributesW(target.c_str());
+    const bool isFolder = attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+    SHChangeNotify(isFolder ? SHCNE_RENAMEFOLDER : SHCNE_RENAMEITEM, SHCNF_PATH, source.c_str(), target.c_str());
+    return S_OK;
+}
+
+bool CWin32RenameFileSystem::Exists(const fs::path& path)
+{
+    return GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+HRESULT CStdRenameFileSystem::Rename(const fs::path& source, const fs::path& target)
+{
+    // rename replaces an existing file on some systems
+    std::error_code error;
+    if (fs::exists(target, error) && !fs::equivalent(source, target, error))
+    {
+        return HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+    }
+
+    fs::rename(source, target, error);
+    return error ? HRESULT_FROM_WIN32(error.value()) : S_OK;
+}
+
+bool CStdRenameFileSystem::Exists(const fs::path& path)
+{
+    std::error_code error;
+    return fs::exists(path, error);
+}
+
+HRESULT CShellRenameOperation::Perform(const std::vector<RenameMove>& moves, std::vector<HRESULT>& results)
+{
+    // Items that do not reach PostRenameItem were not renamed, ex: the user canceled the operation
+    results.assign(moves.size(), E_ABORT);
+
+    CComPtr<IFileOperation> spFileOp;
+    HRESULT hr = CoCreateInstance(CLSID_FileOperation, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&spFileOp));
+    if (SUCCEEDED(hr))
+    {
+        hr = spFileOp->SetOperationFlags(c_shellRenameFlags);
+    }
+
+    if (SUCCEEDED(hr) && m_hwndOwner)
+    {
+        hr = spFileOp->SetOwnerWindow(m_hwndOwner);
+    }
+
+    if (FAILED(hr))
+    {
+        results.assign(moves.size(), hr);
+        return hr;
+    }
+
+    // results is not resized from here on, the sinks write to its elements
+    bool queued = false;
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        CComPtr<IShellItem> spShellItem;
+        HRESULT hrItem = SHCreateItemFromParsingName(moves[i].source.c_str(), nullptr, IID_PPV_ARGS(&spShellItem));
+        if (SUCCEEDED(hrItem))
+        {
+            CComPtr<IFileOperationProgressSink> spSink;
+            spSink.Attach(new CRenameItemProgressSink(results[i]));
+            hrItem = spFileOp->RenameItem(spShellItem, moves[i].target.filename().c_str(), spSink);
+        }
+
+        if (FAILED(hrItem))
+        {
+            results[i] = hrItem;
+        }
+        else
+        {
+            queued = true;
+        }
+    }
+
+    return queued ? spFileOp->PerformOperations() : S_OK;
+}
+
+HRESULT CRenameJournal::Open(const fs::path& path)
+{
+    std::scoped_lock lock(m_lock);
+    m_file.close();
+    m_file.clear();
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    return m_file.is_open() ? S_OK : E_FAIL;
+}
+
+void CRenameJournal::Add(const fs::path& source, const fs::path& target)
+{
+    std::scoped_lock lock(m_lock);
+    m_entries.push_back({ source, target });
+    if (m_file.is_open())
+    {
+        // Control characters are not allowed in file names, so they can separate the paths
+        m_file << ToUtf8(source) << '\t' << ToUtf8(target) << '\n';
+        m_file.flush();
+    }
+}
+
+std::vector<RenameJournalEntry> CRenameJournal::GetEntries() const
+{
+    std::scoped_lock lock(m_lock);
+    return m_entries;
+}
+
+HRESULT CRenameJournal::s_Read(const fs::path& path, std::vector<RenameJournalEntry>& entries)
+{
+    entries.clear();
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return E_FAIL;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const size_t separator = line.find('\t');
+        if (separator == std::string::npos)
+        {
+            // The last record of an interrupted write
+            return S_FALSE;
+        }
+
+        entries.push_back({ FromUtf8(line.substr(0, separator)), FromUtf8(line.substr(separator + 1)) });
+    }
+
+    return S_OK;
+}
+
+HRESULT CRenameJournal::s_Undo(const std::vector<RenameJournalEntry>& entries, CRenameFileSystem& fileSystem)
+{
+    HRESULT result = S_OK;
+    for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry)
+    {
+        const HRESULT hr = fileSystem.Rename(entry->target, entry->source);
+        if (FAILED(hr) && SUCCEEDED(result))
+        {
+            result = hr;
+        }
+    }
+
+    return result;
+}
+
+CRenameExecutor::CRenameExecutor(CRenameFileSystem& fileSystem, CRenameJournal& journal, unsigned int workerCount) :
+    m_fileSystem(fileSystem),
+    m_journal(journal),
+    m_workerCount(workerCount)
+{
+}
+
+CRenameExecutor::CRenameExecutor(CRenameFileSystem& fileSystem, CRenameOperation& operation, CRenameJournal& journal) :
+    m_fileSystem(fileSystem),
+    m_operation(&operation),
+    m_journal(journal),
+    m_workerCount(1)
+{
+}
+
+HRESULT CRenameExecutor::Execute(const std::vector<RenameRequest>& requests, std::vector<HRESULT>& results)
+{
+    results.assign(requests.size(), E_ABORT);
+
+    // Renames of each folder, keyed by the upper case path, with the depth of the folder
+    std::unordered_map<std::wstring, std::pair<size_t, std::vector<PendingMove>>> folders;
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        const fs::path& path = requests[i].path;
+        const std::wstring& newName = requests[i].newName;
+        const std::wstring oldName = path.filename().wstring();
+        if (oldName.empty() || newName.empty() || fs::path(newName).has_parent_path())
+        {
+            results[i] = E_INVALIDARG;
+            continue;
+        }
+
+        if (oldName == newName)
+        {
+            results[i] = S_FALSE;
+            continue;
+        }
+
+        PendingMove move;
+        move.request = i;
+        move.source = path;
+        move.target = path.parent_path() / newName;
+        move.sourceKey = GetKey(oldName);
+        move.targetKey = GetKey(newName);
+
+        auto& folder = folders[GetKey(path.parent_path().wstring())];
+        if (folder.second.empty())
+        {
+            folder.first = static_cast<size_t>(std::distance(path.begin(), path.end()));
+        }
+        folder.second.push_back(std::move(move));
+    }
+
+    Levels levels;
+    for (auto& [folderKey, folder] : folders)
+    {
+        _CheckCollisions(folder.second, results);
+        _PlanFolder(folder.second, levels[folder.first]);
+    }
+
+    if (m_operation)
+    {
+        _PerformLevels(levels, results);
+    }
+    else
+    {
+        // The items of a folder are renamed before the folder, which is one level up. Chains of
+        // the same level do not share any name and run concurrently.
+        for (auto& [depth, chains] : levels)
+        {
+            CWorkerPool::RunChunked(chains.size(), 1, m_workerCount, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    _RunChain(chains[i], results);
+                }
+                return true;
+            });
+        }
+    }
+
+    for (const HRESULT result : results)
+    {
+        if (FAILED(result))
+        {
+            return result;
+        }
+    }
+
+    return S_OK;
+}
+
+void CRenameExecutor::_CheckCollisions(std::vector<PendingMove>& moves, std::vector<HRESULT>& results)
+{
+    auto drop = [&results](PendingMove& move) {
+        move.active = false;
+        results[move.request] = HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+    };
+
+    // The first request for a name keeps it
+    std::unordered_set<std::wstring> targetKeys;
+    for (PendingMove& move : moves)
+    {
+        if (!targetKeys.insert(move.targetKey).second)
+        {
+            drop(move);
+        }
+    }
+
+    // A target is free if no entry has its name or the entry that has it is renamed too.
+    // A dropped rename keeps its name, which can take the target of another one, so the
+    // check runs again until nothing else is dropped.
+    bool dropped = true;
+    while (dropped)
+    {
+        dropped = false;
+        std::unordered_set<std::wstring> sourceKeys;
+        for (const PendingMove& move : moves)
+        {
+            if (move.active)
+            {
+                sourceKeys.insert(move.sourceKey);
+            }
+        }
+
+        for (PendingMove& move : moves)
+        {
+            if (!move.active || move.targetKey == move.sourceKey || sourceKeys.contains(move.targetKey))
+            {
+                continue;
+            }
+
+            if (!move.targetChecked)
+            {
+                move.targetExists = m_fileSystem.Exists(move.target);
+                move.targetChecked = true;
+            }
+
+            if (move.targetExists)
+            {
+                drop(move);
+                dropped = true;
+            }
+        }
+    }
+}
+
+void CRenameExecutor::_PlanFolder(const std::vector<PendingMove>& moves, std::vector<Chain>& chains)
+{
+    const size_t none = static_cast<size_t>(-1);
+    std::unordered_map<std::wstring, size_t> sources;
+    std::unordered_set<std::wstring> reservedKeys;
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        if (moves[i].active)
+        {
+            sources.emplace(moves[i].sourceKey, i);
+            reservedKeys.insert(moves[i].sourceKey);
+            reservedKeys.insert(moves[i].targetKey);
+        }
+    }
+
+    // A rename whose target is the name of another renamed item runs after it, next holds the
+    // rename that waits for each one. Targets are unique, so a rename has at most one rename
+    // waiting for it and the renames form separate chains and cycles.
+    std::vector<size_t> next(moves.size(), none);
+    std::vector<bool> waits(moves.size(), false);
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        if (!moves[i].active || moves[i].targetKey == moves[i].sourceKey)
+        {
+            continue;
+        }
+
+        auto holder = sources.find(moves[i].targetKey);
+        if (holder != sources.end())
+        {
+            next[holder->second] = i;
+            waits[i] = true;
+        }
+    }
+
+    std::vector<bool> planned(moves.size(), false);
+    auto append = [&](Chain& chain, size_t first, size_t last) {
+        for (size_t i = first; i != none && i != last; i = next[i])
+        {
+            chain.moves.push_back({ moves[i].request, moves[i].source, moves[i].target });
+            planned[i] = true;
+        }
+    };
+
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        if (moves[i].active && !waits[i])
+        {
+            Chain chain;
+            append(chain, i, none);
+            chains.push_back(std::move(chain));
+        }
+    }
+
+    // What is left are cycles. The first item of each moves to a temporary name, which frees
+    // its name for the rest of the cycle, then takes its new name last.
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        if (!moves[i].active || planned[i])
+        {
+            continue;
+        }
+
+        Chain chain;
+        chain.cycle = true;
+        const fs::path temporaryPath = _GetTemporaryPath(moves[i], reservedKeys);
+        chain.moves.push_back({ moves[i].request, moves[i].source, temporaryPath, false });
+        planned[i] = true;
+        append(chain, next[i], i);
+        chain.moves.push_back({ moves[i].request, temporaryPath, moves[i].target });
+        chains.push_back(std::move(chain));
+    }
+
+    // The operation gives colliding items a free name, once the other items of the folder moved
+    if (m_operation)
+    {
+        for (const PendingMove& move : moves)
+        {
+            if (!move.active)
+            {
+                Chain chain;
+                chain.collision = true;
+                chain.moves.push_back({ move.request, move.source, move.target });
+                chains.push_back(std::move(chain));
+            }
+        }
+    }
+}
+
+fs::path CRenameExecutor::_GetTemporaryPath(const PendingMove& move, std::unordered_set<std::wstring>& reservedKeys)
+{
+    const std::wstring baseName = move.source.filename().wstring() + c_temporarySuffix;
+    for (unsigned int i = 0;; i++)
+    {
+        const std::wstring name = baseName + std::to_wstring(i);
+        const fs::path path = move.source.parent_path() / name;
+        if (reservedKeys.insert(GetKey(name)).second && !m_fileSystem.Exists(path))
+        {
+            return path;
+        }
+    }
+}
+
+void CRenameExecutor::_RunChain(const Chain& chain, std::vector<HRESULT>& results)
+{
+    size_t completed = 0;
+    for (; completed < chain.moves.size(); completed++)
+    {
+        const RenameMove& move = chain.moves[completed];
+        const HRESULT hr = m_fileSystem.Rename(move.source, move.target);
+        if (FAILED(hr))
+        {
+            // The rest of the chain needs the name that did not move away and keeps E_ABORT
+            results[move.request] = hr;
+            break;
+        }
+
+        m_journal.Add(move.source, move.target);
+        if (move.final)
+        {
+            results[move.request] = S_OK;
+        }
+    }
+
+    if (completed == chain.moves.size() || !chain.cycle)
+    {
+        return;
+    }
+
+    // Put the items of a broken cycle back, so none is left with a temporary name
+    while (completed > 0)
+    {
+        const RenameMove& move = chain.moves[--completed];
+        if (SUCCEEDED(m_fileSystem.Rename(move.target, move.source)))
+        {
+            m_journal.Add(move.target, move.source);
+            if (move.final)
+            {
+                results[move.request] = E_ABORT;
+            }
+        }
+    }
+}
+
+void CRenameExecutor::_PerformLevels(const Levels& levels, std::vector<HRESULT>& results)
+{
+    // Moves of the next operation. Levels without cycles share it with the levels above.
+    std::vector<RenameMove> moves;
+    std::vector<CycleRun> runs;
+    for (const auto& [depth, chains] : levels)
+    {
+        std::vector<RenameMove> collisions;
+        for (const Chain& chain : chains)
+        {
+            if (chain.cycle)
+            {
+                runs.push_back({ chain.moves });
+            }
+            else
+            {
+                std::vector<RenameMove>& target = chain.collision ? collisions : moves;
+                target.insert(target.end(), chain.moves.begin(), chain.moves.end());
+            }
+        }
+
+        // The first step of each cycle joins the operation of the level
+        while (!runs.empty())
+        {
+            _PerformStep(moves, runs, results);
+        }
+
+        // A colliding item could otherwise take a name a cycle frees later
+        moves.insert(moves.end(), collisions.begin(), collisions.end());
+    }
+
+    if (!moves.empty())
+    {
+        _PerformStep(moves, runs, results);
+    }
+}
+
+void CRenameExecutor::_PerformStep(std::vector<RenameMove>& moves, std::vector<CycleRun>& runs, std::vector<HRESULT>& results)
+{
+    // The next step of every cycle, after the other moves
+    const size_t none = static_cast<size_t>(-1);
+    std::vector<size_t> runOfMove(moves.size(), none);
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        moves.push_back(runs[i].moves[runs[i].completed]);
+        runOfMove.push_back(i);
+    }
+
+    std::vector<HRESULT> moveResults;
+    m_operation->Perform(moves, moveResults);
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        const RenameMove& move = moves[i];
+        CycleRun* run = (runOfMove[i] != none) ? &runs[runOfMove[i]] : nullptr;
+        if (FAILED(moveResults[i]))
+        {
+            // The item that could not be put back keeps the result of its rename
+            if (!run || !run->revert)
+            {
+                results[move.request] = moveResults[i];
+            }
+
+            if (run)
+            {
+                run->failed = true;
+            }
+            continue;
+        }
+
+        m_journal.Add(move.source, move.target);
+        if (run)
+        {
+            run->completed++;
+        }
+
+        if (move.final)
+        {
+            results[move.request] = (run && run->revert) ? E_ABORT : S_OK;
+        }
+    }
+    moves.clear();
+
+    // The rest of a broken cycle needs the name that did not move away and keeps E_ABORT.
+    // Its completed steps are undone, last one first, so no item is left with a temporary name.
+    std::vector<CycleRun> nextRuns;
+    for (CycleRun& run : runs)
+    {
+        if (!run.failed)
+        {
+            if (run.completed < run.moves.size())
+            {
+                nextRuns.push_back(std::move(run));
+            }
+        }
+        else if (!run.revert && run.completed > 0)
+        {
+            CycleRun revert;
+            revert.revert = true;
+            for (size_t i = run.completed; i > 0; i--)
+            {
+                const RenameMove& move = run.moves[i - 1];
+                revert.moves.push_back({ move.request, move.target, move.source, move.final });
+            }
+            nextRuns.push_back(std::move(revert));
+        }
+    }
+    runs.swap(nextRuns);
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include "pch.h"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// File system calls of the rename executor
+class CRenameFileSystem
+{
+public:
+    virtual ~CRenameFileSystem() = default;
+
+    // Renames an entry within its folder. Fails with ERROR_ALREADY_EXISTS instead of replacing
+    // another entry that has the target name. A case change of the same entry succeeds.
+    virtual HRESULT Rename(const std::filesystem::path& source, const std::filesystem::path& target) = 0;
+
+    virtual bool Exists(const std::filesystem::path& path) = 0;
+};
+
+// Renames with MoveFileEx and tells the shell about each rename, so open Explorer windows update
+class CWin32RenameFileSystem :
+    public CRenameFileSystem
+{
+public:
+    HRESULT Rename(const std::filesystem::path& source, const std::filesystem::path& target) override;
+    bool Exists(const std::filesystem::path& path) override;
+};
+
+// Renames with std::filesystem only, ex: to run the executor against a local directory tree in tests
+class CStdRenameFileSystem :
+    public CRenameFileSystem
+{
+public:
+    HRESULT Rename(const std::filesystem::path& source, const std::filesystem::path& target) override;
+    bool Exists(const std::filesystem::path& path) override;
+};
+
+struct RenameMove
+{
+    size_t request = 0;
+    std::filesystem::path source;
+    std::filesystem::path target;
+    // Last move of the request, false for the move to a temporary name
+    bool final = true;
+};
+
+// Runs several renames as one file operation, in the order they are given
+class CRenameOperation
+{
+public:
+    virtual ~CRenameOperation() = default;
+
+    // results receives one code per move. A move whose target is taken when it runs gives the
+    // item a free name such as "name (2)" instead of failing.
+    virtual HRESULT Perform(const std::vector<RenameMove>& moves, std::vector<HRESULT>& results) = 0;
+};
+
+// Renames through IFileOperation with the flags of Explorer: each operation is one step of the
+// Explorer undo stack, and the user is asked for elevation where the rename needs it
+class CShellRenameOperation :
+    public CRenameOperation
+{
+public:
+    explicit CShellRenameOperation(HWND hwndOwner) :
+        m_hwndOwner(hwndOwner)
+    {
+    }
+
+    HRESULT Perform(const std::vector<RenameMove>& moves, std::vector<HRESULT>& results) override;
+
+private:
+    HWND m_hwndOwner = nullptr;
+};
+
+struct RenameJournalEntry
+{
+    std::filesystem::path source;
+    std::filesystem::path target;
+};
+
+// Completed renames in the order they happened, so they can be undone. Each record is written
+// to the journal file as soon as it is added, an interrupted operation leaves a journal that
+// is complete up to its last rename. Records can be added from several threads.
+class CRenameJournal
+{
+public:
+    // Starts a new journal file. Without it the records are only kept in memory.
+    HRESULT Open(const std::filesystem::path& path);
+
+    void Add(const std::filesystem::path& source, const std::filesystem::path& target);
+
+    std::vector<RenameJournalEntry> GetEntries() const;
+
+    static HRESULT s_Read(const std::filesystem::path& path, std::vector<RenameJournalEntry>& entries);
+
+    // Renames the targets of entries back to their sources, last entry first
+    static HRESULT s_Undo(const std::vector<RenameJournalEntry>& entries, CRenameFileSystem& fileSystem);
+
+private:
+    mutable std::mutex m_lock;
+    std::vector<RenameJournalEntry> m_entries;
+    std::ofstream m_file;
+};
+
+struct RenameRequest
+{
+    // Full path of the item
+    std::filesystem::path path;
+    // New name of the item in the same folder
+    std::wstring newName;
+};
+
+// Runs the renames of an operation. Items are renamed before the folders that contain them,
+// deepest folder first, and the folders of one depth are renamed concurrently. Within a folder
+// an item whose new name is held by another renamed item waits for that item to move away,
+// and cycles such as a to b with b to a go through a temporary name. Targets that would
+// collide with each other or with an entry that stays in place are found before anything is
+// renamed, and these items are left as they are.
+//
+// With a CRenameOperation every level is queued into one operation on the calling thread
+// instead, deepest level first, so the rename is undone in one step. The operation needs the
+// items it renames to exist when it is built and cannot stop once one of its moves fails, so
+// each step of a cycle runs as an operation of its own and a failed step stops its cycle and
+// puts the items it moved back. Colliding items are renamed once the cycles of their folder
+// completed and get a free name from the operation.
+class CRenameExecutor
+{
+public:
+    CRenameExecutor(CRenameFileSystem& fileSystem, CRenameJournal& journal, unsigned int workerCount);
+    // fileSystem is only used to look up names
+    CRenameExecutor(CRenameFileSystem& fileSystem, CRenameOperation& operation, CRenameJournal& journal);
+
+    // results receives one code per request:
+    //   S_OK if the item was renamed, S_FALSE if its name did not change,
+    //   HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS) if its new name collides and there is no operation,
+    //   E_ABORT if it was not renamed because another rename it depends on failed,
+    //   the error of the rename otherwise.
+    // Returns S_OK if every item has its new name, otherwise the first failed result.
+    HRESULT Execute(const std::vector<RenameRequest>& requests, std::vector<HRESULT>& results);
+
+private:
+    struct PendingMove
+    {
+        size_t request = 0;
+        std::filesystem::path source;
+        std::filesystem::path target;
+        // Upper case names
+        std::wstring sourceKey;
+        std::wstring targetKey;
+        bool active = true;
+        // Result of the lookup of the target on disk, done once
+        bool targetChecked = false;
+        bool targetExists = false;
+    };
+
+    // Moves of one folder that run in order, ex: b to c before a to b
+    struct Chain
+    {
+        std::vector<RenameMove> moves;
+        // The chain starts and ends with the move through a temporary name
+        bool cycle = false;
+        // The move of an item whose new name is taken, the operation picks a free name
+        bool collision = false;
+    };
+
+    // Steps of a cycle, run one operation after another so a failed step stops the rest
+    struct CycleRun
+    {
+        std::vector<RenameMove> moves;
+        size_t completed = 0;
+        bool failed = false;
+        // The moves put the items of a broken cycle back
+        bool revert = false;
+    };
+
+    // Deepest folders first
+    using Levels = std::map<size_t, std::vector<Chain>, std::greater<size_t>>;
+
+    void _CheckCollisions(std::vector<PendingMove>& moves, std::vector<HRESULT>& results);
+    void _PlanFolder(const std::vector<PendingMove>& moves, std::vector<Chain>& chains);
+    std::filesystem::path _GetTemporaryPath(const PendingMove& move, std::unordered_set<std::wstring>& reservedKeys);
+    void _RunChain(const Chain& chain, std::vector<HRESULT>& results);
+    void _PerformLevels(const Levels& levels, std::vector<HRESULT>& results);
+    void _PerformStep(std::vector<RenameMove>& moves, std::vector<CycleRun>& runs, std::vector<HRESULT>& results);
+
+    CRenameFileSystem& m_fileSystem;
+    CRenameOperation* m_operation = nullptr;
+    CRenameJournal& m_journal;
+    unsigned int m_workerCount;
+};
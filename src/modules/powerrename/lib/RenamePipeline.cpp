@@ -0,0 +1,282 @@
+#include "pch.h"
+#include "RenamePipeline.h"
+#include "EnumerationTemplate.h"
+#include "PowerRenameRegEx.h"
+#include "Settings.h"
+#include <cwctype>
+#include <winrt/base.h>
+
+namespace
+{
+    // Position of the dot of the extension, or the length of the name if it has none. Same
+    // split as fs::path stem() and extension().
+    size_t FindExtension(std::wstring_view name)
+    {
+        const size_t dot = name.rfind(L'.');
+        if (dot == std::wstring_view::npos || dot == 0 || name == L"..")
+        {
+            return name.size();
+        }
+        return dot;
+    }
+
+    std::wstring_view Trim(std::wstring_view name)
+    {
+        size_t first = 0;
+        size_t last = name.size();
+        while (first < last && iswspace(name[first]))
+        {
+            first++;
+        }
+        while (first < last && (iswspace(name[last - 1]) || name[last - 1] == L'.'))
+        {
+            last--;
+        }
+        return name.substr(first, last - first);
+    }
+
+    // Same test as the preview of the dialog: an empty name or the original name is no rename
+    bool IsRenamed(std::wstring_view name, std::wstring_view originalName)
+    {
+        return !name.empty() && name != originalName;
+    }
+}
+
+HRESULT CRenamePipeline::Compile(const std::vector<RenameStep>& steps)
+{
+    m_steps.clear();
+    m_enumerateStep = 0;
+    m_usesFileTime = false;
+    m_enumerates = false;
+
+    const bool useLinearRegex = !CSettingsInstance().GetUseBoostLib() && CSettingsInstance().GetUseLinearRegex();
+    for (const RenameStep& step : steps)
+    {
+        CompiledStep compiled;
+        compiled.type = step.type;
+        compiled.flags = step.flags;
+        compiled.start = step.start;
+        compiled.padding = step.padding;
+
+        switch (step.type)
+        {
+        case RenameStepType::LiteralReplace:
+        case RenameStepType::RegexReplace:
+        {
+            // An empty search term leaves the name as it is, like in the dialog
+            if (step.searchTerm.empty())
+            {
+                continue;
+            }
+
+            compiled.replaceTerm = step.replaceTerm;
+            compiled.dateTemplate = CDateTemplate(step.replaceTerm);
+            m_usesFileTime = m_usesFileTime || compiled.dateTemplate.UsesFileTime();
+
+            const bool caseSensitive = (step.flags & CaseSensitive) != 0;
+            if (step.type == RenameStepType::LiteralReplace)
+            {
+                compiled.literal.Reset(step.searchTerm, caseSensitive);
+            }
+            else if (!useLinearRegex || !compiled.linearPattern.Compile(step.searchTerm, caseSensitive))
+            {
+                const DWORD regExFlags = UseRegularExpressions | (step.flags & (CaseSensitive | MatchAllOccurences));
+                HRESULT hr = CPowerRenameRegEx::s_CreateInstance(&compiled.renameRegEx);
+                if (SUCCEEDED(hr))
+                {
+                    hr = compiled.renameRegEx->PutFlags(regExFlags);
+                }
+                if (SUCCEEDED(hr))
+                {
+                    hr = compiled.renameRegEx->PutSearchTerm(step.searchTerm.c_str());
+                }
+                if (SUCCEEDED(hr))
+                {
+                    hr = compiled.renameRegEx->PutReplaceTerm(step.replaceTerm.c_str());
+                }
+                if (FAILED(hr))
+                {
+                    return hr;
+                }
+
+                // The regex object only reports an invalid pattern when it is used
+                PWSTR result = nullptr;
+                hr = compiled.renameRegEx->Replace(L"a", &result);
+                CoTaskMemFree(result);
+                if (FAILED(hr))
+                {
+                    return E_INVALIDARG;
+                }
+            }
+            break;
+        }
+        case RenameStepType::ChangeCase:
+            compiled.transformer = std::make_unique<CCaseTransformer>(step.flags);
+            if (!compiled.transformer->IsEnabled())
+            {
+                continue;
+            }
+            break;
+        case RenameStepType::Enumerate:
+            if (!m_enumerates)
+            {
+                m_enumerateStep = m_steps.size();
+                m_enumerates = true;
+            }
+            break;
+        default:
+            break;
+        }
+
+        m_steps.push_back(std::move(compiled));
+    }
+
+    if (!m_enumerates)
+    {
+        m_enumerateStep = m_steps.size();
+    }
+
+    return S_OK;
+}
+
+bool CRenamePipeline::Apply(std::wstring_view originalName, const SYSTEMTIME& fileTime, unsigned long ordinal, Scratch& scratch, std::wstring& newName) const
+{
+    newName.clear();
+    scratch.current.assign(originalName);
+    _Run(0, m_steps.size(), originalName, fileTime, ordinal, scratch);
+    if (!IsRenamed(scratch.current, originalName))
+    {
+        return false;
+    }
+
+    newName.assign(scratch.current);
+    return true;
+}
+
+bool CRenamePipeline::ApplyBeforeEnumerate(std::wstring_view originalName, const SYSTEMTIME& fileTime, Scratch& scratch, std::wstring& name) const
+{
+    scratch.current.assign(originalName);
+    _Run(0, m_enumerateStep, originalName, fileTime, 0, scratch);
+    name.assign(scratch.current);
+    return IsRenamed(name, originalName);
+}
+
+bool CRenamePipeline::ApplyFromEnumerate(std::wstring_view originalName, std::wstring_view name, const SYSTEMTIME& fileTime, unsigned long ordinal, Scratch& scratch, std::wstring& newName) const
+{
+    newName.clear();
+    scratch.current.assign(name);
+    _Run(m_enumerateStep, m_steps.size(), originalName, fileTime, ordinal, scratch);
+    if (!IsRenamed(scratch.current, originalName))
+    {
+        return false;
+    }
+
+    newName.assign(scratch.current);
+    return true;
+}
+
+void CRenamePipeline::_Run(size_t firstStep, size_t lastStep, std::wstring_view originalName, const SYSTEMTIME& fileTime, unsigned long ordinal, Scratch& scratch) const
+{
+    // Decided once the steps before the first Enumerate step ran
+    bool numbered = false;
+    for (size_t i = firstStep; i < lastStep; i++)
+    {
+        const CompiledStep& step = m_steps[i];
+        if (i == m_enumerateStep)
+        {
+            numbered = IsRenamed(scratch.current, originalName);
+        }
+
+        scratch.next.clear();
+        switch (step.type)
+        {
+        case RenameStepType::LiteralReplace:
+        case RenameStepType::RegexReplace:
+            _Replace(step, fileTime, scratch);
+            break;
+        case RenameStepType::ChangeCase:
+            step.transformer->Transform(scratch.current, scratch.next);
+            break;
+        case RenameStepType::Trim:
+            scratch.next.assign(Trim(scratch.current));
+            break;
+        case RenameStepType::Enumerate:
+        {
+            std::wstring_view enumeratedName;
+            CEnumerationTemplate enumeration(step.start, step.padding);
+            if (numbered)
+            {
+                enumeration.Reset(scratch.current);
+                enumeratedName = enumeration.Format(ordinal);
+            }
+            scratch.next.assign(enumeratedName.empty() ? std::wstring_view(scratch.current) : enumeratedName);
+            break;
+        }
+        }
+
+        scratch.current.swap(scratch.next);
+    }
+}
+
+void CRenamePipeline::_Replace(const CompiledStep& step, const SYSTEMTIME& fileTime, Scratch& scratch) const
+{
+    // The search applies to the part of the name selected by NameOnly or ExtensionOnly, the
+    // rest of the name is copied around the result
+    const std::wstring_view name = scratch.current;
+    const size_t extension = FindExtension(name);
+    std::wstring_view prefix;
+    std::wstring_view source = name;
+    std::wstring_view suffix;
+    if (step.flags & NameOnly)
+    {
+        source = name.substr(0, extension);
+        suffix = name.substr(extension);
+    }
+    else if (step.flags & ExtensionOnly)
+    {
+        if (extension == name.size())
+        {
+            scratch.next.assign(name);
+            return;
+        }
+        prefix = name.substr(0, extension + 1);
+        source = name.substr(extension + 1);
+    }
+
+    scratch.next.append(prefix);
+    if (step.renameRegEx)
+    {
+        const std::wstring sourceName(source);
+        PWSTR replacedName = nullptr;
+        if (step.dateTemplate.UsesFileTime())
+        {
+            winrt::check_hresult(step.renameRegEx->ReplaceWithFileTime(sourceName.c_str(), fileTime, &replacedName));
+        }
+        else
+        {
+            winrt::check_hresult(step.renameRegEx->Replace(sourceName.c_str(), &replacedName));
+        }
+        scratch.next.append(replacedName ? replacedName : sourceName.c_str());
+        CoTaskMemFree(replacedName);
+    }
+    else
+    {
+        std::wstring_view term = step.replaceTerm;
+        if (step.dateTemplate.UsesFileTime())
+        {
+            step.dateTemplate.Format(fileTime, scratch.term);
+            term = scratch.term;
+        }
+
+        const bool replaceAll = (step.flags & MatchAllOccurences) != 0;
+        if (step.type == RenameStepType::LiteralReplace)
+        {
+            step.literal.Replace(source, term, replaceAll, scratch.next);
+        }
+        else
+        {
+            step.linearPattern.Replace(source, term, replaceAll, scratch.next);
+        }
+    }
+    scratch.next.append(suffix);
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "pch.h"
+#include "PowerRenameInterfaces.h"
+#include "CaseTransformer.h"
+#include "DateTemplate.h"
+#include "LinearRegex.h"
+#include "LiteralMatcher.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class RenameStepType
+{
+    // Search and replace. flags: CaseSensitive, MatchAllOccurences, NameOnly or ExtensionOnly.
+    // The replace term can have file time fields such as $YYYY, filled in for each item.
+    LiteralReplace,
+    RegexReplace,
+    // flags: Uppercase, Lowercase, Titlecase or Capitalized, with NameOnly or ExtensionOnly
+    ChangeCase,
+    // Removes leading spaces and trailing spaces and dots, like the dialog does with new names
+    Trim,
+    // Numbers the items the steps before the first Enumerate step renamed, in order and from
+    // start, like EnumerateItems numbers the items the rule of the dialog renames. The counter
+    // has at least padding digits.
+    Enumerate,
+};
+
+struct RenameStep
+{
+    RenameStepType type = RenameStepType::LiteralReplace;
+    std::wstring searchTerm;
+    std::wstring replaceTerm;
+    DWORD flags = MatchAllOccurences;
+    unsigned long start = 1;
+    // Minimum number of digits of the Enumerate counter, padded with zeros
+    unsigned int padding = 0;
+};
+
+// Ordered rename steps compiled once into a program that computes the final name of an item in
+// one pass, instead of one preview and rename run per step. Search terms, replace terms with
+// file time fields and case rules are compiled by Compile. The intermediate names are kept in
+// a scratch buffer that is reused from one item to the next. Const members can be called from
+// several threads, each with its own scratch buffer.
+class CRenamePipeline
+{
+public:
+    struct Scratch
+    {
+        std::wstring current;
+        std::wstring next;
+        // Replace term with the date fields of the item
+        std::wstring term;
+    };
+
+    // Fails with E_INVALIDARG if a regular expression can not be compiled
+    HRESULT Compile(const std::vector<RenameStep>& steps);
+
+    bool UsesFileTime() const { return m_usesFileTime; }
+    bool Enumerates() const { return m_enumerates; }
+
+    // Runs the steps on originalName. ordinal is the position of the item among the items the
+    // steps before the first Enumerate step rename, 0 for the first one, and is not used for
+    // the other items. fileTime is only read if UsesFileTime.
+    // Returns false if the item keeps its name.
+    // Throws winrt::hresult_error if a regex object fails.
+    bool Apply(std::wstring_view originalName, const SYSTEMTIME& fileTime, unsigned long ordinal, Scratch& scratch, std::wstring& newName) const;
+
+    // Apply in two parts, for callers that only know the ordinals once they know which items
+    // are renamed before the first Enumerate step. ApplyBeforeEnumerate runs the steps before
+    // it, name receives their result, and returns true if they rename the item.
+    // ApplyFromEnumerate runs the rest of the steps on that name, with the result of Apply.
+    bool ApplyBeforeEnumerate(std::wstring_view originalName, const SYSTEMTIME& fileTime, Scratch& scratch, std::wstring& name) const;
+    bool ApplyFromEnumerate(std::wstring_view originalName, std::wstring_view name, const SYSTEMTIME& fileTime, unsigned long ordinal, Scratch& scratch, std::wstring& newName) const;
+
+private:
+    struct CompiledStep
+    {
+        RenameStepType type = RenameStepType::LiteralReplace;
+        DWORD flags = 0;
+        unsigned long start = 1;
+        unsigned int padding = 0;
+        std::wstring replaceTerm;
+        CDateTemplate dateTemplate;
+        CLiteralMatcher literal;
+        CLinearRegex linearPattern;
+        // Regular expressions the linear engine does not take, or all of them depending on
+        // the settings, go through the regex object of the dialog
+        CComPtr<IPowerRenameRegEx> renameRegEx;
+        std::unique_ptr<CCaseTransformer> transformer;
+    };
+
+    // Runs the steps from firstStep up to lastStep on scratch.current
+    void _Run(size_t firstStep, size_t lastStep, std::wstring_view originalName, const SYSTEMTIME& fileTime, unsigned long ordinal, Scratch& scratch) const;
+    void _Replace(const CompiledStep& step, const SYSTEMTIME& fileTime, Scratch& scratch) const;
+
+    std::vector<CompiledStep> m_steps;
+    // Index of the first Enumerate step, the number of steps if there is none
+    size_t m_enumerateStep = 0;
+    bool m_usesFileTime = false;
+    bool m_enumerates = false;
+};
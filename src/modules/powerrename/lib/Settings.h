@@ -61,6 +61,16 @@ public:
         settings.useBoostLib = useBoostLib;
     }
 
+    inline bool GetUseLinearRegex() const
+    {
+        return settings.useLinearRegex;
+    }
+
+    inline void SetUseLinearRegex(bool useLinearRegex)
+    {
+        settings.useLinearRegex = useLinearRegex;
+    }
+
     inline bool GetMRUEnabled() const
     {
         return settings.MRUEnabled;
@@ -125,6 +135,7 @@ private:
         bool extendedContextMenuOnly{ false }; // Disabled by default.
         bool persistState{ true };
         bool useBoostLib{ false }; // Disabled by default.
+        bool useLinearRegex{ false }; // Disabled by default.
         bool MRUEnabled{ true };
         unsigned int maxMRUSize{ 10 };
         unsigned int flags{ 0 };
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "StringArena.h"
+#include <algorithm>
+#include <cstring>
+
+const wchar_t* CStringArena::Store(const wchar_t* value, size_t count)
+{
+    std::scoped_lock lock(m_lock);
+
+    if (m_blocks.empty() || m_blocks.back().size - m_blocks.back().used < count + 1)
+    {
+        // Strings longer than a block get a block of their own
+        Block block;
+        block.size = std::max<size_t>(c_blockSize, count + 1);
+        block.data = std::make_unique<wchar_t[]>(block.size);
+        m_blocks.push_back(std::move(block));
+    }
+
+    Block& block = m_blocks.back();
+    wchar_t* result = block.data.get() + block.used;
+    if (count > 0)
+    {
+        memcpy(result, value, count * sizeof(wchar_t));
+    }
+    result[count] = L'\0';
+    block.used += count + 1;
+    return result;
+}
+
+size_t CStringArena::GetReservedBytes() const
+{
+    std::scoped_lock lock(m_lock);
+
+    size_t bytes = 0;
+    for (const auto& block : m_blocks)
+    {
+        bytes += block.size * sizeof(wchar_t);
+    }
+    return bytes;
+}
+
+std::shared_ptr<CStringArena> CStringArena::Shared()
+{
+    static std::mutex s_sharedLock;
+    static std::weak_ptr<CStringArena> s_shared;
+
+    std::scoped_lock lock(s_sharedLock);
+    std::shared_ptr<CStringArena> arena = s_shared.lock();
+    if (!arena)
+    {
+        arena = std::make_shared<CStringArena>();
+        s_shared = arena;
+    }
+    return arena;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Append-only storage for the immutable strings of the rename items (path and original name).
+// Strings are packed into large blocks instead of one heap allocation per string, and live
+// until the arena is destroyed. Items keep the arena alive through a shared reference.
+class CStringArena
+{
+public:
+    CStringArena() = default;
+    CStringArena(const CStringArena&) = delete;
+    CStringArena& operator=(const CStringArena&) = delete;
+
+    // Copies count characters of value (plus a terminating null) into the arena.
+    const wchar_t* Store(const wchar_t* value, size_t count);
+
+    // Total number of bytes reserved by the arena blocks
+    size_t GetReservedBytes() const;
+
+    // Arena shared by every item created while another item is still alive.
+    // A new arena is created once all items of the previous one were released.
+    static std::shared_ptr<CStringArena> Shared();
+
+private:
+    static constexpr size_t c_blockSize = 32 * 1024; // characters
+
+    struct Block
+    {
+        std::unique_ptr<wchar_t[]> data;
+        size_t size = 0;
+        size_t used = 0;
+    };
+
+    mutable std::mutex m_lock;
+    std::vector<Block> m_blocks;
+};
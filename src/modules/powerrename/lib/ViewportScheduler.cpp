@@ -0,0 +1,103 @@
+#include "pch.h"
+#include "ViewportScheduler.h"
+#include <algorithm>
+
+void CViewportHint::Set(unsigned int firstItem, unsigned int lastItem)
+{
+    m_range = (static_cast<uint64_t>(firstItem) << 32) | lastItem;
+}
+
+void CViewportHint::Clear()
+{
+    m_range = c_none;
+}
+
+bool CViewportHint::Get(unsigned int& firstItem, unsigned int& lastItem) const
+{
+    const uint64_t range = m_range;
+    if (range == c_none)
+    {
+        return false;
+    }
+
+    firstItem = static_cast<unsigned int>(range >> 32);
+    lastItem = static_cast<unsigned int>(range);
+    return true;
+}
+
+CViewportScheduler::CViewportScheduler(size_t chunkCount, const CViewportHint& hint, const ChunkOfItem& chunkOfItem) :
+    m_chunkCount(chunkCount),
+    m_hint(hint),
+    m_chunkOfItem(chunkOfItem),
+    m_claimed(chunkCount, false),
+    m_remaining(chunkCount)
+{
+    m_windowEnd = std::min<size_t>(1, chunkCount);
+    m_high = m_windowEnd;
+    _Refocus();
+}
+
+bool CViewportScheduler::Claim(size_t& chunk)
+{
+    std::scoped_lock lock(m_lock);
+    if (m_remaining == 0)
+    {
+        return false;
+    }
+
+    _Refocus();
+
+    // Every chunk left is in the window, before m_low or from m_high on
+    chunk = m_chunkCount;
+    while (chunk == m_chunkCount)
+    {
+        size_t candidate = 0;
+        if (m_windowNext < m_windowEnd)
+        {
+            candidate = m_windowNext++;
+        }
+        else if (m_high < m_chunkCount && (m_upNext || m_low == 0))
+        {
+            candidate = m_high++;
+            m_upNext = false;
+        }
+        else
+        {
+            candidate = --m_low;
+            m_upNext = true;
+        }
+
+        if (!m_claimed[candidate])
+        {
+            chunk = candidate;
+        }
+    }
+
+    m_claimed[chunk] = true;
+    m_remaining--;
+    return true;
+}
+
+void CViewportScheduler::_Refocus()
+{
+    unsigned int firstItem = 0;
+    unsigned int lastItem = 0;
+    if (!m_hint.Get(firstItem, lastItem) ||
+        (m_hasViewport && firstItem == m_firstItem && lastItem == m_lastItem) ||
+        m_chunkCount == 0)
+    {
+        return;
+    }
+
+    m_hasViewport = true;
+    m_firstItem = firstItem;
+    m_lastItem = lastItem;
+
+    const size_t firstChunk = std::min<size_t>(m_chunkOfItem(firstItem), m_chunkCount - 1);
+    const size_t lastChunk = std::clamp(m_chunkOfItem(lastItem), firstChunk, m_chunkCount - 1);
+    m_windowNext = firstChunk;
+    m_windowEnd = lastChunk + 1;
+    m_low = firstChunk;
+    m_high = m_windowEnd;
+    m_upNext = true;
+}
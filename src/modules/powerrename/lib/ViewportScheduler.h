@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Items shown in the list view, set by the UI thread as the user scrolls and read by the
+// preview workers at any time.
+class CViewportHint
+{
+public:
+    // Inclusive range of item indices
+    void Set(unsigned int firstItem, unsigned int lastItem);
+    void Clear();
+
+    // False if the UI did not tell which items it shows
+    bool Get(unsigned int& firstItem, unsigned int& lastItem) const;
+
+private:
+    // First item in the high half and last item in the low half, so both change together
+    std::atomic<uint64_t> m_range = c_none;
+
+    static constexpr uint64_t c_none = UINT64_MAX;
+};
+
+// Hands out the chunks of a preview pass to the workers, the ones under the viewport first in
+// order, then the ones around them moving outward, so the rows on screen get their new name
+// first whatever the number of items. The next claim after the viewport moved starts from its
+// new position. Without a viewport the chunks are handed out in order.
+class CViewportScheduler
+{
+public:
+    // Maps an item index to the chunk that evaluates it
+    using ChunkOfItem = std::function<size_t(unsigned int itemIndex)>;
+
+    CViewportScheduler(size_t chunkCount, const CViewportHint& hint, const ChunkOfItem& chunkOfItem);
+
+    // Returns false once every chunk was claimed
+    bool Claim(size_t& chunk);
+
+private:
+    void _Refocus();
+
+    const size_t m_chunkCount;
+    const CViewportHint& m_hint;
+    const ChunkOfItem m_chunkOfItem;
+
+    std::mutex m_lock;
+    std::vector<bool> m_claimed;
+    size_t m_remaining;
+    // Viewport the cursors below were set from
+    unsigned int m_firstItem = 0;
+    unsigned int m_lastItem = 0;
+    bool m_hasViewport = false;
+    // Next chunk under the viewport and end of the viewport chunks
+    size_t m_windowNext = 0;
+    size_t m_windowEnd = 0;
+    // Chunks before m_low and from m_high on are left to claim, outside of the window
+    size_t m_low = 0;
+    size_t m_high = 0;
+    bool m_upNext = true;
+};
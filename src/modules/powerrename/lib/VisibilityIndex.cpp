@@ -0,0 +1,201 @@
+#include "pch.h"
+#include "VisibilityIndex.h"
+#include <algorithm>
+
+namespace
+{
+    inline size_t LowBit(size_t value)
+    {
+        return value & (~value + 1);
+    }
+}
+
+void CVisibilityIndex::Clear()
+{
+    m_parents.clear();
+    m_lastItemAtDepth.clear();
+    m_visible.clear();
+    m_shown.clear();
+    m_shownChildren.clear();
+    m_tree.assign(1, 0);
+    m_visibleCount = 0;
+}
+
+void CVisibilityIndex::AddItem(unsigned int depth, bool visible)
+{
+    const size_t index = m_parents.size();
+
+    // Items are enumerated depth first, so the parent is the last item seen one level up
+    size_t parent = npos;
+    if (depth > 0 && depth - 1 < m_lastItemAtDepth.size())
+    {
+        parent = m_lastItemAtDepth[depth - 1];
+    }
+    m_lastItemAtDepth.resize(static_cast<size_t>(depth) + 1, npos);
+    m_lastItemAtDepth[depth] = index;
+
+    m_parents.push_back(parent);
+    m_visible.push_back(visible);
+    m_shown.push_back(false);
+    m_shownChildren.push_back(0);
+
+    // Append a hidden node: it covers (p - LowBit(p), p - 1] of the existing items
+    const size_t position = index + 1;
+    m_tree.push_back(static_cast<unsigned int>(_TreePrefixSum(index) - _TreePrefixSum(position - LowBit(position))));
+
+    _SetShown(index, visible);
+}
+
+void CVisibilityIndex::Assign(const std::vector<bool>& visible)
+{
+    const size_t count = m_parents.size();
+    m_shownChildren.assign(count, 0);
+    m_visibleCount = 0;
+
+    // Subitems always come after their folder, so a reverse walk sees them first
+    for (size_t i = count; i-- > 0;)
+    {
+        m_visible[i] = i < visible.size() && visible[i];
+        const bool shown = m_visible[i] || m_shownChildren[i] > 0;
+        m_shown[i] = shown;
+        if (shown)
+        {
+            m_visibleCount++;
+            if (m_parents[i] != npos)
+            {
+                m_shownChildren[m_parents[i]]++;
+            }
+        }
+    }
+
+    // Linear time Fenwick tree construction
+    m_tree.assign(count + 1, 0);
+    for (size_t position = 1; position <= count; position++)
+    {
+        m_tree[position] += m_shown[position - 1];
+        const size_t next = position + LowBit(position);
+        if (next <= count)
+        {
+            m_tree[next] += m_tree[position];
+        }
+    }
+}
+
+bool CVisibilityIndex::SetVisible(size_t index, bool visible)
+{
+    if (index >= m_parents.size())
+    {
+        return false;
+    }
+
+    m_visible[index] = visible;
+    const bool shown = visible || m_shownChildren[index] > 0;
+    if (static_cast<bool>(m_shown[index]) == shown)
+    {
+        return false;
+    }
+
+    _SetShown(index, shown);
+    return true;
+}
+
+bool CVisibilityIndex::IsVisible(size_t index) const
+{
+    return index < m_shown.size() && m_shown[index];
+}
+
+size_t CVisibilityIndex::GetItemIndex(size_t visibleIndex) const
+{
+    if (visibleIndex >= m_visibleCount)
+    {
+        return npos;
+    }
+
+    const size_t count = m_parents.size();
+    size_t step = 1;
+    while (step * 2 <= count)
+    {
+        step *= 2;
+    }
+
+    // Find the last position whose prefix sum is at most visibleIndex
+    size_t position = 0;
+    size_t remaining = visibleIndex + 1;
+    for (; step > 0; step /= 2)
+    {
+        if (position + step <= count && m_tree[position + step] < remaining)
+        {
+            position += step;
+            remaining -= m_tree[position];
+        }
+    }
+
+    // position is 1-based and the item after it is the one we are looking for
+    return position;
+}
+
+size_t CVisibilityIndex::GetVisibleIndex(size_t index) const
+{
+    return _TreePrefixSum(std::min<size_t>(index, m_parents.size()));
+}
+
+void CVisibilityIndex::_SetShown(size_t index, bool shown)
+{
+    // Walk up while the change flips the visibility of the parent folder
+    while (index != npos && static_cast<bool>(m_shown[index]) != shown)
+    {
+        m_shown[index] = shown;
+        _TreeAdd(index, shown);
+        if (shown)
+        {
+            m_visibleCount++;
+        }
+        else
+        {
+            m_visibleCount--;
+        }
+
+        const size_t parent = m_parents[index];
+        if (parent == npos)
+        {
+            break;
+        }
+
+        if (shown)
+        {
+            m_shownChildren[parent]++;
+        }
+        else
+        {
+            m_shownChildren[parent]--;
+        }
+
+        index = parent;
+        shown = m_visible[parent] || m_shownChildren[parent] > 0;
+    }
+}
+
+void CVisibilityIndex::_TreeAdd(size_t index, bool increment)
+{
+    for (size_t position = index + 1; position < m_tree.size(); position += LowBit(position))
+    {
+        if (increment)
+        {
+            m_tree[position]++;
+        }
+        else
+        {
+            m_tree[position]--;
+        }
+    }
+}
+
+size_t CVisibilityIndex::_TreePrefixSum(size_t count) const
+{
+    size_t sum = 0;
+    for (size_t position = count; position > 0; position -= LowBit(position))
+    {
+        sum += m_tree[position];
+    }
+    return sum;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tracks which rename items are shown in the list view for the current filter.
+// Items are added in enumeration order (a folder is directly followed by its content) and
+// each one has its own visibility from the filter. A folder is also shown when at least one
+// item below it is shown. The shown items are kept in a Fenwick tree so the visible count
+// and the visible index to item index lookups are O(log n), and changing the visibility of
+// one item only touches its ancestors.
+class CVisibilityIndex
+{
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    void Clear();
+
+    // Appends an item. depth is the depth of the item below the first enumerated level.
+    void AddItem(unsigned int depth, bool visible);
+
+    // Replaces the visibility of every item at once (ex: the filter changed).
+    void Assign(const std::vector<bool>& visible);
+
+    // Updates the visibility of one item. Returns true if the shown items changed.
+    bool SetVisible(size_t index, bool visible);
+
+    size_t GetItemCount() const { return m_parents.size(); }
+    size_t GetVisibleCount() const { return m_visibleCount; }
+
+    // True if the item is shown, either by itself or through one of its subitems
+    bool IsVisible(size_t index) const;
+
+    // Index of the item shown at visibleIndex, or npos if fewer items are shown
+    size_t GetItemIndex(size_t visibleIndex) const;
+
+    // Number of items shown before the item, which is its visible index when it is shown
+    size_t GetVisibleIndex(size_t index) const;
+
+private:
+    void _SetShown(size_t index, bool shown);
+    void _TreeAdd(size_t index, bool increment);
+    size_t _TreePrefixSum(size_t count) const;
+
+    // Parent of each item, npos for the items of the first level
+    std::vector<size_t> m_parents;
+    // Last item added at each depth, used to find the parent of the next item
+    std::vector<size_t> m_lastItemAtDepth;
+    std::vector<uint8_t> m_visible;
+    std::vector<uint8_t> m_shown;
+    // Number of direct subitems that are shown
+    std::vector<unsigned int> m_shownChildren;
+    // 1-based Fenwick tree over m_shown
+    std::vector<unsigned int> m_tree{ 0 };
+    size_t m_visibleCount = 0;
+};
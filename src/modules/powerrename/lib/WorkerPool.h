@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Splits [0, itemCount) into chunks and processes them on a small pool of threads.
+// Workers claim the next unprocessed chunk from a shared cursor when they become idle,
+// so a chunk of expensive items never holds up the rest of the range.
+// The calling thread takes part in the work. The chunk callback returns false to stop
+// all workers (ex: the operation was canceled). The first exception thrown by a chunk
+// callback is rethrown on the calling thread once every worker has stopped.
+class CWorkerPool
+{
+public:
+    using ChunkCallback = std::function<bool(size_t begin, size_t end)>;
+
+    static unsigned int DefaultWorkerCount()
+    {
+        unsigned int count = std::thread::hardware_concurrency();
+        return count > 0 ? count : 1;
+    }
+
+    // Claims the next chunk to process, returns false once there is none left
+    using ChunkClaim = std::function<bool(size_t& chunk)>;
+
+    static size_t GetChunkCount(size_t itemCount, size_t chunkSize)
+    {
+        chunkSize = std::max<size_t>(chunkSize, 1);
+        return (itemCount + chunkSize - 1) / chunkSize;
+    }
+
+    // Returns true if every chunk was processed.
+    static bool RunChunked(size_t itemCount, size_t chunkSize, unsigned int workerCount, const ChunkCallback& callback)
+    {
+        const size_t chunkCount = GetChunkCount(itemCount, chunkSize);
+        std::atomic<size_t> nextChunk = 0;
+        return RunChunked(itemCount, chunkSize, workerCount, [&](size_t& chunk) {
+            chunk = nextChunk++;
+            return chunk < chunkCount;
+        }, callback);
+    }
+
+    // Same as above with the chunks processed in the order of claimChunk, which is called
+    // concurrently and has to hand out every chunk once.
+    static bool RunChunked(size_t itemCount, size_t chunkSize, unsigned int workerCount, const ChunkClaim& claimChunk, const ChunkCallback& callback)
+    {
+        if (itemCount == 0)
+        {
+            return true;
+        }
+
+        chunkSize = std::max<size_t>(chunkSize, 1);
+        size_t chunkCount = GetChunkCount(itemCount, chunkSize);
+        workerCount = static_cast<unsigned int>(std::min<size_t>(std::max<unsigned int>(workerCount, 1u), chunkCount));
+
+        std::atomic<bool> stopped = false;
+        std::exception_ptr error;
+        std::mutex errorLock;
+
+        auto worker = [&]() {
+            while (!stopped)
+            {
+                size_t chunk = 0;
+                if (!claimChunk(chunk))
+                {
+                    break;
+                }
+
+                size_t begin = chunk * chunkSize;
+                size_t end = std::min<size_t>(begin + chunkSize, itemCount);
+                try
+                {
+                    if (!callback(begin, end))
+                    {
+                        stopped = true;
+                    }
+                }
+                catch (...)
+                {
+                    std::scoped_lock lock(errorLock);
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                    stopped = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workerCount - 1);
+        for (unsigned int i = 1; i < workerCount; i++)
+        {
+            threads.emplace_back(worker);
+        }
+
+        worker();
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+
+        return !stopped;
+    }
+};
@@ -0,0 +1,808 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "powerrename/lib/Settings.h"
+#include <PowerRenameInterfaces.h>
+#include <PowerRenameRegEx.h>
+#include <PowerRenameItem.h>
+#include <PowerRenameManager.h>
+#include <ItemRangeBatch.h>
+#include <LiteralMatcher.h>
+#include <CaseTransformer.h>
+#include <DateTemplate.h>
+#include <EnumerationTemplate.h>
+#include <RenameEngine.h>
+#include <RenamePipeline.h>
+#include <WorkerPool.h>
+#include <ViewportScheduler.h>
+#include "Helpers.h"
+#include "MockPowerRenameItem.h"
+#include "MockPowerRenameManagerEvents.h"
+#include <psapi.h>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+EXTERN_C IMAGE_DOS_HEADER __ImageBase;
+
+#define HINST_THISCOMPONENT ((HINSTANCE)&__ImageBase)
+
+HINSTANCE g_hInst = HINST_THISCOMPONENT;
+
+// Throughput benchmarks for the preview hot paths. They live in their own project, which
+// the solution does not build by default and CI does not run. Each one logs the per-item
+// cost of the current implementation next to a reference implementation of the previous
+// code path, and only asserts that both produce the same names.
+namespace PowerRenamePerfTests
+{
+    const size_t c_corpusSize = 100000;
+
+    std::vector<std::wstring> CreateCorpus(size_t count)
+    {
+        std::vector<std::wstring> corpus;
+        corpus.reserve(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            wchar_t name[MAX_PATH] = { 0 };
+            StringCchPrintf(name, ARRAYSIZE(name), L"IMG_%06zu_Holiday Trip %zu.jpg", i, i % 37);
+            corpus.push_back(name);
+        }
+        return corpus;
+    }
+
+    // Runs work once and logs its total and per-item cost
+    template<typename Work>
+    void MeasurePerItem(PCWSTR label, size_t count, Work&& work)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        work();
+        double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        wchar_t message[256] = { 0 };
+        StringCchPrintf(message, ARRAYSIZE(message), L"%s: %zu items in %.1f ms (%.3f us/item)\n", label, count, totalMs, totalMs * 1000.0 / count);
+        Logger::WriteMessage(message);
+    }
+
+    TEST_CLASS(RegExPerfTests)
+    {
+    public:
+        TEST_CLASS_INITIALIZE(ClassInitialize)
+        {
+            CSettingsInstance().SetUseBoostLib(false);
+        }
+
+        TEST_METHOD(CompiledPatternCache)
+        {
+            const std::wstring searchTerm = L"_(\\d+)_holiday";
+            const std::wstring replaceTerm = L"-$1-vacation";
+            const DWORD flags = MatchAllOccurences | UseRegularExpressions;
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+
+            // Reference: what Replace used to do for every item.
+            std::vector<std::wstring> expected;
+            expected.reserve(corpus.size());
+            MeasurePerItem(L"Uncached regex", corpus.size(), [&]() {
+                for (const auto& name : corpus)
+                {
+                    std::wstring replace = std::regex_replace(replaceTerm, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$[0]"), L"$1$$$0");
+                    replace = std::regex_replace(replace, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$([1-9])"), L"$1$0$4");
+                    std::wregex pattern(searchTerm, std::regex_constants::icase | std::regex_constants::ECMAScript);
+                    expected.push_back(std::regex_replace(name, pattern, replace));
+                }
+            });
+
+            CComPtr<IPowerRenameRegEx> renameRegEx;
+            Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+            Assert::IsTrue(renameRegEx->PutFlags(flags) == S_OK);
+            Assert::IsTrue(renameRegEx->PutSearchTerm(searchTerm.c_str()) == S_OK);
+            Assert::IsTrue(renameRegEx->PutReplaceTerm(replaceTerm.c_str()) == S_OK);
+
+            std::vector<std::wstring> actual;
+            actual.reserve(corpus.size());
+            MeasurePerItem(L"Cached regex", corpus.size(), [&]() {
+                for (const auto& name : corpus)
+                {
+                    PWSTR result = nullptr;
+                    Assert::IsTrue(renameRegEx->Replace(name.c_str(), &result) == S_OK);
+                    actual.push_back(result);
+                    CoTaskMemFree(result);
+                }
+            });
+
+            Assert::IsTrue(expected == actual);
+        }
+    };
+
+    TEST_CLASS(RegExEnginePerfTests)
+    {
+    public:
+        TEST_CLASS_CLEANUP(ClassCleanup)
+        {
+            CSettingsInstance().SetUseBoostLib(false);
+            CSettingsInstance().SetUseLinearRegex(false);
+        }
+
+        // Replaces every name with each engine and logs the per-item cost. Returns the number of
+        // names the linear engine failed on. The backtracking engines are skipped for patterns
+        // they take exponential time on.
+        size_t RunEngines(PCWSTR label, PCWSTR searchTerm, PCWSTR replaceTerm, const std::vector<std::wstring>& corpus, bool backtrackingEngines = true)
+        {
+            struct Engine
+            {
+                PCWSTR name;
+                bool useBoostLib;
+                bool useLinearRegex;
+            };
+            const Engine engines[] = {
+                { L"std", false, false },
+                { L"Boost", true, false },
+                { L"linear", false, true },
+            };
+
+            size_t linearFailures = 0;
+            for (const auto& engine : engines)
+            {
+                if (!engine.useLinearRegex && !backtrackingEngines)
+                {
+                    continue;
+                }
+
+                CSettingsInstance().SetUseBoostLib(engine.useBoostLib);
+                CSettingsInstance().SetUseLinearRegex(engine.useLinearRegex);
+
+                CComPtr<IPowerRenameRegEx> renameRegEx;
+                Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+                Assert::IsTrue(renameRegEx->PutFlags(MatchAllOccurences | UseRegularExpressions) == S_OK);
+                Assert::IsTrue(renameRegEx->PutSearchTerm(searchTerm) == S_OK);
+                Assert::IsTrue(renameRegEx->PutReplaceTerm(replaceTerm) == S_OK);
+
+                size_t failures = 0;
+                std::wstring message = std::wstring(label) + L" (" + engine.name + L")";
+                MeasurePerItem(message.c_str(), corpus.size(), [&]() {
+                    for (const auto& name : corpus)
+                    {
+                        PWSTR result = nullptr;
+                        if (FAILED(renameRegEx->Replace(name.c_str(), &result)))
+                        {
+                            failures++;
+                        }
+                        CoTaskMemFree(result);
+                    }
+                });
+
+                if (failures > 0)
+                {
+                    Logger::WriteMessage((message + L": " + std::to_wstring(failures) + L" failed\n").c_str());
+                }
+                if (engine.useLinearRegex)
+                {
+                    linearFailures = failures;
+                }
+            }
+            return linearFailures;
+        }
+
+        TEST_METHOD(TypicalPatterns)
+        {
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+            Assert::IsTrue(RunEngines(L"Capture groups", L"_(\\d+)_holiday", L"-$1-vacation", corpus) == 0);
+            Assert::IsTrue(RunEngines(L"Character classes", L"[a-z]+ trip \\d+", L"trip", corpus) == 0);
+            Assert::IsTrue(RunEngines(L"Alternation", L"jpe?g$|png$|gif$", L"img", corpus) == 0);
+        }
+
+        TEST_METHOD(AdversarialPatterns)
+        {
+            // Names made of one repeated character, where nested quantifiers make a backtracking
+            // engine try every way to split the name before failing. Every engine runs on short
+            // names, where the backtracking ones still finish, to compare their growth with the
+            // linear engine. Only the linear engine runs on the long names, the others would take
+            // minutes.
+            const size_t shortLength = 12;
+            const size_t longLength = 24;
+            const PCWSTR patterns[][2] = {
+                { L"Nested quantifiers", L"(a+)+b" },
+                { L"Overlapping alternatives", L"(a|aa)+$" },
+                { L"Repeated wildcards", L"a.*a.*a.*a.*b" },
+            };
+
+            std::vector<std::wstring> shortCorpus(100, std::wstring(shortLength, L'a') + L"!.txt");
+            std::vector<std::wstring> longCorpus(100, std::wstring(longLength, L'a') + L"!.txt");
+            for (const auto& [label, searchTerm] : patterns)
+            {
+                const std::wstring shortLabel = std::wstring(label) + L", " + std::to_wstring(shortLength) + L" characters";
+                Assert::IsTrue(RunEngines(shortLabel.c_str(), searchTerm, L"x", shortCorpus) == 0);
+                const std::wstring longLabel = std::wstring(label) + L", " + std::to_wstring(longLength) + L" characters";
+                Assert::IsTrue(RunEngines(longLabel.c_str(), searchTerm, L"x", longCorpus, false) == 0);
+            }
+        }
+    };
+
+    TEST_CLASS(LiteralPerfTests)
+    {
+    public:
+        TEST_METHOD(CaseInsensitiveReplace)
+        {
+            const std::wstring searchTerm = L"holiday trip";
+            const std::wstring replaceTerm = L"Vacation";
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+
+            // Reference: the previous literal search lower cased copies of the name and of the
+            // search term before every find.
+            std::vector<std::wstring> expected;
+            expected.reserve(corpus.size());
+            MeasurePerItem(L"Copy and lower case find", corpus.size(), [&]() {
+                for (const auto& name : corpus)
+                {
+                    std::wstring data = name;
+                    std::wstring toSearch = searchTerm;
+                    std::transform(data.begin(), data.end(), data.begin(), ::towlower);
+                    std::transform(toSearch.begin(), toSearch.end(), toSearch.begin(), ::towlower);
+                    std::wstring result = name;
+                    size_t pos = data.find(toSearch);
+                    if (pos != std::wstring::npos)
+                    {
+                        result.replace(pos, searchTerm.length(), replaceTerm);
+                    }
+                    expected.push_back(result);
+                }
+            });
+
+            const CLiteralMatcher matcher(searchTerm, false);
+            std::vector<std::wstring> actual;
+            actual.reserve(corpus.size());
+            MeasurePerItem(L"Literal matcher", corpus.size(), [&]() {
+                for (const auto& name : corpus)
+                {
+                    std::wstring result;
+                    matcher.Replace(name, replaceTerm, false, result);
+                    actual.push_back(result);
+                }
+            });
+
+            Assert::IsTrue(expected == actual);
+        }
+    };
+
+    TEST_CLASS(CaseTransformPerfTests)
+    {
+    public:
+        TEST_METHOD(PerNameCost)
+        {
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+
+            // Reference: the previous GetTransformedFileName set the global locale and split the
+            // name with fs::path for every name, and title case searched a vector of exception words.
+            auto previousTransform = [](const std::wstring& source, DWORD flags) {
+                std::locale::global(std::locale(""));
+                std::wstring stem = std::filesystem::path(source).stem().wstring();
+                std::wstring extension = std::filesystem::path(source).extension().wstring();
+                if (flags & Uppercase)
+                {
+                    std::transform(stem.begin(), stem.end(), stem.begin(), ::towupper);
+                    return stem + extension;
+                }
+
+                std::vector<std::wstring> exceptions = { L"a", L"an", L"to", L"the", L"at", L"by", L"for", L"in", L"of", L"on", L"up", L"and", L"as", L"but", L"or", L"nor" };
+                size_t stemLength = stem.length();
+                while (stemLength > 0 && (iswspace(stem[stemLength - 1]) || iswpunct(stem[stemLength - 1])))
+                {
+                    stemLength--;
+                }
+
+                bool isFirstWord = true;
+                for (size_t i = 0; i < stemLength; i++)
+                {
+                    if (!i || iswspace(stem[i - 1]) || iswpunct(stem[i - 1]))
+                    {
+                        if (iswspace(stem[i]) || iswpunct(stem[i]))
+                        {
+                            continue;
+                        }
+                        size_t wordLength = 0;
+                        while (i + wordLength < stemLength && !iswspace(stem[i + wordLength]) && !iswpunct(stem[i + wordLength]))
+                        {
+                            wordLength++;
+                        }
+                        if (isFirstWord || i + wordLength == stemLength || std::find(exceptions.begin(), exceptions.end(), stem.substr(i, wordLength)) == exceptions.end())
+                        {
+                            stem[i] = towupper(stem[i]);
+                            isFirstWord = false;
+                        }
+                        else
+                        {
+                            stem[i] = towlower(stem[i]);
+                        }
+                    }
+                    else
+                    {
+                        stem[i] = towlower(stem[i]);
+                    }
+                }
+                return stem + extension;
+            };
+
+            const DWORD flagsToMeasure[] = { Uppercase | NameOnly, Titlecase };
+            for (DWORD flags : flagsToMeasure)
+            {
+                PCWSTR label = (flags & Uppercase) ? L"upper case" : L"title case";
+
+                std::vector<std::wstring> expected;
+                expected.reserve(corpus.size());
+                MeasurePerItem((std::wstring(L"Global locale per name, ") + label).c_str(), corpus.size(), [&]() {
+                    for (const auto& name : corpus)
+                    {
+                        expected.push_back(previousTransform(name, flags));
+                    }
+                });
+
+                std::vector<std::wstring> actual(corpus.size());
+                MeasurePerItem((std::wstring(L"Case transformer per pass, ") + label).c_str(), corpus.size(), [&]() {
+                    const CCaseTransformer transformer(flags);
+                    for (size_t i = 0; i < corpus.size(); i++)
+                    {
+                        transformer.Transform(corpus[i], actual[i]);
+                    }
+                });
+
+                Assert::IsTrue(expected == actual);
+            }
+        }
+    };
+
+    TEST_CLASS(DateTemplatePerfTests)
+    {
+    public:
+        TEST_METHOD(PerItemCost)
+        {
+            // The reference compiles twenty patterns per item, so it runs on a smaller corpus
+            const size_t itemCount = c_corpusSize / 10;
+            const std::wstring replaceTerm = L"IMG_$YYYY-$MM-$DD_$hh.$mm.$ss.$fff";
+            std::vector<SYSTEMTIME> fileTimes(itemCount);
+            for (size_t i = 0; i < itemCount; i++)
+            {
+                fileTimes[i] = { static_cast<WORD>(2000 + i % 25), static_cast<WORD>(1 + i % 12), 0, static_cast<WORD>(1 + i % 28), static_cast<WORD>(i % 24), static_cast<WORD>(i % 60), static_cast<WORD>(i / 60 % 60), static_cast<WORD>(i % 1000) };
+            }
+
+            // Reference: the previous GetDatedFileName expanded every numeric token with its own regex
+            // for every item, while the worker set the item's file time on the shared regex object.
+            auto previousDatedName = [](const std::wstring& source, const SYSTEMTIME& fileTime) {
+                const struct
+                {
+                    PCWSTR token;
+                    PCWSTR format;
+                    int value;
+                } tokens[] = {
+                    { L"YYYY", L"%04d", fileTime.wYear },
+                    { L"YY", L"%02d", fileTime.wYear % 100 },
+                    { L"Y", L"%d", fileTime.wYear % 10 },
+                    { L"MM", L"%02d", fileTime.wMonth },
+                    { L"M", L"%d", fileTime.wMonth },
+                    { L"DD", L"%02d", fileTime.wDay },
+                    { L"D", L"%d", fileTime.wDay },
+                    { L"hh", L"%02d", fileTime.wHour },
+                    { L"h", L"%d", fileTime.wHour },
+                    { L"mm", L"%02d", fileTime.wMinute },
+                    { L"m", L"%d", fileTime.wMinute },
+                    { L"ss", L"%02d", fileTime.wSecond },
+                    { L"s", L"%d", fileTime.wSecond },
+                    { L"fff", L"%03d", fileTime.wMilliseconds },
+                    { L"ff", L"%02d", fileTime.wMilliseconds / 10 },
+                    { L"f", L"%d", fileTime.wMilliseconds / 100 },
+                };
+
+                std::wstring res(source);
+                for (const auto& token : tokens)
+                {
+                    wchar_t value[16] = { 0 };
+                    StringCchPrintf(value, ARRAYSIZE(value), token.format, token.value);
+                    res = std::regex_replace(res, std::wregex(std::wstring(L"(([^\\$]|^)(\\$\\$)*)\\$") + token.token), std::wstring(L"$01") + value);
+                }
+                return res;
+            };
+
+            std::vector<std::wstring> expected;
+            expected.reserve(itemCount);
+            MeasurePerItem(L"Date tokens expanded per item", itemCount, [&]() {
+                for (size_t i = 0; i < itemCount; i++)
+                {
+                    expected.push_back(previousDatedName(replaceTerm, fileTimes[i]));
+                }
+            });
+
+            std::vector<std::wstring> actual(itemCount);
+            MeasurePerItem(L"Date template compiled per pass", itemCount, [&]() {
+                const CDateTemplate dateTemplate(replaceTerm);
+                for (size_t i = 0; i < itemCount; i++)
+                {
+                    dateTemplate.Format(fileTimes[i], actual[i]);
+                }
+            });
+
+            Assert::IsTrue(expected == actual);
+        }
+    };
+
+    TEST_CLASS(VisibilityPerfTests)
+    {
+    public:
+        TEST_METHOD(FilteredListPaint)
+        {
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+
+            // Every other item is unselected
+            for (size_t i = 0; i < corpus.size(); i++)
+            {
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(CMockPowerRenameItem::CreateInstance(corpus[i].c_str(), corpus[i].c_str(), 0, false, SYSTEMTIME{ 0 }, &item) == S_OK);
+                item->PutSelected(i % 2 == 0);
+                Assert::IsTrue(mgr->AddItem(item) == S_OK);
+            }
+
+            // None -> Selected
+            Assert::IsTrue(mgr->SwitchFilter(0) == S_OK);
+
+            // The list view asks for the visible count and then for each visible row
+            UINT visibleCount = 0;
+            MeasurePerItem(L"Visible item lookup", c_corpusSize / 2, [&]() {
+                for (UINT i = 0; i < c_corpusSize / 2; i++)
+                {
+                    Assert::IsTrue(mgr->GetVisibleItemCount(&visibleCount) == S_OK);
+                    CComPtr<IPowerRenameItem> item;
+                    Assert::IsTrue(mgr->GetVisibleItemByIndex(i, &item) == S_OK);
+                }
+            });
+
+            Assert::IsTrue(visibleCount == c_corpusSize / 2);
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+        }
+    };
+
+    TEST_CLASS(ViewportPerfTests)
+    {
+    public:
+        TEST_METHOD(TimeToViewportNames)
+        {
+            // The list is scrolled to the middle of the selection, the rows on screen only get
+            // their names once the chunks above them are done when evaluated in order.
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+            const UINT firstRow = static_cast<UINT>(c_corpusSize / 2);
+            const UINT lastRow = firstRow + 40;
+            const size_t chunkSize = 256;
+
+            CComPtr<IPowerRenameRegEx> renameRegEx;
+            Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+            Assert::IsTrue(renameRegEx->PutFlags(MatchAllOccurences) == S_OK);
+            Assert::IsTrue(renameRegEx->PutSearchTerm(L"Holiday Trip") == S_OK);
+            Assert::IsTrue(renameRegEx->PutReplaceTerm(L"Vacation") == S_OK);
+            const CCaseTransformer transformer(MatchAllOccurences);
+
+            auto runPass = [&](PCWSTR label, const CWorkerPool::ChunkClaim* claimChunk, std::vector<std::wstring>& names) {
+                names.assign(corpus.size(), std::wstring());
+                std::atomic<size_t> viewportLeft = lastRow - firstRow + 1;
+                std::chrono::steady_clock::duration viewportElapsed{};
+                const auto start = std::chrono::steady_clock::now();
+                auto evaluate = [&](size_t begin, size_t end) {
+                    size_t viewportDone = 0;
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        ComputeNewName(corpus[i].c_str(), corpus[i].c_str(), MatchAllOccurences, renameRegEx, nullptr, transformer, names[i]);
+                        viewportDone += (i >= firstRow && i <= lastRow) ? 1 : 0;
+                    }
+                    if (viewportDone > 0 && (viewportLeft -= viewportDone) == 0)
+                    {
+                        viewportElapsed = std::chrono::steady_clock::now() - start;
+                    }
+                    return true;
+                };
+
+                const unsigned int workerCount = CWorkerPool::DefaultWorkerCount();
+                Assert::IsTrue(claimChunk ? CWorkerPool::RunChunked(corpus.size(), chunkSize, workerCount, *claimChunk, evaluate) :
+                                            CWorkerPool::RunChunked(corpus.size(), chunkSize, workerCount, evaluate));
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+
+                wchar_t message[256] = { 0 };
+                StringCchPrintf(message, ARRAYSIZE(message), L"%s: viewport named after %.1f ms, every item after %.1f ms\n", label, std::chrono::duration<double, std::milli>(viewportElapsed).count(), std::chrono::duration<double, std::milli>(elapsed).count());
+                Logger::WriteMessage(message);
+            };
+
+            std::vector<std::wstring> expected;
+            runPass(L"Items in order", nullptr, expected);
+
+            CViewportHint hint;
+            hint.Set(firstRow, lastRow);
+            CViewportScheduler scheduler(CWorkerPool::GetChunkCount(corpus.size(), chunkSize), hint, [chunkSize](UINT itemIndex) {
+                return itemIndex / chunkSize;
+            });
+            const CWorkerPool::ChunkClaim claimChunk = [&scheduler](size_t& chunk) {
+                return scheduler.Claim(chunk);
+            };
+            std::vector<std::wstring> actual;
+            runPass(L"Viewport first", &claimChunk, actual);
+
+            Assert::IsTrue(expected == actual);
+        }
+    };
+
+    TEST_CLASS(UpdateBatchPerfTests)
+    {
+    public:
+        TEST_METHOD(NotificationsPerPreviewPass)
+        {
+            // Every item of the selection gets a new name, as when typing the first character
+            // of a search term that matches everything. Previously each item was one message
+            // and one full list redraw.
+            CItemRangeBatch batch(std::chrono::milliseconds(16), 4096);
+            size_t notifications = 0;
+            size_t ranges = 0;
+            MeasurePerItem(L"Batched item updates", c_corpusSize, [&]() {
+                for (unsigned int i = 0; i < c_corpusSize; i++)
+                {
+                    if (batch.Add(i))
+                    {
+                        notifications++;
+                        ranges += batch.Take().size();
+                    }
+                }
+                ranges += batch.Take().size();
+            });
+
+            wchar_t message[256] = { 0 };
+            StringCchPrintf(message, ARRAYSIZE(message), L"Update notifications: %zu, redrawn ranges: %zu for %zu items\n", notifications, ranges, c_corpusSize);
+            Logger::WriteMessage(message);
+
+            Assert::IsTrue(notifications < c_corpusSize / 1000);
+        }
+    };
+
+    TEST_CLASS(TypeAheadPerfTests)
+    {
+    public:
+        static void WaitForPreview(CMockPowerRenameManagerEvents* mockMgrEvents)
+        {
+            while (!mockMgrEvents->m_regExCompleted)
+            {
+                MSG msg;
+                while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+                {
+                    TranslateMessage(&msg);
+                    DispatchMessage(&msg);
+                }
+                Sleep(1);
+            }
+        }
+
+        TEST_METHOD(KeystrokeLatency)
+        {
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+            CMockPowerRenameManagerEvents* mockMgrEvents = new CMockPowerRenameManagerEvents();
+            CComPtr<IPowerRenameManagerEvents> mgrEvents;
+            Assert::IsTrue(mockMgrEvents->QueryInterface(IID_PPV_ARGS(&mgrEvents)) == S_OK);
+            DWORD cookie = 0;
+            Assert::IsTrue(mgr->Advise(mgrEvents, &cookie) == S_OK);
+
+            for (const auto& name : corpus)
+            {
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(CMockPowerRenameItem::CreateInstance(name.c_str(), name.c_str(), 0, false, SYSTEMTIME{ 0 }, &item) == S_OK);
+                Assert::IsTrue(mgr->AddItem(item) == S_OK);
+            }
+
+            CComPtr<IPowerRenameRegEx> renRegEx;
+            Assert::IsTrue(mgr->GetRenameRegEx(&renRegEx) == S_OK);
+            mockMgrEvents->m_regExCompleted = false;
+            renRegEx->PutFlags(MatchAllOccurences);
+            WaitForPreview(mockMgrEvents);
+            mockMgrEvents->m_regExCompleted = false;
+            renRegEx->PutReplaceTerm(L"-");
+            WaitForPreview(mockMgrEvents);
+
+            // Time from the edit to the end of its preview pass, including the debounce delay.
+            // The first keystroke evaluates every item, the next ones only the items that
+            // still match.
+            const std::wstring typedTerm = L"_00012";
+            for (size_t length = 1; length <= typedTerm.size(); length++)
+            {
+                std::wstring searchTerm = typedTerm.substr(0, length);
+                std::wstring label = L"Keystroke '" + searchTerm + L"'";
+                mockMgrEvents->m_regExCompleted = false;
+                MeasurePerItem(label.c_str(), corpus.size(), [&]() {
+                    renRegEx->PutSearchTerm(searchTerm.c_str());
+                    WaitForPreview(mockMgrEvents);
+                });
+            }
+
+            UINT renameCount = 0;
+            Assert::IsTrue(mgr->GetRenameItemCount(&renameCount) == S_OK);
+            Assert::IsTrue(renameCount == 10);
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+            mockMgrEvents->Release();
+        }
+    };
+
+    TEST_CLASS(ItemStorePerfTests)
+    {
+    public:
+        static SIZE_T GetPrivateBytes()
+        {
+            PROCESS_MEMORY_COUNTERS_EX counters = { 0 };
+            counters.cb = sizeof(counters);
+            GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters));
+            return counters.PrivateUsage;
+        }
+
+        TEST_METHOD(MemoryPerItem)
+        {
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+            std::vector<CComPtr<IPowerRenameItem>> items;
+            items.reserve(corpus.size());
+
+            SIZE_T privateBytesBefore = GetPrivateBytes();
+            for (const auto& name : corpus)
+            {
+                std::wstring path = L"C:\\Users\\Public\\Pictures\\2020\\" + name;
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(CMockPowerRenameItem::CreateInstance(path.c_str(), name.c_str(), 0, false, SYSTEMTIME{ 0 }, &item) == S_OK);
+                Assert::IsTrue(item->PutNewName(name.c_str()) == S_OK);
+                items.push_back(item);
+            }
+            SIZE_T privateBytesAfter = GetPrivateBytes();
+
+            wchar_t message[256] = { 0 };
+            StringCchPrintf(message, ARRAYSIZE(message), L"Item memory: %.1f bytes/item (object size %zu bytes)\n", static_cast<double>(privateBytesAfter - privateBytesBefore) / items.size(), sizeof(CMockPowerRenameItem));
+            Logger::WriteMessage(message);
+
+            // Names read back from the arena storage
+            PWSTR originalName = nullptr;
+            Assert::IsTrue(items[0]->GetOriginalName(&originalName) == S_OK);
+            Assert::IsTrue(corpus[0] == originalName);
+            CoTaskMemFree(originalName);
+        }
+    };
+
+    TEST_CLASS(EnumerationPerfTests)
+    {
+    public:
+        TEST_METHOD(MillionItems)
+        {
+            const size_t itemCount = 1000000;
+            std::vector<std::wstring> corpus = CreateCorpus(itemCount);
+
+            // Reference: what the preview did for every item
+            std::vector<std::wstring> expected(itemCount);
+            MeasurePerItem(L"GetEnumeratedFileName", itemCount, [&]() {
+                for (size_t i = 0; i < itemCount; i++)
+                {
+                    wchar_t uniqueName[MAX_PATH] = { 0 };
+                    unsigned long countUsed = 0;
+                    if (GetEnumeratedFileName(uniqueName, ARRAYSIZE(uniqueName), corpus[i].c_str(), nullptr, static_cast<unsigned long>(i + 1), &countUsed))
+                    {
+                        expected[i] = uniqueName;
+                    }
+                }
+            });
+
+            std::vector<std::wstring> results(itemCount);
+            CEnumerationTemplate enumeration;
+            MeasurePerItem(L"Enumeration template", itemCount, [&]() {
+                for (size_t i = 0; i < itemCount; i++)
+                {
+                    enumeration.Reset(corpus[i]);
+                    results[i] = enumeration.Format(static_cast<unsigned long>(i));
+                }
+            });
+
+            // GetEnumeratedFileName stops below a million
+            for (size_t i = 0; i + 1 < itemCount; i++)
+            {
+                Assert::IsTrue(expected[i] == results[i]);
+            }
+            Assert::IsTrue(expected.back().empty());
+        }
+    };
+
+    TEST_CLASS(RenameEnginePerfTests)
+    {
+    public:
+        TEST_METHOD(PreviewThroughput)
+        {
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+            std::vector<RenameEngineItem> items(corpus.size());
+            for (size_t i = 0; i < corpus.size(); i++)
+            {
+                items[i].path = std::filesystem::path(L"C:\\Users\\Public\\Pictures\\2020") / corpus[i];
+            }
+
+            const RenameRule rule = { L"Holiday Trip", L"Vacation", MatchAllOccurences | Titlecase };
+
+            // Reference: one name at a time on the calling thread, like the dialog without workers
+            CComPtr<IPowerRenameRegEx> renameRegEx;
+            Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+            Assert::IsTrue(renameRegEx->PutFlags(rule.flags) == S_OK);
+            Assert::IsTrue(renameRegEx->PutSearchTerm(rule.searchTerm.c_str()) == S_OK);
+            Assert::IsTrue(renameRegEx->PutReplaceTerm(rule.replaceTerm.c_str()) == S_OK);
+            const CCaseTransformer transformer(rule.flags);
+
+            std::vector<std::wstring> expected(corpus.size());
+            MeasurePerItem(L"Names computed one at a time", corpus.size(), [&]() {
+                for (size_t i = 0; i < corpus.size(); i++)
+                {
+                    const std::wstring sourceName = GetRenameSource(corpus[i].c_str(), rule.flags);
+                    ComputeNewName(corpus[i].c_str(), sourceName.c_str(), rule.flags, renameRegEx, nullptr, transformer, expected[i]);
+                }
+            });
+
+            CRenameEngine engine;
+            Assert::IsTrue(engine.Init(rule) == S_OK);
+            MeasurePerItem(L"Rename engine preview", items.size(), [&]() {
+                Assert::IsTrue(engine.Preview(items, CWorkerPool::DefaultWorkerCount()) == S_OK);
+            });
+
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                Assert::IsTrue(expected[i] == items[i].newName);
+            }
+        }
+    };
+
+    TEST_CLASS(RenamePipelinePerfTests)
+    {
+    public:
+        TEST_METHOD(PipelineAgainstRunPerRule)
+        {
+            std::vector<std::wstring> corpus = CreateCorpus(c_corpusSize);
+            std::vector<RenameEngineItem> items(corpus.size());
+            for (size_t i = 0; i < corpus.size(); i++)
+            {
+                items[i].path = std::filesystem::path(L"C:\\Users\\Public\\Pictures\\2020") / corpus[i];
+            }
+
+            const std::vector<RenameRule> rules = { { L"Holiday Trip", L"Vacation", MatchAllOccurences | NameOnly },
+                                                    { L"IMG_", L"Photo ", MatchAllOccurences },
+                                                    { L"jpg", L"jpeg", MatchAllOccurences | ExtensionOnly | Uppercase } };
+
+            // Reference: one preview per rule, each on the names of the previous one
+            std::vector<RenameEngineItem> runItems = items;
+            MeasurePerItem(L"One preview per rule", items.size(), [&]() {
+                for (const RenameRule& rule : rules)
+                {
+                    CRenameEngine engine;
+                    Assert::IsTrue(engine.Init(rule) == S_OK);
+                    Assert::IsTrue(engine.Preview(runItems, CWorkerPool::DefaultWorkerCount()) == S_OK);
+                    for (RenameEngineItem& item : runItems)
+                    {
+                        if (!item.newName.empty())
+                        {
+                            item.path.replace_filename(item.newName);
+                        }
+                    }
+                }
+            });
+
+            std::vector<RenameStep> steps;
+            for (const RenameRule& rule : rules)
+            {
+                steps.push_back({ RenameStepType::LiteralReplace, rule.searchTerm, rule.replaceTerm, rule.flags });
+                steps.push_back({ RenameStepType::Trim });
+                steps.push_back({ RenameStepType::ChangeCase, L"", L"", rule.flags });
+            }
+
+            CRenameEngine engine;
+            Assert::IsTrue(engine.InitPipeline(steps, 0) == S_OK);
+            MeasurePerItem(L"Pipeline in one pass", items.size(), [&]() {
+                Assert::IsTrue(engine.Preview(items, CWorkerPool::DefaultWorkerCount()) == S_OK);
+            });
+
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                Assert::IsTrue(runItems[i].path.filename().wstring() == items[i].newName);
+            }
+        }
+    };
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "targetver.h"
+
+#include <atlbase.h>
+
+// Headers for CppUnitTest
+#include "CppUnitTest.h"
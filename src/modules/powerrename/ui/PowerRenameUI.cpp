@@ -14,6 +14,9 @@
 
 extern HINSTANCE g_hInst;
 
+// Posted by _OnInitDlg, so that the items are enumerated once the dialog is shown
+const UINT WM_PRIV_ENUMERATE_ITEMS = WM_APP + 1;
+
 enum
 {
     MATCHMODE_FULLNAME = 0,
@@ -183,7 +186,7 @@ IFACEMETHODIMP CPowerRenameUI::OnItemAdded(_In_ IPowerRenameItem*)
     return S_OK;
 }
 
-IFACEMETHODIMP CPowerRenameUI::OnUpdate(_In_ IPowerRenameItem*)
+IFACEMETHODIMP CPowerRenameUI::OnUpdate(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex)
 {
     UINT visibleItemCount = 0;
     if (m_spsrm)
@@ -191,13 +194,21 @@ IFACEMETHODIMP CPowerRenameUI::OnUpdate(_In_ IPowerRenameItem*)
         m_spsrm->GetVisibleItemCount(&visibleItemCount);
     }
     m_listview.SetItemCount(visibleItemCount);
-    m_listview.RedrawItems(0, visibleItemCount);
+
+    // Only redraw the rows of the updated items
+    if (firstVisibleIndex < visibleItemCount)
+    {
+        UINT last = (lastVisibleIndex < visibleItemCount) ? lastVisibleIndex : visibleItemCount - 1;
+        m_listview.RedrawItems(firstVisibleIndex, last);
+    }
     _UpdateCounts();
     return S_OK;
 }
 
 IFACEMETHODIMP CPowerRenameUI::OnError(_In_ IPowerRenameItem*)
 {
+    // Reported to the user once the rename completes
+    m_renameFailedCount++;
     return S_OK;
 }
 
@@ -233,6 +244,8 @@ IFACEMETHODIMP CPowerRenameUI::OnRegExCompleted(_In_ DWORD threadId)
 
 IFACEMETHODIMP CPowerRenameUI::OnRenameStarted()
 {
+    m_renameFailedCount = 0;
+
     // Disable controls
     EnableWindow(m_hwnd, FALSE);
     return S_OK;
@@ -243,6 +256,17 @@ IFACEMETHODIMP CPowerRenameUI::OnRenameCompleted()
     // Enable controls
     EnableWindow(m_hwnd, TRUE);
 
+    if (m_renameFailedCount > 0)
+    {
+        wchar_t messageFormat[100] = { 0 };
+        wchar_t message[100] = { 0 };
+        wchar_t title[100] = { 0 };
+        LoadString(g_hInst, IDS_RENAME_FAILED_FMT, messageFormat, ARRAYSIZE(messageFormat));
+        StringCchPrintf(message, ARRAYSIZE(message), messageFormat, m_renameFailedCount);
+        LoadString(g_hInst, IDS_APP_TITLE, title, ARRAYSIZE(title));
+        MessageBox(m_hwnd, message, title, MB_OK | MB_ICONWARNING);
+    }
+
     // Close the window
     PostMessage(m_hwnd, WM_CLOSE, (WPARAM)0, (LPARAM)0);
     return S_OK;
@@ -251,6 +275,11 @@ IFACEMETHODIMP CPowerRenameUI::OnRenameCompleted()
 // IDropTarget
 IFACEMETHODIMP CPowerRenameUI::DragEnter(_In_ IDataObject* pdtobj, DWORD /* grfKeyState */, POINTL pt, _Inout_ DWORD* pdwEffect)
 {
+    if (m_enumerating)
+    {
+        *pdwEffect = DROPEFFECT_NONE;
+    }
+
     if (m_spdth)
     {
         POINT ptT = { pt.x, pt.y };
@@ -262,6 +291,11 @@ IFACEMETHODIMP CPowerRenameUI::DragEnter(_In_ IDataObject* pdtobj, DWORD /* grfK
 
 IFACEMETHODIMP CPowerRenameUI::DragOver(DWORD /* grfKeyState */, POINTL pt, _Inout_ DWORD* pdwEffect)
 {
+    if (m_enumerating)
+    {
+        *pdwEffect = DROPEFFECT_NONE;
+    }
+
     if (m_spdth)
     {
         POINT ptT = { pt.x, pt.y };
@@ -283,6 +317,17 @@ IFACEMETHODIMP CPowerRenameUI::DragLeave()
 
 IFACEMETHODIMP CPowerRenameUI::Drop(_In_ IDataObject* pdtobj, DWORD, POINTL pt, _Inout_ DWORD* pdwEffect)
 {
+    if (m_enumerating)
+    {
+        // The items of the previous data object are still being added
+        *pdwEffect = DROPEFFECT_NONE;
+        if (m_spdth)
+        {
+            m_spdth->DragLeave();
+        }
+        return S_OK;
+    }
+
     if (m_spdth)
     {
         POINT ptT = { pt.x, pt.y };
@@ -390,22 +435,38 @@ HRESULT CPowerRenameUI::_EnumerateItems(_In_ IUnknown* pdtobj)
 {
     HRESULT hr = S_OK;
     // Enumerate the data object and populate the manager
-    if (m_spsrm)
+    if (m_spsrm && !m_enumerating)
     {
         m_disableCountUpdate = true;
 
-        // Ensure we re-create the enumerator
+        // Start pumps messages while the items are walked. Until it returns, drops are
+        // refused, Rename is disabled and closing the dialog only cancels the enumeration.
+        m_enumerating = true;
+        EnableWindow(GetDlgItem(m_hwnd, ID_RENAME), FALSE);
+
+        // Ensure we re-create the enumerator. The local reference keeps it alive until Start
+        // returns.
+        CComPtr<IPowerRenameEnum> sppre;
         m_sppre = nullptr;
-        hr = CPowerRenameEnum::s_CreateInstance(pdtobj, m_spsrm, IID_PPV_ARGS(&m_sppre));
+        hr = CPowerRenameEnum::s_CreateInstance(pdtobj, m_spsrm, IID_PPV_ARGS(&sppre));
         if (SUCCEEDED(hr))
         {
+            m_sppre = sppre;
             m_prpui.Start();
-            hr = m_sppre->Start();
+            hr = sppre->Start();
             m_prpui.Stop();
         }
 
+        m_enumerating = false;
         m_disableCountUpdate = false;
 
+        if (m_closePending)
+        {
+            m_closePending = false;
+            _OnCloseDlg();
+            return E_ABORT;
+        }
+
         if (SUCCEEDED(hr))
         {
             UINT itemCount = 0;
@@ -414,6 +475,9 @@ HRESULT CPowerRenameUI::_EnumerateItems(_In_ IUnknown* pdtobj)
 
             _UpdateCounts();
         }
+
+        // _UpdateCounts only updates the button when the counts change
+        EnableWindow(GetDlgItem(m_hwnd, ID_RENAME), (m_renamingCount > 0));
     }
 
     return hr;
@@ -486,6 +550,17 @@ HRESULT CPowerRenameUI::_WriteSettings()
 
 void CPowerRenameUI::_OnCloseDlg()
 {
+    if (m_enumerating)
+    {
+        // Start is still on the stack, _EnumerateItems closes the dialog once it returns
+        m_closePending = true;
+        if (m_sppre)
+        {
+            m_sppre->Cancel();
+        }
+        return;
+    }
+
     if (m_hwnd != NULL)
     {
         if (m_modeless)
@@ -590,6 +665,10 @@ INT_PTR CPowerRenameUI::_DlgProc(UINT uMsg, WPARAM wParam, LPARAM lParam)
         _OnInitDlg();
         break;
 
+    case WM_PRIV_ENUMERATE_ITEMS:
+        _OnEnumerateDataSource();
+        break;
+
     case WM_COMMAND:
         _OnCommand(wParam, lParam);
         break;
@@ -633,22 +712,18 @@ void CPowerRenameUI::_OnInitDlg()
 
     m_listview.Init(m_hwndLV);
 
+    // Initialize from stored settings. Do this before the enumeration so a
+    // restored search or replace text is evaluated against the items while
+    // they are enumerated.
+    _ReadSettings();
+
     if (m_dataSource)
     {
-        // Populate the manager from the data object
-        if (FAILED(_EnumerateItems(m_dataSource)))
-        {
-            // Failed during enumeration.  Close the dialog.
-            _OnCloseDlg();
-            return;
-        }
+        // Populate the manager from the data object once the dialog is visible, so the
+        // items show up while the rest of them are walked
+        PostMessage(m_hwnd, WM_PRIV_ENUMERATE_ITEMS, 0, 0);
     }
 
-    // Initialize from stored settings. Do this now in case we have
-    // restored a previous search or replace text that needs to be
-    // evaluated against the items we just enumerated.
-    _ReadSettings();
-
     // Load the main icon
     LoadIconWithScaleDown(g_hInst, MAKEINTRESOURCE(IDI_RENAME), 32, 32, &m_iconMain);
 
@@ -687,6 +762,22 @@ void CPowerRenameUI::_OnInitDlg()
     m_initialized = true;
 }
 
+void CPowerRenameUI::_OnEnumerateDataSource()
+{
+    // The modal dialog loop may not have shown the dialog yet
+    if (!IsWindowVisible(m_hwnd))
+    {
+        ShowWindow(m_hwnd, SW_SHOWNORMAL);
+        UpdateWindow(m_hwnd);
+    }
+
+    if (m_dataSource && FAILED(_EnumerateItems(m_dataSource)))
+    {
+        // Failed during enumeration.  Close the dialog.
+        _OnCloseDlg();
+    }
+}
+
 void UpdateDlgControl(HWND dlg, int item_id, int string_id)
 {
     HWND control = GetDlgItem(dlg, item_id);
@@ -728,7 +819,11 @@ void CPowerRenameUI::_OnCommand(_In_ WPARAM wParam, _In_ LPARAM lParam)
     {
     case IDOK:
     case ID_RENAME:
-        _OnRename();
+        // Enter reaches here even while the button is disabled
+        if (!m_enumerating)
+        {
+            _OnRename();
+        }
         break;
 
     case ID_ABOUT:
@@ -1067,7 +1162,7 @@ void CPowerRenameUI::_UpdateCounts()
         SetDlgItemText(m_hwnd, IDC_STATUS_MESSAGE_RENAMING, countsLabelRenaming);
 
         // Update Rename button state
-        EnableWindow(GetDlgItem(m_hwnd, ID_RENAME), (renamingCount > 0));
+        EnableWindow(GetDlgItem(m_hwnd, ID_RENAME), (renamingCount > 0 && !m_enumerating));
     }
 }
 
@@ -1164,6 +1259,7 @@ void CPowerRenameListView::ToggleAll(_In_ IPowerRenameManager* psrm, _In_ bool s
             }
         }
 
+        psrm->SetVisible();
         psrm->GetVisibleItemCount(&visibleItemCount);
         SetItemCount(visibleItemCount);
         RedrawItems(0, visibleItemCount);
@@ -1179,6 +1275,10 @@ void CPowerRenameListView::ToggleItem(_In_ IPowerRenameManager* psrm, _In_ int i
         spItem->GetSelected(&selected);
         spItem->PutSelected(!selected);
 
+        int id = 0;
+        spItem->GetId(&id);
+        psrm->UpdateItemVisibility(id);
+
         UINT visibleItemCount = 0;
         psrm->GetVisibleItemCount(&visibleItemCount);
         SetItemCount(visibleItemCount);
@@ -1225,6 +1325,10 @@ void CPowerRenameListView::UpdateItemCheckState(_In_ IPowerRenameManager* psrm,
             bool checked = ListView_GetCheckState(m_hwndLV, iItem);
             spItem->PutSelected(checked);
 
+            int id = 0;
+            spItem->GetId(&id);
+            psrm->UpdateItemVisibility(id);
+
             UINT uSelected = (checked) ? LVIS_SELECTED : 0;
             ListView_SetItemState(m_hwndLV, iItem, uSelected, LVIS_SELECTED);
 
@@ -1248,6 +1352,8 @@ void CPowerRenameListView::UpdateItemCheckState(_In_ IPowerRenameManager* psrm,
 
 void CPowerRenameListView::GetDisplayInfo(_In_ IPowerRenameManager* psrm, _Inout_ LV_DISPINFO* plvdi)
 {
+    _UpdateViewport(psrm);
+
     UINT count = 0;
     psrm->GetVisibleItemCount(&count);
     if (plvdi->item.iItem < 0 || plvdi->item.iItem > static_cast<int>(count))
@@ -1340,6 +1446,23 @@ void CPowerRenameListView::SetItemCount(_In_ UINT itemCount)
     {
         m_itemCount = itemCount;
         ListView_SetItemCount(m_hwndLV, itemCount);
+
+        // The rows may show other items now (ex: the filter changed)
+        m_viewportFirst = -1;
+        m_viewportLast = -1;
+    }
+}
+
+void CPowerRenameListView::_UpdateViewport(_In_ IPowerRenameManager* psrm)
+{
+    // Rows are asked for as they are painted, so this follows scrolling and resizing
+    const int first = ListView_GetTopIndex(m_hwndLV);
+    const int last = first + ListView_GetCountPerPage(m_hwndLV);
+    if (first != m_viewportFirst || last != m_viewportLast)
+    {
+        m_viewportFirst = first;
+        m_viewportLast = last;
+        psrm->PutViewport(static_cast<UINT>(first), static_cast<UINT>(last));
     }
 }
 
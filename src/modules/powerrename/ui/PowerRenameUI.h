@@ -30,9 +30,13 @@ private:
     void _UpdateColumnSizes();
     void _UpdateHeaderCheckState(_In_ bool check);
     void _UpdateHeaderFilterState(_In_ DWORD filter);
+    void _UpdateViewport(_In_ IPowerRenameManager* psrm);
 
     UINT m_itemCount = 0;
     HWND m_hwndLV = nullptr;
+    // Rows last reported to the manager as the viewport
+    int m_viewportFirst = -1;
+    int m_viewportLast = -1;
 };
 
 class CPowerRenameProgressUI :
@@ -96,7 +100,7 @@ public:
 
     // IPowerRenameManagerEvents
     IFACEMETHODIMP OnItemAdded(_In_ IPowerRenameItem* renameItem);
-    IFACEMETHODIMP OnUpdate(_In_ IPowerRenameItem* renameItem);
+    IFACEMETHODIMP OnUpdate(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex);
     IFACEMETHODIMP OnError(_In_ IPowerRenameItem* renameItem);
     IFACEMETHODIMP OnRegExStarted(_In_ DWORD threadId);
     IFACEMETHODIMP OnRegExCanceled(_In_ DWORD threadId);
@@ -163,6 +167,7 @@ private:
     void _OnSize(_In_ WPARAM wParam);
     void _OnGetMinMaxInfo(_In_ LPARAM lParam);
     void _OnInitDlg();
+    void _OnEnumerateDataSource();
     void _InitDlgText();
     void _OnRename();
     void _OnAbout();
@@ -188,6 +193,10 @@ private:
     bool m_enableDragDrop = false;
     bool m_disableCountUpdate = false;
     bool m_modeless = true;
+    // _EnumerateItems is waiting for the enumerator, with messages dispatched
+    bool m_enumerating = false;
+    // The dialog was closed during the enumeration
+    bool m_closePending = false;
     HWND m_hwnd = nullptr;
     HWND m_hwndLV = nullptr;
     HICON m_iconMain = nullptr;
@@ -195,6 +204,8 @@ private:
     DWORD m_currentRegExId = 0;
     UINT m_selectedCount = 0;
     UINT m_renamingCount = 0;
+    // Items the last rename operation failed to rename
+    UINT m_renameFailedCount = 0;
     UINT m_initialDPI = 0;
     DialogItemsPositioning m_itemsPositioning {};
     int m_initialWidth = 0;
@@ -18,18 +18,10 @@ HRESULT CMockPowerRenameItem::CreateInstance(_In_opt_ PCWSTR path, _In_opt_ PCWS
 
 void CMockPowerRenameItem::Init(_In_opt_ PCWSTR path, _In_opt_ PCWSTR originalName, _In_ UINT depth, _In_ bool isFolder, _In_ SYSTEMTIME time)
 {
-    if (path != nullptr)
-    {
-        SHStrDup(path, &m_path);
-    }
-
-    if (originalName != nullptr)
-    {
-        SHStrDup(originalName, &m_originalName);
-    }
+    _InitNames(path, originalName);
 
     m_depth = depth;
     m_isFolder = isFolder;
     m_time = time;
-    m_isTimeParsed = true;
+    m_hasMetadata = true;
 }
@@ -35,9 +35,11 @@ IFACEMETHODIMP CMockPowerRenameManagerEvents::OnItemAdded(_In_ IPowerRenameItem*
     return S_OK;
 }
 
-IFACEMETHODIMP CMockPowerRenameManagerEvents::OnUpdate(_In_ IPowerRenameItem* pItem)
+IFACEMETHODIMP CMockPowerRenameManagerEvents::OnUpdate(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex)
 {
-    m_itemUpdated = pItem;
+    m_updateCount++;
+    m_lastUpdateFirst = firstVisibleIndex;
+    m_lastUpdateLast = lastVisibleIndex;
     return S_OK;
 }
 
@@ -19,7 +19,7 @@ public:
 
     // IPowerRenameManagerEvents
     IFACEMETHODIMP OnItemAdded(_In_ IPowerRenameItem* renameItem);
-    IFACEMETHODIMP OnUpdate(_In_ IPowerRenameItem* renameItem);
+    IFACEMETHODIMP OnUpdate(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex);
     IFACEMETHODIMP OnError(_In_ IPowerRenameItem* renameItem);
     IFACEMETHODIMP OnRegExStarted(_In_ DWORD threadId);
     IFACEMETHODIMP OnRegExCanceled(_In_ DWORD threadId);
@@ -34,7 +34,9 @@ public:
     }
 
     CComPtr<IPowerRenameItem> m_itemAdded;
-    CComPtr<IPowerRenameItem> m_itemUpdated;
+    UINT m_updateCount = 0;
+    UINT m_lastUpdateFirst = 0;
+    UINT m_lastUpdateLast = 0;
     CComPtr<IPowerRenameItem> m_itemError;
     bool m_regExStarted = false;
     bool m_regExCanceled = false;
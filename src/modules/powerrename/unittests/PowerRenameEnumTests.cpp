@@ -0,0 +1,368 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <PowerRenameInterfaces.h>
+#include <PowerRenameManager.h>
+#include <PowerRenameEnum.h>
+#include <ItemWalker.h>
+#include <BoundedQueue.h>
+#include <MetadataPrefetcher.h>
+#include <Helpers.h>
+#include "MockPowerRenameItem.h"
+#include "MockPowerRenameManagerEvents.h"
+#include "TestFileHelper.h"
+#include <map>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace PowerRenameEnumTests
+{
+    namespace
+    {
+        // Makes mock items for the entries of a directory walk
+        CDirectoryItemWalker::CreateItemCallback CreateMockItem()
+        {
+            return [](const std::filesystem::path& path, bool isFolder, UINT depth, IPowerRenameItem** item) {
+                return CMockPowerRenameItem::CreateInstance(path.c_str(), path.filename().c_str(), depth, isFolder, SYSTEMTIME{ 0 }, item);
+            };
+        }
+
+        void CreateTree(CTestFileHelper& testFileHelper)
+        {
+            Assert::IsTrue(testFileHelper.AddFile(L"foo.txt"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo folder"));
+            Assert::IsTrue(testFileHelper.AddFile(L"foo folder\\foo 1.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"foo folder\\bar.txt"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo folder\\sub"));
+            Assert::IsTrue(testFileHelper.AddFile(L"foo folder\\sub\\foo 2.txt"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"empty"));
+        }
+
+        // In memory folder listings, which record the folders they list
+        class CFakeMetadataProvider :
+            public CFileMetadataProvider
+        {
+        public:
+            void AddEntry(PCWSTR folder, PCWSTR name, const FileMetadata& metadata)
+            {
+                m_folders[folder].push_back({ name, metadata });
+            }
+
+            HRESULT ListFolder(_In_ PCWSTR folder, const EntryCallback& addEntry) override
+            {
+                listedFolders.push_back(folder);
+                auto entries = m_folders.find(folder);
+                if (entries == m_folders.end())
+                {
+                    return HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND);
+                }
+
+                for (const auto& [name, metadata] : entries->second)
+                {
+                    addEntry(name.c_str(), metadata);
+                }
+                return S_OK;
+            }
+
+            std::vector<std::wstring> listedFolders;
+
+        private:
+            std::map<std::wstring, std::vector<std::pair<std::wstring, FileMetadata>>> m_folders;
+        };
+
+        FileMetadata CreateMetadata(WORD day, DWORD attributes, ULONGLONG size)
+        {
+            const SYSTEMTIME time = { 2021, 4, 0, day, 12, 30, 0, 0 };
+            FileMetadata metadata;
+            SystemTimeToFileTime(&time, &metadata.creationTime);
+            metadata.attributes = attributes;
+            metadata.size = size;
+            return metadata;
+        }
+
+        std::vector<CComPtr<IPowerRenameItem>> CreateItems(PCWSTR folder, PCWSTR nameFormat, size_t count, UINT depth)
+        {
+            std::vector<CComPtr<IPowerRenameItem>> items;
+            for (size_t i = 0; i < count; i++)
+            {
+                wchar_t name[MAX_PATH] = { 0 };
+                StringCchPrintf(name, ARRAYSIZE(name), nameFormat, i);
+                const std::wstring path = std::wstring(folder) + L"\\" + name;
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(CMockPowerRenameItem::CreateInstance(path.c_str(), name, depth, false, SYSTEMTIME{ 0 }, &item) == S_OK);
+                items.push_back(item);
+            }
+            return items;
+        }
+
+        // Depth of a path below the temp directory, the items directly in it are at depth 0
+        UINT GetExpectedDepth(CTestFileHelper& testFileHelper, PCWSTR path)
+        {
+            std::filesystem::path relativePath = std::filesystem::path(path).lexically_relative(testFileHelper.GetTempDirectory());
+            return static_cast<UINT>(std::distance(relativePath.begin(), relativePath.end()) - 1);
+        }
+    }
+
+    TEST_CLASS(BoundedQueueTests)
+    {
+    public:
+        TEST_METHOD(PopsItemsInOrder)
+        {
+            CBoundedQueue<int> queue(4);
+            Assert::IsTrue(queue.Push(1));
+            Assert::IsTrue(queue.Push(2));
+            queue.Complete();
+
+            int item = 0;
+            Assert::IsTrue(queue.Pop(item, std::chrono::milliseconds(0)) == CBoundedQueue<int>::PopResult::Item && item == 1);
+            Assert::IsTrue(queue.Pop(item, std::chrono::milliseconds(0)) == CBoundedQueue<int>::PopResult::Item && item == 2);
+            Assert::IsTrue(queue.Pop(item, std::chrono::milliseconds(0)) == CBoundedQueue<int>::PopResult::Closed);
+        }
+
+        TEST_METHOD(PopTimesOutUntilCompleted)
+        {
+            CBoundedQueue<int> queue(1);
+            int item = 0;
+            Assert::IsTrue(queue.Pop(item, std::chrono::milliseconds(1)) == CBoundedQueue<int>::PopResult::Timeout);
+            queue.Complete();
+            Assert::IsTrue(queue.Pop(item, std::chrono::milliseconds(1)) == CBoundedQueue<int>::PopResult::Closed);
+        }
+
+        TEST_METHOD(CancelUnblocksProducer)
+        {
+            CBoundedQueue<int> queue(1);
+            Assert::IsTrue(queue.Push(1));
+
+            // The queue is full, so this push waits for the cancel
+            bool pushed = true;
+            std::thread producer([&]() {
+                pushed = queue.Push(2);
+                queue.Complete();
+            });
+
+            queue.Cancel();
+            producer.join();
+            Assert::IsFalse(pushed);
+
+            int item = 0;
+            Assert::IsTrue(queue.Pop(item, std::chrono::milliseconds(0)) == CBoundedQueue<int>::PopResult::Closed);
+        }
+    };
+
+    TEST_CLASS(DirectoryItemWalkerTests)
+    {
+    public:
+        TEST_METHOD(WalksDepthFirstInBatches)
+        {
+            CTestFileHelper testFileHelper;
+            CreateTree(testFileHelper);
+
+            std::vector<std::filesystem::path> roots;
+            for (const auto& entry : std::filesystem::directory_iterator(testFileHelper.GetTempDirectory()))
+            {
+                roots.push_back(entry.path());
+            }
+
+            CDirectoryItemWalker walker(roots, CreateMockItem());
+            std::vector<CComPtr<IPowerRenameItem>> items;
+            HRESULT hr = S_OK;
+            while (hr == S_OK)
+            {
+                size_t previousCount = items.size();
+                hr = walker.Next(2, items);
+                Assert::IsTrue(items.size() - previousCount <= 2);
+            }
+            Assert::IsTrue(hr == S_FALSE);
+            Assert::IsTrue(items.size() == 7);
+
+            // Every item comes after its folder and after the content of the folders it follows
+            std::vector<std::filesystem::path> folders;
+            for (const auto& item : items)
+            {
+                PWSTR path = nullptr;
+                UINT depth = 0;
+                bool isFolder = false;
+                Assert::IsTrue(item->GetPath(&path) == S_OK);
+                Assert::IsTrue(item->GetDepth(&depth) == S_OK);
+                Assert::IsTrue(item->GetIsFolder(&isFolder) == S_OK);
+
+                Assert::IsTrue(depth == GetExpectedDepth(testFileHelper, path));
+                Assert::IsTrue(depth <= folders.size());
+                folders.resize(depth);
+                if (depth > 0)
+                {
+                    Assert::IsTrue(std::filesystem::path(path).parent_path() == folders.back());
+                }
+
+                if (isFolder)
+                {
+                    folders.push_back(path);
+                }
+                CoTaskMemFree(path);
+            }
+        }
+    };
+
+    TEST_CLASS(MetadataPrefetcherTests)
+    {
+    public:
+        TEST_METHOD(ListsEachWalkedFolderOnce)
+        {
+            auto provider = std::make_unique<CFakeMetadataProvider>();
+            CFakeMetadataProvider& fakeProvider = *provider;
+            for (WORD i = 0; i < 40; i++)
+            {
+                wchar_t name[MAX_PATH] = { 0 };
+                StringCchPrintf(name, ARRAYSIZE(name), L"IMG_%02u.jpg", i);
+                fakeProvider.AddEntry(L"C:\\fake\\photos", name, CreateMetadata(static_cast<WORD>(1 + i % 28), FILE_ATTRIBUTE_ARCHIVE, 1000ull * i));
+            }
+
+            // Names are matched without case, like the file system does
+            std::vector<CComPtr<IPowerRenameItem>> items = CreateItems(L"C:\\fake\\photos", L"img_%02zu.JPG", 40, 1);
+            CMetadataPrefetcher prefetcher(std::move(provider));
+            prefetcher.Prefetch(std::vector<CComPtr<IPowerRenameItem>>(items.begin(), items.begin() + 20));
+            prefetcher.Prefetch(std::vector<CComPtr<IPowerRenameItem>>(items.begin() + 20, items.end()));
+            Assert::IsTrue(fakeProvider.listedFolders.size() == 1);
+
+            for (WORD i = 0; i < 40; i++)
+            {
+                SYSTEMTIME expectedTime;
+                Assert::IsTrue(FileTimeToLocalSystemTime(CreateMetadata(static_cast<WORD>(1 + i % 28), 0, 0).creationTime, &expectedTime));
+
+                SYSTEMTIME time = { 0 };
+                DWORD attributes = 0;
+                ULONGLONG size = 0;
+                Assert::IsTrue(items[i]->GetTime(&time) == S_OK);
+                Assert::IsTrue(items[i]->GetAttributes(&attributes) == S_OK);
+                Assert::IsTrue(items[i]->GetSize(&size) == S_OK);
+                Assert::IsTrue(memcmp(&time, &expectedTime, sizeof(time)) == 0);
+                Assert::IsTrue(attributes == FILE_ATTRIBUTE_ARCHIVE);
+                Assert::IsTrue(size == 1000ull * i);
+            }
+        }
+
+        TEST_METHOD(ListsFolderOfSelectedItemsOnlyForLargeSelections)
+        {
+            auto provider = std::make_unique<CFakeMetadataProvider>();
+            CFakeMetadataProvider& fakeProvider = *provider;
+            CMetadataPrefetcher prefetcher(std::move(provider));
+
+            // A few selected items are not worth listing their whole folder
+            prefetcher.Prefetch(CreateItems(L"C:\\fake\\large", L"file %zu.txt", 2, 0));
+            Assert::IsTrue(fakeProvider.listedFolders.empty());
+
+            prefetcher.Prefetch(CreateItems(L"C:\\fake\\selection", L"file %zu.txt", 16, 0));
+            Assert::IsTrue(fakeProvider.listedFolders.size() == 1);
+
+            // A failed listing is not retried, the items keep their own metadata
+            std::vector<CComPtr<IPowerRenameItem>> items = CreateItems(L"C:\\fake\\selection", L"other %zu.txt", 16, 0);
+            prefetcher.Prefetch(items);
+            Assert::IsTrue(fakeProvider.listedFolders.size() == 1);
+
+            SYSTEMTIME time = { 1 };
+            Assert::IsTrue(items[0]->GetTime(&time) == S_OK);
+            Assert::IsTrue(time.wYear == 0);
+        }
+    };
+
+    TEST_CLASS(EnumPipelineTests)
+    {
+    public:
+        TEST_METHOD(VerifyEnumeratedItemsArePreviewed)
+        {
+            CTestFileHelper testFileHelper;
+            CreateTree(testFileHelper);
+
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+            CMockPowerRenameManagerEvents* mockMgrEvents = new CMockPowerRenameManagerEvents();
+            CComPtr<IPowerRenameManagerEvents> mgrEvents;
+            Assert::IsTrue(mockMgrEvents->QueryInterface(IID_PPV_ARGS(&mgrEvents)) == S_OK);
+            DWORD cookie = 0;
+            Assert::IsTrue(mgr->Advise(mgrEvents, &cookie) == S_OK);
+
+            // Terms restored from the settings are set before the enumeration starts
+            CComPtr<IPowerRenameRegEx> renRegEx;
+            Assert::IsTrue(mgr->GetRenameRegEx(&renRegEx) == S_OK);
+            renRegEx->PutFlags(MatchAllOccurences);
+            renRegEx->PutSearchTerm(L"foo");
+            renRegEx->PutReplaceTerm(L"bar");
+
+            const std::filesystem::path root = testFileHelper.GetTempDirectory();
+            CComPtr<IPowerRenameEnum> renameEnum;
+            Assert::IsTrue(CPowerRenameEnum::s_CreateInstance([root](std::unique_ptr<CItemWalker>& walker) {
+                walker = std::make_unique<CDirectoryItemWalker>(std::vector<std::filesystem::path>{ root }, CreateMockItem());
+                return S_OK;
+            }, mgr, IID_PPV_ARGS(&renameEnum)) == S_OK);
+            Assert::IsTrue(renameEnum->Start() == S_OK);
+
+            UINT itemCount = 0;
+            Assert::IsTrue(mgr->GetItemCount(&itemCount) == S_OK);
+            Assert::IsTrue(itemCount == 8);
+
+            // The items added during the walk are previewed by the passes that follow it
+            auto isPreviewed = [&]() {
+                for (UINT i = 0; i < itemCount; i++)
+                {
+                    CComPtr<IPowerRenameItem> item;
+                    Assert::IsTrue(mgr->GetItemByIndex(i, &item) == S_OK);
+                    PWSTR originalName = nullptr;
+                    PWSTR newName = nullptr;
+                    item->GetOriginalName(&originalName);
+                    item->GetNewName(&newName);
+                    const bool expectsName = wcsstr(originalName, L"foo") != nullptr;
+                    const bool previewed = expectsName ? (newName != nullptr && wcsstr(newName, L"bar") != nullptr) : newName == nullptr;
+                    CoTaskMemFree(originalName);
+                    CoTaskMemFree(newName);
+                    if (!previewed)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+
+            for (int step = 0; step < 500 && !isPreviewed(); step++)
+            {
+                MSG msg;
+                while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+                {
+                    TranslateMessage(&msg);
+                    DispatchMessage(&msg);
+                }
+                Sleep(10);
+            }
+            Assert::IsTrue(isPreviewed());
+
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+            mockMgrEvents->Release();
+        }
+
+        TEST_METHOD(VerifyQuitMessageIsPostedAgain)
+        {
+            CTestFileHelper testFileHelper;
+            CreateTree(testFileHelper);
+
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+
+            const std::filesystem::path root = testFileHelper.GetTempDirectory();
+            CComPtr<IPowerRenameEnum> renameEnum;
+            Assert::IsTrue(CPowerRenameEnum::s_CreateInstance([root](std::unique_ptr<CItemWalker>& walker) {
+                walker = std::make_unique<CDirectoryItemWalker>(std::vector<std::filesystem::path>{ root }, CreateMockItem());
+                return S_OK;
+            }, mgr, IID_PPV_ARGS(&renameEnum)) == S_OK);
+
+            // The quit message pumped while the items are walked cancels the enumeration and
+            // is left for the message loop of the caller
+            PostQuitMessage(7);
+            Assert::IsTrue(renameEnum->Start() == E_ABORT);
+
+            MSG msg;
+            Assert::IsTrue(PeekMessage(&msg, nullptr, WM_QUIT, WM_QUIT, PM_REMOVE) != FALSE);
+            Assert::IsTrue(msg.wParam == 7);
+
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+        }
+    };
+}
@@ -7,6 +7,16 @@
 #include "MockPowerRenameManagerEvents.h"
 #include "TestFileHelper.h"
 #include "Helpers.h"
+#include <ItemRangeBatch.h>
+#include <ViewportScheduler.h>
+#include <CaseTransformer.h>
+#include <DateTemplate.h>
+#include <EnumerationTemplate.h>
+#include <RenameExecutor.h>
+#include <RenameEngine.h>
+#include <RenamePipeline.h>
+#include <algorithm>
+#include <fstream>
 
 #define DEFAULT_FLAGS MatchAllOccurences
 
@@ -133,6 +143,47 @@ namespace PowerRenameManagerTests
             Assert::IsTrue(mgr->Shutdown() == S_OK);
         }
 
+        TEST_METHOD(VerifyItemLookups)
+        {
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+            PCWSTR names[] = { L"foo.txt", L"bar.txt", L"baz" };
+            for (int i = 0; i < ARRAYSIZE(names); i++)
+            {
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(CMockPowerRenameItem::CreateInstance(names[i], names[i], 0, i == 2, SYSTEMTIME{ 0 }, &item) == S_OK);
+                Assert::IsTrue(mgr->AddItem(item) == S_OK);
+            }
+
+            UINT itemCount = 0;
+            Assert::IsTrue(mgr->GetItemCount(&itemCount) == S_OK);
+            Assert::IsTrue(itemCount == ARRAYSIZE(names));
+
+            for (UINT i = 0; i < itemCount; i++)
+            {
+                CComPtr<IPowerRenameItem> itemByIndex;
+                Assert::IsTrue(mgr->GetItemByIndex(i, &itemByIndex) == S_OK);
+                int id = 0;
+                Assert::IsTrue(itemByIndex->GetId(&id) == S_OK);
+                CComPtr<IPowerRenameItem> itemById;
+                Assert::IsTrue(mgr->GetItemById(id, &itemById) == S_OK);
+                Assert::IsTrue(itemByIndex == itemById);
+
+                PWSTR originalName = nullptr;
+                Assert::IsTrue(itemByIndex->GetOriginalName(&originalName) == S_OK);
+                Assert::IsTrue(wcscmp(originalName, names[i]) == 0);
+                CoTaskMemFree(originalName);
+
+                PWSTR newName = nullptr;
+                Assert::IsTrue(itemByIndex->PutNewName(L"renamed") == S_OK);
+                Assert::IsTrue(itemByIndex->GetNewName(&newName) == S_OK);
+                Assert::IsTrue(wcscmp(newName, L"renamed") == 0);
+                CoTaskMemFree(newName);
+            }
+
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+        }
+
         TEST_METHOD(VerifyRenameManagerEvents)
         {
             CComPtr<IPowerRenameManager> mgr;
@@ -238,6 +289,179 @@ namespace PowerRenameManagerTests
             RenameHelper(renamePairs, ARRAYSIZE(renamePairs), L"foo", L"bar", SYSTEMTIME{ 2020, 7, 3, 22, 15, 6, 42, 453 }, DEFAULT_FLAGS | ExcludeSubfolders);
         }
 
+        TEST_METHOD(VerifySelectedFilterVisibility)
+        {
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+
+            // folder1 contains file1 and subfolder2, subfolder2 contains file2. file3 is at the top level.
+            struct
+            {
+                PCWSTR name;
+                UINT depth;
+                bool isFolder;
+            } entries[] = {
+                { L"folder1", 0, true },
+                { L"file1", 1, false },
+                { L"subfolder2", 1, true },
+                { L"file2", 2, false },
+                { L"file3", 0, false },
+            };
+
+            std::vector<int> ids;
+            for (const auto& entry : entries)
+            {
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(CMockPowerRenameItem::CreateInstance(entry.name, entry.name, entry.depth, entry.isFolder, SYSTEMTIME{ 0 }, &item) == S_OK);
+                int id = 0;
+                item->GetId(&id);
+                ids.push_back(id);
+                Assert::IsTrue(mgr->AddItem(item) == S_OK);
+            }
+
+            // None -> Selected
+            Assert::IsTrue(mgr->SwitchFilter(0) == S_OK);
+
+            auto verifyVisibleItems = [&](std::vector<size_t> expected) {
+                UINT visibleCount = 0;
+                Assert::IsTrue(mgr->GetVisibleItemCount(&visibleCount) == S_OK);
+                Assert::IsTrue(expected.size() == visibleCount);
+                for (UINT i = 0; i < visibleCount; i++)
+                {
+                    CComPtr<IPowerRenameItem> item;
+                    Assert::IsTrue(mgr->GetVisibleItemByIndex(i, &item) == S_OK);
+                    int id = 0;
+                    item->GetId(&id);
+                    Assert::IsTrue(ids[expected[i]] == id);
+                }
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(mgr->GetVisibleItemByIndex(visibleCount, &item) == E_FAIL);
+            };
+
+            auto putSelected = [&](size_t index, bool selected) {
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(mgr->GetItemByIndex(static_cast<UINT>(index), &item) == S_OK);
+                item->PutSelected(selected);
+                Assert::IsTrue(mgr->UpdateItemVisibility(ids[index]) == S_OK);
+            };
+
+            verifyVisibleItems({ 0, 1, 2, 3, 4 });
+
+            // Folders stay visible while one of their subitems is
+            putSelected(0, false);
+            putSelected(2, false);
+            verifyVisibleItems({ 0, 1, 2, 3, 4 });
+
+            putSelected(3, false);
+            verifyVisibleItems({ 0, 1, 4 });
+
+            putSelected(1, false);
+            verifyVisibleItems({ 4 });
+
+            putSelected(3, true);
+            verifyVisibleItems({ 0, 2, 3, 4 });
+
+            // Selected -> FlagsApplicable shows everything without exclusion flags
+            Assert::IsTrue(mgr->SwitchFilter(0) == S_OK);
+            verifyVisibleItems({ 0, 1, 2, 3, 4 });
+
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+        }
+
+        static void WaitForPreview(CMockPowerRenameManagerEvents* mockMgrEvents)
+        {
+            // Term edits start the preview from a timer on this thread, so pump messages
+            // until the pass completes
+            for (int step = 0; step < 500 && !mockMgrEvents->m_regExCompleted; step++)
+            {
+                MSG msg;
+                while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+                {
+                    TranslateMessage(&msg);
+                    DispatchMessage(&msg);
+                }
+                Sleep(10);
+            }
+            Assert::IsTrue(mockMgrEvents->m_regExCompleted);
+        }
+
+        TEST_METHOD(VerifyTypedLiteralSearchTerm)
+        {
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+            CMockPowerRenameManagerEvents* mockMgrEvents = new CMockPowerRenameManagerEvents();
+            CComPtr<IPowerRenameManagerEvents> mgrEvents;
+            Assert::IsTrue(mockMgrEvents->QueryInterface(IID_PPV_ARGS(&mgrEvents)) == S_OK);
+            DWORD cookie = 0;
+            Assert::IsTrue(mgr->Advise(mgrEvents, &cookie) == S_OK);
+
+            PCWSTR names[] = { L"foo.txt", L"fob.txt", L"bar.txt", L"foo bar.txt" };
+            for (PCWSTR name : names)
+            {
+                CComPtr<IPowerRenameItem> item;
+                Assert::IsTrue(CMockPowerRenameItem::CreateInstance(name, name, 0, false, SYSTEMTIME{ 0 }, &item) == S_OK);
+                Assert::IsTrue(mgr->AddItem(item) == S_OK);
+            }
+
+            CComPtr<IPowerRenameRegEx> renRegEx;
+            Assert::IsTrue(mgr->GetRenameRegEx(&renRegEx) == S_OK);
+            mockMgrEvents->m_regExCompleted = false;
+            renRegEx->PutFlags(DEFAULT_FLAGS);
+            WaitForPreview(mockMgrEvents);
+            mockMgrEvents->m_regExCompleted = false;
+            renRegEx->PutReplaceTerm(L"baz");
+            WaitForPreview(mockMgrEvents);
+
+            auto typeSearchTerm = [&](PCWSTR searchTerm, std::vector<PCWSTR> expected) {
+                mockMgrEvents->m_regExCompleted = false;
+                renRegEx->PutSearchTerm(searchTerm);
+                WaitForPreview(mockMgrEvents);
+
+                for (UINT i = 0; i < expected.size(); i++)
+                {
+                    CComPtr<IPowerRenameItem> item;
+                    Assert::IsTrue(mgr->GetItemByIndex(i, &item) == S_OK);
+                    PWSTR newName = nullptr;
+                    item->GetNewName(&newName);
+                    Assert::IsTrue((newName == nullptr && expected[i] == nullptr) ||
+                                   (newName != nullptr && expected[i] != nullptr && wcscmp(newName, expected[i]) == 0));
+                    CoTaskMemFree(newName);
+                }
+            };
+
+            // Each term extends the previous one
+            typeSearchTerm(L"f", { L"bazoo.txt", L"bazob.txt", nullptr, L"bazoo bar.txt" });
+            typeSearchTerm(L"fo", { L"bazo.txt", L"bazb.txt", nullptr, L"bazo bar.txt" });
+            typeSearchTerm(L"foo", { L"baz.txt", nullptr, nullptr, L"baz bar.txt" });
+
+            // Deleting a character or changing the term needs the whole selection again
+            typeSearchTerm(L"fo", { L"bazo.txt", L"bazb.txt", nullptr, L"bazo bar.txt" });
+            typeSearchTerm(L"ob", { nullptr, L"fbaz.txt", nullptr, nullptr });
+            typeSearchTerm(L"fob", { nullptr, L"baz.txt", nullptr, nullptr });
+            typeSearchTerm(L"o b", { nullptr, nullptr, nullptr, L"fobazar.txt" });
+
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+            mockMgrEvents->Release();
+        }
+
+        TEST_METHOD(VerifyEnumerateItemsOrderAcrossWorkers)
+        {
+            // Enough items to be split across several preview workers. Enumeration must
+            // still follow the item order.
+            const int itemCount = 600;
+            std::vector<rename_pairs> renamePairs;
+            for (int i = 0; i < itemCount; i++)
+            {
+                wchar_t originalName[MAX_PATH] = { 0 };
+                wchar_t newName[MAX_PATH] = { 0 };
+                StringCchPrintf(originalName, ARRAYSIZE(originalName), L"foo%03d.txt", i);
+                StringCchPrintf(newName, ARRAYSIZE(newName), L"bar%03d (%d).txt", i, i + 1);
+                renamePairs.push_back({ originalName, newName, true, true, 0 });
+            }
+
+            RenameHelper(renamePairs.data(), static_cast<int>(renamePairs.size()), L"foo", L"bar", SYSTEMTIME{ 2020, 7, 3, 22, 15, 6, 42, 453 }, DEFAULT_FLAGS | EnumerateItems);
+        }
+
         TEST_METHOD (VerifyUppercaseTransform)
         {
             rename_pairs renamePairs[] = {
@@ -352,4 +576,755 @@ namespace PowerRenameManagerTests
             RenameHelper(renamePairs, ARRAYSIZE(renamePairs), L"foo", L"bar$MMM-$MMMM-$DDD-$DDDD", SYSTEMTIME{ 2020, 1, 3, 1, 15, 6, 42, 453 }, DEFAULT_FLAGS);
         }
     };
+
+    TEST_CLASS(ItemRangeBatchTests)
+    {
+    public:
+        TEST_METHOD(MergesPendingItemsIntoRanges)
+        {
+            CItemRangeBatch batch(std::chrono::hours(1), 100);
+            for (unsigned int index : { 7u, 2u, 3u, 3u, 4u, 12u, 8u })
+            {
+                Assert::IsFalse(batch.Add(index));
+            }
+
+            std::vector<CItemRangeBatch::Range> ranges = batch.Take();
+            Assert::IsTrue(ranges.size() == 3);
+            Assert::IsTrue(ranges[0].first == 2 && ranges[0].last == 4);
+            Assert::IsTrue(ranges[1].first == 7 && ranges[1].last == 8);
+            Assert::IsTrue(ranges[2].first == 12 && ranges[2].last == 12);
+            Assert::IsTrue(batch.Take().empty());
+        }
+
+        TEST_METHOD(NotifiesOncePerBatch)
+        {
+            CItemRangeBatch batch(std::chrono::hours(1), 4);
+            Assert::IsFalse(batch.Add(0));
+            Assert::IsFalse(batch.Add(1));
+            Assert::IsFalse(batch.Add(2));
+            Assert::IsTrue(batch.Add(3));
+
+            // Already notified: nothing more until the batch is taken
+            Assert::IsFalse(batch.Add(4));
+            Assert::IsFalse(batch.Add(5));
+            Assert::IsFalse(batch.Add(6));
+            Assert::IsFalse(batch.Add(7));
+
+            std::vector<CItemRangeBatch::Range> ranges = batch.Take();
+            Assert::IsTrue(ranges.size() == 1 && ranges[0].first == 0 && ranges[0].last == 7);
+        }
+
+        TEST_METHOD(NotifiesAfterInterval)
+        {
+            CItemRangeBatch batch(std::chrono::milliseconds(0), 100);
+            Assert::IsTrue(batch.Add(0));
+            Assert::IsFalse(batch.Add(1));
+            batch.Take();
+            Assert::IsTrue(batch.Add(2));
+        }
+
+        TEST_METHOD(KeepsItemsAddedRightAfterTakePending)
+        {
+            CItemRangeBatch batch(std::chrono::hours(1), 100);
+            Assert::IsFalse(batch.HasPending());
+            Assert::IsFalse(batch.Add(5));
+            Assert::IsTrue(batch.HasPending());
+
+            // Left for the flush timer of the UI thread
+            std::vector<CItemRangeBatch::Range> ranges = batch.Take();
+            Assert::IsTrue(ranges.size() == 1 && ranges[0].first == 5 && ranges[0].last == 5);
+            Assert::IsFalse(batch.HasPending());
+        }
+    };
+
+    TEST_CLASS(ViewportSchedulerTests)
+    {
+    public:
+        TEST_METHOD(ClaimsChunksInOrderWithoutViewport)
+        {
+            CViewportHint hint;
+            Assert::IsTrue(ClaimAll(10, hint) == std::vector<size_t>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 });
+        }
+
+        TEST_METHOD(ClaimsViewportFirstThenOutward)
+        {
+            // Items 20 to 27 are in chunks 5 and 6
+            CViewportHint hint;
+            hint.Set(20, 27);
+            Assert::IsTrue(ClaimAll(10, hint) == std::vector<size_t>{ 5, 6, 7, 4, 8, 3, 9, 2, 1, 0 });
+        }
+
+        TEST_METHOD(FollowsMovedViewport)
+        {
+            CViewportHint hint;
+            hint.Set(20, 27);
+            CViewportScheduler scheduler(10, hint, ChunkOfItem);
+            std::vector<size_t> chunks(3);
+            for (size_t& chunk : chunks)
+            {
+                Assert::IsTrue(scheduler.Claim(chunk));
+            }
+
+            hint.Set(36, 39);
+            size_t chunk = 0;
+            while (scheduler.Claim(chunk))
+            {
+                chunks.push_back(chunk);
+            }
+            Assert::IsTrue(chunks == std::vector<size_t>{ 5, 6, 7, 9, 8, 4, 3, 2, 1, 0 });
+        }
+
+    private:
+        // Four items per chunk
+        static size_t ChunkOfItem(UINT itemIndex)
+        {
+            return itemIndex / 4;
+        }
+
+        static std::vector<size_t> ClaimAll(size_t chunkCount, const CViewportHint& hint)
+        {
+            CViewportScheduler scheduler(chunkCount, hint, ChunkOfItem);
+            std::vector<size_t> chunks;
+            size_t chunk = 0;
+            while (scheduler.Claim(chunk))
+            {
+                chunks.push_back(chunk);
+            }
+            return chunks;
+        }
+    };
+
+    TEST_CLASS(CaseTransformerTests)
+    {
+    public:
+        TEST_METHOD(TransformsMixedText)
+        {
+            struct
+            {
+                DWORD flags;
+                PCWSTR source;
+                PCWSTR expected;
+            } table[] = {
+                { Uppercase, L"caf\u00e9 au lait and more.txt", L"CAF\u00c9 AU LAIT AND MORE.TXT" },
+                { Lowercase | NameOnly, L"SOME LONGER NAME \u00c4BC.TXT", L"some longer name \u00e4bc.TXT" },
+                { Uppercase | ExtensionOnly, L"notes.txt", L"notes.TXT" },
+                { Uppercase | ExtensionOnly, L".gitignore", L".GITIGNORE" },
+                { Titlecase, L"the lord of the rings - the return of the king.mkv", L"The Lord of the Rings - the Return of the King.mkv" },
+                { Titlecase, L"a tale of two cities - a.txt", L"A Tale of Two Cities - A.txt" },
+                { Capitalized, L"the art of war...txt", L"The Art Of War...txt" },
+                { Titlecase | ExtensionOnly, L"the file.txt", L"the file.txt" },
+            };
+
+            for (const auto& entry : table)
+            {
+                const CCaseTransformer transformer(entry.flags);
+                Assert::IsTrue(transformer.IsEnabled());
+
+                std::wstring result;
+                transformer.Transform(entry.source, result);
+                Assert::AreEqual(entry.expected, result.c_str());
+
+                // The helper gives the same names
+                wchar_t transformed[MAX_PATH] = { 0 };
+                Assert::IsTrue(GetTransformedFileName(transformed, ARRAYSIZE(transformed), entry.source, entry.flags) == S_OK);
+                Assert::AreEqual(entry.expected, transformed);
+            }
+
+            Assert::IsFalse(CCaseTransformer(MatchAllOccurences | NameOnly).IsEnabled());
+        }
+    };
+
+    TEST_CLASS(DateTemplateTests)
+    {
+    public:
+        TEST_METHOD(FormatsFields)
+        {
+            const SYSTEMTIME fileTime = { 2021, 3, 2, 9, 7, 5, 4, 38 };
+            struct
+            {
+                PCWSTR replaceTerm;
+                bool usesFileTime;
+                PCWSTR expected;
+            } table[] = {
+                { L"bar", false, L"bar" },
+                { L"$YYYY$YY$Y", true, L"2021211" },
+                { L"$YYY.$MMMMMx", true, L"21Y.MarchMx" },
+                { L"$M$MM $D$DD", true, L"303 909" },
+                { L"$h$hh:$m$mm:$s$ss", true, L"707:505:404" },
+                { L"$fff $ff $f", true, L"038 03 0" },
+                { L"$$YYYY $$$YYYY $$$$YYYY", true, L"$$YYYY $$2021 $$$$YYYY" },
+                { L"$1$0 $y $x", false, L"$1$0 $y $x" },
+                { L"$", false, L"$" },
+            };
+
+            for (const auto& entry : table)
+            {
+                const CDateTemplate dateTemplate(entry.replaceTerm);
+                Assert::AreEqual(entry.usesFileTime, dateTemplate.UsesFileTime());
+                Assert::AreEqual(entry.usesFileTime, isFileTimeUsed(entry.replaceTerm));
+
+                // Month names depend on the user locale, so only check the ones for English
+                if (wcsstr(entry.expected, L"March") != nullptr && !IsEnglishLocale())
+                {
+                    continue;
+                }
+
+                std::wstring result;
+                dateTemplate.Format(fileTime, result);
+                Assert::AreEqual(entry.expected, result.c_str());
+            }
+        }
+
+        TEST_METHOD(LeavesNamesOfInvalidDatesEmpty)
+        {
+            std::wstring result;
+            CDateTemplate(L"[$MMMM][$DDD][$YYYY]").Format(SYSTEMTIME{ 0 }, result);
+            Assert::AreEqual(L"[][][0000]", result.c_str());
+        }
+
+    private:
+        static bool IsEnglishLocale()
+        {
+            wchar_t localeName[LOCALE_NAME_MAX_LENGTH] = { 0 };
+            return GetUserDefaultLocaleName(localeName, LOCALE_NAME_MAX_LENGTH) == 0 || wcsncmp(localeName, L"en", 2) == 0;
+        }
+    };
+
+    TEST_CLASS(EnumerationTemplateTests)
+    {
+    public:
+        TEST_METHOD(MatchesGetEnumeratedFileName)
+        {
+            const std::wstring names[] = { L"foo.txt", L"foo", L"foo (3).txt", L"a(b)c.d", L"()", L"x(12)(3)", L".txt", L"a.b c", L"a.b.c", std::wstring(250, L'a') + L".jpg", std::wstring(259, L'a') };
+            for (const std::wstring& name : names)
+            {
+                for (unsigned long counter : { 0ul, 1ul, 9ul, 10ul, 999ul, 12345ul, 999999ul })
+                {
+                    wchar_t expected[MAX_PATH] = { 0 };
+                    unsigned long countUsed = 0;
+                    const BOOL enumerated = GetEnumeratedFileName(expected, ARRAYSIZE(expected), name.c_str(), nullptr, counter, &countUsed);
+
+                    CEnumerationTemplate enumeration(counter);
+                    enumeration.Reset(name);
+                    const std::wstring_view result = enumeration.Format(0);
+                    Assert::AreEqual(enumerated != FALSE, !result.empty());
+                    Assert::AreEqual(std::wstring(expected), std::wstring(result));
+                }
+            }
+        }
+
+        TEST_METHOD(PadsAndStartsCounters)
+        {
+            CEnumerationTemplate enumeration(7, 4);
+            enumeration.Reset(L"IMG.jpg");
+            Assert::AreEqual(L"IMG (0012).jpg", enumeration.Format(5).data());
+
+            enumeration.Reset(L"IMG (1) copy");
+            Assert::AreEqual(L"IMG (12352) copy", enumeration.Format(12345).data());
+
+            // No limit of a million like GetEnumeratedFileName
+            Assert::AreEqual(L"IMG (1000006) copy", enumeration.Format(999999).data());
+        }
+    };
+
+    TEST_CLASS(RenameExecutorTests)
+    {
+    public:
+        TEST_METHOD(SwapsNamesThroughTemporaryName)
+        {
+            CTestFileHelper testFileHelper;
+            for (PCWSTR name : { L"a.txt", L"b.txt", L"x.txt", L"y.txt", L"z.txt" })
+            {
+                WriteContent(testFileHelper, name);
+            }
+
+            CStdRenameFileSystem fileSystem;
+            CRenameJournal journal;
+            CRenameExecutor executor(fileSystem, journal, 4);
+            std::vector<HRESULT> results;
+            Assert::IsTrue(executor.Execute({ { testFileHelper.GetFullPath(L"a.txt"), L"b.txt" },
+                                              { testFileHelper.GetFullPath(L"b.txt"), L"a.txt" },
+                                              { testFileHelper.GetFullPath(L"x.txt"), L"y.txt" },
+                                              { testFileHelper.GetFullPath(L"y.txt"), L"z.txt" },
+                                              { testFileHelper.GetFullPath(L"z.txt"), L"x.txt" } },
+                                            results) == S_OK);
+
+            Assert::AreEqual(std::wstring(L"a.txt"), ReadContent(testFileHelper, L"b.txt"));
+            Assert::AreEqual(std::wstring(L"b.txt"), ReadContent(testFileHelper, L"a.txt"));
+            Assert::AreEqual(std::wstring(L"x.txt"), ReadContent(testFileHelper, L"y.txt"));
+            Assert::AreEqual(std::wstring(L"y.txt"), ReadContent(testFileHelper, L"z.txt"));
+            Assert::AreEqual(std::wstring(L"z.txt"), ReadContent(testFileHelper, L"x.txt"));
+            // One extra move per cycle
+            Assert::AreEqual(static_cast<size_t>(7), journal.GetEntries().size());
+        }
+
+        TEST_METHOD(RenamesItemsBeforeTheirFolders)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo\\bar"));
+            Assert::IsTrue(testFileHelper.AddFile(L"foo\\bar\\baz.txt"));
+
+            CStdRenameFileSystem fileSystem;
+            CRenameJournal journal;
+            CRenameExecutor executor(fileSystem, journal, 4);
+            std::vector<HRESULT> results;
+            Assert::IsTrue(executor.Execute({ { testFileHelper.GetFullPath(L"foo"), L"foo2" },
+                                              { testFileHelper.GetFullPath(L"foo\\bar"), L"bar2" },
+                                              { testFileHelper.GetFullPath(L"foo\\bar\\baz.txt"), L"baz2.txt" } },
+                                            results) == S_OK);
+
+            Assert::IsTrue(testFileHelper.PathExists(L"foo2\\bar2\\baz2.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"foo"));
+        }
+
+        TEST_METHOD(LeavesCollidingItemsInPlace)
+        {
+            CTestFileHelper testFileHelper;
+            for (PCWSTR name : { L"a.txt", L"b.txt", L"c.txt", L"d.txt", L"e.txt", L"f.txt" })
+            {
+                WriteContent(testFileHelper, name);
+            }
+
+            CStdRenameFileSystem fileSystem;
+            CRenameJournal journal;
+            CRenameExecutor executor(fileSystem, journal, 4);
+            std::vector<HRESULT> results;
+            // b.txt stays in place, e.txt is taken by d.txt first, f.txt keeps its name
+            const HRESULT hr = executor.Execute({ { testFileHelper.GetFullPath(L"a.txt"), L"b.txt" },
+                                                  { testFileHelper.GetFullPath(L"c.txt"), L"new.txt" },
+                                                  { testFileHelper.GetFullPath(L"d.txt"), L"NEW.TXT" },
+                                                  { testFileHelper.GetFullPath(L"e.txt"), L"g.txt" },
+                                                  { testFileHelper.GetFullPath(L"f.txt"), L"f.txt" } },
+                                                results);
+
+            const HRESULT collision = HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+            Assert::IsTrue(hr == collision);
+            Assert::IsTrue(results == std::vector<HRESULT>{ collision, S_OK, collision, S_OK, S_FALSE });
+            Assert::AreEqual(std::wstring(L"a.txt"), ReadContent(testFileHelper, L"a.txt"));
+            Assert::AreEqual(std::wstring(L"b.txt"), ReadContent(testFileHelper, L"b.txt"));
+            Assert::AreEqual(std::wstring(L"c.txt"), ReadContent(testFileHelper, L"new.txt"));
+            Assert::AreEqual(std::wstring(L"d.txt"), ReadContent(testFileHelper, L"d.txt"));
+            Assert::AreEqual(std::wstring(L"e.txt"), ReadContent(testFileHelper, L"g.txt"));
+        }
+
+        TEST_METHOD(UndoesRenamesFromJournal)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo"));
+            WriteContent(testFileHelper, L"foo\\a.txt");
+            WriteContent(testFileHelper, L"foo\\b.txt");
+
+            CStdRenameFileSystem fileSystem;
+            CRenameJournal journal;
+            const std::filesystem::path journalPath = testFileHelper.GetFullPath(L"journal.txt");
+            Assert::IsTrue(journal.Open(journalPath) == S_OK);
+            CRenameExecutor executor(fileSystem, journal, 4);
+            std::vector<HRESULT> results;
+            Assert::IsTrue(executor.Execute({ { testFileHelper.GetFullPath(L"foo"), L"bar" },
+                                              { testFileHelper.GetFullPath(L"foo\\a.txt"), L"b.txt" },
+                                              { testFileHelper.GetFullPath(L"foo\\b.txt"), L"a.txt" } },
+                                            results) == S_OK);
+            Assert::AreEqual(std::wstring(L"foo\\a.txt"), ReadContent(testFileHelper, L"bar\\b.txt"));
+
+            std::vector<RenameJournalEntry> entries;
+            Assert::IsTrue(CRenameJournal::s_Read(journalPath, entries) == S_OK);
+            Assert::AreEqual(journal.GetEntries().size(), entries.size());
+            Assert::IsTrue(CRenameJournal::s_Undo(entries, fileSystem) == S_OK);
+            Assert::AreEqual(std::wstring(L"foo\\a.txt"), ReadContent(testFileHelper, L"foo\\a.txt"));
+            Assert::AreEqual(std::wstring(L"foo\\b.txt"), ReadContent(testFileHelper, L"foo\\b.txt"));
+        }
+
+        TEST_METHOD(RenamesPermutedTree)
+        {
+            // Every folder swaps the names of its files around and is renamed itself
+            const int folderCount = 16;
+            const int fileCount = 64;
+            CTestFileHelper testFileHelper;
+            std::vector<RenameRequest> requests;
+            std::vector<std::pair<std::wstring, std::wstring>> expected;
+            for (int folder = 0; folder < folderCount; folder++)
+            {
+                const std::wstring folderName = L"folder" + std::to_wstring(folder);
+                Assert::IsTrue(testFileHelper.AddFolder(folderName));
+                for (int file = 0; file < fileCount; file++)
+                {
+                    const std::wstring name = folderName + L"\\file" + std::to_wstring(file);
+                    WriteContent(testFileHelper, name);
+
+                    // An odd multiplier gives a permutation of the names, made of cycles of several lengths
+                    const int target = (file * (2 * folder + 1) + folder) % fileCount;
+                    requests.push_back({ testFileHelper.GetFullPath(name), L"file" + std::to_wstring(target) });
+                    expected.push_back({ L"renamed" + std::to_wstring(folder) + L"\\file" + std::to_wstring(target), name });
+                }
+                requests.push_back({ testFileHelper.GetFullPath(folderName), L"renamed" + std::to_wstring(folder) });
+            }
+
+            CStdRenameFileSystem fileSystem;
+            CRenameJournal journal;
+            CRenameExecutor executor(fileSystem, journal, 8);
+            std::vector<HRESULT> results;
+            Assert::IsTrue(executor.Execute(requests, results) == S_OK);
+            for (const auto& [path, content] : expected)
+            {
+                Assert::AreEqual(content, ReadContent(testFileHelper, path));
+            }
+        }
+
+        TEST_METHOD(RunsLevelsAsOperations)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo"));
+            for (PCWSTR name : { L"foo\\a.txt", L"foo\\b.txt", L"foo\\c.txt", L"foo\\d.txt" })
+            {
+                WriteContent(testFileHelper, name);
+            }
+
+            CStdRenameFileSystem fileSystem;
+            CTestRenameOperation operation;
+            CRenameJournal journal;
+            CRenameExecutor executor(fileSystem, operation, journal);
+            std::vector<HRESULT> results;
+            // d.txt stays in place, so c.txt is given a free name instead
+            Assert::IsTrue(executor.Execute({ { testFileHelper.GetFullPath(L"foo"), L"bar" },
+                                              { testFileHelper.GetFullPath(L"foo\\a.txt"), L"b.txt" },
+                                              { testFileHelper.GetFullPath(L"foo\\b.txt"), L"a.txt" },
+                                              { testFileHelper.GetFullPath(L"foo\\c.txt"), L"d.txt" } },
+                                            results) == S_OK);
+
+            // One operation per step of the cycle, then c.txt and foo itself
+            Assert::AreEqual(static_cast<size_t>(4), operation.operationCount);
+            Assert::AreEqual(std::wstring(L"foo\\a.txt"), ReadContent(testFileHelper, L"bar\\b.txt"));
+            Assert::AreEqual(std::wstring(L"foo\\b.txt"), ReadContent(testFileHelper, L"bar\\a.txt"));
+            Assert::AreEqual(std::wstring(L"foo\\c.txt"), ReadContent(testFileHelper, L"bar\\d (2).txt"));
+            Assert::AreEqual(std::wstring(L"foo\\d.txt"), ReadContent(testFileHelper, L"bar\\d.txt"));
+        }
+
+        TEST_METHOD(AbortsBrokenCycles)
+        {
+            CTestFileHelper testFileHelper;
+            for (PCWSTR name : { L"a.txt", L"b.txt", L"x.txt", L"y.txt" })
+            {
+                WriteContent(testFileHelper, name);
+            }
+
+            CStdRenameFileSystem fileSystem;
+            CTestRenameOperation operation;
+            // The second step of the first cycle fails, and the first step of the other one
+            operation.failingNames = { L"b.txt", L"x.txt" };
+            CRenameJournal journal;
+            CRenameExecutor executor(fileSystem, operation, journal);
+            std::vector<HRESULT> results;
+            Assert::IsTrue(executor.Execute({ { testFileHelper.GetFullPath(L"a.txt"), L"b.txt" },
+                                              { testFileHelper.GetFullPath(L"b.txt"), L"a.txt" },
+                                              { testFileHelper.GetFullPath(L"x.txt"), L"y.txt" },
+                                              { testFileHelper.GetFullPath(L"y.txt"), L"x.txt" } },
+                                            results) == E_ABORT);
+
+            const HRESULT denied = HRESULT_FROM_WIN32(ERROR_ACCESS_DENIED);
+            Assert::IsTrue(results == std::vector<HRESULT>{ E_ABORT, denied, denied, E_ABORT });
+
+            // Nothing was given a free name and a.txt is back from its temporary name
+            const auto entryCount = std::distance(std::filesystem::directory_iterator(testFileHelper.GetTempDirectory()), std::filesystem::directory_iterator());
+            Assert::AreEqual(static_cast<ptrdiff_t>(4), entryCount);
+            for (PCWSTR name : { L"a.txt", L"b.txt", L"x.txt", L"y.txt" })
+            {
+                Assert::AreEqual(std::wstring(name), ReadContent(testFileHelper, name));
+            }
+        }
+
+    private:
+        // Renames like IFileOperation with FOF_RENAMEONCOLLISION: the items must exist when
+        // the operation starts and a taken target gets a free name. Items named in failingNames
+        // fail to rename.
+        class CTestRenameOperation :
+            public CRenameOperation
+        {
+        public:
+            HRESULT Perform(const std::vector<RenameMove>& moves, std::vector<HRESULT>& results) override
+            {
+                operationCount++;
+                std::error_code error;
+                results.assign(moves.size(), S_OK);
+                for (size_t i = 0; i < moves.size(); i++)
+                {
+                    if (!std::filesystem::exists(moves[i].source, error))
+                    {
+                        results[i] = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+                    }
+                    else if (std::find(failingNames.begin(), failingNames.end(), moves[i].source.filename().wstring()) != failingNames.end())
+                    {
+                        results[i] = HRESULT_FROM_WIN32(ERROR_ACCESS_DENIED);
+                    }
+                }
+
+                for (size_t i = 0; i < moves.size(); i++)
+                {
+                    if (FAILED(results[i]))
+                    {
+                        continue;
+                    }
+
+                    const std::filesystem::path& target = moves[i].target;
+                    std::filesystem::path freeTarget = target;
+                    for (int copy = 2; std::filesystem::exists(freeTarget, error); copy++)
+                    {
+                        freeTarget = target.parent_path() / (target.stem().wstring() + L" (" + std::to_wstring(copy) + L")" + target.extension().wstring());
+                    }
+
+                    std::filesystem::rename(moves[i].source, freeTarget, error);
+                    results[i] = error ? HRESULT_FROM_WIN32(error.value()) : S_OK;
+                }
+                return S_OK;
+            }
+
+            size_t operationCount = 0;
+            std::vector<std::wstring> failingNames;
+        };
+
+        // Each file holds its original relative path
+        static void WriteContent(CTestFileHelper& testFileHelper, const std::wstring& path)
+        {
+            std::wofstream file(testFileHelper.GetFullPath(path));
+            file << path;
+        }
+
+        static std::wstring ReadContent(CTestFileHelper& testFileHelper, const std::wstring& path)
+        {
+            std::wifstream file(testFileHelper.GetFullPath(path));
+            std::wstring content;
+            std::getline(file, content);
+            return content;
+        }
+    };
+
+    TEST_CLASS(RenamePipelineTests)
+    {
+    public:
+        TEST_METHOD(AppliesStepsInOrder)
+        {
+            CRenamePipeline pipeline;
+            Assert::IsTrue(pipeline.Compile({ { RenameStepType::LiteralReplace, L"holiday", L"Trip" },
+                                              { RenameStepType::RegexReplace, L"IMG_(\\d+)", L"$1" },
+                                              { RenameStepType::LiteralReplace, L"jpg", L"$YYYY", MatchAllOccurences | ExtensionOnly },
+                                              { RenameStepType::Trim },
+                                              { RenameStepType::ChangeCase, L"", L"", Uppercase | NameOnly },
+                                              { RenameStepType::Enumerate, L"", L"", 0, 10 } }) == S_OK);
+            Assert::IsTrue(pipeline.UsesFileTime());
+            Assert::IsTrue(pipeline.Enumerates());
+
+            CRenamePipeline::Scratch scratch;
+            std::wstring newName;
+            Assert::IsTrue(pipeline.Apply(L"  IMG_001 Holiday.jpg", SYSTEMTIME{ 2021, 3, 4, 4, 5, 6, 7, 8 }, 2, scratch, newName));
+            Assert::AreEqual(std::wstring(L"001 TRIP (12).2021"), newName);
+        }
+
+        TEST_METHOD(LeavesUnchangedNamesEmpty)
+        {
+            CRenamePipeline pipeline;
+            Assert::IsTrue(pipeline.Compile({ { RenameStepType::LiteralReplace, L"foo", L"bar" },
+                                              { RenameStepType::LiteralReplace, L"bar", L"foo" } }) == S_OK);
+
+            CRenamePipeline::Scratch scratch;
+            std::wstring newName;
+            Assert::IsFalse(pipeline.Apply(L"foo.txt", SYSTEMTIME{ 0 }, 0, scratch, newName));
+            Assert::IsTrue(newName.empty());
+        }
+
+        TEST_METHOD(RejectsInvalidRegularExpression)
+        {
+            CRenamePipeline pipeline;
+            Assert::IsTrue(pipeline.Compile({ { RenameStepType::RegexReplace, L"(", L"" } }) == E_INVALIDARG);
+        }
+
+        TEST_METHOD(NumbersOnlyRenamedItems)
+        {
+            // Only some of the items match, the others are not numbered nor counted, like with
+            // the EnumerateItems flag of a single rule
+            std::vector<RenameEngineItem> items(200);
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                const std::wstring name = ((i % 3 == 0) ? L"foo" : L"bar") + std::to_wstring(i) + L".txt";
+                items[i].path = std::filesystem::path(L"C:\\Pictures") / name;
+            }
+
+            const RenameRule rule = { L"foo", L"qux", MatchAllOccurences | EnumerateItems };
+            std::vector<RenameEngineItem> expected = items;
+            CRenameEngine singleRuleEngine;
+            Assert::IsTrue(singleRuleEngine.Init(rule) == S_OK);
+            Assert::IsTrue(singleRuleEngine.Preview(expected, 4) == S_OK);
+
+            CRenameEngine engine;
+            Assert::IsTrue(engine.InitPipeline({ { RenameStepType::LiteralReplace, rule.searchTerm, rule.replaceTerm, MatchAllOccurences },
+                                                 { RenameStepType::Trim },
+                                                 { RenameStepType::Enumerate } },
+                                               0) == S_OK);
+            Assert::IsTrue(engine.Preview(items, 4) == S_OK);
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                Assert::AreEqual(expected[i].newName, items[i].newName);
+            }
+            Assert::IsTrue(items[1].newName.empty());
+            Assert::AreEqual(std::wstring(L"qux3 (2).txt"), items[3].newName);
+        }
+
+        TEST_METHOD(SingleRuleNumbersFromStart)
+        {
+            std::vector<RenameEngineItem> items(3);
+            items[0].path = L"C:\\Pictures\\foo.txt";
+            items[1].path = L"C:\\Pictures\\bar.txt";
+            items[2].path = L"C:\\Pictures\\foo.jpg";
+
+            RenameRule rule = { L"foo", L"qux", MatchAllOccurences | EnumerateItems };
+            rule.enumerateStart = 0;
+            rule.enumeratePadding = 3;
+            CRenameEngine engine;
+            Assert::IsTrue(engine.Init(rule) == S_OK);
+            Assert::IsTrue(engine.Preview(items, 2) == S_OK);
+            Assert::AreEqual(std::wstring(L"qux (000).txt"), items[0].newName);
+            Assert::IsTrue(items[1].newName.empty());
+            Assert::AreEqual(std::wstring(L"qux (001).jpg"), items[2].newName);
+        }
+
+        TEST_METHOD(MatchesSequentialRuns)
+        {
+            // One pass of the pipeline gives the names of one engine run per rule
+            const std::vector<RenameRule> rules = { { L"Holiday Trip", L"Vacation", MatchAllOccurences | NameOnly },
+                                                    { L"IMG_(\\d+)", L"$1_photo", MatchAllOccurences | UseRegularExpressions },
+                                                    { L"jpg", L"jpeg", MatchAllOccurences | ExtensionOnly | Titlecase } };
+            std::vector<RenameEngineItem> items(500);
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                wchar_t name[MAX_PATH] = { 0 };
+                StringCchPrintf(name, ARRAYSIZE(name), L"IMG_%06zu_Holiday Trip %zu.jpg", i, i % 37);
+                items[i].path = std::filesystem::path(L"C:\\Pictures") / name;
+            }
+
+            std::vector<std::wstring> expected;
+            std::vector<RenameEngineItem> runItems = items;
+            for (const RenameRule& rule : rules)
+            {
+                CRenameEngine engine;
+                Assert::IsTrue(engine.Init(rule) == S_OK);
+                Assert::IsTrue(engine.Preview(runItems, 4) == S_OK);
+                for (RenameEngineItem& item : runItems)
+                {
+                    if (!item.newName.empty())
+                    {
+                        item.path.replace_filename(item.newName);
+                    }
+                }
+            }
+
+            std::vector<RenameStep> steps;
+            for (const RenameRule& rule : rules)
+            {
+                const RenameStepType type = (rule.flags & UseRegularExpressions) ? RenameStepType::RegexReplace : RenameStepType::LiteralReplace;
+                steps.push_back({ type, rule.searchTerm, rule.replaceTerm, rule.flags });
+                steps.push_back({ RenameStepType::Trim });
+                steps.push_back({ RenameStepType::ChangeCase, L"", L"", rule.flags });
+            }
+
+            CRenameEngine engine;
+            Assert::IsTrue(engine.InitPipeline(steps, 0) == S_OK);
+            Assert::IsTrue(engine.Preview(items, 4) == S_OK);
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                Assert::AreEqual(runItems[i].path.filename().wstring(), items[i].newName);
+            }
+        }
+    };
+
+    TEST_CLASS(RenameEngineTests)
+    {
+    public:
+        TEST_METHOD(ListsFoldersBeforeTheirContent)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo\\bar"));
+            Assert::IsTrue(testFileHelper.AddFile(L"foo\\bar\\baz.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"foo\\qux.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"zzz.txt"));
+
+            CFindFileMetadataProvider provider;
+            std::vector<RenameEngineItem> items;
+            Assert::IsTrue(CRenameEngine::s_ListTree(testFileHelper.GetTempDirectory(), provider, items) == S_OK);
+            Assert::AreEqual(static_cast<size_t>(5), items.size());
+
+            auto indexOf = [&](PCWSTR path) {
+                const std::filesystem::path fullPath = testFileHelper.GetFullPath(path);
+                for (size_t i = 0; i < items.size(); i++)
+                {
+                    if (items[i].path == fullPath)
+                    {
+                        return i;
+                    }
+                }
+                Assert::Fail(path);
+                return items.size();
+            };
+
+            Assert::AreEqual(indexOf(L"foo\\bar") + 1, indexOf(L"foo\\bar\\baz.txt"));
+            Assert::IsTrue(indexOf(L"foo") < indexOf(L"foo\\bar"));
+            Assert::IsTrue(indexOf(L"foo") < indexOf(L"foo\\qux.txt"));
+            Assert::IsTrue(items[indexOf(L"foo\\bar")].isFolder);
+            Assert::IsFalse(items[indexOf(L"zzz.txt")].isFolder);
+            Assert::AreEqual(2u, items[indexOf(L"foo\\bar\\baz.txt")].depth);
+            Assert::AreEqual(0u, items[indexOf(L"zzz.txt")].depth);
+        }
+
+        TEST_METHOD(PreviewsAndCommitsTree)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"foo"));
+            Assert::IsTrue(testFileHelper.AddFile(L"foo\\foo.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"foo.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"baa.txt"));
+
+            CRenameEngine engine;
+            Assert::IsTrue(engine.Init({ L"foo", L"bar", DEFAULT_FLAGS | ExcludeSubfolders }) == S_OK);
+
+            CFindFileMetadataProvider provider;
+            std::vector<RenameEngineItem> items;
+            Assert::IsTrue(CRenameEngine::s_ListTree(testFileHelper.GetTempDirectory(), provider, items) == S_OK);
+            Assert::IsTrue(engine.Preview(items, 4) == S_OK);
+
+            CStdRenameFileSystem fileSystem;
+            CRenameJournal journal;
+            std::vector<HRESULT> results;
+            Assert::IsTrue(engine.Commit(items, fileSystem, journal, 4, results) == S_OK);
+            Assert::AreEqual(items.size(), results.size());
+
+            // The content of foo is excluded and moves with its folder
+            Assert::IsTrue(testFileHelper.PathExists(L"bar\\foo.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"bar.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"baa.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"foo"));
+            Assert::AreEqual(static_cast<size_t>(2), journal.GetEntries().size());
+        }
+
+        TEST_METHOD(PreviewMatchesManager)
+        {
+            // Same items and names as VerifyEnumerateItemsOrderAcrossWorkers, enumeration follows the item order
+            const size_t itemCount = 600;
+            std::vector<RenameEngineItem> items(itemCount);
+            for (size_t i = 0; i < itemCount; i++)
+            {
+                wchar_t name[MAX_PATH] = { 0 };
+                StringCchPrintf(name, ARRAYSIZE(name), L"foo%03zu.txt", i);
+                items[i].path = std::filesystem::path(L"C:\\Pictures") / name;
+            }
+
+            CRenameEngine engine;
+            Assert::IsTrue(engine.Init({ L"foo", L"bar", DEFAULT_FLAGS | EnumerateItems }) == S_OK);
+            Assert::IsTrue(engine.Preview(items, 4) == S_OK);
+            for (size_t i = 0; i < itemCount; i++)
+            {
+                wchar_t newName[MAX_PATH] = { 0 };
+                StringCchPrintf(newName, ARRAYSIZE(newName), L"bar%03zu (%zu).txt", i, i + 1);
+                Assert::AreEqual(std::wstring(newName), items[i].newName);
+            }
+        }
+    };
 }
@@ -0,0 +1,189 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "powerrename/lib/Settings.h"
+#include <PowerRenameInterfaces.h>
+#include <PowerRenameRegEx.h>
+#include <LinearRegex.h>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace PowerRenameRegExLinearTests
+{
+    struct SearchReplaceExpected
+    {
+        PCWSTR search;
+        PCWSTR replace;
+        PCWSTR test;
+        PCWSTR expected;
+    };
+
+    TEST_CLASS(SimpleTests)
+    {
+    public:
+TEST_CLASS_INITIALIZE(ClassInitialize)
+{
+    CSettingsInstance().SetUseBoostLib(false);
+    CSettingsInstance().SetUseLinearRegex(true);
+}
+
+TEST_CLASS_CLEANUP(ClassCleanup)
+{
+    CSettingsInstance().SetUseLinearRegex(false);
+}
+
+void VerifyReplace(SearchReplaceExpected sreTable[], int tableSize, DWORD flags)
+{
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    Assert::IsTrue(renameRegEx->PutFlags(flags) == S_OK);
+
+    for (int i = 0; i < tableSize; i++)
+    {
+        PWSTR result = nullptr;
+        Assert::IsTrue(renameRegEx->PutSearchTerm(sreTable[i].search) == S_OK);
+        Assert::IsTrue(renameRegEx->PutReplaceTerm(sreTable[i].replace) == S_OK);
+        Assert::IsTrue(renameRegEx->Replace(sreTable[i].test, &result) == S_OK);
+        Assert::AreEqual(sreTable[i].expected, result);
+        CoTaskMemFree(result);
+    }
+}
+
+TEST_METHOD(VerifyReplaceFirstOnlyUseRegEx)
+{
+    SearchReplaceExpected sreTable[] = {
+        //search, replace, test, result
+        { L"B", L"BB", L"ABA", L"ABBA" },
+        { L"B", L"A", L"ABBBA", L"AABBA" },
+        { L"B", L"BBB", L"ABABAB", L"ABBBABAB" },
+    };
+    VerifyReplace(sreTable, ARRAYSIZE(sreTable), UseRegularExpressions);
+}
+
+TEST_METHOD(VerifyReplaceAllUseRegEx)
+{
+    SearchReplaceExpected sreTable[] = {
+        //search, replace, test, result
+        { L"B", L"BB", L"ABA", L"ABBA" },
+        { L"B", L"A", L"ABBBA", L"AAAAA" },
+        { L"holiday", L"Vacation", L"HOLIDAY trip", L"Vacation trip" },
+        { L"a+?", L"x", L"aaa", L"xxx" },
+        { L"\\bcat\\b", L"dog", L"cat concat cat.jpg", L"dog concat dog.jpg" },
+        { L"^\\w", L"X", L"abc", L"Xbc" },
+    };
+    VerifyReplace(sreTable, ARRAYSIZE(sreTable), UseRegularExpressions | MatchAllOccurences);
+}
+
+TEST_METHOD(VerifyEmptyMatchesUseRegEx)
+{
+    // Same enumeration of the empty matches as std::regex_replace
+    SearchReplaceExpected sreTable[] = {
+        //search, replace, test, result
+        { L".*", L"Foo", L"AAAAAA", L"Foo" },
+        { L"a*", L"-", L"baaac", L"-b--c" },
+    };
+    VerifyReplace(sreTable, ARRAYSIZE(sreTable), UseRegularExpressions | MatchAllOccurences);
+}
+
+TEST_METHOD(VerifyHandleCapturingGroups)
+{
+    // The replace term follows the std engine rules
+    SearchReplaceExpected sreTable[] = {
+        //search, replace, test, result
+        { L"(foo)(bar)", L"$1_$002_$223_$001021_$00001", L"foobar", L"foo_$002_bar23_$001021_$00001" },
+        { L"(foo)(bar)", L"_$1$2_$123$040", L"foobar", L"_foobar_foo23$040" },
+        { L"(foo)(bar)", L"$$$1", L"foobar", L"$foo" },
+        { L"(foo)(bar)", L"$$1", L"foobar", L"$1" },
+        { L"(foo)(bar)", L"$12", L"foobar", L"foo2" },
+        { L"(foo)(bar)", L"$10", L"foobar", L"foo0" },
+        { L"(foo)(bar)", L"$01", L"foobar", L"$01" },
+        { L"(foo)(bar)", L"$$$11", L"foobar", L"$foo1" },
+        { L"(foo)(bar)", L"$$$$113a", L"foobar", L"$$113a" },
+        { L"(\\d+)-(\\d+)", L"$2-$1", L"IMG 2020-07.jpg", L"IMG 07-2020.jpg" },
+        { L"(foo)|bar", L"[$1]", L"foobar", L"[foo][]" },
+    };
+    VerifyReplace(sreTable, ARRAYSIZE(sreTable), UseRegularExpressions | MatchAllOccurences | CaseSensitive);
+}
+
+TEST_METHOD(VerifyFileAttributesUseRegEx)
+{
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    Assert::IsTrue(renameRegEx->PutFlags(MatchAllOccurences | UseRegularExpressions) == S_OK);
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"(f)oo") == S_OK);
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"$1-$YYYY-$MM-$DD") == S_OK);
+    Assert::IsTrue(renameRegEx->PutFileTime(SYSTEMTIME{ 2020, 7, 3, 22, 15, 6, 42, 453 }) == S_OK);
+
+    PWSTR result = nullptr;
+    Assert::IsTrue(renameRegEx->Replace(L"foo", &result) == S_OK);
+    Assert::AreEqual(L"f-2020-07-22", result);
+    CoTaskMemFree(result);
+}
+
+TEST_METHOD(VerifyFallbackForUnsupportedPatterns)
+{
+    // Backreferences are handled by std::wregex
+    SearchReplaceExpected sreTable[] = {
+        //search, replace, test, result
+        { L"(a)\\1", L"b", L"aab", L"bb" },
+    };
+    VerifyReplace(sreTable, ARRAYSIZE(sreTable), UseRegularExpressions | MatchAllOccurences);
+
+    // and so is lookbehind, which std::wregex does not support either
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    Assert::IsTrue(renameRegEx->PutFlags(UseRegularExpressions) == S_OK);
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"(?<=E12).*") == S_OK);
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"Foo") == S_OK);
+    PWSTR result = nullptr;
+    Assert::IsTrue(renameRegEx->Replace(L"AAAAAA", &result) == E_FAIL);
+    Assert::IsNull(result);
+}
+
+TEST_METHOD(VerifyPathologicalPattern)
+{
+    // Exponential for a backtracking engine
+    const std::wstring name = std::wstring(64, L'a') + L".txt";
+    SearchReplaceExpected sreTable[] = {
+        //search, replace, test, result
+        { L"(a+)+b", L"Foo", name.c_str(), name.c_str() },
+        { L"(a|aa)+$", L"Foo", name.c_str(), name.c_str() },
+    };
+    VerifyReplace(sreTable, ARRAYSIZE(sreTable), UseRegularExpressions | MatchAllOccurences);
+}
+    };
+
+    TEST_CLASS(LinearRegexTests)
+    {
+    public:
+        TEST_METHOD(CompileRejectsUnsupportedPatterns)
+        {
+            CLinearRegex regex;
+            Assert::IsTrue(regex.Compile(L"(a+)+b", true));
+            Assert::IsTrue(regex.IsValid());
+
+            PCWSTR unsupported[] = { L"(a)\\1", L"(?=a)", L"(?!a)", L"(?<=a)b", L"(a*)*", L"[[:alpha:]]", L"\\k<name>", L"a{2,1}", L"(a" };
+            for (PCWSTR pattern : unsupported)
+            {
+                Assert::IsFalse(regex.Compile(pattern, true));
+                Assert::IsFalse(regex.IsValid());
+            }
+        }
+
+        TEST_METHOD(SearchReportsCaptures)
+        {
+            CLinearRegex regex;
+            Assert::IsTrue(regex.Compile(L"(\\w+)\\.(jpe?g)|(png)", false));
+            Assert::IsTrue(regex.GetGroupCount() == 3);
+
+            std::vector<size_t> captures;
+            Assert::IsTrue(regex.Search(L"My photo.JPG", 0, captures));
+            Assert::IsTrue(captures[0] == 3 && captures[1] == 12);
+            Assert::IsTrue(captures[2] == 3 && captures[3] == 8);
+            Assert::IsTrue(captures[4] == 9 && captures[5] == 12);
+            Assert::IsTrue(captures[6] == CLinearRegex::npos);
+
+            Assert::IsFalse(regex.Search(L"notes.txt", 0, captures));
+        }
+    };
+}
@@ -188,6 +188,32 @@ TEST_METHOD(VerifyReplaceAllCaseInsensitive)
     }
 }
 
+TEST_METHOD(VerifyLiteralReplaceCaseInsensitive)
+{
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    DWORD flags = MatchAllOccurences;
+    Assert::IsTrue(renameRegEx->PutFlags(flags) == S_OK);
+
+    SearchReplaceExpected sreTable[] = {
+        { L"holiday", L"Trip", L"IMG_0001_HOLIDAY_Holiday_holiday.jpg", L"IMG_0001_Trip_Trip_Trip.jpg" },
+        { L"aa", L"b", L"AAAAA", L"bbA" },
+        { L"\u00C9T\u00C9", L"Summer", L"Photo \u00E9t\u00E9 2020.jpg", L"Photo Summer 2020.jpg" },
+        { L"jpg", L"png", L"Long file name with more than sixteen characters before the extension.JPG", L"Long file name with more than sixteen characters before the extension.png" },
+        { L"xyz", L"abc", L"No match in this name.txt", L"No match in this name.txt" },
+    };
+
+    for (int i = 0; i < ARRAYSIZE(sreTable); i++)
+    {
+        PWSTR result = nullptr;
+        Assert::IsTrue(renameRegEx->PutSearchTerm(sreTable[i].search) == S_OK);
+        Assert::IsTrue(renameRegEx->PutReplaceTerm(sreTable[i].replace) == S_OK);
+        Assert::IsTrue(renameRegEx->Replace(sreTable[i].test, &result) == S_OK);
+        Assert::IsTrue(wcscmp(result, sreTable[i].expected) == 0);
+        CoTaskMemFree(result);
+    }
+}
+
 TEST_METHOD(VerifyReplaceFirstOnlyUseRegEx)
 {
     CComPtr<IPowerRenameRegEx> renameRegEx;
@@ -466,6 +492,35 @@ TEST_METHOD (VerifyFileAttributesMonthandDayNames)
     }
 }
 
+TEST_METHOD(VerifyReplaceWithFileTime)
+{
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    CMockPowerRenameRegExEvents* mockEvents = new CMockPowerRenameRegExEvents();
+    CComPtr<IPowerRenameRegExEvents> regExEvents;
+    Assert::IsTrue(mockEvents->QueryInterface(IID_PPV_ARGS(&regExEvents)) == S_OK);
+    DWORD cookie = 0;
+    Assert::IsTrue(renameRegEx->Advise(regExEvents, &cookie) == S_OK);
+    Assert::IsTrue(renameRegEx->PutFlags(MatchAllOccurences | UseRegularExpressions) == S_OK);
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"(f)oo") == S_OK);
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"$1-$YYYY-$MM-$DD$D-$$$hh$$mm") == S_OK);
+
+    // Each call gets the fields from its own file time, escaped '$' and groups still work
+    PWSTR result = nullptr;
+    Assert::IsTrue(renameRegEx->ReplaceWithFileTime(L"foo", SYSTEMTIME{ 2020, 7, 3, 22, 15, 6, 42, 453 }, &result) == S_OK);
+    Assert::AreEqual(L"f-2020-07-2222-$15$mm", result);
+    CoTaskMemFree(result);
+    Assert::IsTrue(renameRegEx->ReplaceWithFileTime(L"foo", SYSTEMTIME{ 1999, 12, 5, 31, 9, 0, 0, 0 }, &result) == S_OK);
+    Assert::AreEqual(L"f-1999-12-3131-$09$mm", result);
+    CoTaskMemFree(result);
+
+    // The file time of the regex object is not changed, so no event fires
+    SYSTEMTIME noFileTime = { 0 };
+    Assert::IsTrue(memcmp(&mockEvents->m_fileTime, &noFileTime, sizeof(noFileTime)) == 0);
+    Assert::IsTrue(renameRegEx->UnAdvise(cookie) == S_OK);
+    mockEvents->Release();
+}
+
 TEST_METHOD(VerifyLookbehindFails)
 {
     // Standard Library Regex Engine does not support lookbehind, thus test should fail.
@@ -490,6 +545,36 @@ TEST_METHOD(VerifyLookbehindFails)
     }
 }
 
+TEST_METHOD(VerifyCachedPatternFollowsTermChanges)
+{
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    Assert::IsTrue(renameRegEx->PutFlags(MatchAllOccurences | UseRegularExpressions) == S_OK);
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"(\\d+)") == S_OK);
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"<$1>") == S_OK);
+
+    PWSTR result = nullptr;
+    Assert::IsTrue(renameRegEx->Replace(L"IMG_001_002.jpg", &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"IMG_<001>_<002>.jpg") == 0);
+    CoTaskMemFree(result);
+
+    // Each change of the search term, replace term or flags replaces the cached pattern
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"img_(\\d+)") == S_OK);
+    Assert::IsTrue(renameRegEx->Replace(L"IMG_001_002.jpg", &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"<001>_002.jpg") == 0);
+    CoTaskMemFree(result);
+
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"[$1]") == S_OK);
+    Assert::IsTrue(renameRegEx->Replace(L"IMG_001_002.jpg", &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"[001]_002.jpg") == 0);
+    CoTaskMemFree(result);
+
+    Assert::IsTrue(renameRegEx->PutFlags(MatchAllOccurences | UseRegularExpressions | CaseSensitive) == S_OK);
+    Assert::IsTrue(renameRegEx->Replace(L"IMG_001_002.jpg", &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"IMG_001_002.jpg") == 0);
+    CoTaskMemFree(result);
+}
+
 TEST_METHOD(VerifyEventsFire)
 {
     CComPtr<IPowerRenameRegEx> renameRegEx;
@@ -16,6 +16,7 @@ namespace Microsoft.PowerToys.Settings.UI.Library
             ShowIcon = new BoolProperty();
             ExtendedContextMenuOnly = new BoolProperty();
             UseBoostLib = new BoolProperty();
+            UseLinearRegex = new BoolProperty();
             Enabled = new BoolProperty();
         }
 
@@ -38,5 +39,8 @@ namespace Microsoft.PowerToys.Settings.UI.Library
 
         [JsonPropertyName("bool_use_boost_lib")]
         public BoolProperty UseBoostLib { get; set; }
+
+        [JsonPropertyName("bool_use_linear_regex")]
+        public BoolProperty UseLinearRegex { get; set; }
     }
 }
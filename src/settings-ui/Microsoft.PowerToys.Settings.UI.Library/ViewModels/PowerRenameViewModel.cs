@@ -68,6 +68,7 @@ namespace Microsoft.PowerToys.Settings.UI.Library.ViewModels
             _powerRenameMaxDispListNumValue = Settings.Properties.MaxMRUSize.Value;
             _autoComplete = Settings.Properties.MRUEnabled.Value;
             _powerRenameUseBoostLib = Settings.Properties.UseBoostLib.Value;
+            _powerRenameUseLinearRegex = Settings.Properties.UseLinearRegex.Value;
             _powerRenameEnabled = GeneralSettingsConfig.Enabled.PowerRename;
         }
 
@@ -78,6 +79,7 @@ namespace Microsoft.PowerToys.Settings.UI.Library.ViewModels
         private int _powerRenameMaxDispListNumValue;
         private bool _autoComplete;
         private bool _powerRenameUseBoostLib;
+        private bool _powerRenameUseLinearRegex;
 
         public bool IsEnabled
         {
@@ -219,6 +221,24 @@ namespace Microsoft.PowerToys.Settings.UI.Library.ViewModels
             }
         }
 
+        public bool UseLinearRegex
+        {
+            get
+            {
+                return _powerRenameUseLinearRegex;
+            }
+
+            set
+            {
+                if (value != _powerRenameUseLinearRegex)
+                {
+                    _powerRenameUseLinearRegex = value;
+                    Settings.Properties.UseLinearRegex.Value = value;
+                    RaisePropertyChanged();
+                }
+            }
+        }
+
         public string GetSettingsSubPath()
         {
             return _settingsConfigFileFolder + "\\" + ModuleName;